@@ -0,0 +1,143 @@
+/*
+ * Benchmarks for Huge-Page backed Arenas
+ * This builds two trees of identical shape and identical memory layout, one
+ * in an arena backed by regular pages, one in an arena backed by huge pages.
+ * It then compares the cost of random lookups in both.
+ *
+ * The effect only shows once the tree exceeds the reach of the TLB, that is,
+ * with several million nodes. Tree sizes grow by a factor of 4, from 500k up
+ * to 8M nodes by default. The largest tree size can be changed via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbarena.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_LOOKUPS 1000000
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+} Node;
+
+#define node_from_rb(_rb) ((Node *)((char *)(_rb) - offsetof(Node, rb)))
+
+static const char *backing_names[] = {
+        [C_RBARENA_BACKING_PAGES] = "regular pages",
+        [C_RBARENA_BACKING_THP] = "transparent huge pages",
+        [C_RBARENA_BACKING_HUGETLB] = "hugetlb pages",
+};
+
+static volatile CRBNode *sink;
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = node_from_rb(n);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void shuffle(unsigned long *keys, size_t n_memb) {
+        unsigned long t;
+        size_t i, j;
+
+        for (i = 0; i < n_memb; ++i) {
+                j = rand() % n_memb;
+                t = keys[j];
+                keys[j] = keys[i];
+                keys[i] = t;
+        }
+}
+
+static void bench_arena(CRBBench *b, const unsigned long *keys, size_t n_keys,
+                        const unsigned long *lookups, unsigned int flags) {
+        CRBNode **slot, *p;
+        CRBTree t = C_RBTREE_INIT;
+        CRBBenchSample s;
+        CRBArena a;
+        Node *node;
+        size_t i;
+        int r;
+
+        r = c_rbarena_init(&a, sizeof(Node), n_keys, flags);
+        assert(!r);
+
+        /* same insertion order for all arenas, so shape and layout match */
+        for (i = 0; i < n_keys; ++i) {
+                node = c_rbarena_alloc(&a);
+                assert(node);
+                node->key = keys[i];
+
+                slot = c_rbtree_find_slot(&t, compare, (void *)node->key, &p);
+                assert(slot);
+                c_rbtree_add(&t, p, slot, &node->rb);
+        }
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_LOOKUPS; ++i)
+                sink = c_rbtree_find_node(&t, compare, (void *)lookups[i]);
+        c_rbbench_stop(b, &s);
+
+        c_rbbench_print(backing_names[a.backing], &s, N_LOOKUPS);
+
+        c_rbarena_deinit(&a);
+}
+
+static void bench_size(CRBBench *b, size_t n_keys) {
+        unsigned long *keys, *lookups;
+        char title[64];
+        size_t i;
+
+        keys = malloc(n_keys * sizeof(*keys));
+        lookups = malloc(N_LOOKUPS * sizeof(*lookups));
+        assert(keys && lookups);
+
+        for (i = 0; i < n_keys; ++i)
+                keys[i] = i;
+        shuffle(keys, n_keys);
+
+        for (i = 0; i < N_LOOKUPS; ++i)
+                lookups[i] = rand() % n_keys;
+
+        snprintf(title, sizeof(title), "%zu nodes, lookup", n_keys);
+        c_rbbench_print_header(title);
+
+        bench_arena(b, keys, n_keys, lookups, 0);
+        bench_arena(b, keys, n_keys, lookups, C_RBARENA_FLAG_HUGEPAGES);
+
+        fprintf(stderr, "\n");
+
+        free(lookups);
+        free(keys);
+}
+
+int main(int argc, char **argv) {
+        size_t n, max = 8000000;
+        const char *e;
+        CRBBench b;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e)
+                max = strtoul(e, NULL, 10);
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        for (n = 500000; n <= max; n *= 4)
+                bench_size(&b, n);
+
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
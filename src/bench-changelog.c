@@ -0,0 +1,129 @@
+/*
+ * Benchmarks for Change Logs
+ * This keeps a tree of 1M nodes under churn, and exports it to a consumer
+ * after every round of changes, once via a full scan of the tree, and once
+ * via the change log. The churn per round ranges from 0.01% to 10% of the
+ * tree. The full scan costs the same regardless of churn, while reading the
+ * change log is proportional to it. The time is per round, and includes the
+ * changes themselves, as well as recording them in the change log.
+ *
+ * The number of nodes defaults to 1M, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbchangelog.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_ROUNDS 16
+
+typedef struct {
+        CRBNode rb;
+        uint64_t value;
+} Node;
+
+#define node_from_rb(_rb) c_rbnode_entry((_rb), Node, rb)
+
+static volatile uint64_t sink;
+
+static void churn(Node *nodes, size_t n_nodes, size_t n_churn, CRBChangelog *l) {
+        Node *node;
+        size_t i;
+
+        for (i = 0; i < n_churn; ++i) {
+                node = &nodes[rand() % n_nodes];
+                ++node->value;
+                if (l)
+                        c_rbchangelog_update(l, &node->rb);
+        }
+}
+
+static void bench_churn(CRBBench *b, CRBTree *t, Node *nodes, size_t n_nodes, size_t n_churn) {
+        CRBChange *ring, changes[256];
+        uint64_t seq = 0, sum = 0;
+        size_t i, j, n_read;
+        CRBBenchSample s;
+        char label[64];
+        CRBChangelog l;
+        CRBNode *n;
+        int r;
+
+        ring = malloc(n_churn * sizeof(*ring));
+        assert(ring);
+        c_rbchangelog_init(&l, ring, n_churn);
+
+        snprintf(label, sizeof(label), "%zu nodes, %zu changed", n_nodes, n_churn);
+        c_rbbench_print_header(label);
+
+        srand(n_churn);
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_ROUNDS; ++i) {
+                churn(nodes, n_nodes, n_churn, NULL);
+                c_rbtree_for_each(n, t)
+                        sum += node_from_rb(n)->value;
+        }
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("full scan", &s, N_ROUNDS);
+
+        srand(n_churn);
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_ROUNDS; ++i) {
+                churn(nodes, n_nodes, n_churn, &l);
+                do {
+                        r = c_rbchangelog_read(&l, &seq, changes, sizeof(changes) / sizeof(*changes), &n_read);
+                        assert(!r);
+                        for (j = 0; j < n_read; ++j)
+                                sum += node_from_rb(changes[j].node)->value;
+                } while (n_read);
+        }
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("change log", &s, N_ROUNDS);
+
+        sink = sum;
+        fprintf(stderr, "\n");
+
+        free(ring);
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_nodes = 1000000, max;
+        CRBTree t = C_RBTREE_INIT;
+        CRBNode **sorted;
+        CRBBench b;
+        const char *e;
+        Node *nodes;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_nodes = n_nodes < max ? n_nodes : max;
+        }
+
+        c_rbbench_init(&b);
+
+        nodes = calloc(n_nodes, sizeof(*nodes));
+        sorted = malloc(n_nodes * sizeof(*sorted));
+        assert(nodes && sorted);
+
+        for (i = 0; i < n_nodes; ++i)
+                sorted[i] = &nodes[i].rb;
+        c_rbtree_build(&t, sorted, n_nodes);
+
+        bench_churn(&b, &t, nodes, n_nodes, n_nodes / 10000 + 1);
+        bench_churn(&b, &t, nodes, n_nodes, n_nodes / 100 + 1);
+        bench_churn(&b, &t, nodes, n_nodes, n_nodes / 10 + 1);
+
+        free(sorted);
+        free(nodes);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
@@ -0,0 +1,1122 @@
+/*
+ * Benchmarks to compare against other Ordered Containers
+ * This runs the same workloads on c-rbtree and a set of alternative ordered
+ * containers, to show where an RB-Tree is (or is not) the right choice:
+ *
+ *   o tsearch(3p): The POSIX tree API, see test-posix.c for details.
+ *
+ *   o AVL-Tree: A simple, recursive AVL-Tree without parent pointers. It is
+ *               more strictly balanced than an RB-Tree, hence lookups tend to
+ *               be cheaper, while modifications tend to be more expensive.
+ *
+ *   o Skip-List: A probabilistic skip-list with a branching factor of 4.
+ *
+ *   o B-Tree: A B-Tree with up to 15 keys per node, stored inline. It trades
+ *             pointer chasing for linear scans within a node.
+ *
+ *   o Sorted Array: A plain sorted array with binary search. Modifications
+ *                   are O(n), so they are only measured on small sizes.
+ *
+ * All containers store unsigned long keys, and all of them allocate one entry
+ * per key via malloc(3) (including c-rbtree, which embeds its node in the
+ * entry), so time and memory consumption are comparable. Memory is measured
+ * via mallinfo2(3), and thus includes allocator overhead.
+ *
+ * The workloads are:
+ *
+ *   o random: Insert, lookup, and remove keys in random order.
+ *
+ *   o sequential: Insert, lookup, and remove keys in ascending order.
+ *
+ *   o zipf: Lookup keys of a filled container with a Zipfian distribution
+ *           (s = 0.99), so a small set of keys is hot.
+ *
+ *   o churn: Remove a random key from a filled container and insert a new key
+ *            in its place, keeping the size stable.
+ *
+ * Sizes range from 1000 entries to CRBTREE_BENCH_MAX (default: 1M) entries, in
+ * steps of 10x.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <malloc.h>
+#include <math.h>
+#include <search.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define SORTED_MAX_MODIFY 100000
+#define ZIPF_S 0.99
+
+typedef struct {
+        const char *name;
+        void *(*new) (void);
+        void (*free) (void *c);
+        void (*load) (void *c, const unsigned long *keys, size_t n_keys);
+        void (*insert) (void *c, unsigned long key);
+        bool (*find) (void *c, unsigned long key);
+        void (*remove) (void *c, unsigned long key);
+        size_t max_modify;
+} Container;
+
+static void shuffle(unsigned long *keys, size_t n_memb) {
+        unsigned long t;
+        size_t i, j;
+
+        for (i = 0; i < n_memb; ++i) {
+                j = rand() % n_memb;
+                t = keys[j];
+                keys[j] = keys[i];
+                keys[i] = t;
+        }
+}
+
+static unsigned long mix(unsigned long v) {
+        uint64_t x = v;
+
+        /* splitmix64 finalizer; it is bijective, so keys stay unique */
+        x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+        x = x ^ (x >> 31);
+        return (unsigned long)x;
+}
+
+static size_t heap_usage(void) {
+        struct mallinfo2 mi = mallinfo2();
+
+        return mi.uordblks + mi.hblkhd;
+}
+
+/*
+ * c-rbtree
+ */
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+} RBNode;
+
+#define rbnode_from_rb(_rb) ((RBNode *)((char *)(_rb) - offsetof(RBNode, rb)))
+
+static int rbtree_compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = *(unsigned long *)k;
+        RBNode *node = rbnode_from_rb(n);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void *rbtree_new(void) {
+        CRBTree *t;
+
+        t = malloc(sizeof(*t));
+        assert(t);
+        c_rbtree_init(t);
+        return t;
+}
+
+static void rbtree_free(void *c) {
+        CRBTree *t = c;
+        RBNode *node, *safe;
+
+        c_rbtree_for_each_entry_safe_postorder_unlink(node, safe, t, rb)
+                free(node);
+        free(t);
+}
+
+static void rbtree_insert(void *c, unsigned long key) {
+        CRBNode **slot, *p;
+        CRBTree *t = c;
+        RBNode *node;
+
+        slot = c_rbtree_find_slot(t, rbtree_compare, &key, &p);
+        assert(slot);
+
+        node = malloc(sizeof(*node));
+        assert(node);
+        node->key = key;
+        c_rbtree_add(t, p, slot, &node->rb);
+}
+
+static bool rbtree_find(void *c, unsigned long key) {
+        return !!c_rbtree_find_node(c, rbtree_compare, &key);
+}
+
+static void rbtree_remove(void *c, unsigned long key) {
+        RBNode *node;
+
+        node = c_rbtree_find_entry(c, rbtree_compare, &key, RBNode, rb);
+        assert(node);
+        c_rbnode_unlink(&node->rb);
+        free(node);
+}
+
+/*
+ * tsearch(3p)
+ *
+ * Keys are stored directly in the key-pointer, so tsearch(3p) allocates its
+ * own node only.
+ */
+
+typedef struct {
+        void *root;
+} PosixTree;
+
+static int posix_compare(const void *a, const void *b) {
+        unsigned long x = (unsigned long)a, y = (unsigned long)b;
+
+        return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void posix_noop(void *p) {
+}
+
+static void *posix_new(void) {
+        PosixTree *t;
+
+        t = calloc(1, sizeof(*t));
+        assert(t);
+        return t;
+}
+
+static void posix_free(void *c) {
+        PosixTree *t = c;
+
+        tdestroy(t->root, posix_noop);
+        free(t);
+}
+
+static void posix_insert(void *c, unsigned long key) {
+        PosixTree *t = c;
+        void *res;
+
+        res = tsearch((void *)key, &t->root, posix_compare);
+        assert(res && *(void **)res == (void *)key);
+}
+
+static bool posix_find(void *c, unsigned long key) {
+        PosixTree *t = c;
+
+        return !!tfind((void *)key, &t->root, posix_compare);
+}
+
+static void posix_remove(void *c, unsigned long key) {
+        PosixTree *t = c;
+        void *res;
+
+        res = tdelete((void *)key, &t->root, posix_compare);
+        assert(res);
+}
+
+/*
+ * AVL-Tree
+ */
+
+typedef struct AvlNode AvlNode;
+
+struct AvlNode {
+        unsigned long key;
+        AvlNode *left;
+        AvlNode *right;
+        int height;
+};
+
+typedef struct {
+        AvlNode *root;
+} AvlTree;
+
+static int avl_height(AvlNode *n) {
+        return n ? n->height : 0;
+}
+
+static void avl_update(AvlNode *n) {
+        int l = avl_height(n->left), r = avl_height(n->right);
+
+        n->height = 1 + (l > r ? l : r);
+}
+
+static AvlNode *avl_rotate_left(AvlNode *n) {
+        AvlNode *r = n->right;
+
+        n->right = r->left;
+        r->left = n;
+        avl_update(n);
+        avl_update(r);
+        return r;
+}
+
+static AvlNode *avl_rotate_right(AvlNode *n) {
+        AvlNode *l = n->left;
+
+        n->left = l->right;
+        l->right = n;
+        avl_update(n);
+        avl_update(l);
+        return l;
+}
+
+static AvlNode *avl_balance(AvlNode *n) {
+        int balance;
+
+        avl_update(n);
+        balance = avl_height(n->left) - avl_height(n->right);
+
+        if (balance > 1) {
+                if (avl_height(n->left->left) < avl_height(n->left->right))
+                        n->left = avl_rotate_left(n->left);
+                return avl_rotate_right(n);
+        } else if (balance < -1) {
+                if (avl_height(n->right->right) < avl_height(n->right->left))
+                        n->right = avl_rotate_right(n->right);
+                return avl_rotate_left(n);
+        }
+
+        return n;
+}
+
+static AvlNode *avl_insert_node(AvlNode *n, AvlNode *node) {
+        if (!n)
+                return node;
+
+        if (node->key < n->key)
+                n->left = avl_insert_node(n->left, node);
+        else
+                n->right = avl_insert_node(n->right, node);
+
+        return avl_balance(n);
+}
+
+static AvlNode *avl_remove_min(AvlNode *n, AvlNode **minp) {
+        if (!n->left) {
+                *minp = n;
+                return n->right;
+        }
+
+        n->left = avl_remove_min(n->left, minp);
+        return avl_balance(n);
+}
+
+static AvlNode *avl_remove_node(AvlNode *n, unsigned long key) {
+        AvlNode *l, *r, *min;
+
+        assert(n);
+
+        if (key < n->key) {
+                n->left = avl_remove_node(n->left, key);
+        } else if (key > n->key) {
+                n->right = avl_remove_node(n->right, key);
+        } else {
+                l = n->left;
+                r = n->right;
+                free(n);
+
+                if (!r)
+                        return l;
+
+                r = avl_remove_min(r, &min);
+                min->left = l;
+                min->right = r;
+                n = min;
+        }
+
+        return avl_balance(n);
+}
+
+static void avl_free_node(AvlNode *n) {
+        if (n) {
+                avl_free_node(n->left);
+                avl_free_node(n->right);
+                free(n);
+        }
+}
+
+static void *avl_new(void) {
+        AvlTree *t;
+
+        t = calloc(1, sizeof(*t));
+        assert(t);
+        return t;
+}
+
+static void avl_free(void *c) {
+        AvlTree *t = c;
+
+        avl_free_node(t->root);
+        free(t);
+}
+
+static void avl_insert(void *c, unsigned long key) {
+        AvlTree *t = c;
+        AvlNode *node;
+
+        node = malloc(sizeof(*node));
+        assert(node);
+        *node = (AvlNode){ .key = key, .height = 1 };
+        t->root = avl_insert_node(t->root, node);
+}
+
+static bool avl_find(void *c, unsigned long key) {
+        AvlTree *t = c;
+        AvlNode *n = t->root;
+
+        while (n && n->key != key)
+                n = (key < n->key) ? n->left : n->right;
+
+        return !!n;
+}
+
+static void avl_remove(void *c, unsigned long key) {
+        AvlTree *t = c;
+
+        t->root = avl_remove_node(t->root, key);
+}
+
+/*
+ * Skip-List
+ */
+
+#define SKIP_MAX 32
+
+typedef struct SkipNode SkipNode;
+
+struct SkipNode {
+        unsigned long key;
+        SkipNode *next[];
+};
+
+typedef struct {
+        SkipNode *head[SKIP_MAX];
+        unsigned int level;
+        uint64_t seed;
+} SkipList;
+
+static unsigned int skip_level(SkipList *l) {
+        unsigned int level = 1;
+        uint64_t r;
+
+        /* xorshift64; cheaper than rand(3), and does not disturb its sequence */
+        l->seed ^= l->seed << 13;
+        l->seed ^= l->seed >> 7;
+        l->seed ^= l->seed << 17;
+        r = l->seed;
+
+        while (level < SKIP_MAX && !(r & 3)) {
+                ++level;
+                r >>= 2;
+        }
+
+        return level;
+}
+
+static SkipNode **skip_search(SkipList *l, unsigned long key, SkipNode ***update) {
+        SkipNode **next = l->head;
+        unsigned int i;
+
+        for (i = l->level; i-- > 0; ) {
+                while (next[i] && next[i]->key < key)
+                        next = next[i]->next;
+                if (update)
+                        update[i] = next;
+        }
+
+        return next;
+}
+
+static void *skip_new(void) {
+        SkipList *l;
+
+        l = calloc(1, sizeof(*l));
+        assert(l);
+        l->seed = 0xdeadbeef;
+        return l;
+}
+
+static void skip_free(void *c) {
+        SkipList *l = c;
+        SkipNode *n, *next;
+
+        for (n = l->head[0]; n; n = next) {
+                next = n->next[0];
+                free(n);
+        }
+        free(l);
+}
+
+static void skip_insert(void *c, unsigned long key) {
+        SkipNode **update[SKIP_MAX];
+        unsigned int i, level;
+        SkipList *l = c;
+        SkipNode *node;
+
+        skip_search(l, key, update);
+
+        level = skip_level(l);
+        for (i = l->level; i < level; ++i)
+                update[i] = l->head;
+        if (level > l->level)
+                l->level = level;
+
+        node = malloc(sizeof(*node) + level * sizeof(*node->next));
+        assert(node);
+        node->key = key;
+
+        for (i = 0; i < level; ++i) {
+                node->next[i] = update[i][i];
+                update[i][i] = node;
+        }
+}
+
+static bool skip_find(void *c, unsigned long key) {
+        SkipNode **next;
+
+        next = skip_search(c, key, NULL);
+        return next[0] && next[0]->key == key;
+}
+
+static void skip_remove(void *c, unsigned long key) {
+        SkipNode **update[SKIP_MAX], **next, *node;
+        SkipList *l = c;
+        unsigned int i;
+
+        next = skip_search(l, key, update);
+        node = next[0];
+        assert(node && node->key == key);
+
+        for (i = 0; i < l->level && update[i][i] == node; ++i)
+                update[i][i] = node->next[i];
+        while (l->level > 0 && !l->head[l->level - 1])
+                --l->level;
+
+        free(node);
+}
+
+/*
+ * B-Tree
+ *
+ * This follows the classic top-down algorithms, which split full nodes on the
+ * way down during insertion, and refill minimal nodes on the way down during
+ * removal. Leaves are allocated without room for child pointers.
+ */
+
+#define BTREE_T 8
+#define BTREE_MAX (2 * BTREE_T - 1)
+
+typedef struct BTreeNode BTreeNode;
+
+struct BTreeNode {
+        unsigned int n_keys;
+        bool leaf;
+        unsigned long keys[BTREE_MAX];
+        BTreeNode *children[];
+};
+
+typedef struct {
+        BTreeNode *root;
+} BTree;
+
+static BTreeNode *btree_node_new(bool leaf) {
+        BTreeNode *n;
+
+        n = malloc(sizeof(*n) + (leaf ? 0 : (BTREE_MAX + 1) * sizeof(*n->children)));
+        assert(n);
+        n->n_keys = 0;
+        n->leaf = leaf;
+        return n;
+}
+
+static void btree_node_free(BTreeNode *n) {
+        unsigned int i;
+
+        if (!n->leaf)
+                for (i = 0; i <= n->n_keys; ++i)
+                        btree_node_free(n->children[i]);
+        free(n);
+}
+
+static unsigned int btree_pos(BTreeNode *n, unsigned long key) {
+        unsigned int i = 0;
+
+        while (i < n->n_keys && n->keys[i] < key)
+                ++i;
+
+        return i;
+}
+
+static void btree_split(BTreeNode *x, unsigned int i) {
+        BTreeNode *y = x->children[i], *z;
+
+        /* split the full child @i of @x, moving its median up into @x */
+        z = btree_node_new(y->leaf);
+        z->n_keys = BTREE_T - 1;
+        memcpy(z->keys, y->keys + BTREE_T, (BTREE_T - 1) * sizeof(*z->keys));
+        if (!y->leaf)
+                memcpy(z->children, y->children + BTREE_T, BTREE_T * sizeof(*z->children));
+        y->n_keys = BTREE_T - 1;
+
+        memmove(x->children + i + 2, x->children + i + 1, (x->n_keys - i) * sizeof(*x->children));
+        memmove(x->keys + i + 1, x->keys + i, (x->n_keys - i) * sizeof(*x->keys));
+        x->children[i + 1] = z;
+        x->keys[i] = y->keys[BTREE_T - 1];
+        ++x->n_keys;
+}
+
+static void btree_merge(BTreeNode *x, unsigned int i) {
+        BTreeNode *y = x->children[i], *z = x->children[i + 1];
+
+        /* merge child @i+1 and separator @i of @x into child @i */
+        y->keys[BTREE_T - 1] = x->keys[i];
+        memcpy(y->keys + BTREE_T, z->keys, z->n_keys * sizeof(*y->keys));
+        if (!y->leaf)
+                memcpy(y->children + BTREE_T, z->children, (z->n_keys + 1) * sizeof(*y->children));
+        y->n_keys = BTREE_MAX;
+
+        memmove(x->keys + i, x->keys + i + 1, (x->n_keys - i - 1) * sizeof(*x->keys));
+        memmove(x->children + i + 1, x->children + i + 2, (x->n_keys - i - 1) * sizeof(*x->children));
+        --x->n_keys;
+
+        free(z);
+}
+
+static void btree_refill(BTreeNode *x, unsigned int i) {
+        BTreeNode *c = x->children[i], *s;
+
+        /* make sure child @i of @x has at least BTREE_T keys */
+        if (i > 0 && x->children[i - 1]->n_keys >= BTREE_T) {
+                s = x->children[i - 1];
+
+                memmove(c->keys + 1, c->keys, c->n_keys * sizeof(*c->keys));
+                if (!c->leaf)
+                        memmove(c->children + 1, c->children, (c->n_keys + 1) * sizeof(*c->children));
+
+                c->keys[0] = x->keys[i - 1];
+                if (!c->leaf)
+                        c->children[0] = s->children[s->n_keys];
+                x->keys[i - 1] = s->keys[s->n_keys - 1];
+
+                --s->n_keys;
+                ++c->n_keys;
+        } else if (i < x->n_keys && x->children[i + 1]->n_keys >= BTREE_T) {
+                s = x->children[i + 1];
+
+                c->keys[c->n_keys] = x->keys[i];
+                if (!c->leaf)
+                        c->children[c->n_keys + 1] = s->children[0];
+                x->keys[i] = s->keys[0];
+
+                memmove(s->keys, s->keys + 1, (s->n_keys - 1) * sizeof(*s->keys));
+                if (!s->leaf)
+                        memmove(s->children, s->children + 1, s->n_keys * sizeof(*s->children));
+
+                --s->n_keys;
+                ++c->n_keys;
+        } else if (i < x->n_keys) {
+                btree_merge(x, i);
+        } else {
+                btree_merge(x, i - 1);
+        }
+}
+
+static void *btree_new(void) {
+        BTree *t;
+
+        t = calloc(1, sizeof(*t));
+        assert(t);
+        return t;
+}
+
+static void btree_free(void *c) {
+        BTree *t = c;
+
+        if (t->root)
+                btree_node_free(t->root);
+        free(t);
+}
+
+static void btree_insert(void *c, unsigned long key) {
+        BTree *t = c;
+        BTreeNode *x;
+        unsigned int i;
+
+        if (!t->root)
+                t->root = btree_node_new(true);
+
+        if (t->root->n_keys == BTREE_MAX) {
+                x = btree_node_new(false);
+                x->children[0] = t->root;
+                t->root = x;
+                btree_split(x, 0);
+        }
+
+        x = t->root;
+        for (;;) {
+                i = btree_pos(x, key);
+
+                if (x->leaf) {
+                        memmove(x->keys + i + 1, x->keys + i, (x->n_keys - i) * sizeof(*x->keys));
+                        x->keys[i] = key;
+                        ++x->n_keys;
+                        return;
+                }
+
+                if (x->children[i]->n_keys == BTREE_MAX) {
+                        btree_split(x, i);
+                        if (key > x->keys[i])
+                                ++i;
+                }
+
+                x = x->children[i];
+        }
+}
+
+static bool btree_find(void *c, unsigned long key) {
+        BTree *t = c;
+        BTreeNode *x;
+        unsigned int i;
+
+        for (x = t->root; x; x = x->leaf ? NULL : x->children[i]) {
+                i = btree_pos(x, key);
+                if (i < x->n_keys && x->keys[i] == key)
+                        return true;
+        }
+
+        return false;
+}
+
+static void btree_remove(void *c, unsigned long key) {
+        BTreeNode *x, *y;
+        BTree *t = c;
+        unsigned int i;
+
+        x = t->root;
+        assert(x);
+
+        for (;;) {
+                i = btree_pos(x, key);
+
+                if (i < x->n_keys && x->keys[i] == key) {
+                        if (x->leaf) {
+                                memmove(x->keys + i, x->keys + i + 1, (x->n_keys - i - 1) * sizeof(*x->keys));
+                                --x->n_keys;
+                                break;
+                        }
+
+                        if (x->children[i]->n_keys >= BTREE_T) {
+                                /* replace by predecessor, then remove that */
+                                for (y = x->children[i]; !y->leaf; y = y->children[y->n_keys])
+                                        ;
+                                key = y->keys[y->n_keys - 1];
+                                x->keys[i] = key;
+                                x = x->children[i];
+                        } else if (x->children[i + 1]->n_keys >= BTREE_T) {
+                                /* replace by successor, then remove that */
+                                for (y = x->children[i + 1]; !y->leaf; y = y->children[0])
+                                        ;
+                                key = y->keys[0];
+                                x->keys[i] = key;
+                                x = x->children[i + 1];
+                        } else {
+                                btree_merge(x, i);
+                                x = x->children[i];
+                        }
+                } else {
+                        assert(!x->leaf);
+
+                        if (x->children[i]->n_keys < BTREE_T) {
+                                btree_refill(x, i);
+                                if (i > x->n_keys)
+                                        i = x->n_keys;
+                        }
+
+                        x = x->children[i];
+                }
+        }
+
+        /* shrink the tree if the root ran empty */
+        x = t->root;
+        if (!x->n_keys) {
+                t->root = x->leaf ? NULL : x->children[0];
+                free(x);
+        }
+}
+
+/*
+ * Sorted Array
+ */
+
+typedef struct {
+        unsigned long *keys;
+        size_t n_keys;
+        size_t n_alloc;
+} SortedArray;
+
+static int sorted_compare(const void *a, const void *b) {
+        unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+
+        return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static size_t sorted_pos(SortedArray *a, unsigned long key) {
+        size_t l = 0, r = a->n_keys, m;
+
+        while (l < r) {
+                m = l + (r - l) / 2;
+                if (a->keys[m] < key)
+                        l = m + 1;
+                else
+                        r = m;
+        }
+
+        return l;
+}
+
+static void sorted_reserve(SortedArray *a, size_t n) {
+        if (n > a->n_alloc) {
+                a->n_alloc = a->n_alloc ? a->n_alloc : 16;
+                while (a->n_alloc < n)
+                        a->n_alloc *= 2;
+                a->keys = realloc(a->keys, a->n_alloc * sizeof(*a->keys));
+                assert(a->keys);
+        }
+}
+
+static void *sorted_new(void) {
+        SortedArray *a;
+
+        a = calloc(1, sizeof(*a));
+        assert(a);
+        return a;
+}
+
+static void sorted_free(void *c) {
+        SortedArray *a = c;
+
+        free(a->keys);
+        free(a);
+}
+
+static void sorted_load(void *c, const unsigned long *keys, size_t n_keys) {
+        SortedArray *a = c;
+
+        sorted_reserve(a, a->n_keys + n_keys);
+        memcpy(a->keys + a->n_keys, keys, n_keys * sizeof(*keys));
+        a->n_keys += n_keys;
+        qsort(a->keys, a->n_keys, sizeof(*a->keys), sorted_compare);
+}
+
+static void sorted_insert(void *c, unsigned long key) {
+        SortedArray *a = c;
+        size_t i;
+
+        sorted_reserve(a, a->n_keys + 1);
+        i = sorted_pos(a, key);
+        memmove(a->keys + i + 1, a->keys + i, (a->n_keys - i) * sizeof(*a->keys));
+        a->keys[i] = key;
+        ++a->n_keys;
+}
+
+static bool sorted_find(void *c, unsigned long key) {
+        SortedArray *a = c;
+        size_t i;
+
+        i = sorted_pos(a, key);
+        return i < a->n_keys && a->keys[i] == key;
+}
+
+static void sorted_remove(void *c, unsigned long key) {
+        SortedArray *a = c;
+        size_t i;
+
+        i = sorted_pos(a, key);
+        assert(i < a->n_keys && a->keys[i] == key);
+        memmove(a->keys + i, a->keys + i + 1, (a->n_keys - i - 1) * sizeof(*a->keys));
+        --a->n_keys;
+}
+
+/*
+ * Workloads
+ *
+ * Every workload runs on each container in turn. Key sequences are generated
+ * up-front, so the timed sections contain the container operations only.
+ */
+
+static const Container containers[] = {
+        {
+                .name = "c-rbtree",
+                .new = rbtree_new,
+                .free = rbtree_free,
+                .insert = rbtree_insert,
+                .find = rbtree_find,
+                .remove = rbtree_remove,
+                .max_modify = SIZE_MAX,
+        },
+        {
+                .name = "tsearch(3p)",
+                .new = posix_new,
+                .free = posix_free,
+                .insert = posix_insert,
+                .find = posix_find,
+                .remove = posix_remove,
+                .max_modify = SIZE_MAX,
+        },
+        {
+                .name = "avl",
+                .new = avl_new,
+                .free = avl_free,
+                .insert = avl_insert,
+                .find = avl_find,
+                .remove = avl_remove,
+                .max_modify = SIZE_MAX,
+        },
+        {
+                .name = "skiplist",
+                .new = skip_new,
+                .free = skip_free,
+                .insert = skip_insert,
+                .find = skip_find,
+                .remove = skip_remove,
+                .max_modify = SIZE_MAX,
+        },
+        {
+                .name = "btree",
+                .new = btree_new,
+                .free = btree_free,
+                .insert = btree_insert,
+                .find = btree_find,
+                .remove = btree_remove,
+                .max_modify = SIZE_MAX,
+        },
+        {
+                .name = "sorted-array",
+                .new = sorted_new,
+                .free = sorted_free,
+                .load = sorted_load,
+                .insert = sorted_insert,
+                .find = sorted_find,
+                .remove = sorted_remove,
+                .max_modify = SORTED_MAX_MODIFY,
+        },
+};
+
+typedef struct {
+        CRBBench bench;
+        size_t n_keys;
+        unsigned long *random;
+        unsigned long *sequential;
+        unsigned long *lookups;
+        unsigned long *zipf;
+        size_t *churn_slots;
+        unsigned long *churn_keys;
+        unsigned long *pool;
+} Context;
+
+static void fill(const Container *c, void *container, const unsigned long *keys, size_t n_keys) {
+        size_t i;
+
+        if (c->load) {
+                c->load(container, keys, n_keys);
+        } else {
+                for (i = 0; i < n_keys; ++i)
+                        c->insert(container, keys[i]);
+        }
+}
+
+static void print(const Container *c, const char *workload, const char *op,
+                  const CRBBenchSample *s, size_t n_ops) {
+        char label[64];
+
+        snprintf(label, sizeof(label), "%s %s %s", c->name, workload, op);
+        c_rbbench_print(label, s, n_ops);
+}
+
+static void run_ordered(Context *ctx, const Container *c, const char *workload,
+                        const unsigned long *keys, const unsigned long *lookups,
+                        double *memoryp) {
+        bool modify = ctx->n_keys <= c->max_modify;
+        size_t i, n = ctx->n_keys, heap;
+        CRBBenchSample s;
+        void *container;
+
+        heap = heap_usage();
+        container = c->new();
+
+        if (modify) {
+                c_rbbench_start(&ctx->bench, &s);
+                for (i = 0; i < n; ++i)
+                        c->insert(container, keys[i]);
+                c_rbbench_stop(&ctx->bench, &s);
+                print(c, workload, "insert", &s, n);
+        } else {
+                fill(c, container, keys, n);
+        }
+
+        if (memoryp)
+                *memoryp = (double)(heap_usage() - heap) / n;
+
+        c_rbbench_start(&ctx->bench, &s);
+        for (i = 0; i < n; ++i)
+                if (!c->find(container, lookups[i]))
+                        assert(0);
+        c_rbbench_stop(&ctx->bench, &s);
+        print(c, workload, "lookup", &s, n);
+
+        if (modify) {
+                c_rbbench_start(&ctx->bench, &s);
+                for (i = 0; i < n; ++i)
+                        c->remove(container, lookups[i]);
+                c_rbbench_stop(&ctx->bench, &s);
+                print(c, workload, "remove", &s, n);
+        }
+
+        c->free(container);
+}
+
+static void run_zipf(Context *ctx, const Container *c) {
+        size_t i, n = ctx->n_keys;
+        CRBBenchSample s;
+        void *container;
+
+        container = c->new();
+        fill(c, container, ctx->random, n);
+
+        c_rbbench_start(&ctx->bench, &s);
+        for (i = 0; i < n; ++i)
+                if (!c->find(container, ctx->zipf[i]))
+                        assert(0);
+        c_rbbench_stop(&ctx->bench, &s);
+        print(c, "zipf", "lookup", &s, n);
+
+        c->free(container);
+}
+
+static void run_churn(Context *ctx, const Container *c) {
+        size_t i, n = ctx->n_keys;
+        CRBBenchSample s;
+        void *container;
+
+        if (n > c->max_modify)
+                return;
+
+        container = c->new();
+        fill(c, container, ctx->random, n);
+        memcpy(ctx->pool, ctx->random, n * sizeof(*ctx->pool));
+
+        c_rbbench_start(&ctx->bench, &s);
+        for (i = 0; i < n; ++i) {
+                c->remove(container, ctx->pool[ctx->churn_slots[i]]);
+                c->insert(container, ctx->churn_keys[i]);
+                ctx->pool[ctx->churn_slots[i]] = ctx->churn_keys[i];
+        }
+        c_rbbench_stop(&ctx->bench, &s);
+        print(c, "churn", "remove+insert", &s, n);
+
+        c->free(container);
+}
+
+static void setup_zipf(Context *ctx) {
+        size_t i, l, r, m, n = ctx->n_keys;
+        double *cdf, sum = 0, u;
+
+        cdf = malloc(n * sizeof(*cdf));
+        assert(cdf);
+
+        for (i = 0; i < n; ++i) {
+                sum += 1.0 / pow(i + 1, ZIPF_S);
+                cdf[i] = sum;
+        }
+
+        /* rank i maps to random[i], so hot keys are scattered across the tree */
+        for (i = 0; i < n; ++i) {
+                u = (double)rand() / ((double)RAND_MAX + 1) * sum;
+                for (l = 0, r = n - 1; l < r; ) {
+                        m = l + (r - l) / 2;
+                        if (cdf[m] < u)
+                                l = m + 1;
+                        else
+                                r = m;
+                }
+                ctx->zipf[i] = ctx->random[l];
+        }
+
+        free(cdf);
+}
+
+static void bench_size(Context *ctx, size_t n_keys) {
+        double memory[sizeof(containers) / sizeof(*containers)];
+        char title[64];
+        size_t i;
+
+        ctx->n_keys = n_keys;
+        ctx->random = malloc(n_keys * sizeof(*ctx->random));
+        ctx->sequential = malloc(n_keys * sizeof(*ctx->sequential));
+        ctx->lookups = malloc(n_keys * sizeof(*ctx->lookups));
+        ctx->zipf = malloc(n_keys * sizeof(*ctx->zipf));
+        ctx->churn_slots = malloc(n_keys * sizeof(*ctx->churn_slots));
+        ctx->churn_keys = malloc(n_keys * sizeof(*ctx->churn_keys));
+        ctx->pool = malloc(n_keys * sizeof(*ctx->pool));
+        assert(ctx->random && ctx->sequential && ctx->lookups && ctx->zipf &&
+               ctx->churn_slots && ctx->churn_keys && ctx->pool);
+
+        for (i = 0; i < n_keys; ++i) {
+                ctx->random[i] = mix(i);
+                ctx->sequential[i] = i;
+                ctx->lookups[i] = ctx->random[i];
+                ctx->churn_slots[i] = rand() % n_keys;
+                ctx->churn_keys[i] = mix(n_keys + i);
+        }
+        shuffle(ctx->lookups, n_keys);
+        setup_zipf(ctx);
+
+        snprintf(title, sizeof(title), "%zu entries", n_keys);
+        c_rbbench_print_header(title);
+
+        for (i = 0; i < sizeof(containers) / sizeof(*containers); ++i)
+                run_ordered(ctx, &containers[i], "random", ctx->random, ctx->lookups, &memory[i]);
+        for (i = 0; i < sizeof(containers) / sizeof(*containers); ++i)
+                run_ordered(ctx, &containers[i], "sequential", ctx->sequential, ctx->sequential, NULL);
+        for (i = 0; i < sizeof(containers) / sizeof(*containers); ++i)
+                run_zipf(ctx, &containers[i]);
+        for (i = 0; i < sizeof(containers) / sizeof(*containers); ++i)
+                run_churn(ctx, &containers[i]);
+
+        fprintf(stderr, "\n%-32s %10s\n", title, "bytes/entry");
+        for (i = 0; i < sizeof(containers) / sizeof(*containers); ++i)
+                fprintf(stderr, "%-32s %10.2f\n", containers[i].name, memory[i]);
+        fprintf(stderr, "\n");
+
+        free(ctx->pool);
+        free(ctx->churn_keys);
+        free(ctx->churn_slots);
+        free(ctx->zipf);
+        free(ctx->lookups);
+        free(ctx->sequential);
+        free(ctx->random);
+}
+
+int main(int argc, char **argv) {
+        size_t n, max = 1000000;
+        Context ctx = {};
+        const char *e;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e)
+                max = strtoul(e, NULL, 10);
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&ctx.bench);
+
+        for (n = 1000; n <= max; n *= 10)
+                bench_size(&ctx, n);
+
+        c_rbbench_deinit(&ctx.bench);
+
+        return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Benchmarks for EEVDF Queues
+ * This simulates a scheduler with thousands of runnable entities of equal
+ * weight, but with request sizes spread over 1/8 to 8 times a base slice. The
+ * virtual time is the average virtual start time. Each step picks the next
+ * entity, lets it run for its full request, and requeues it with its old
+ * deadline as new start time. Entities with short requests thus have early
+ * deadlines, but often are not eligible yet.
+ *
+ * The pick via c_rbeevdf_pick() is compared to the naive approach, which
+ * walks the tree in deadline order until it finds the first eligible entity.
+ * Both make the same decisions. The number of picks defaults to 1M, and can be
+ * capped via the CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbeevdf.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define SLICE 1000
+
+#define entry_from_rb(_rb) c_rbnode_entry((_rb), CRBEevdfEntry, rb)
+
+static CRBEevdfEntry *scan(CRBEevdf *q, uint64_t vtime, size_t *n_passed) {
+        CRBNode *n;
+
+        c_rbtree_for_each(n, &q->tree) {
+                if (entry_from_rb(n)->vstart <= vtime)
+                        return entry_from_rb(n);
+                ++*n_passed;
+        }
+
+        return NULL;
+}
+
+static uint64_t run(CRBBench *b, CRBBenchSample *s, CRBEevdf *q, const uint64_t *requests, CRBEevdfEntry *entries, size_t n_entries, size_t n_picks, size_t *n_passed) {
+        uint64_t vtime, vsum = 0, sum = 0;
+        CRBEevdfEntry *e;
+        size_t i;
+
+        for (i = 0; i < n_entries; ++i)
+                vsum += entries[i].vstart;
+
+        c_rbbench_start(b, s);
+        for (i = 0; i < n_picks; ++i) {
+                vtime = vsum / n_entries;
+                e = n_passed ? scan(q, vtime, n_passed) : c_rbeevdf_pick(q, vtime);
+                vsum += requests[e - entries];
+                c_rbeevdf_update(q, e, e->vdeadline, e->vdeadline + requests[e - entries]);
+                sum += (uintptr_t)e;
+        }
+        c_rbbench_stop(b, s);
+
+        return sum;
+}
+
+static void setup(CRBEevdf *q, uint64_t *requests, CRBEevdfEntry *entries, size_t n_entries) {
+        size_t i;
+
+        c_rbeevdf_init(q);
+        for (i = 0; i < n_entries; ++i) {
+                requests[i] = (SLICE / 8) << (rand() % 7);
+                c_rbnode_init(&entries[i].rb);
+                c_rbeevdf_add(q, &entries[i], 0, requests[i]);
+        }
+}
+
+static void bench_entities(CRBBench *b, size_t n_entries, size_t n_picks) {
+        uint64_t *requests, sum_pick, sum_scan;
+        CRBEevdfEntry *entries;
+        size_t n_passed = 0;
+        CRBBenchSample s;
+        char label[64];
+        CRBEevdf q;
+
+        entries = calloc(n_entries, sizeof(*entries));
+        requests = calloc(n_entries, sizeof(*requests));
+        assert(entries && requests);
+
+        snprintf(label, sizeof(label), "%zu entities", n_entries);
+        c_rbbench_print_header(label);
+
+        srand(n_entries);
+        setup(&q, requests, entries, n_entries);
+        sum_pick = run(b, &s, &q, requests, entries, n_entries, n_picks, NULL);
+        c_rbbench_print("c_rbeevdf_pick + update", &s, n_picks);
+
+        srand(n_entries);
+        setup(&q, requests, entries, n_entries);
+        sum_scan = run(b, &s, &q, requests, entries, n_entries, n_picks, &n_passed);
+        snprintf(label, sizeof(label), "scan + update (%.1f passed)", (double)n_passed / n_picks);
+        c_rbbench_print(label, &s, n_picks);
+
+        /* both variants must make the same scheduling decisions */
+        assert(sum_pick == sum_scan);
+
+        fprintf(stderr, "\n");
+        free(requests);
+        free(entries);
+}
+
+int main(int argc, char **argv) {
+        size_t n_picks = 1000000, max;
+        CRBBench b;
+        const char *e;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_picks = n_picks < max ? n_picks : max;
+        }
+
+        c_rbbench_init(&b);
+
+        bench_entities(&b, 1000, n_picks);
+        bench_entities(&b, 4000, n_picks);
+        bench_entities(&b, 16000, n_picks);
+
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Benchmarks for Extent Allocators
+ * This runs the same random allocation workload against the best-fit extent
+ * allocator, and against first-fit allocation from a range set. Allocation
+ * sizes are skewed towards small sizes, with occasional large requests, and
+ * allocations are freed in random order. The workload keeps the address space
+ * either 80% or 95% full, so both allocators run into fragmentation.
+ *
+ * Besides the time per operation, this prints the number of failed
+ * allocations, the number of free extents at the end, and the fragmentation
+ * at the end, as the share of free space outside the largest free extent. The
+ * number of operations defaults to 4M, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbextent.h"
+#include "c-rbrange.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define SPACE (64ULL * 1024ULL * 1024ULL)
+
+typedef struct {
+        uint64_t addr;
+        uint64_t size;
+} Allocation;
+
+typedef struct {
+        size_t n_failed;
+        size_t n_extents;
+        uint64_t n_free;
+        uint64_t largest;
+} Result;
+
+static uint64_t sample_size(void) {
+        uint64_t size;
+
+        /* mostly 256 to 8K, and every 64th request up to 1M */
+        size = 256 + rand() % (8 * 1024);
+        if (rand() % 64 == 0)
+                size *= 1 + rand() % 128;
+        return size;
+}
+
+static void plan(uint64_t *sizes, size_t *victims, size_t n_ops) {
+        size_t i;
+
+        for (i = 0; i < n_ops; ++i) {
+                sizes[i] = sample_size();
+                victims[i] = rand();
+        }
+}
+
+static int do_alloc(CRBExtentAllocator *x, CRBRangeSet *s, uint64_t size, uint64_t *addrp) {
+        return x ? c_rbextent_alloc(x, size, addrp) : c_rbrangeset_allocate(s, size, addrp);
+}
+
+static void do_free(CRBExtentAllocator *x, CRBRangeSet *s, uint64_t addr, uint64_t size) {
+        int r;
+
+        r = x ? c_rbextent_free(x, addr, size) : c_rbrangeset_insert(s, addr, addr + size);
+        assert(!r);
+}
+
+static void run(CRBBench *b, CRBBenchSample *sample, CRBExtentAllocator *x, CRBRangeSet *s,
+                const uint64_t *sizes, const size_t *victims, size_t n_ops, uint64_t fill,
+                Allocation *allocations, Result *result) {
+        size_t i, j, n_allocations = 0;
+        uint64_t addr, used = 0;
+        CRBRange *r;
+
+        memset(result, 0, sizeof(*result));
+        do_free(x, s, 0, SPACE);
+
+        c_rbbench_start(b, sample);
+        for (i = 0; i < n_ops; ++i) {
+                if (used + sizes[i] <= fill) {
+                        if (!do_alloc(x, s, sizes[i], &addr)) {
+                                allocations[n_allocations++] = (Allocation){ addr, sizes[i] };
+                                used += sizes[i];
+                                continue;
+                        }
+                        ++result->n_failed;
+                }
+
+                if (n_allocations) {
+                        j = victims[i] % n_allocations;
+                        do_free(x, s, allocations[j].addr, allocations[j].size);
+                        used -= allocations[j].size;
+                        allocations[j] = allocations[--n_allocations];
+                }
+        }
+        c_rbbench_stop(b, sample);
+
+        if (x) {
+                result->n_extents = x->n_extents;
+                result->n_free = x->n_free;
+                result->largest = c_rbextent_largest(x)->size;
+        } else {
+                c_rbrangeset_for_each(r, s) {
+                        ++result->n_extents;
+                        result->n_free += r->end - r->start;
+                        if (r->end - r->start > result->largest)
+                                result->largest = r->end - r->start;
+                }
+        }
+}
+
+static void print(const char *name, CRBBenchSample *sample, size_t n_ops, Result *result) {
+        c_rbbench_print(name, sample, n_ops);
+        fprintf(stderr, "    %zu failed, %zu free extents, %.1f%% fragmentation\n",
+                result->n_failed, result->n_extents,
+                100.0 * (double)(result->n_free - result->largest) / (double)result->n_free);
+}
+
+static void bench_fill(CRBBench *b, const uint64_t *sizes, const size_t *victims, size_t n_ops,
+                       Allocation *allocations, unsigned int percent) {
+        CRBExtentAllocator x;
+        CRBBenchSample sample;
+        Result result;
+        CRBRangeSet s;
+        char title[64];
+
+        snprintf(title, sizeof(title), "64M space, %u%% fill", percent);
+        c_rbbench_print_header(title);
+
+        c_rbextent_init(&x);
+        run(b, &sample, &x, NULL, sizes, victims, n_ops, SPACE / 100 * percent, allocations, &result);
+        print("c_rbextent_alloc (best-fit)", &sample, n_ops, &result);
+        c_rbextent_deinit(&x);
+
+        c_rbrangeset_init(&s);
+        run(b, &sample, NULL, &s, sizes, victims, n_ops, SPACE / 100 * percent, allocations, &result);
+        print("c_rbrangeset_allocate (first)", &sample, n_ops, &result);
+        c_rbrangeset_deinit(&s);
+
+        fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+        size_t n_ops = 4000000, max, *victims;
+        Allocation *allocations;
+        uint64_t *sizes;
+        CRBBench b;
+        const char *e;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_ops = n_ops < max ? n_ops : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        sizes = malloc(n_ops * sizeof(*sizes));
+        victims = malloc(n_ops * sizeof(*victims));
+        allocations = malloc(n_ops * sizeof(*allocations));
+        assert(sizes && victims && allocations);
+
+        plan(sizes, victims, n_ops);
+
+        bench_fill(&b, sizes, victims, n_ops, allocations, 80);
+        bench_fill(&b, sizes, victims, n_ops, allocations, 95);
+
+        free(allocations);
+        free(victims);
+        free(sizes);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Benchmarks for Multi-Index Containers
+ * This keeps objects in three indices (by id, by name, and by expiry), and
+ * updates the expiry of random objects. The generated rekey function is
+ * compared to the open-coded approach of unlinking an object from all
+ * indices, and linking it back via c_rbtree_find_slot() and c_rbtree_add().
+ *
+ * Updates are run with small expiry changes, which mostly keep objects in
+ * place, and with random ones, which mostly move them. The number of objects
+ * defaults to 1M, and can be capped via the CRBTREE_BENCH_MAX environment
+ * variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbindex.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_UPDATES (1024UL * 1024UL)
+
+typedef struct {
+        unsigned long id;
+        char name[16];
+        uint64_t expiry;
+        CRBNode rb_id;
+        CRBNode rb_name;
+        CRBNode rb_expiry;
+} Object;
+
+static int compare_id(CRBTree *t, void *k, CRBNode *n) {
+        Object *a = k, *b = c_rbnode_entry(n, Object, rb_id);
+
+        return (a->id < b->id) ? -1 : (a->id > b->id) ? 1 : 0;
+}
+
+static int compare_name(CRBTree *t, void *k, CRBNode *n) {
+        Object *a = k, *b = c_rbnode_entry(n, Object, rb_name);
+
+        return strcmp(a->name, b->name);
+}
+
+static int compare_expiry(CRBTree *t, void *k, CRBNode *n) {
+        Object *a = k, *b = c_rbnode_entry(n, Object, rb_expiry);
+
+        if (a->expiry != b->expiry)
+                return (a->expiry < b->expiry) ? -1 : 1;
+        return (a->id < b->id) ? -1 : (a->id > b->id) ? 1 : 0;
+}
+
+#define OBJECT_INDICES(X, _ctx)                                                                         \
+        X(_ctx, by_id, rb_id, compare_id)                                                               \
+        X(_ctx, by_name, rb_name, compare_name)                                                         \
+        X(_ctx, by_expiry, rb_expiry, compare_expiry)
+
+C_RBINDEX_DEFINE(object_index, Object, OBJECT_INDICES)
+
+static void relink(CRBTree *t, CRBCompareFunc f, Object *o, CRBNode *n) {
+        CRBNode **slot, *p;
+
+        c_rbnode_unlink(n);
+        slot = c_rbtree_find_slot(t, f, o, &p);
+        assert(slot);
+        c_rbtree_add(t, p, slot, n);
+}
+
+static void bench_update(CRBBench *b, struct object_index *m, Object *objects, size_t n_objects, uint64_t range) {
+        size_t i, *picks;
+        uint64_t *deltas;
+        CRBBenchSample s;
+        char label[64];
+        Object *o;
+        int r;
+
+        picks = malloc(N_UPDATES * sizeof(*picks));
+        deltas = malloc(N_UPDATES * sizeof(*deltas));
+        assert(picks && deltas);
+
+        for (i = 0; i < N_UPDATES; ++i) {
+                picks[i] = rand() % n_objects;
+                deltas[i] = rand() % range;
+        }
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_UPDATES; ++i) {
+                o = &objects[picks[i]];
+                o->expiry += deltas[i];
+                r = object_index_rekey(m, o, C_RBINDEX_MASK(object_index, by_expiry));
+                assert(!r);
+        }
+        c_rbbench_stop(b, &s);
+        snprintf(label, sizeof(label), "rekey, +%" PRIu64 " max", range - 1);
+        c_rbbench_print(label, &s, N_UPDATES);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_UPDATES; ++i) {
+                o = &objects[picks[i]];
+                o->expiry += deltas[i];
+                relink(&m->by_id, compare_id, o, &o->rb_id);
+                relink(&m->by_name, compare_name, o, &o->rb_name);
+                relink(&m->by_expiry, compare_expiry, o, &o->rb_expiry);
+        }
+        c_rbbench_stop(b, &s);
+        snprintf(label, sizeof(label), "relink all, +%" PRIu64 " max", range - 1);
+        c_rbbench_print(label, &s, N_UPDATES);
+
+        free(deltas);
+        free(picks);
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_objects = 1000000, max;
+        struct object_index m;
+        char title[64];
+        Object *objects;
+        CRBBench b;
+        const char *e;
+        int r;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_objects = n_objects < max ? n_objects : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        objects = calloc(n_objects, sizeof(*objects));
+        assert(objects);
+
+        object_index_init(&m);
+        for (i = 0; i < n_objects; ++i) {
+                objects[i].id = i;
+                snprintf(objects[i].name, sizeof(objects[i].name), "object-%zu", (i * 7919) % n_objects);
+                objects[i].expiry = rand() % n_objects;
+                c_rbnode_init(&objects[i].rb_id);
+                c_rbnode_init(&objects[i].rb_name);
+                c_rbnode_init(&objects[i].rb_expiry);
+
+                r = object_index_add(&m, &objects[i]);
+                assert(!r);
+        }
+
+        snprintf(title, sizeof(title), "%zu objects", n_objects);
+        c_rbbench_print_header(title);
+
+        bench_update(&b, &m, objects, n_objects, 2);
+        bench_update(&b, &m, objects, n_objects, n_objects);
+
+        free(objects);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
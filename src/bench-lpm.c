@@ -0,0 +1,168 @@
+/*
+ * Benchmarks for Longest-Prefix-Match Tables
+ * This fills LPM tables with synthetic, full-table-sized IPv4 and IPv6 route
+ * sets, and compares lookups via the populated-length bitmap to lookups that
+ * probe every possible prefix length.
+ *
+ * Prefix lengths follow the rough distribution of the public IPv4 and IPv6
+ * routing tables, dominated by /24 and /48 respectively. Table sizes default
+ * to ~1M IPv4 and ~200k IPv6 routes, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rblpm.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_LOOKUPS 200000
+#define N_VERIFY 10000
+
+typedef struct {
+        uint8_t prefix[16];
+        CRBLpmEntry lpm;
+} Route;
+
+typedef struct {
+        unsigned int length;
+        unsigned int weight;
+} Length;
+
+static const Length lengths4[] = {
+        { 8, 1 }, { 12, 1 }, { 14, 1 }, { 15, 1 },
+        { 16, 20 }, { 17, 10 }, { 18, 20 }, { 19, 30 },
+        { 20, 40 }, { 21, 40 }, { 22, 110 }, { 23, 100 },
+        { 24, 576 }, { 25, 10 }, { 26, 10 }, { 27, 5 },
+        { 28, 5 }, { 29, 5 }, { 30, 5 }, { 32, 5 },
+};
+
+static const Length lengths6[] = {
+        { 24, 10 }, { 28, 10 }, { 29, 40 }, { 32, 120 },
+        { 33, 4 }, { 34, 3 }, { 35, 3 }, { 36, 40 },
+        { 40, 60 }, { 42, 20 }, { 44, 80 }, { 45, 20 },
+        { 46, 30 }, { 47, 20 }, { 48, 500 }, { 56, 20 },
+        { 64, 20 },
+};
+
+static volatile CRBLpmEntry *sink;
+
+static unsigned int pick_length(const Length *lengths, size_t n_lengths) {
+        unsigned int total = 0, v;
+        size_t i;
+
+        for (i = 0; i < n_lengths; ++i)
+                total += lengths[i].weight;
+
+        v = rand() % total;
+        for (i = 0; v >= lengths[i].weight; ++i)
+                v -= lengths[i].weight;
+
+        return lengths[i].length;
+}
+
+static CRBLpmEntry *lookup_all_lengths(CRBLpm *lpm, const uint8_t *address) {
+        CRBLpmEntry *e;
+        unsigned int l;
+
+        /* the naive approach: probe every possible length */
+        for (l = lpm->n_bits + 1; l-- > 0; ) {
+                e = c_rblpm_find(lpm, address, l);
+                if (e)
+                        return e;
+        }
+
+        return NULL;
+}
+
+static void bench_table(CRBBench *b, const char *name, unsigned int n_bits,
+                        const Length *lengths, size_t n_lengths, size_t n_routes) {
+        size_t i, j, n_bytes = n_bits / 8;
+        CRBBenchSample s;
+        uint8_t *lookups;
+        char label[64];
+        Route *routes;
+        CRBLpm lpm;
+        int r;
+
+        routes = malloc(n_routes * sizeof(*routes));
+        lookups = malloc(N_LOOKUPS * n_bytes);
+        assert(routes && lookups);
+
+        c_rblpm_init(&lpm, n_bits);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_routes; ++i) {
+                do {
+                        for (j = 0; j < n_bytes; ++j)
+                                routes[i].prefix[j] = rand();
+                        r = c_rblpm_add(&lpm, &routes[i].lpm, routes[i].prefix,
+                                        pick_length(lengths, n_lengths));
+                } while (r == -EEXIST);
+                assert(!r);
+        }
+        c_rbbench_stop(b, &s);
+
+        snprintf(label, sizeof(label), "%zu %s routes", n_routes, name);
+        c_rbbench_print_header(label);
+        c_rbbench_print("c_rblpm_add", &s, n_routes);
+
+        /* look up addresses within announced prefixes */
+        for (i = 0; i < N_LOOKUPS; ++i) {
+                memcpy(lookups + i * n_bytes, routes[rand() % n_routes].prefix, n_bytes);
+                lookups[i * n_bytes + n_bytes - 1] ^= rand();
+        }
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_LOOKUPS; ++i)
+                sink = c_rblpm_lookup(&lpm, lookups + i * n_bytes);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("c_rblpm_lookup", &s, N_LOOKUPS);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_LOOKUPS; ++i)
+                sink = lookup_all_lengths(&lpm, lookups + i * n_bytes);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("probe all lengths", &s, N_LOOKUPS);
+
+        for (i = 0; i < N_VERIFY; ++i)
+                assert(c_rblpm_lookup(&lpm, lookups + i * n_bytes) ==
+                       lookup_all_lengths(&lpm, lookups + i * n_bytes));
+
+        fprintf(stderr, "\n");
+
+        free(lookups);
+        free(routes);
+}
+
+int main(int argc, char **argv) {
+        size_t n4 = 1000000, n6 = 200000, max;
+        CRBBench b;
+        const char *e;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n4 = n4 < max ? n4 : max;
+                n6 = n6 < max ? n6 : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        bench_table(&b, "IPv4", 32, lengths4, sizeof(lengths4) / sizeof(*lengths4), n4);
+        bench_table(&b, "IPv6", 128, lengths6, sizeof(lengths6) / sizeof(*lengths6), n6);
+
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
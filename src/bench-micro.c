@@ -0,0 +1,703 @@
+/*
+ * Micro-Benchmarks for the Public API
+ * This measures each primitive exported by the library in isolation. It builds
+ * trees of different shapes and sizes, and then runs each primitive both with
+ * warm and cold caches:
+ *
+ *   o warm: The primitive is run on a small set of nodes over and over, so all
+ *           involved nodes reside in the CPU caches.
+ *
+ *   o cold: All CPU caches are flushed before each sample, and each sample
+ *           operates on different, randomly picked nodes.
+ *
+ * With warm caches, primitives are measured in batches, to hide the timer
+ * overhead. With cold caches, each primitive is measured on its own, and the
+ * measured timer overhead is subtracted.
+ *
+ * The largest tree size defaults to 1M nodes, and can be changed via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define BATCH 256
+#define N_SAMPLES 64
+#define N_COLD 128
+#define EVICT_SIZE (32UL * 1024UL * 1024UL)
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+} Node;
+
+typedef enum {
+        SHAPE_RANDOM,
+        SHAPE_SEQUENTIAL,
+        SHAPE_BUILT,
+        _SHAPE_N,
+} Shape;
+
+typedef struct {
+        CRBBench bench;
+        CRBTree tree;
+        Node *nodes;
+        CRBNode **sorted;
+        CRBNode **picks;
+        size_t n_nodes;
+        unsigned char *evict;
+        CRBBenchSample overhead;
+} Context;
+
+typedef CRBNode *(*NodeFunc) (CRBNode *n);
+typedef CRBNode *(*TreeFunc) (CRBTree *t);
+
+#define node_from_rb(_rb) ((Node *)((char *)(_rb) - offsetof(Node, rb)))
+
+static const char *shape_names[_SHAPE_N] = {
+        [SHAPE_RANDOM] = "random",
+        [SHAPE_SEQUENTIAL] = "sequential",
+        [SHAPE_BUILT] = "built",
+};
+
+static volatile CRBNode *sink;
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = node_from_rb(n);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void compare_batch(CRBTree *t, void **keys, CRBNode **nodes, int *results, size_t n) {
+        unsigned long a[C_RBTREE_BATCH_MAX], b[C_RBTREE_BATCH_MAX];
+        size_t i;
+
+        /* gather first, so the comparisons themselves can be vectorized */
+        for (i = 0; i < n; ++i) {
+                a[i] = (unsigned long)keys[i];
+                b[i] = node_from_rb(nodes[i])->key;
+        }
+        for (i = 0; i < n; ++i)
+                results[i] = (a[i] > b[i]) - (a[i] < b[i]);
+}
+
+static void shuffle(CRBNode **nodes, size_t n_memb) {
+        size_t i, j;
+        CRBNode *t;
+
+        for (i = 0; i < n_memb; ++i) {
+                j = rand() % n_memb;
+                t = nodes[j];
+                nodes[j] = nodes[i];
+                nodes[i] = t;
+        }
+}
+
+static void evict(Context *ctx) {
+        size_t i;
+
+        /* write a buffer larger than any LLC, pushing all tree nodes out */
+        for (i = 0; i < EVICT_SIZE; i += 64)
+                ctx->evict[i] += 1;
+}
+
+static void pick(Context *ctx, size_t n, bool warm) {
+        size_t i;
+
+        /* warm runs always use the same nodes, cold runs random ones */
+        for (i = 0; i < n; ++i)
+                ctx->picks[i] = ctx->sorted[warm ? (i * 7919) % ctx->n_nodes : rand() % ctx->n_nodes];
+}
+
+static void sample_add(CRBBenchSample *sum, const CRBBenchSample *s) {
+        unsigned int i;
+
+        sum->ns += s->ns;
+        for (i = 0; i < _C_RBBENCH_N; ++i) {
+                sum->counters[i] += s->counters[i];
+                sum->valid[i] = s->valid[i];
+        }
+}
+
+static void sample_sub(CRBBenchSample *sum, const CRBBenchSample *s, uint64_t n) {
+        unsigned int i;
+
+        sum->ns -= (sum->ns > s->ns * n) ? s->ns * n : sum->ns;
+        for (i = 0; i < _C_RBBENCH_N; ++i)
+                sum->counters[i] -= (sum->counters[i] > s->counters[i] * n) ? s->counters[i] * n : sum->counters[i];
+}
+
+static void insert(CRBTree *t, Node *node) {
+        CRBNode **slot, *p;
+
+        slot = c_rbtree_find_slot(t, compare, (void *)node->key, &p);
+        assert(slot);
+        c_rbtree_add(t, p, slot, &node->rb);
+}
+
+static void setup(Context *ctx, Shape shape) {
+        size_t i;
+
+        c_rbtree_init(&ctx->tree);
+
+        switch (shape) {
+        case SHAPE_RANDOM:
+                memcpy(ctx->picks, ctx->sorted, ctx->n_nodes * sizeof(*ctx->picks));
+                shuffle(ctx->picks, ctx->n_nodes);
+                for (i = 0; i < ctx->n_nodes; ++i)
+                        insert(&ctx->tree, node_from_rb(ctx->picks[i]));
+                break;
+        case SHAPE_SEQUENTIAL:
+                for (i = 0; i < ctx->n_nodes; ++i)
+                        insert(&ctx->tree, node_from_rb(ctx->sorted[i]));
+                break;
+        case SHAPE_BUILT:
+                memcpy(ctx->picks, ctx->sorted, ctx->n_nodes * sizeof(*ctx->picks));
+                c_rbtree_build(&ctx->tree, ctx->picks, ctx->n_nodes);
+                break;
+        default:
+                assert(0);
+        }
+}
+
+static void bench_node(Context *ctx, const char *name, NodeFunc fn) {
+        CRBBenchSample s, sum;
+        char label[64];
+        size_t i, j;
+
+        /* cold: flush caches before each call, and time each call alone */
+        sum = (CRBBenchSample){};
+        pick(ctx, N_COLD, false);
+
+        for (i = 0; i < N_COLD; ++i) {
+                evict(ctx);
+
+                c_rbbench_start(&ctx->bench, &s);
+                sink = fn(ctx->picks[i]);
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add(&sum, &s);
+        }
+
+        sample_sub(&sum, &ctx->overhead, N_COLD);
+
+        snprintf(label, sizeof(label), "%s (cold)", name);
+        c_rbbench_print(label, &sum, N_COLD);
+
+        /* warm: run the same nodes over and over, timed in batches */
+        sum = (CRBBenchSample){};
+        pick(ctx, BATCH, true);
+
+        for (i = 0; i < N_SAMPLES; ++i) {
+                for (j = 0; j < BATCH; ++j)
+                        sink = fn(ctx->picks[j]);
+
+                c_rbbench_start(&ctx->bench, &s);
+                for (j = 0; j < BATCH; ++j)
+                        sink = fn(ctx->picks[j]);
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add(&sum, &s);
+        }
+
+        snprintf(label, sizeof(label), "%s (warm)", name);
+        c_rbbench_print(label, &sum, N_SAMPLES * BATCH);
+}
+
+static void bench_tree(Context *ctx, const char *name, TreeFunc fn) {
+        CRBBenchSample s, sum;
+        char label[64];
+        unsigned int warm;
+        size_t i, j;
+
+        for (warm = 0; warm < 2; ++warm) {
+                sum = (CRBBenchSample){};
+
+                for (i = 0; i < N_SAMPLES; ++i) {
+                        if (warm)
+                                sink = fn(&ctx->tree);
+                        else
+                                evict(ctx);
+
+                        /* only the first call can be cold, so time it alone */
+                        c_rbbench_start(&ctx->bench, &s);
+                        if (warm) {
+                                for (j = 0; j < BATCH; ++j)
+                                        sink = fn(&ctx->tree);
+                        } else {
+                                sink = fn(&ctx->tree);
+                        }
+                        c_rbbench_stop(&ctx->bench, &s);
+                        sample_add(&sum, &s);
+                }
+
+                if (!warm)
+                        sample_sub(&sum, &ctx->overhead, N_SAMPLES);
+
+                snprintf(label, sizeof(label), "%s (%s)", name, warm ? "warm" : "cold");
+                c_rbbench_print(label, &sum, warm ? N_SAMPLES * BATCH : N_SAMPLES);
+        }
+}
+
+static unsigned long walk_next(Context *ctx) {
+        unsigned long sum = 0;
+        CRBNode *n;
+
+        for (n = c_rbtree_first(&ctx->tree); n; n = c_rbnode_next(n))
+                sum += node_from_rb(n)->key;
+
+        return sum;
+}
+
+static unsigned long walk_fill(Context *ctx) {
+        CRBNode *batch[BATCH];
+        unsigned long sum = 0;
+        CRBIter iter;
+        size_t i, n;
+
+        c_rbtree_iter_init(&iter, &ctx->tree);
+        while ((n = c_rbtree_iter_fill(&iter, batch, BATCH)))
+                for (i = 0; i < n; ++i)
+                        sum += node_from_rb(batch[i])->key;
+
+        return sum;
+}
+
+static void bench_walk(Context *ctx) {
+        unsigned long (*walks[2]) (Context *ctx) = { walk_next, walk_fill };
+        static const char *names[2] = { "c_rbnode_next", "c_rbtree_iter_fill" };
+        unsigned long sum, expected = ctx->n_nodes * (ctx->n_nodes - 1) / 2;
+        CRBBenchSample s;
+        unsigned int warm, i;
+        char label[64];
+
+        /* full in-order traversals, with a checksum of all keys as user work */
+        for (i = 0; i < 2; ++i) {
+                for (warm = 0; warm < 2; ++warm) {
+                        if (warm)
+                                walks[i](ctx);
+                        else
+                                evict(ctx);
+
+                        c_rbbench_start(&ctx->bench, &s);
+                        sum = walks[i](ctx);
+                        c_rbbench_stop(&ctx->bench, &s);
+                        assert(sum == expected);
+
+                        snprintf(label, sizeof(label), "%s walk (%s)", names[i], warm ? "warm" : "cold");
+                        c_rbbench_print(label, &s, ctx->n_nodes);
+                }
+        }
+}
+
+static void bench_modify_warm(Context *ctx) {
+        CRBBenchSample s, sum_unlink = {}, sum_find = {}, sum_add = {}, sum_link = {};
+        CRBNode **slot, *p, *n;
+        size_t i, j;
+
+        /*
+         * Single operations are too cheap to be timed individually with warm
+         * caches. Hence, we time batches. Slots cannot be pre-computed, as
+         * rotations of earlier insertions might invalidate them, so we time
+         * the lookups separately and subtract them.
+         */
+        pick(ctx, BATCH, true);
+
+        for (i = 0; i < N_SAMPLES; ++i) {
+                c_rbbench_start(&ctx->bench, &s);
+                for (j = 0; j < BATCH; ++j)
+                        c_rbnode_unlink_stale(ctx->picks[j]);
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add(&sum_unlink, &s);
+
+                c_rbbench_start(&ctx->bench, &s);
+                for (j = 0; j < BATCH; ++j)
+                        sink = (void *)c_rbtree_find_slot(&ctx->tree, compare,
+                                                          (void *)node_from_rb(ctx->picks[j])->key, &p);
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add(&sum_find, &s);
+
+                /* c_rbnode_link() requires a parent, which is always given here */
+                c_rbbench_start(&ctx->bench, &s);
+                for (j = 0; j < BATCH; ++j) {
+                        n = ctx->picks[j];
+                        slot = c_rbtree_find_slot(&ctx->tree, compare, (void *)node_from_rb(n)->key, &p);
+                        if (i % 2)
+                                c_rbnode_link(p, slot, n);
+                        else
+                                c_rbtree_add(&ctx->tree, p, slot, n);
+                }
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add((i % 2) ? &sum_link : &sum_add, &s);
+        }
+
+        /* lookups were timed on every sample, but each insertion on half */
+        sum_find.ns /= 2;
+        for (i = 0; i < _C_RBBENCH_N; ++i)
+                sum_find.counters[i] /= 2;
+
+        sample_sub(&sum_add, &sum_find, 1);
+        sample_sub(&sum_link, &sum_find, 1);
+
+        c_rbbench_print("c_rbnode_unlink_stale (warm)", &sum_unlink, N_SAMPLES * (BATCH));
+        c_rbbench_print("c_rbnode_link (warm)", &sum_link, N_SAMPLES / 2 * (BATCH));
+        c_rbbench_print("c_rbtree_add (warm)", &sum_add, N_SAMPLES / 2 * (BATCH));
+}
+
+static void bench_modify_cold(Context *ctx) {
+        CRBBenchSample s, sum_unlink = {}, sum_add = {}, sum_link = {};
+        CRBNode **slot, *p, *n;
+        size_t i;
+
+        pick(ctx, N_COLD, false);
+
+        for (i = 0; i < N_COLD; ++i) {
+                n = ctx->picks[i];
+
+                evict(ctx);
+
+                c_rbbench_start(&ctx->bench, &s);
+                c_rbnode_unlink_stale(n);
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add(&sum_unlink, &s);
+
+                slot = c_rbtree_find_slot(&ctx->tree, compare, (void *)node_from_rb(n)->key, &p);
+                assert(slot && p);
+
+                evict(ctx);
+
+                c_rbbench_start(&ctx->bench, &s);
+                if (i % 2)
+                        c_rbnode_link(p, slot, n);
+                else
+                        c_rbtree_add(&ctx->tree, p, slot, n);
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add((i % 2) ? &sum_link : &sum_add, &s);
+        }
+
+        sample_sub(&sum_unlink, &ctx->overhead, N_COLD);
+        sample_sub(&sum_link, &ctx->overhead, N_COLD / 2);
+        sample_sub(&sum_add, &ctx->overhead, N_COLD / 2);
+
+        c_rbbench_print("c_rbnode_unlink_stale (cold)", &sum_unlink, N_COLD);
+        c_rbbench_print("c_rbnode_link (cold)", &sum_link, N_COLD / 2);
+        c_rbbench_print("c_rbtree_add (cold)", &sum_add, N_COLD / 2);
+}
+
+static void bench_move(Context *ctx) {
+        CRBBenchSample s, sum;
+        CRBTree other = C_RBTREE_INIT;
+        unsigned int warm;
+        char label[64];
+        size_t i, j, n;
+
+        for (warm = 0; warm < 2; ++warm) {
+                sum = (CRBBenchSample){};
+                n = warm ? BATCH : 1;
+
+                for (i = 0; i < N_SAMPLES; ++i) {
+                        if (!warm)
+                                evict(ctx);
+
+                        c_rbbench_start(&ctx->bench, &s);
+                        for (j = 0; j < n; ++j) {
+                                c_rbtree_move(&other, &ctx->tree);
+                                c_rbtree_move(&ctx->tree, &other);
+                        }
+                        c_rbbench_stop(&ctx->bench, &s);
+                        sample_add(&sum, &s);
+                }
+
+                if (!warm)
+                        sample_sub(&sum, &ctx->overhead, N_SAMPLES);
+
+                snprintf(label, sizeof(label), "c_rbtree_move (%s)", warm ? "warm" : "cold");
+                c_rbbench_print(label, &sum, N_SAMPLES * n * 2);
+        }
+}
+
+static int clone_node(CRBNode *n, CRBNode **copyp, void *userdata) {
+        Node *copies = userdata, *node = node_from_rb(n);
+
+        copies[node->key].key = node->key;
+        *copyp = &copies[node->key].rb;
+        return 0;
+}
+
+static void bench_clone(Context *ctx) {
+        CRBTree copy = C_RBTREE_INIT;
+        CRBBenchSample s;
+        Node *copies;
+        CRBNode *n;
+        int r;
+
+        copies = malloc(ctx->n_nodes * sizeof(*copies));
+        assert(copies);
+
+        evict(ctx);
+
+        c_rbbench_start(&ctx->bench, &s);
+        r = c_rbtree_clone(&copy, &ctx->tree, clone_node, copies);
+        c_rbbench_stop(&ctx->bench, &s);
+        assert(!r);
+
+        c_rbbench_print("c_rbtree_clone (cold)", &s, ctx->n_nodes);
+
+        /* compare against re-inserting a copy of each node in order */
+        c_rbtree_init(&copy);
+        evict(ctx);
+
+        c_rbbench_start(&ctx->bench, &s);
+        c_rbtree_for_each(n, &ctx->tree) {
+                copies[node_from_rb(n)->key].key = node_from_rb(n)->key;
+                insert(&copy, &copies[node_from_rb(n)->key]);
+        }
+        c_rbbench_stop(&ctx->bench, &s);
+
+        c_rbbench_print("re-insert (cold)", &s, ctx->n_nodes);
+
+        free(copies);
+}
+
+static void bench_find(Context *ctx) {
+        CRBNode **found;
+        CRBBenchSample s;
+        void **keys;
+        size_t i;
+
+        keys = malloc(ctx->n_nodes * sizeof(*keys));
+        found = malloc(ctx->n_nodes * sizeof(*found));
+        assert(keys && found);
+
+        for (i = 0; i < ctx->n_nodes; ++i)
+                keys[i] = (void *)(unsigned long)(rand() % ctx->n_nodes);
+
+        evict(ctx);
+        c_rbbench_start(&ctx->bench, &s);
+        for (i = 0; i < ctx->n_nodes; ++i)
+                found[i] = c_rbtree_find_node(&ctx->tree, compare, keys[i]);
+        c_rbbench_stop(&ctx->bench, &s);
+        c_rbbench_print("c_rbtree_find_node (cold)", &s, ctx->n_nodes);
+
+        evict(ctx);
+        c_rbbench_start(&ctx->bench, &s);
+        c_rbtree_find_batch(&ctx->tree, compare, NULL, keys, found, ctx->n_nodes);
+        c_rbbench_stop(&ctx->bench, &s);
+        c_rbbench_print("c_rbtree_find_batch (cold)", &s, ctx->n_nodes);
+
+        evict(ctx);
+        c_rbbench_start(&ctx->bench, &s);
+        c_rbtree_find_batch(&ctx->tree, NULL, compare_batch, keys, found, ctx->n_nodes);
+        c_rbbench_stop(&ctx->bench, &s);
+        c_rbbench_print("c_rbtree_find_batch, fb (cold)", &s, ctx->n_nodes);
+
+        for (i = 0; i < ctx->n_nodes; ++i)
+                assert(found[i] && node_from_rb(found[i])->key == (unsigned long)keys[i]);
+
+        free(found);
+        free(keys);
+}
+
+static void bench_build(Context *ctx) {
+        CRBBenchSample s;
+
+        memcpy(ctx->picks, ctx->sorted, ctx->n_nodes * sizeof(*ctx->picks));
+        evict(ctx);
+
+        c_rbtree_init(&ctx->tree);
+        c_rbbench_start(&ctx->bench, &s);
+        c_rbtree_build(&ctx->tree, ctx->picks, ctx->n_nodes);
+        c_rbbench_stop(&ctx->bench, &s);
+
+        c_rbbench_print("c_rbtree_build (cold)", &s, ctx->n_nodes);
+}
+
+static _Bool retain_keep(CRBNode *n, void *userdata) {
+        unsigned long *percent = userdata;
+
+        return node_from_rb(n)->key % 100 >= *percent;
+}
+
+static void bench_retain(Context *ctx) {
+        static const unsigned long percents[] = { 1, 10, 50, 90 };
+        CRBBenchSample s;
+        CRBNode *n, *safe;
+        char label[64];
+        size_t i;
+
+        for (i = 0; i < sizeof(percents) / sizeof(*percents); ++i) {
+                memcpy(ctx->picks, ctx->sorted, ctx->n_nodes * sizeof(*ctx->picks));
+                c_rbtree_init(&ctx->tree);
+                c_rbtree_build(&ctx->tree, ctx->picks, ctx->n_nodes);
+                evict(ctx);
+
+                c_rbbench_start(&ctx->bench, &s);
+                c_rbtree_retain(&ctx->tree, retain_keep, NULL, (void *)&percents[i]);
+                c_rbbench_stop(&ctx->bench, &s);
+
+                snprintf(label, sizeof(label), "c_rbtree_retain, %lu%% (cold)", percents[i]);
+                c_rbbench_print(label, &s, ctx->n_nodes);
+
+                /* compare against walking the tree, and unlinking each rejected node */
+                memcpy(ctx->picks, ctx->sorted, ctx->n_nodes * sizeof(*ctx->picks));
+                c_rbtree_init(&ctx->tree);
+                c_rbtree_build(&ctx->tree, ctx->picks, ctx->n_nodes);
+                evict(ctx);
+
+                c_rbbench_start(&ctx->bench, &s);
+                c_rbtree_for_each_safe(n, safe, &ctx->tree)
+                        if (!retain_keep(n, (void *)&percents[i]))
+                                c_rbnode_unlink(n);
+                c_rbbench_stop(&ctx->bench, &s);
+
+                snprintf(label, sizeof(label), "c_rbnode_unlink, %lu%% (cold)", percents[i]);
+                c_rbbench_print(label, &s, ctx->n_nodes);
+        }
+}
+
+static void bench_step_run(Context *ctx, CRBStep *step, const char *name, size_t n_ops) {
+        CRBBenchSample s, sum = {};
+        uint64_t max = 0;
+        size_t n_steps = 0;
+        _Bool done;
+
+        evict(ctx);
+
+        do {
+                c_rbbench_start(&ctx->bench, &s);
+                done = c_rbtree_step_run(step, BATCH);
+                c_rbbench_stop(&ctx->bench, &s);
+
+                sample_add(&sum, &s);
+                max = (s.ns > max) ? s.ns : max;
+                ++n_steps;
+        } while (!done);
+
+        c_rbbench_print(name, &sum, n_ops);
+        fprintf(stderr, "    %zu steps of %u nodes, longest step %" PRIu64 " ns\n", n_steps, BATCH, max);
+}
+
+static void bench_step(Context *ctx) {
+        static const unsigned long percent = 50;
+        CRBStep step;
+        size_t n_kept;
+
+        memcpy(ctx->picks, ctx->sorted, ctx->n_nodes * sizeof(*ctx->picks));
+        c_rbtree_init(&ctx->tree);
+        c_rbtree_step_build(&step, &ctx->tree, ctx->picks, ctx->n_nodes);
+        bench_step_run(ctx, &step, "c_rbtree_step_build (cold)", ctx->n_nodes);
+
+        c_rbtree_step_retain(&step, &ctx->tree, retain_keep, NULL, (void *)&percent);
+        bench_step_run(ctx, &step, "c_rbtree_step_retain, 50% (cold)", ctx->n_nodes);
+        n_kept = ctx->n_nodes - step.n_removed;
+
+        c_rbtree_step_teardown(&step, &ctx->tree, NULL, NULL);
+        bench_step_run(ctx, &step, "c_rbtree_step_teardown (cold)", n_kept);
+}
+
+static void bench_overhead(Context *ctx) {
+        CRBBenchSample s, sum = {};
+        size_t i;
+
+        /* measure the cost of the timers themselves, with cold caches */
+        for (i = 0; i < N_COLD; ++i) {
+                evict(ctx);
+
+                c_rbbench_start(&ctx->bench, &s);
+                c_rbbench_stop(&ctx->bench, &s);
+                sample_add(&sum, &s);
+        }
+
+        ctx->overhead = sum;
+        ctx->overhead.ns /= N_COLD;
+        for (i = 0; i < _C_RBBENCH_N; ++i)
+                ctx->overhead.counters[i] /= N_COLD;
+}
+
+static void bench_size(Context *ctx, size_t n_nodes) {
+        char title[64];
+        Shape shape;
+        size_t i;
+
+        ctx->n_nodes = n_nodes;
+        ctx->nodes = malloc(n_nodes * sizeof(*ctx->nodes));
+        ctx->sorted = malloc(n_nodes * sizeof(*ctx->sorted));
+        ctx->picks = malloc((n_nodes > N_COLD ? n_nodes : N_COLD) * sizeof(*ctx->picks));
+        assert(ctx->nodes && ctx->sorted && ctx->picks);
+
+        /* order nodes randomly in memory, so in-order walks are not linear */
+        for (i = 0; i < n_nodes; ++i)
+                ctx->sorted[i] = &ctx->nodes[i].rb;
+        shuffle(ctx->sorted, n_nodes);
+        for (i = 0; i < n_nodes; ++i)
+                node_from_rb(ctx->sorted[i])->key = i;
+
+        for (shape = 0; shape < _SHAPE_N; ++shape) {
+                setup(ctx, shape);
+
+                snprintf(title, sizeof(title), "%zu nodes, %s", n_nodes, shape_names[shape]);
+                c_rbbench_print_header(title);
+
+                bench_node(ctx, "c_rbnode_leftmost", c_rbnode_leftmost);
+                bench_node(ctx, "c_rbnode_rightmost", c_rbnode_rightmost);
+                bench_node(ctx, "c_rbnode_leftdeepest", c_rbnode_leftdeepest);
+                bench_node(ctx, "c_rbnode_rightdeepest", c_rbnode_rightdeepest);
+                bench_node(ctx, "c_rbnode_next", c_rbnode_next);
+                bench_node(ctx, "c_rbnode_prev", c_rbnode_prev);
+                bench_node(ctx, "c_rbnode_next_postorder", c_rbnode_next_postorder);
+                bench_node(ctx, "c_rbnode_prev_postorder", c_rbnode_prev_postorder);
+                bench_tree(ctx, "c_rbtree_first", c_rbtree_first);
+                bench_tree(ctx, "c_rbtree_last", c_rbtree_last);
+                bench_tree(ctx, "c_rbtree_first_postorder", c_rbtree_first_postorder);
+                bench_tree(ctx, "c_rbtree_last_postorder", c_rbtree_last_postorder);
+                bench_walk(ctx);
+                bench_modify_cold(ctx);
+                bench_modify_warm(ctx);
+                bench_move(ctx);
+                bench_clone(ctx);
+                bench_find(ctx);
+                bench_build(ctx);
+                bench_retain(ctx);
+                bench_step(ctx);
+
+                fprintf(stderr, "\n");
+        }
+
+        free(ctx->picks);
+        free(ctx->sorted);
+        free(ctx->nodes);
+}
+
+int main(int argc, char **argv) {
+        Context ctx = {};
+        size_t n, max = 1000000;
+        const char *e;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e)
+                max = strtoul(e, NULL, 10);
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        ctx.evict = calloc(1, EVICT_SIZE);
+        assert(ctx.evict);
+
+        c_rbbench_init(&ctx.bench);
+        bench_overhead(&ctx);
+
+        for (n = 1000; n <= max; n *= 10)
+                bench_size(&ctx, n);
+
+        c_rbbench_deinit(&ctx.bench);
+        free(ctx.evict);
+
+        return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Benchmarks for Order-Maintenance Labels
+ * This compares ways to decide whether one linked entry orders before
+ * another, on the same set of entries, which are spread randomly in memory:
+ *
+ *   o compare: Call the comparator with the key of the first entry, and the
+ *              node of the second. This needs the key at hand.
+ *
+ *   o ancestor: Climb from both nodes to their lowest common ancestor, and
+ *               check which side of it each came from.
+ *
+ *   o label: Compare the labels, via c_rborder_precedes().
+ *
+ * It further shows the cost of maintaining labels, once for random
+ * modifications, and once for insertions that all hit the same gap, which is
+ * the worst case for relabelling. The number of entries defaults to 1M, and
+ * can be capped via the CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rborder.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_QUERIES 1000000
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+        CRBOrderEntry o;
+} Node;
+
+static volatile size_t sink;
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = c_rbnode_entry(n, Node, rb);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static int compare_order(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = c_rbnode_entry(n, Node, o.rb);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void shuffle(Node **nodes, size_t n_memb) {
+        size_t i, j;
+        Node *t;
+
+        for (i = 0; i < n_memb; ++i) {
+                j = rand() % n_memb;
+                t = nodes[j];
+                nodes[j] = nodes[i];
+                nodes[i] = t;
+        }
+}
+
+static void add(CRBTree *t, Node *node) {
+        CRBNode **slot, *p;
+
+        slot = c_rbtree_find_slot(t, compare, (void *)node->key, &p);
+        assert(slot);
+        c_rbtree_add(t, p, slot, &node->rb);
+}
+
+static void add_order(CRBOrder *o, Node *node) {
+        CRBNode **slot, *p;
+
+        slot = c_rbtree_find_slot(&o->tree, compare_order, (void *)node->key, &p);
+        assert(slot);
+        c_rborder_add(o, p, slot, &node->o);
+}
+
+static size_t depth(CRBNode *n) {
+        size_t d = 0;
+
+        while ((n = c_rbnode_parent(n)))
+                ++d;
+
+        return d;
+}
+
+static _Bool precedes_ancestor(CRBNode *a, CRBNode *b) {
+        CRBNode *ca = NULL, *cb = NULL;
+        size_t da, db;
+
+        if (a == b)
+                return 0;
+
+        da = depth(a);
+        db = depth(b);
+
+        for ( ; da > db; --da) {
+                ca = a;
+                a = c_rbnode_parent(a);
+        }
+        for ( ; db > da; --db) {
+                cb = b;
+                b = c_rbnode_parent(b);
+        }
+        while (a != b) {
+                ca = a;
+                a = c_rbnode_parent(a);
+                cb = b;
+                b = c_rbnode_parent(b);
+        }
+
+        /* @a is the common ancestor now, @ca and @cb the children below it */
+        if (!ca)
+                return cb == a->right;
+        return ca == a->left;
+}
+
+static void bench_precedes(CRBBench *b, Node **pairs) {
+        CRBBenchSample s;
+        size_t i, sum;
+
+        sum = 0;
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_QUERIES; ++i)
+                sum += compare(NULL, (void *)pairs[2 * i]->key, &pairs[2 * i + 1]->rb) < 0;
+        c_rbbench_stop(b, &s);
+        sink = sum;
+        c_rbbench_print("precedes: compare", &s, N_QUERIES);
+
+        sum = 0;
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_QUERIES; ++i)
+                sum += precedes_ancestor(&pairs[2 * i]->rb, &pairs[2 * i + 1]->rb);
+        c_rbbench_stop(b, &s);
+        sink = sum;
+        c_rbbench_print("precedes: ancestor", &s, N_QUERIES);
+
+        sum = 0;
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_QUERIES; ++i)
+                sum += c_rborder_precedes(&pairs[2 * i]->o, &pairs[2 * i + 1]->o);
+        c_rbbench_stop(b, &s);
+        sink = sum;
+        c_rbbench_print("precedes: c_rborder_precedes", &s, N_QUERIES);
+}
+
+static void bench_modify(CRBBench *b, CRBTree *t, CRBOrder *o, Node **order, size_t n_nodes) {
+        CRBBenchSample s;
+        size_t i, n_relabeled;
+
+        shuffle(order, n_nodes);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_nodes; ++i)
+                c_rbnode_unlink(&order[i]->rb);
+        for (i = 0; i < n_nodes; ++i)
+                add(t, order[i]);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("modify: c_rbtree", &s, n_nodes);
+
+        n_relabeled = o->n_relabeled;
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_nodes; ++i)
+                c_rborder_remove(o, &order[i]->o);
+        for (i = 0; i < n_nodes; ++i)
+                add_order(o, order[i]);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("modify: c_rborder", &s, n_nodes);
+
+        fprintf(stderr, "    %.2f relabels per insertion\n",
+                (double)(o->n_relabeled - n_relabeled) / n_nodes);
+}
+
+static void bench_dense(CRBBench *b, Node *nodes, size_t n_nodes) {
+        CRBOrder o = C_RBORDER_INIT;
+        CRBBenchSample s;
+        size_t i;
+
+        /* insert each key right after the first, so all hit the same gap */
+        for (i = 0; i < n_nodes; ++i) {
+                nodes[i].key = i ? 2 * n_nodes - i : 0;
+                c_rbnode_init(&nodes[i].o.rb);
+        }
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_nodes; ++i)
+                add_order(&o, &nodes[i]);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("dense: c_rborder", &s, n_nodes);
+
+        fprintf(stderr, "    %.2f relabels per insertion\n", (double)o.n_relabeled / n_nodes);
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_nodes = 1000000, max;
+        CRBOrder o = C_RBORDER_INIT;
+        CRBTree t = C_RBTREE_INIT;
+        Node *nodes, **order, **pairs;
+        char title[64];
+        CRBBench b;
+        const char *e;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_nodes = n_nodes < max ? n_nodes : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        nodes = malloc(n_nodes * sizeof(*nodes));
+        order = malloc(n_nodes * sizeof(*order));
+        pairs = malloc(2 * N_QUERIES * sizeof(*pairs));
+        assert(nodes && order && pairs);
+
+        /* order nodes randomly in memory, so in-order walks are not linear */
+        for (i = 0; i < n_nodes; ++i)
+                order[i] = &nodes[i];
+        shuffle(order, n_nodes);
+        for (i = 0; i < n_nodes; ++i)
+                order[i]->key = i;
+
+        shuffle(order, n_nodes);
+        for (i = 0; i < n_nodes; ++i) {
+                add(&t, order[i]);
+                add_order(&o, order[i]);
+        }
+
+        for (i = 0; i < 2 * N_QUERIES; ++i)
+                pairs[i] = &nodes[rand() % n_nodes];
+
+        snprintf(title, sizeof(title), "%zu entries", n_nodes);
+        c_rbbench_print_header(title);
+
+        bench_precedes(&b, pairs);
+        bench_modify(&b, &t, &o, order, n_nodes);
+        bench_dense(&b, nodes, n_nodes);
+
+        fprintf(stderr, "\n");
+
+        free(pairs);
+        free(order);
+        free(nodes);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Benchmarks for Radix-Sharded Trees
+ * This fills a radix-sharded tree and a plain RB-Tree with the same random
+ * 64bit keys, and compares insertions and random lookups. It also reports the
+ * average depth of all entries in their tree, which shows how many levels the
+ * shard table saves.
+ *
+ * The number of entries defaults to 1M, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbradix.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_LOOKUPS 1000000
+
+typedef struct {
+        CRBNode rb;
+        CRBRadixEntry radix;
+} Entry;
+
+static volatile void *sink;
+
+static uint64_t random_key(void) {
+        return (uint64_t)rand() << 62 ^ (uint64_t)rand() << 31 ^ (uint64_t)rand();
+}
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        uint64_t key = *(uint64_t *)k, other = c_rbnode_entry(n, Entry, rb)->radix.key;
+
+        return (key < other) ? -1 : (key > other) ? 1 : 0;
+}
+
+static double average_depth(CRBNode **nodes, size_t n_nodes) {
+        size_t i, depth = 0;
+        CRBNode *n;
+
+        for (i = 0; i < n_nodes; ++i)
+                for (n = nodes[i]; n; n = c_rbnode_parent(n))
+                        ++depth;
+
+        return (double)depth / n_nodes;
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_entries = 1000000, max;
+        CRBTree t = C_RBTREE_INIT;
+        CRBNode **slot, *p, **nodes;
+        CRBBenchSample s;
+        uint64_t *lookups;
+        Entry *entries;
+        CRBRadix radix;
+        CRBBench b;
+        const char *e;
+        char label[64];
+        int r;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_entries = n_entries < max ? n_entries : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        entries = calloc(n_entries, sizeof(*entries));
+        nodes = malloc(n_entries * sizeof(*nodes));
+        lookups = malloc(N_LOOKUPS * sizeof(*lookups));
+        assert(entries && nodes && lookups);
+
+        for (i = 0; i < n_entries; ++i)
+                entries[i].radix.key = random_key();
+        for (i = 0; i < N_LOOKUPS; ++i)
+                lookups[i] = entries[rand() % n_entries].radix.key;
+
+        snprintf(label, sizeof(label), "%zu entries", n_entries);
+        c_rbbench_print_header(label);
+
+        c_rbbench_start(&b, &s);
+        for (i = 0; i < n_entries; ++i) {
+                slot = c_rbtree_find_slot(&t, compare, &entries[i].radix.key, &p);
+                assert(slot);
+                c_rbtree_add(&t, p, slot, &entries[i].rb);
+        }
+        c_rbbench_stop(&b, &s);
+        c_rbbench_print("c_rbtree_add", &s, n_entries);
+
+        c_rbradix_init(&radix, 64);
+        c_rbbench_start(&b, &s);
+        for (i = 0; i < n_entries; ++i) {
+                c_rbnode_init(&entries[i].radix.rb);
+                r = c_rbradix_add(&radix, &entries[i].radix, entries[i].radix.key);
+                assert(!r);
+        }
+        c_rbbench_stop(&b, &s);
+        c_rbbench_print("c_rbradix_add", &s, n_entries);
+
+        c_rbbench_start(&b, &s);
+        for (i = 0; i < N_LOOKUPS; ++i)
+                sink = c_rbtree_find_node(&t, compare, &lookups[i]);
+        c_rbbench_stop(&b, &s);
+        c_rbbench_print("c_rbtree_find_node", &s, N_LOOKUPS);
+
+        c_rbbench_start(&b, &s);
+        for (i = 0; i < N_LOOKUPS; ++i)
+                sink = c_rbradix_find(&radix, lookups[i]);
+        c_rbbench_stop(&b, &s);
+        c_rbbench_print("c_rbradix_find", &s, N_LOOKUPS);
+
+        for (i = 0; i < n_entries; ++i)
+                nodes[i] = &entries[i].rb;
+        fprintf(stderr, "%-32s %.2f\n", "average depth (plain)", average_depth(nodes, n_entries));
+
+        for (i = 0; i < n_entries; ++i)
+                nodes[i] = &entries[i].radix.rb;
+        fprintf(stderr, "%-32s %.2f (%u shard bits)\n", "average depth (sharded)",
+                average_depth(nodes, n_entries), radix.n_shard_bits);
+        fprintf(stderr, "\n");
+
+        c_rbradix_deinit(&radix);
+        free(lookups);
+        free(nodes);
+        free(entries);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
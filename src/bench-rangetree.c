@@ -0,0 +1,243 @@
+/*
+ * Benchmarks for Two-Dimensional Range Trees
+ * This compares rectangle queries on a range tree against a range scan over a
+ * plain RB-Tree ordered by the primary key, which filters on the secondary
+ * key. Both structures hold the same entries.
+ *
+ * Queries use a wide primary range and a narrow secondary range, so most
+ * entries visited by the scan are filtered out. A mixed workload interleaves
+ * queries with updates, to include the cost of staged entries and tombstones.
+ * The number of entries defaults to 1M, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbrangetree.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_QUERIES 500
+#define N_KEYS (UINT64_C(1) << 32)
+
+typedef struct {
+        CRBNode rb;
+        uint64_t key;
+        uint64_t secondary;
+        CRBRangeTreeEntry rt;
+} Entry;
+
+typedef struct {
+        uint64_t key_min;
+        uint64_t key_max;
+        uint64_t secondary_min;
+        uint64_t secondary_max;
+} Query;
+
+static uint64_t random_key(void) {
+        return ((uint64_t)rand() << 16 ^ (uint64_t)rand()) % N_KEYS;
+}
+
+static int count(CRBRangeTreeEntry *e, void *userdata) {
+        ++*(size_t *)userdata;
+        return 0;
+}
+
+static size_t scan_and_filter(CRBTree *t, const Query *q) {
+        CRBNode *n, *s = NULL;
+        size_t n_found = 0;
+        Entry *e;
+
+        for (n = t->root; n; ) {
+                if (c_rbnode_entry(n, Entry, rb)->key < q->key_min) {
+                        n = n->right;
+                } else {
+                        s = n;
+                        n = n->left;
+                }
+        }
+
+        for ( ; s; s = c_rbnode_next(s)) {
+                e = c_rbnode_entry(s, Entry, rb);
+                if (e->key > q->key_max)
+                        break;
+                if (e->secondary >= q->secondary_min && e->secondary <= q->secondary_max)
+                        ++n_found;
+        }
+
+        return n_found;
+}
+
+static void scan_add(CRBTree *t, Entry *e) {
+        CRBNode **slot = &t->root, *p = NULL;
+
+        while (*slot) {
+                p = *slot;
+                if (e->key < c_rbnode_entry(p, Entry, rb)->key)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbtree_add(t, p, slot, &e->rb);
+}
+
+static void random_queries(Query *queries, uint64_t key_width, uint64_t secondary_width) {
+        size_t i;
+
+        for (i = 0; i < N_QUERIES; ++i) {
+                queries[i].key_min = random_key();
+                queries[i].key_max = queries[i].key_min + key_width;
+                queries[i].secondary_min = random_key();
+                queries[i].secondary_max = queries[i].secondary_min + secondary_width;
+        }
+}
+
+static void bench_queries(CRBBench *b, CRBRangeTree *rt, CRBTree *t, const char *label,
+                          uint64_t key_width, uint64_t secondary_width) {
+        size_t i, n_rt = 0, n_scan = 0;
+        CRBBenchSample s;
+        Query *queries;
+
+        queries = malloc(N_QUERIES * sizeof(*queries));
+        assert(queries);
+
+        random_queries(queries, key_width, secondary_width);
+
+        c_rbbench_print_header(label);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_QUERIES; ++i)
+                c_rbrangetree_query(rt, queries[i].key_min, queries[i].key_max,
+                                    queries[i].secondary_min, queries[i].secondary_max,
+                                    count, &n_rt);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("c_rbrangetree_query", &s, N_QUERIES);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_QUERIES; ++i)
+                n_scan += scan_and_filter(t, &queries[i]);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("scan and filter", &s, N_QUERIES);
+
+        assert(n_rt == n_scan);
+        fprintf(stderr, "%-32s %zu\n", "results per query", n_rt / N_QUERIES);
+        fprintf(stderr, "\n");
+
+        free(queries);
+}
+
+static void bench_mixed(CRBBench *b, CRBRangeTree *rt, CRBTree *t, Entry *entries, size_t n_entries) {
+        size_t i, n_rt = 0, n_scan = 0;
+        uint64_t key, secondary;
+        CRBBenchSample s;
+        Query *queries;
+        Entry *e;
+
+        queries = malloc(N_QUERIES * sizeof(*queries));
+        assert(queries);
+
+        random_queries(queries, N_KEYS / 16, N_KEYS / 1024);
+
+        c_rbbench_print_header("1 update per query");
+
+        /* move one random entry before each query, in both structures */
+        srand(0xcafe);
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_QUERIES; ++i) {
+                e = &entries[rand() % n_entries];
+                key = random_key();
+                secondary = random_key();
+                c_rbrangetree_remove(rt, &e->rt);
+                c_rbrangetree_add(rt, &e->rt, key, secondary);
+                c_rbrangetree_query(rt, queries[i].key_min, queries[i].key_max,
+                                    queries[i].secondary_min, queries[i].secondary_max,
+                                    count, &n_rt);
+        }
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("c_rbrangetree_*", &s, N_QUERIES);
+
+        srand(0xcafe);
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_QUERIES; ++i) {
+                e = &entries[rand() % n_entries];
+                c_rbnode_unlink(&e->rb);
+                e->key = random_key();
+                e->secondary = random_key();
+                scan_add(t, e);
+                n_scan += scan_and_filter(t, &queries[i]);
+        }
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("scan and filter", &s, N_QUERIES);
+
+        assert(n_rt == n_scan);
+        fprintf(stderr, "\n");
+
+        free(queries);
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_entries = 1000000, max;
+        CRBRangeTree rt = C_RBRANGETREE_INIT;
+        CRBTree t = C_RBTREE_INIT;
+        CRBBenchSample s;
+        Entry *entries;
+        CRBBench b;
+        const char *e;
+        char label[64];
+        int r;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_entries = n_entries < max ? n_entries : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        entries = calloc(n_entries, sizeof(*entries));
+        assert(entries);
+
+        snprintf(label, sizeof(label), "%zu entries", n_entries);
+        c_rbbench_print_header(label);
+
+        c_rbbench_start(&b, &s);
+        for (i = 0; i < n_entries; ++i) {
+                entries[i].rt = (CRBRangeTreeEntry)C_RBRANGETREE_ENTRY_INIT(entries[i].rt);
+                c_rbrangetree_add(&rt, &entries[i].rt, random_key(), random_key());
+        }
+        r = c_rbrangetree_rebuild(&rt);
+        assert(!r);
+        c_rbbench_stop(&b, &s);
+        c_rbbench_print("c_rbrangetree_add + rebuild", &s, n_entries);
+
+        c_rbbench_start(&b, &s);
+        for (i = 0; i < n_entries; ++i) {
+                c_rbnode_init(&entries[i].rb);
+                entries[i].key = entries[i].rt.key;
+                entries[i].secondary = entries[i].rt.secondary;
+                scan_add(&t, &entries[i]);
+        }
+        c_rbbench_stop(&b, &s);
+        c_rbbench_print("c_rbtree_add", &s, n_entries);
+        fprintf(stderr, "\n");
+
+        bench_queries(&b, &rt, &t, "1/16 keys, 1/1024 secondaries", N_KEYS / 16, N_KEYS / 1024);
+        bench_queries(&b, &rt, &t, "1/256 keys, 1/16 secondaries", N_KEYS / 256, N_KEYS / 16);
+        bench_mixed(&b, &rt, &t, entries, n_entries);
+
+        c_rbrangetree_deinit(&rt);
+        free(entries);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Benchmarks for Skewed Lookups
+ * This looks up keys drawn from a Zipf distribution, once in a balanced tree
+ * built via c_rbtree_build(), and once in a tree rebuilt via
+ * c_rbtree_build_weighted() from the access counts of a training run. The
+ * popularity ranks are assigned to keys randomly, so hot keys are spread over
+ * the whole tree, rather than clustered on one side.
+ *
+ * Besides the lookup time, this prints the average number of nodes visited
+ * per lookup. The number of nodes defaults to 1M, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_LOOKUPS (4UL * 1024UL * 1024UL)
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+} Node;
+
+#define node_from_rb(_rb) c_rbnode_entry((_rb), Node, rb)
+
+static volatile CRBNode *sink;
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = node_from_rb(n);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void shuffle(unsigned long *v, size_t n_memb) {
+        unsigned long t;
+        size_t i, j;
+
+        for (i = 0; i < n_memb; ++i) {
+                j = rand() % n_memb;
+                t = v[j];
+                v[j] = v[i];
+                v[i] = t;
+        }
+}
+
+static void sample(unsigned long *keys, size_t n_keys, const double *cdf, const unsigned long *ranks, size_t n_nodes) {
+        size_t i, lo, hi, mid;
+        double u;
+
+        for (i = 0; i < n_keys; ++i) {
+                u = (double)rand() / ((double)RAND_MAX + 1.0);
+
+                lo = 0;
+                hi = n_nodes - 1;
+                while (lo < hi) {
+                        mid = lo + (hi - lo) / 2;
+                        if (cdf[mid] <= u)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+
+                keys[i] = ranks[lo];
+        }
+}
+
+static void bench_lookups(CRBBench *b, CRBTree *t, const unsigned long *keys, const char *name) {
+        CRBBenchSample s;
+        size_t i, n_visited = 0;
+        char label[64];
+        CRBNode *n;
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_LOOKUPS; ++i)
+                sink = c_rbtree_find_node(t, compare, (void *)keys[i]);
+        c_rbbench_stop(b, &s);
+
+        for (i = 0; i < N_LOOKUPS; ++i)
+                for (n = c_rbtree_find_node(t, compare, (void *)keys[i]); n; n = c_rbnode_parent(n))
+                        ++n_visited;
+
+        snprintf(label, sizeof(label), "%s (%.2f visited)", name, (double)n_visited / N_LOOKUPS);
+        c_rbbench_print(label, &s, N_LOOKUPS);
+}
+
+static void bench_zipf(CRBBench *b, Node *nodes, CRBNode **sorted, size_t n_nodes, double exponent) {
+        unsigned long *ranks, *keys;
+        CRBTree t = C_RBTREE_INIT;
+        CRBBenchSample s;
+        size_t i, *weights;
+        char title[64];
+        double *cdf;
+
+        ranks = malloc(n_nodes * sizeof(*ranks));
+        cdf = malloc(n_nodes * sizeof(*cdf));
+        weights = calloc(n_nodes, sizeof(*weights));
+        keys = malloc(N_LOOKUPS * sizeof(*keys));
+        assert(ranks && cdf && weights && keys);
+
+        for (i = 0; i < n_nodes; ++i)
+                ranks[i] = i;
+        shuffle(ranks, n_nodes);
+
+        cdf[0] = 1.0;
+        for (i = 1; i < n_nodes; ++i)
+                cdf[i] = cdf[i - 1] + 1.0 / pow((double)(i + 1), exponent);
+        for (i = 0; i < n_nodes; ++i)
+                cdf[i] /= cdf[n_nodes - 1];
+
+        snprintf(title, sizeof(title), "%zu nodes, zipf s = %.1f", n_nodes, exponent);
+        c_rbbench_print_header(title);
+
+        /* count accesses of a training run, then measure a separate one */
+        sample(keys, N_LOOKUPS, cdf, ranks, n_nodes);
+        for (i = 0; i < N_LOOKUPS; ++i)
+                ++weights[keys[i]];
+        sample(keys, N_LOOKUPS, cdf, ranks, n_nodes);
+
+        c_rbtree_build(&t, sorted, n_nodes);
+        bench_lookups(b, &t, keys, "balanced");
+
+        c_rbtree_init(&t);
+        c_rbbench_start(b, &s);
+        c_rbtree_build_weighted(&t, sorted, weights, n_nodes);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("c_rbtree_build_weighted", &s, n_nodes);
+
+        bench_lookups(b, &t, keys, "weighted");
+
+        fprintf(stderr, "\n");
+
+        free(keys);
+        free(weights);
+        free(cdf);
+        free(ranks);
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_nodes = 1000000, max;
+        CRBNode **sorted;
+        CRBBench b;
+        const char *e;
+        Node *nodes;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_nodes = n_nodes < max ? n_nodes : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        nodes = malloc(n_nodes * sizeof(*nodes));
+        sorted = malloc(n_nodes * sizeof(*sorted));
+        assert(nodes && sorted);
+
+        for (i = 0; i < n_nodes; ++i) {
+                nodes[i].key = i;
+                sorted[i] = &nodes[i].rb;
+        }
+
+        bench_zipf(&b, nodes, sorted, n_nodes, 0.8);
+        bench_zipf(&b, nodes, sorted, n_nodes, 1.0);
+        bench_zipf(&b, nodes, sorted, n_nodes, 1.2);
+
+        free(sorted);
+        free(nodes);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
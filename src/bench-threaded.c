@@ -0,0 +1,214 @@
+/*
+ * Benchmarks for Threaded Trees
+ * This compares a threaded tree to a plain RB-Tree, on the same set of
+ * entries, which are spread randomly in memory:
+ *
+ *   o walk: Iterate all entries in order, via c_rbnode_next() and
+ *           c_rbthreaded_next(), respectively.
+ *
+ *   o scan: Look up a random key, and iterate the following entries.
+ *
+ *   o modify: Remove all entries in random order, and add them back, to
+ *             show the cost of maintaining the list.
+ *
+ * The number of entries defaults to 1M, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbthreaded.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_SCANS 100000
+#define SCAN_LENGTH 32
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+        CRBThreadedEntry th;
+} Node;
+
+static volatile unsigned long sink;
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = c_rbnode_entry(n, Node, rb);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static int compare_threaded(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = c_rbnode_entry(n, Node, th.rb);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void shuffle(Node **nodes, size_t n_memb) {
+        size_t i, j;
+        Node *t;
+
+        for (i = 0; i < n_memb; ++i) {
+                j = rand() % n_memb;
+                t = nodes[j];
+                nodes[j] = nodes[i];
+                nodes[i] = t;
+        }
+}
+
+static void add(CRBTree *t, CRBThreaded *th, Node *node) {
+        CRBNode **slot, *p;
+
+        slot = c_rbtree_find_slot(t, compare, (void *)node->key, &p);
+        assert(slot);
+        c_rbtree_add(t, p, slot, &node->rb);
+
+        slot = c_rbtree_find_slot(&th->tree, compare_threaded, (void *)node->key, &p);
+        assert(slot);
+        c_rbthreaded_add(th, p, slot, &node->th);
+}
+
+static void bench_walk(CRBBench *b, CRBTree *t, CRBThreaded *th, size_t n_nodes) {
+        CRBThreadedEntry *e;
+        unsigned long sum;
+        CRBBenchSample s;
+        CRBNode *n;
+
+        sum = 0;
+        c_rbbench_start(b, &s);
+        c_rbtree_for_each(n, t)
+                sum += c_rbnode_entry(n, Node, rb)->key;
+        c_rbbench_stop(b, &s);
+        sink = sum;
+        c_rbbench_print("walk: c_rbnode_next", &s, n_nodes);
+
+        sum = 0;
+        c_rbbench_start(b, &s);
+        c_rbthreaded_for_each(e, th)
+                sum += c_rbnode_entry(e, Node, th)->key;
+        c_rbbench_stop(b, &s);
+        sink = sum;
+        c_rbbench_print("walk: c_rbthreaded_next", &s, n_nodes);
+}
+
+static void bench_scan(CRBBench *b, CRBTree *t, CRBThreaded *th, size_t n_nodes) {
+        unsigned long sum, *keys;
+        CRBThreadedEntry *e;
+        CRBBenchSample s;
+        size_t i, j;
+        CRBNode *n;
+
+        keys = malloc(N_SCANS * sizeof(*keys));
+        assert(keys);
+        for (i = 0; i < N_SCANS; ++i)
+                keys[i] = rand() % n_nodes;
+
+        sum = 0;
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_SCANS; ++i) {
+                n = c_rbtree_find_node(t, compare, (void *)keys[i]);
+                for (j = 0; n && j < SCAN_LENGTH; ++j, n = c_rbnode_next(n))
+                        sum += c_rbnode_entry(n, Node, rb)->key;
+        }
+        c_rbbench_stop(b, &s);
+        sink = sum;
+        c_rbbench_print("scan: c_rbnode_next", &s, N_SCANS);
+
+        sum = 0;
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_SCANS; ++i) {
+                e = c_rbthreaded_lower_bound(th, compare_threaded, (void *)keys[i]);
+                for (j = 0; e && j < SCAN_LENGTH; ++j, e = c_rbthreaded_next(e))
+                        sum += c_rbnode_entry(e, Node, th)->key;
+        }
+        c_rbbench_stop(b, &s);
+        sink = sum;
+        c_rbbench_print("scan: c_rbthreaded_next", &s, N_SCANS);
+
+        free(keys);
+}
+
+static void bench_modify(CRBBench *b, CRBTree *t, CRBThreaded *th, Node **order, size_t n_nodes) {
+        CRBNode **slot, *p;
+        CRBBenchSample s;
+        size_t i;
+
+        shuffle(order, n_nodes);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_nodes; ++i)
+                c_rbnode_unlink(&order[i]->rb);
+        for (i = 0; i < n_nodes; ++i) {
+                slot = c_rbtree_find_slot(t, compare, (void *)order[i]->key, &p);
+                c_rbtree_add(t, p, slot, &order[i]->rb);
+        }
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("modify: c_rbtree", &s, n_nodes);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_nodes; ++i)
+                c_rbthreaded_remove(th, &order[i]->th);
+        for (i = 0; i < n_nodes; ++i) {
+                slot = c_rbtree_find_slot(&th->tree, compare_threaded, (void *)order[i]->key, &p);
+                c_rbthreaded_add(th, p, slot, &order[i]->th);
+        }
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("modify: c_rbthreaded", &s, n_nodes);
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_nodes = 1000000, max;
+        CRBThreaded th = C_RBTHREADED_INIT;
+        CRBTree t = C_RBTREE_INIT;
+        char title[64];
+        Node *nodes, **order;
+        CRBBench b;
+        const char *e;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_nodes = n_nodes < max ? n_nodes : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        nodes = malloc(n_nodes * sizeof(*nodes));
+        order = malloc(n_nodes * sizeof(*order));
+        assert(nodes && order);
+
+        /* order nodes randomly in memory, so in-order walks are not linear */
+        for (i = 0; i < n_nodes; ++i)
+                order[i] = &nodes[i];
+        shuffle(order, n_nodes);
+        for (i = 0; i < n_nodes; ++i)
+                order[i]->key = i;
+
+        shuffle(order, n_nodes);
+        for (i = 0; i < n_nodes; ++i)
+                add(&t, &th, order[i]);
+
+        snprintf(title, sizeof(title), "%zu nodes", n_nodes);
+        c_rbbench_print_header(title);
+
+        bench_walk(&b, &t, &th, n_nodes);
+        bench_scan(&b, &t, &th, n_nodes);
+        bench_modify(&b, &t, &th, order, n_nodes);
+
+        free(order);
+        free(nodes);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Benchmarks for Top-K Selection
+ * This streams values through a top-k container, and compares it to the
+ * naive approach: link every candidate into a plain tree, and unlink the
+ * minimum whenever the tree grows past k nodes. Both go through the same
+ * comparison callback, so neither gets to inline it.
+ *
+ * Random streams are dominated by rejections, once the container is full.
+ * Ascending streams are the worst case, since every candidate evicts the
+ * minimum. The stream length defaults to 4M values, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbtopk.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+typedef struct {
+        uint64_t value;
+        CRBNode rb;
+} Node;
+
+#define node_from_rb(_rb) c_rbnode_entry((_rb), Node, rb)
+
+static int compare(CRBNode *a, CRBNode *b) {
+        uint64_t va = node_from_rb(a)->value, vb = node_from_rb(b)->value;
+
+        return (va < vb) ? -1 : (va > vb) ? 1 : 0;
+}
+
+static void naive_push(CRBTree *t, CRBTopkCompareFunc compare, size_t *n_nodes, size_t k, CRBNode *n) {
+        CRBNode **slot = &t->root, *p = NULL;
+
+        while (*slot) {
+                p = *slot;
+                if (compare(n, p) < 0)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbtree_add(t, p, slot, n);
+        if (++*n_nodes > k) {
+                c_rbnode_unlink(c_rbtree_first(t));
+                --*n_nodes;
+        }
+}
+
+static void bench_stream(CRBBench *b, Node *nodes, size_t n_values, size_t k, const char *name) {
+        CRBTree naive = C_RBTREE_INIT;
+        size_t i, n_naive = 0;
+        CRBBenchSample s;
+        char label[64];
+        CRBTopk t;
+
+        snprintf(label, sizeof(label), "%s, k = %zu", name, k);
+        c_rbbench_print_header(label);
+
+        c_rbtopk_init(&t, compare, k);
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_values; ++i)
+                c_rbtopk_push(&t, &nodes[i].rb);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("c_rbtopk_push", &s, n_values);
+
+        for (i = 0; i < n_values; ++i)
+                c_rbnode_init(&nodes[i].rb);
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < n_values; ++i)
+                naive_push(&naive, t.compare, &n_naive, k, &nodes[i].rb);
+        c_rbbench_stop(b, &s);
+        c_rbbench_print("c_rbtree_add + unlink first", &s, n_values);
+
+        for (i = 0; i < n_values; ++i)
+                c_rbnode_init(&nodes[i].rb);
+
+        fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_values = 4000000, max;
+        CRBBench b;
+        const char *e;
+        Node *nodes;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_values = n_values < max ? n_values : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        nodes = calloc(n_values, sizeof(*nodes));
+        assert(nodes);
+
+        for (i = 0; i < n_values; ++i)
+                nodes[i].value = (uint64_t)rand() << 31 ^ (uint64_t)rand();
+
+        bench_stream(&b, nodes, n_values, 1000, "random");
+        bench_stream(&b, nodes, n_values, 100000, "random");
+
+        for (i = 0; i < n_values; ++i)
+                nodes[i].value = i;
+
+        bench_stream(&b, nodes, n_values, 1000, "ascending");
+        bench_stream(&b, nodes, n_values, 100000, "ascending");
+
+        free(nodes);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Benchmarks for TTL Caches
+ * This measures the throughput of a TTL cache under a typical read-through
+ * workload: look up a key, refresh its expiry on a hit, and add it on a miss,
+ * evicting the entry closest to expiry if the cache is full. Keys are skewed,
+ * so hot keys are refreshed often, while cold ones expire. The clock advances
+ * with the number of operations, and expired entries are detached
+ * periodically.
+ *
+ * The workload is run with fine-grained expiry times, where each refresh
+ * moves the entry to the end of the expiry order, and with coarse ones,
+ * where many entries share an expiry time and refreshes mostly update in
+ * place. Both are compared to refreshing via remove and add.
+ *
+ * The cache size defaults to 1M entries, and can be capped via the
+ * CRBTREE_BENCH_MAX environment variable.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbttl.h"
+#include "c-rbtree.h"
+#include "c-rbtree-bench.h"
+#include "c-rbtree-private.h"
+
+#define N_OPS (8UL * 1024UL * 1024UL)
+#define EXPIRE_INTERVAL 1024
+
+typedef struct {
+        unsigned long key;
+        CRBTtlEntry ttl;
+} Node;
+
+static size_t hash(unsigned long key) {
+        return key * 0x9e3779b97f4a7c15ULL;
+}
+
+static bool equal(CRBTtlEntry *e, const void *k) {
+        return c_rbnode_entry(e, Node, ttl)->key == (unsigned long)k;
+}
+
+static void bench_workload(CRBBench *b,
+                           Node *nodes,
+                           unsigned long *keys,
+                           size_t n_keys,
+                           size_t n_entries,
+                           uint64_t granularity,
+                           bool relink,
+                           const char *name) {
+        size_t i, n_buckets, n_hits = 0;
+        CRBTtlEntry **buckets, *e;
+        uint64_t now, ttl, expiry;
+        CRBBenchSample s;
+        char label[64];
+        CRBTtl c;
+
+        for (n_buckets = 1; n_buckets < n_entries; n_buckets *= 2)
+                ;
+
+        buckets = malloc(n_buckets * sizeof(*buckets));
+        assert(buckets);
+
+        for (i = 0; i < n_keys; ++i)
+                nodes[i] = (Node){ .key = i, .ttl = C_RBTTL_ENTRY_INIT(nodes[i].ttl) };
+
+        c_rbttl_init(&c, buckets, n_buckets, n_entries);
+
+        /* entries live for about as many operations as fit into the cache */
+        ttl = n_entries;
+
+        c_rbbench_start(b, &s);
+        for (i = 0; i < N_OPS; ++i) {
+                now = i;
+                expiry = (now + ttl) / granularity * granularity;
+
+                e = c_rbttl_find(&c, hash(keys[i]), equal, (void *)keys[i]);
+                if (e) {
+                        ++n_hits;
+                        if (relink) {
+                                c_rbttl_remove(&c, e);
+                                c_rbttl_add(&c, e, hash(keys[i]), expiry);
+                        } else {
+                                c_rbttl_refresh(&c, e, expiry);
+                        }
+                } else {
+                        c_rbttl_add(&c, &nodes[keys[i]].ttl, hash(keys[i]), expiry);
+                }
+
+                if (!(i % EXPIRE_INTERVAL))
+                        c_rbttl_expire(&c, now, NULL);
+        }
+        c_rbbench_stop(b, &s);
+
+        snprintf(label, sizeof(label), "%s (%.0f%% hits)", name, 100.0 * n_hits / N_OPS);
+        c_rbbench_print(label, &s, N_OPS);
+
+        free(buckets);
+}
+
+int main(int argc, char **argv) {
+        size_t i, n_entries = 1000000, n_keys, max;
+        unsigned long *keys;
+        char title[64];
+        double u;
+        CRBBench b;
+        const char *e;
+        Node *nodes;
+
+        e = getenv("CRBTREE_BENCH_MAX");
+        if (e) {
+                max = strtoul(e, NULL, 10);
+                n_entries = n_entries < max ? n_entries : max;
+        }
+
+        /* we want stable benchmarks, so use fixed seed */
+        srand(0xdeadbeef);
+
+        c_rbbench_init(&b);
+
+        n_keys = n_entries;
+        nodes = malloc(n_keys * sizeof(*nodes));
+        keys = malloc(N_OPS * sizeof(*keys));
+        assert(nodes && keys);
+
+        /* cube a uniform value, so low keys are much hotter than others */
+        for (i = 0; i < N_OPS; ++i) {
+                u = (double)rand() / ((double)RAND_MAX + 1.0);
+                keys[i] = (unsigned long)(u * u * u * n_keys);
+        }
+
+        snprintf(title, sizeof(title), "%zu entries", n_entries);
+        c_rbbench_print_header(title);
+
+        bench_workload(&b, nodes, keys, n_keys, n_entries, 1, false, "fine, refresh");
+        bench_workload(&b, nodes, keys, n_keys, n_entries, 1, true, "fine, remove + add");
+        bench_workload(&b, nodes, keys, n_keys, n_entries, n_entries / 8, false, "coarse, refresh");
+        bench_workload(&b, nodes, keys, n_keys, n_entries, n_entries / 8, true, "coarse, remove + add");
+
+        free(keys);
+        free(nodes);
+        c_rbbench_deinit(&b);
+
+        return 0;
+}
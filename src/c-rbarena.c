@@ -0,0 +1,231 @@
+/*
+ * Node Arenas
+ * This implements a fixed-size entry pool on top of a single anonymous memory
+ * mapping, optionally backed by huge pages.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "c-rbarena.h"
+#include "c-rbtree-private.h"
+
+#define C_RBARENA_HUGEPAGE_SIZE (2UL * 1024UL * 1024UL)
+
+static size_t c_rbarena_align(size_t v, size_t to) {
+        return (v + to - 1) & ~(to - 1);
+}
+
+static void *c_rbarena_map(size_t size) {
+        return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+static _Bool c_rbarena_thp_enabled(void) {
+        char buf[128];
+        ssize_t l;
+        int fd;
+
+        /*
+         * The kernel accepts MADV_HUGEPAGE even if transparent huge pages are
+         * disabled system-wide, so check the mode first. Without the sysfs
+         * file, the kernel has no THP support at all.
+         */
+        fd = open("/sys/kernel/mm/transparent_hugepage/enabled", O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return 0;
+
+        l = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (l <= 0)
+                return 0;
+
+        buf[l] = 0;
+        return !strstr(buf, "[never]");
+}
+
+static int c_rbarena_map_huge(CRBArena *a) {
+        uintptr_t start, aligned;
+        size_t size;
+        void *mem;
+
+        /* the trimmed over-allocation needs another huge page on top */
+        if (a->size > SIZE_MAX - 2 * C_RBARENA_HUGEPAGE_SIZE + 1)
+                return -ENOMEM;
+
+        a->size = c_rbarena_align(a->size, C_RBARENA_HUGEPAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+        /* this only succeeds if the admin reserved huge pages */
+        mem = mmap(NULL, a->size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+                a->mem = mem;
+                a->backing = C_RBARENA_BACKING_HUGETLB;
+                return 0;
+        }
+#endif
+
+        /*
+         * Transparent huge pages are only used for huge-page aligned ranges,
+         * so over-allocate and trim the mapping to an aligned range.
+         */
+        size = a->size + C_RBARENA_HUGEPAGE_SIZE;
+        mem = c_rbarena_map(size);
+        if (mem == MAP_FAILED)
+                return -errno;
+
+        start = (uintptr_t)mem;
+        aligned = c_rbarena_align(start, C_RBARENA_HUGEPAGE_SIZE);
+        if (aligned > start)
+                munmap(mem, aligned - start);
+        if (start + size > aligned + a->size)
+                munmap((void *)(aligned + a->size), start + size - aligned - a->size);
+
+        a->mem = (void *)aligned;
+        a->backing = C_RBARENA_BACKING_PAGES;
+
+#ifdef MADV_HUGEPAGE
+        if (madvise(a->mem, a->size, MADV_HUGEPAGE) >= 0 && c_rbarena_thp_enabled())
+                a->backing = C_RBARENA_BACKING_THP;
+#endif
+
+        return 0;
+}
+
+/**
+ * c_rbarena_init() - initialize arena
+ * @a:                  arena to initialize
+ * @entry_size:         size of each entry
+ * @n_entries:          minimum number of entries to provide
+ * @flags:              flags to control the backing memory
+ *
+ * This maps backing memory for at least @n_entries entries of @entry_size
+ * bytes each, and initializes @a to hand them out. Entries are aligned
+ * suitably for any object type, so @entry_size is rounded up accordingly.
+ *
+ * If C_RBARENA_FLAG_HUGEPAGES is set in @flags, the memory is backed by huge
+ * pages, if possible. If not, this falls back to regular pages. In that case,
+ * the size of the mapping is rounded up to the huge page size, and thus might
+ * provide more entries than requested.
+ *
+ * Return: 0 on success, negative error code on failure.
+ */
+_public_ int c_rbarena_init(CRBArena *a, size_t entry_size, size_t n_entries, unsigned int flags) {
+        size_t page_size;
+        void *mem;
+        int r;
+
+        assert(a);
+        assert(entry_size > 0);
+        assert(n_entries > 0);
+
+        *a = (CRBArena)C_RBARENA_INIT;
+
+        /* each rounding step below must not wrap around */
+        if (entry_size > SIZE_MAX - (alignof(max_align_t) - 1))
+                return -ENOMEM;
+
+        entry_size = c_rbarena_align(entry_size, alignof(max_align_t));
+        if (n_entries > SIZE_MAX / entry_size)
+                return -ENOMEM;
+
+        page_size = sysconf(_SC_PAGESIZE);
+        if (entry_size * n_entries > SIZE_MAX - (page_size - 1))
+                return -ENOMEM;
+
+        a->entry_size = entry_size;
+        a->size = c_rbarena_align(entry_size * n_entries, page_size);
+
+        if (flags & C_RBARENA_FLAG_HUGEPAGES) {
+                r = c_rbarena_map_huge(a);
+                if (r < 0)
+                        return r;
+        } else {
+                mem = c_rbarena_map(a->size);
+                if (mem == MAP_FAILED)
+                        return -errno;
+
+                a->mem = mem;
+                a->backing = C_RBARENA_BACKING_PAGES;
+        }
+
+        a->n_entries = a->size / entry_size;
+        return 0;
+}
+
+/**
+ * c_rbarena_deinit() - deinitialize arena
+ * @a:                  arena to deinitialize
+ *
+ * This unmaps the backing memory of @a. All entries become invalid. The arena
+ * is reset to C_RBARENA_INIT, so calling this multiple times is safe.
+ */
+_public_ void c_rbarena_deinit(CRBArena *a) {
+        assert(a);
+
+        if (a->mem)
+                munmap(a->mem, a->size);
+
+        *a = (CRBArena)C_RBARENA_INIT;
+}
+
+/**
+ * c_rbarena_alloc() - allocate entry
+ * @a:                  arena to allocate from
+ *
+ * This returns an unused entry of @a. Released entries are reused first.
+ * Otherwise, the next untouched entry is used. Content of the returned entry
+ * is undefined.
+ *
+ * Fixed runtime: O(1)
+ *
+ * Return: Pointer to entry, or NULL if the arena is exhausted.
+ */
+_public_ void *c_rbarena_alloc(CRBArena *a) {
+        void *p;
+
+        assert(a);
+
+        if (a->free_list) {
+                p = a->free_list;
+                a->free_list = *(void **)p;
+        } else if (a->n_used < a->n_entries) {
+                p = (char *)a->mem + a->n_used++ * a->entry_size;
+        } else {
+                p = NULL;
+        }
+
+        return p;
+}
+
+/**
+ * c_rbarena_free() - release entry
+ * @a:                  arena to release to
+ * @p:                  entry to release, or NULL
+ *
+ * This releases the entry @p, previously returned by c_rbarena_alloc() on the
+ * same arena. If @p is NULL, this is a no-op.
+ *
+ * Fixed runtime: O(1)
+ */
+_public_ void c_rbarena_free(CRBArena *a, void *p) {
+        assert(a);
+
+        if (p) {
+                assert((char *)p >= (char *)a->mem);
+                assert((char *)p < (char *)a->mem + a->n_used * a->entry_size);
+
+                *(void **)p = a->free_list;
+                a->free_list = p;
+        }
+}
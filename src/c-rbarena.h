@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * Node Arenas
+ *
+ * An arena is a fixed-size pool of equally sized entries, backed by a single
+ * anonymous memory mapping. It is meant to back the objects embedding CRBNode
+ * structures of a large tree, so all nodes share a dense memory region.
+ *
+ * For very large trees, the cost of a lookup is dominated by TLB misses rather
+ * than cache misses, since every level of the tree touches a different page.
+ * Arenas can optionally be backed by 2MiB huge pages, which cover the same
+ * amount of memory with 512x fewer TLB entries. Explicit huge pages
+ * (MAP_HUGETLB) are used if the system has them reserved, otherwise
+ * transparent huge pages are requested via madvise(MADV_HUGEPAGE). If neither
+ * is available, the arena silently falls back to regular pages. The backing
+ * actually used is reported in the @backing field. Transparent huge pages are
+ * only reported if the system-wide mode in
+ * /sys/kernel/mm/transparent_hugepage/enabled is not "never". Even then, the
+ * kernel might back parts of the arena with regular pages, if it cannot find
+ * free huge pages.
+ *
+ * Entries are allocated and released in O(1). Released entries are kept in a
+ * free-list and reused before any untouched entries.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+typedef struct CRBArena CRBArena;
+
+enum {
+        C_RBARENA_FLAG_HUGEPAGES        = (1U << 0),
+};
+
+enum {
+        C_RBARENA_BACKING_PAGES,
+        C_RBARENA_BACKING_THP,
+        C_RBARENA_BACKING_HUGETLB,
+};
+
+/**
+ * struct CRBArena - node arena
+ * @mem:                backing memory mapping
+ * @size:               size of @mem in bytes
+ * @entry_size:         size of each entry, including alignment
+ * @n_entries:          number of entries that fit into @mem
+ * @n_used:             number of entries handed out at least once
+ * @free_list:          released entries, ready for reuse
+ * @backing:            type of pages backing @mem
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBArena {
+        void *mem;
+        size_t size;
+        size_t entry_size;
+        size_t n_entries;
+        size_t n_used;
+        void *free_list;
+        unsigned int backing;
+};
+
+#define C_RBARENA_INIT {}
+
+int c_rbarena_init(CRBArena *a, size_t entry_size, size_t n_entries, unsigned int flags);
+void c_rbarena_deinit(CRBArena *a);
+
+void *c_rbarena_alloc(CRBArena *a);
+void c_rbarena_free(CRBArena *a, void *p);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Change Logs
+ * This implements change logs in a ring buffer of the API user. Change N is
+ * stored at index N modulo the ring size, so the ring always holds the last
+ * changes up to the ring size, and no further bookkeeping is needed to find
+ * them.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "c-rbchangelog.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+/**
+ * c_rbchangelog_record() - record change
+ * @l:                  change log to record in
+ * @type:               type of the change, C_RBCHANGE_*
+ * @n:                  node that changed
+ *
+ * This records a change of @n with the next sequence number. If the ring
+ * buffer is full, the oldest change is overwritten.
+ *
+ * Fixed runtime: O(1)
+ */
+_public_ void c_rbchangelog_record(CRBChangelog *l, unsigned int type, CRBNode *n) {
+        CRBChange *c;
+
+        assert(l);
+        assert(l->n_ring > 0);
+        assert(type <= C_RBCHANGE_UPDATE);
+        assert(n);
+
+        c = &l->ring[l->seq % l->n_ring];
+        c->seq = l->seq++;
+        c->type = type;
+        c->node = n;
+}
+
+/**
+ * c_rbchangelog_read() - read changes since sequence number
+ * @l:                  change log to read from
+ * @seqp:               sequence number to read from, updated on return
+ * @changes:            array to copy changes into
+ * @n_changes:          number of changes that fit into @changes
+ * @n_readp:            output argument for the number of changes read
+ *
+ * This copies the changes with sequence numbers starting at *@seqp into
+ * @changes, in recording order, up to @n_changes of them. *@seqp is advanced
+ * past the last change read, so the next call continues from there. Once all
+ * changes were read, 0 is returned in @n_readp.
+ *
+ * If the ring buffer already overwrote the change at *@seqp, -ESTALE is
+ * returned, and nothing is read. The consumer missed changes, and must scan
+ * the whole tree. *@seqp must not be larger than c_rbchangelog_seq().
+ *
+ * Worst case runtime (k: number of changes read): O(k)
+ *
+ * Return: 0 on success, -ESTALE if changes were lost.
+ */
+_public_ int c_rbchangelog_read(CRBChangelog *l, uint64_t *seqp, CRBChange *changes, size_t n_changes, size_t *n_readp) {
+        uint64_t seq, n;
+        size_t i;
+
+        assert(l);
+        assert(seqp);
+        assert(*seqp <= l->seq);
+        assert(changes || !n_changes);
+        assert(n_readp);
+
+        seq = *seqp;
+        if (l->seq - seq > l->n_ring) {
+                *n_readp = 0;
+                return -ESTALE;
+        }
+
+        n = l->seq - seq;
+        if (n > n_changes)
+                n = n_changes;
+
+        for (i = 0; i < n; ++i)
+                changes[i] = l->ring[(seq + i) % l->n_ring];
+
+        *seqp = seq + n;
+        *n_readp = n;
+        return 0;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+/**
+ * Change Logs
+ *
+ * A change log records which nodes of a tree were added, removed, or updated,
+ * so consumers can follow a tree incrementally, rather than rescanning it to
+ * find out what changed. Each change gets a sequence number, starting at 0.
+ * A consumer remembers the sequence number it read up to, and later asks for
+ * all changes since then, which costs time proportional to the churn, not to
+ * the size of the tree.
+ *
+ * Changes are stored in a ring buffer provided by the API user, so the log
+ * never allocates memory, and recording a change takes O(1). Once the ring is
+ * full, the oldest changes are overwritten. A consumer that fell behind by
+ * more than the ring size is told so, and must fall back to a full scan:
+ *
+ *         seq = c_rbchangelog_seq(l);
+ *         ...scan the whole tree...
+ *         ...continue reading changes from @seq...
+ *
+ * The log is attached to a tree by using the wrappers below for all changes
+ * to the tree, or by calling c_rbchangelog_record() next to the tree
+ * operations. Updates are whatever the API user considers a change of a node,
+ * usually a modification of the object that embeds it.
+ *
+ * Changes only reference nodes. A removed node might have been released by
+ * the time a consumer reads its change, so the reference must only be used to
+ * identify it, unless the API user defers releasing nodes until all consumers
+ * caught up.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBChange CRBChange;
+typedef struct CRBChangelog CRBChangelog;
+
+enum {
+        C_RBCHANGE_ADD,
+        C_RBCHANGE_REMOVE,
+        C_RBCHANGE_UPDATE,
+};
+
+/**
+ * struct CRBChange - recorded change
+ * @seq:                sequence number of the change
+ * @type:               type of the change, C_RBCHANGE_*
+ * @node:               node that changed
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBChange {
+        uint64_t seq;
+        unsigned int type;
+        CRBNode *node;
+};
+
+/**
+ * struct CRBChangelog - change log
+ * @ring:               ring buffer of recorded changes
+ * @n_ring:             number of changes that fit into @ring
+ * @seq:                sequence number of the next change
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBChangelog {
+        CRBChange *ring;
+        size_t n_ring;
+        uint64_t seq;
+};
+
+#define C_RBCHANGELOG_INIT(_ring, _n_ring) { .ring = (_ring), .n_ring = (_n_ring) }
+
+void c_rbchangelog_record(CRBChangelog *l, unsigned int type, CRBNode *n);
+int c_rbchangelog_read(CRBChangelog *l, uint64_t *seqp, CRBChange *changes, size_t n_changes, size_t *n_readp);
+
+/**
+ * c_rbchangelog_init() - initialize change log
+ * @l:                  change log to initialize
+ * @ring:               ring buffer to store changes in
+ * @n_ring:             number of changes that fit into @ring, at least 1
+ *
+ * This initializes @l as an empty change log, which stores the last @n_ring
+ * changes in @ring. The ring buffer must stay valid as long as @l is used.
+ */
+static inline void c_rbchangelog_init(CRBChangelog *l, CRBChange *ring, size_t n_ring) {
+        *l = (CRBChangelog)C_RBCHANGELOG_INIT(ring, n_ring);
+}
+
+/**
+ * c_rbchangelog_seq() - return next sequence number
+ * @l:                  change log to query
+ *
+ * Return: The sequence number the next recorded change will get.
+ */
+static inline uint64_t c_rbchangelog_seq(CRBChangelog *l) {
+        return l->seq;
+}
+
+/**
+ * c_rbchangelog_add() - link node into tree, and record it
+ * @l:                  change log to record in
+ * @t:                  tree to operate on
+ * @p:                  parent node to link under
+ * @slot:               left/right slot of @p to link at
+ * @n:                  node to add
+ *
+ * This is c_rbtree_add(), followed by recording a C_RBCHANGE_ADD change.
+ *
+ * Worst case runtime (n: number of elements in tree): O(log(n))
+ */
+static inline void c_rbchangelog_add(CRBChangelog *l, CRBTree *t, CRBNode *p, CRBNode **slot, CRBNode *n) {
+        c_rbtree_add(t, p, slot, n);
+        c_rbchangelog_record(l, C_RBCHANGE_ADD, n);
+}
+
+/**
+ * c_rbchangelog_unlink() - unlink node from its tree, and record it
+ * @l:                  change log to record in
+ * @n:                  node to unlink
+ *
+ * This is c_rbnode_unlink(), followed by recording a C_RBCHANGE_REMOVE change.
+ * Nothing is recorded if @n is not linked.
+ *
+ * Worst case runtime (n: number of elements in tree): O(log(n))
+ */
+static inline void c_rbchangelog_unlink(CRBChangelog *l, CRBNode *n) {
+        if (c_rbnode_is_linked(n)) {
+                c_rbnode_unlink(n);
+                c_rbchangelog_record(l, C_RBCHANGE_REMOVE, n);
+        }
+}
+
+/**
+ * c_rbchangelog_update() - record update of node
+ * @l:                  change log to record in
+ * @n:                  node that was updated
+ *
+ * This records a C_RBCHANGE_UPDATE change of @n.
+ *
+ * Fixed runtime: O(1)
+ */
+static inline void c_rbchangelog_update(CRBChangelog *l, CRBNode *n) {
+        c_rbchangelog_record(l, C_RBCHANGE_UPDATE, n);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,167 @@
+/*
+ * EEVDF Queues
+ * This implements EEVDF queues on top of an augmented RB-Tree. The tree is
+ * ordered by virtual deadline, and each entry caches the lowest virtual start
+ * time of its subtree, which is maintained via the augmentation callbacks of
+ * the tree implementation.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "c-rbeevdf.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rbeevdf_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBEevdfEntry, rb)
+
+static _Bool c_rbeevdf_augment(CRBNode *n) {
+        CRBEevdfEntry *e = c_rbeevdf_entry_from_rb(n), *c;
+        uint64_t min_vstart = e->vstart;
+
+        if (n->left) {
+                c = c_rbeevdf_entry_from_rb(n->left);
+                if (c->min_vstart < min_vstart)
+                        min_vstart = c->min_vstart;
+        }
+        if (n->right) {
+                c = c_rbeevdf_entry_from_rb(n->right);
+                if (c->min_vstart < min_vstart)
+                        min_vstart = c->min_vstart;
+        }
+
+        if (e->min_vstart == min_vstart)
+                return 0;
+
+        e->min_vstart = min_vstart;
+        return 1;
+}
+
+/**
+ * c_rbeevdf_add() - add entry
+ * @q:                  queue to operate on
+ * @e:                  entry to link
+ * @vstart:             virtual start time of @e
+ * @vdeadline:          virtual deadline of @e
+ *
+ * This links @e into @q. It is queued after all entries with the same
+ * deadline. @e must not be linked.
+ *
+ * Worst case runtime (n: number of entries in queue): O(log(n))
+ */
+_public_ void c_rbeevdf_add(CRBEevdf *q, CRBEevdfEntry *e, uint64_t vstart, uint64_t vdeadline) {
+        CRBNode **slot = &q->tree.root, *p = NULL;
+
+        assert(q);
+        assert(e);
+        assert(!c_rbnode_is_linked(&e->rb));
+
+        e->vstart = vstart;
+        e->vdeadline = vdeadline;
+        e->min_vstart = vstart;
+
+        while (*slot) {
+                p = *slot;
+                if (vdeadline < c_rbeevdf_entry_from_rb(p)->vdeadline)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbtree_add_augmented(&q->tree, p, slot, &e->rb, c_rbeevdf_augment);
+}
+
+/**
+ * c_rbeevdf_remove() - remove entry
+ * @q:                  queue to operate on
+ * @e:                  entry to unlink
+ *
+ * This unlinks @e from @q. The entry must be linked into @q. Afterwards, it
+ * is marked as unlinked, and can be released or added again.
+ *
+ * Worst case runtime (n: number of entries in queue): O(log(n))
+ */
+_public_ void c_rbeevdf_remove(CRBEevdf *q, CRBEevdfEntry *e) {
+        assert(q);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        c_rbnode_unlink_augmented(&e->rb, c_rbeevdf_augment);
+}
+
+/**
+ * c_rbeevdf_update() - change virtual times of entry
+ * @q:                  queue to operate on
+ * @e:                  linked entry to update
+ * @vstart:             new virtual start time
+ * @vdeadline:          new virtual deadline
+ *
+ * This changes the virtual times of @e, which is the common operation after
+ * an entity ran for a while. If the deadline does not change, only the start
+ * time is propagated towards the root. Otherwise, @e is requeued after all
+ * entries with the same deadline.
+ *
+ * Worst case runtime (n: number of entries in queue): O(log(n))
+ */
+_public_ void c_rbeevdf_update(CRBEevdf *q, CRBEevdfEntry *e, uint64_t vstart, uint64_t vdeadline) {
+        assert(q);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        if (vdeadline == e->vdeadline) {
+                e->vstart = vstart;
+                c_rbnode_propagate(&e->rb, c_rbeevdf_augment);
+                return;
+        }
+
+        c_rbnode_unlink_augmented(&e->rb, c_rbeevdf_augment);
+        c_rbeevdf_add(q, e, vstart, vdeadline);
+}
+
+/**
+ * c_rbeevdf_pick() - pick next entry
+ * @q:                  queue to operate on
+ * @vtime:              current virtual time
+ *
+ * This returns the entry with the earliest deadline among all entries that
+ * are eligible at @vtime, that is, whose virtual start time is not later than
+ * @vtime. Among entries with equal deadlines, the one queued first is
+ * returned. The entry is not unlinked.
+ *
+ * Worst case runtime (n: number of entries in queue): O(log(n))
+ *
+ * Return: Pointer to the picked entry, or NULL if no entry is eligible.
+ */
+_public_ CRBEevdfEntry *c_rbeevdf_pick(CRBEevdf *q, uint64_t vtime) {
+        CRBEevdfEntry *e;
+        CRBNode *n;
+
+        assert(q);
+
+        n = q->tree.root;
+        if (!n || c_rbeevdf_entry_from_rb(n)->min_vstart > vtime)
+                return NULL;
+
+        /*
+         * The subtree of @n always holds an eligible entry. All entries of
+         * the left subtree precede @n, so if any of them is eligible, the
+         * pick is there. Otherwise, it is @n, or it is in the right subtree.
+         */
+        for (;;) {
+                if (n->left && c_rbeevdf_entry_from_rb(n->left)->min_vstart <= vtime) {
+                        n = n->left;
+                        continue;
+                }
+
+                e = c_rbeevdf_entry_from_rb(n);
+                if (e->vstart <= vtime)
+                        return e;
+
+                n = n->right;
+                assert(n && c_rbeevdf_entry_from_rb(n)->min_vstart <= vtime);
+        }
+}
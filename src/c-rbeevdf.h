@@ -0,0 +1,109 @@
+#pragma once
+
+/**
+ * EEVDF Queues
+ *
+ * An EEVDF queue holds schedulable entities for an Earliest Eligible Virtual
+ * Deadline First scheduler. Each entity has a virtual start time, from which
+ * on it is eligible to run, and a virtual deadline. The scheduler always picks
+ * the eligible entity with the earliest deadline.
+ *
+ * Entities are kept in an RB-Tree ordered by deadline, and each node is
+ * augmented with the lowest start time in its subtree. The augmentation is
+ * maintained through all rotations, so picking the next entity does not scan
+ * for the first eligible one in deadline order. It is a single descent: if
+ * anything in the left subtree is eligible, the pick is there, otherwise it
+ * is the node itself, or in the right subtree. This takes O(log(n)), no
+ * matter how many entities with early deadlines are not yet eligible.
+ *
+ * Virtual times are unsigned 64bit values, which must not wrap around.
+ * Entities with equal deadlines are picked first-in first-out.
+ *
+ * Entities are embedded in the objects of the API user, like CRBNode. The
+ * API performs no memory allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBEevdf CRBEevdf;
+typedef struct CRBEevdfEntry CRBEevdfEntry;
+
+/**
+ * struct CRBEevdfEntry - EEVDF queue entry
+ * @rb:                 node in the queue tree
+ * @vstart:             virtual start time, from which on the entry is eligible
+ * @vdeadline:          virtual deadline
+ * @min_vstart:         lowest virtual start time in this subtree
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBEevdfEntry {
+        CRBNode rb;
+        uint64_t vstart;
+        uint64_t vdeadline;
+        uint64_t min_vstart;
+};
+
+#define C_RBEEVDF_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb) }
+
+/**
+ * struct CRBEevdf - EEVDF queue
+ * @tree:               tree of all entries, ordered by deadline
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBEevdf {
+        CRBTree tree;
+};
+
+#define C_RBEEVDF_INIT {}
+
+void c_rbeevdf_add(CRBEevdf *q, CRBEevdfEntry *e, uint64_t vstart, uint64_t vdeadline);
+void c_rbeevdf_remove(CRBEevdf *q, CRBEevdfEntry *e);
+void c_rbeevdf_update(CRBEevdf *q, CRBEevdfEntry *e, uint64_t vstart, uint64_t vdeadline);
+CRBEevdfEntry *c_rbeevdf_pick(CRBEevdf *q, uint64_t vtime);
+
+/**
+ * c_rbeevdf_init() - initialize EEVDF queue
+ * @q:                  queue to initialize
+ *
+ * This initializes @q as an empty queue.
+ */
+static inline void c_rbeevdf_init(CRBEevdf *q) {
+        *q = (CRBEevdf)C_RBEEVDF_INIT;
+}
+
+/**
+ * c_rbeevdf_is_empty() - check whether an EEVDF queue is empty
+ * @q:                  queue to operate on
+ *
+ * Return: True if the queue is empty, false otherwise.
+ */
+static inline _Bool c_rbeevdf_is_empty(CRBEevdf *q) {
+        return c_rbtree_is_empty(&q->tree);
+}
+
+/**
+ * c_rbeevdf_min_vstart() - return lowest virtual start time
+ * @q:                  queue to query, which must not be empty
+ *
+ * A pick at any virtual time before this one yields nothing, so a scheduler
+ * can use it to advance its virtual clock when the queue is idle.
+ *
+ * Fixed runtime (n: number of entries in queue): O(1)
+ *
+ * Return: The lowest virtual start time of all entries in @q.
+ */
+static inline uint64_t c_rbeevdf_min_vstart(CRBEevdf *q) {
+        return c_rbnode_entry(q->tree.root, CRBEevdfEntry, rb)->min_vstart;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Extent Allocators
+ * This implements best-fit extent allocators on top of two RB-Trees, which
+ * link the same extents ordered by (size, address), and by address.
+ *
+ * Free extents are never adjacent or overlapping, hence shrinking an extent
+ * from its start, or growing it towards a neighbouring hole, never changes its
+ * position in the address tree. Only the size tree needs relinking, and only
+ * if the new size passes a neighbour in size order.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "c-rbextent.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rbextent_from_size(_rb) c_rbnode_entry((_rb), CRBExtent, by_size)
+#define c_rbextent_from_addr(_rb) c_rbnode_entry((_rb), CRBExtent, by_addr)
+
+static int c_rbextent_compare(CRBExtent *e, uint64_t size, uint64_t addr) {
+        if (e->size != size)
+                return (e->size < size) ? -1 : 1;
+        return (e->addr < addr) ? -1 : (e->addr > addr) ? 1 : 0;
+}
+
+static void c_rbextent_link_size(CRBExtentAllocator *a, CRBExtent *e) {
+        CRBNode **slot = &a->by_size.root, *p = NULL;
+
+        while (*slot) {
+                p = *slot;
+                if (c_rbextent_compare(c_rbextent_from_size(p), e->size, e->addr) > 0)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbtree_add(&a->by_size, p, slot, &e->by_size);
+}
+
+/*
+ * Relink @e in the size tree after its size changed, unless it still sorts
+ * between its neighbours. Most size changes are small compared to the spread
+ * of extent sizes, so this check usually saves the unlink and relink.
+ */
+static void c_rbextent_resize(CRBExtentAllocator *a, CRBExtent *e) {
+        CRBExtent *prev, *next;
+
+        prev = c_rbextent_from_size(c_rbnode_prev(&e->by_size));
+        next = c_rbextent_from_size(c_rbnode_next(&e->by_size));
+        if ((!prev || c_rbextent_compare(prev, e->size, e->addr) < 0) &&
+            (!next || c_rbextent_compare(next, e->size, e->addr) > 0))
+                return;
+
+        c_rbnode_unlink(&e->by_size);
+        c_rbextent_link_size(a, e);
+}
+
+static void c_rbextent_release(CRBExtentAllocator *a, CRBExtent *e) {
+        c_rbnode_unlink(&e->by_size);
+        c_rbnode_unlink(&e->by_addr);
+        --a->n_extents;
+        free(e);
+}
+
+/**
+ * c_rbextent_init() - initialize extent allocator
+ * @a:                  allocator to initialize
+ *
+ * This initializes @a as an allocator without any free space. Space is made
+ * available via c_rbextent_free().
+ */
+_public_ void c_rbextent_init(CRBExtentAllocator *a) {
+        assert(a);
+
+        *a = (CRBExtentAllocator)C_RBEXTENT_ALLOCATOR_INIT;
+}
+
+/**
+ * c_rbextent_deinit() - deinitialize extent allocator
+ * @a:                  allocator to deinitialize
+ *
+ * This releases all free extents of @a. Afterwards, @a has no free space and
+ * can be reused.
+ *
+ * Worst case runtime (n: number of free extents): O(n)
+ */
+_public_ void c_rbextent_deinit(CRBExtentAllocator *a) {
+        CRBExtent *e, *safe;
+
+        assert(a);
+
+        c_rbtree_init(&a->by_size);
+        c_rbtree_for_each_entry_safe_postorder_unlink(e, safe, &a->by_addr, by_addr)
+                free(e);
+
+        a->n_extents = 0;
+        a->n_free = 0;
+}
+
+/**
+ * c_rbextent_alloc() - allocate extent
+ * @a:                  allocator to allocate from
+ * @size:               size to allocate
+ * @addrp:              output argument for the address of the allocation
+ *
+ * This searches @a for the smallest free extent that provides at least @size,
+ * the lowest one among equally sized extents, and allocates the first @size
+ * of it. The address of the allocation is returned in @addrp. The remainder
+ * stays free, and keeps its position in the address tree. @size must not be
+ * 0.
+ *
+ * Worst case runtime (n: number of free extents): O(log(n))
+ *
+ * Return: 0 on success, -ENOSPC if no free extent is large enough.
+ */
+_public_ int c_rbextent_alloc(CRBExtentAllocator *a, uint64_t size, uint64_t *addrp) {
+        CRBNode *n, *fit = NULL;
+        CRBExtent *e;
+
+        assert(a);
+        assert(size > 0);
+        assert(addrp);
+
+        n = a->by_size.root;
+        while (n) {
+                if (c_rbextent_from_size(n)->size >= size) {
+                        fit = n;
+                        n = n->left;
+                } else {
+                        n = n->right;
+                }
+        }
+
+        if (!fit)
+                return -ENOSPC;
+
+        e = c_rbextent_from_size(fit);
+        *addrp = e->addr;
+        a->n_free -= size;
+
+        if (e->size == size) {
+                c_rbextent_release(a, e);
+        } else {
+                e->addr += size;
+                e->size -= size;
+                c_rbextent_resize(a, e);
+        }
+
+        return 0;
+}
+
+/**
+ * c_rbextent_free() - free extent
+ * @a:                  allocator to operate on
+ * @addr:               first address to free
+ * @size:               size to free
+ *
+ * This makes [@addr, @addr + @size) available for allocation. The extent is
+ * coalesced with the free extents directly before and after it, so a new
+ * extent is only allocated if it is adjacent to neither. The extent must not
+ * overlap any free space. @size must not be 0, and the extent must not wrap
+ * around the address space.
+ *
+ * Worst case runtime (n: number of free extents): O(log(n))
+ *
+ * Return: 0 on success, -EEXIST if the extent overlaps free space, -ENOMEM if
+ *         allocation failed. In both error cases, @a is unchanged.
+ */
+_public_ int c_rbextent_free(CRBExtentAllocator *a, uint64_t addr, uint64_t size) {
+        CRBNode **slot = &a->by_addr.root, *p = NULL;
+        CRBExtent *prev = NULL, *next = NULL, *e;
+
+        assert(a);
+        assert(size > 0);
+        assert(size <= UINT64_MAX - addr);
+
+        while (*slot) {
+                p = *slot;
+                e = c_rbextent_from_addr(p);
+                if (addr < e->addr) {
+                        next = e;
+                        slot = &p->left;
+                } else {
+                        prev = e;
+                        slot = &p->right;
+                }
+        }
+
+        if ((prev && prev->addr + prev->size > addr) || (next && addr + size > next->addr))
+                return -EEXIST;
+
+        if (prev && prev->addr + prev->size == addr) {
+                prev->size += size;
+                if (next && addr + size == next->addr) {
+                        prev->size += next->size;
+                        c_rbextent_release(a, next);
+                }
+                c_rbextent_resize(a, prev);
+        } else if (next && addr + size == next->addr) {
+                next->addr = addr;
+                next->size += size;
+                c_rbextent_resize(a, next);
+        } else {
+                e = malloc(sizeof(*e));
+                if (!e)
+                        return -ENOMEM;
+
+                e->addr = addr;
+                e->size = size;
+                c_rbnode_init(&e->by_size);
+                c_rbnode_init(&e->by_addr);
+                c_rbtree_add(&a->by_addr, p, slot, &e->by_addr);
+                c_rbextent_link_size(a, e);
+                ++a->n_extents;
+        }
+
+        a->n_free += size;
+        return 0;
+}
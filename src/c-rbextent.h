@@ -0,0 +1,113 @@
+#pragma once
+
+/**
+ * Extent Allocators
+ *
+ * An extent allocator manages free space of an address space, or a buffer
+ * pool, as disjoint, half-open extents [addr, addr + size). Freed extents are
+ * coalesced with adjacent free extents, so free space is always stored as the
+ * minimal number of extents.
+ *
+ * Allocation is best-fit: it picks the smallest free extent that is large
+ * enough, and the lowest one among equally sized extents. Unlike the
+ * first-fit allocation of range sets, this keeps large extents intact for as
+ * long as possible, at the cost of a second index.
+ *
+ * Each extent is therefore linked into two trees at once: one ordered by
+ * (size, address) for best-fit searches, and one ordered by address, to find
+ * the neighbours of a freed extent for coalescing. Both nodes are embedded in
+ * the same extent, so each operation takes O(log(n)).
+ *
+ * Like range sets, extent allocators allocate their extents themselves.
+ * Functions that might need a new extent report -ENOMEM if allocation fails,
+ * in which case the allocator is left unchanged.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBExtent CRBExtent;
+typedef struct CRBExtentAllocator CRBExtentAllocator;
+
+/**
+ * struct CRBExtent - free extent
+ * @by_size:            node in the tree ordered by size and address
+ * @by_addr:            node in the tree ordered by address
+ * @addr:               first address of the extent
+ * @size:               size of the extent
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBExtent {
+        CRBNode by_size;
+        CRBNode by_addr;
+        uint64_t addr;
+        uint64_t size;
+};
+
+/**
+ * struct CRBExtentAllocator - extent allocator
+ * @by_size:            tree of all free extents, ordered by size and address
+ * @by_addr:            tree of all free extents, ordered by address
+ * @n_extents:          number of free extents
+ * @n_free:             total size of all free extents
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBExtentAllocator {
+        CRBTree by_size;
+        CRBTree by_addr;
+        size_t n_extents;
+        uint64_t n_free;
+};
+
+#define C_RBEXTENT_ALLOCATOR_INIT {}
+
+void c_rbextent_init(CRBExtentAllocator *a);
+void c_rbextent_deinit(CRBExtentAllocator *a);
+
+int c_rbextent_alloc(CRBExtentAllocator *a, uint64_t size, uint64_t *addrp);
+int c_rbextent_free(CRBExtentAllocator *a, uint64_t addr, uint64_t size);
+
+/**
+ * c_rbextent_is_empty() - check whether an extent allocator has free space
+ * @a:                  allocator to operate on
+ *
+ * Return: True if there is no free extent, false otherwise.
+ */
+static inline _Bool c_rbextent_is_empty(CRBExtentAllocator *a) {
+        return c_rbtree_is_empty(&a->by_addr);
+}
+
+/**
+ * c_rbextent_largest() - return largest free extent
+ * @a:                  allocator to query
+ *
+ * Worst case runtime (n: number of free extents): O(log(n))
+ *
+ * Return: Pointer to the largest free extent, the highest one among equally
+ *         sized extents, or NULL if there is none.
+ */
+static inline CRBExtent *c_rbextent_largest(CRBExtentAllocator *a) {
+        return c_rbnode_entry(c_rbtree_last(&a->by_size), CRBExtent, by_size);
+}
+
+/**
+ * c_rbextent_for_each() - iterate all free extents
+ * @_iter:      loop iterator, of type CRBExtent
+ * @_a:         allocator to iterate
+ *
+ * This iterates all free extents of @_a in ascending address order. The
+ * allocator must not be modified during iteration.
+ */
+#define c_rbextent_for_each(_iter, _a) \
+        c_rbtree_for_each_entry(_iter, &(_a)->by_addr, by_addr)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,175 @@
+#pragma once
+
+/**
+ * Multi-Index Containers
+ *
+ * Objects are often linked into several trees at once, each ordered by a
+ * different key (e.g., by id, by name, and by expiry). This generates a
+ * container type for such objects, plus functions to add, remove, and rekey
+ * an object across all of its indices at once:
+ *
+ *   o Adding an object looks up its slot in all indices before linking it
+ *     into any of them. If any key conflicts, nothing is linked.
+ *
+ *   o Rekeying an object only touches the indices the caller marks as
+ *     changed. For each of them, the object stays where it is if it is still
+ *     in order relative to its neighbours, which takes two comparisons.
+ *     Only otherwise is it unlinked and linked anew.
+ *
+ * The indices are declared once, as an X-macro. Each entry names the tree,
+ * the CRBNode member of the object type, and the comparison function. The
+ * comparison function is a CRBCompareFunc, which is passed the object itself
+ * as key. For instance:
+ *
+ *     #define OBJECT_INDICES(X, _ctx)                                          \
+ *             X(_ctx, by_id, rb_id, object_compare_id)                         \
+ *             X(_ctx, by_name, rb_name, object_compare_name)
+ *
+ *     C_RBINDEX_DEFINE(object_index, Object, OBJECT_INDICES)
+ *
+ * This defines `struct object_index`, with one CRBTree member per index, and
+ * the functions object_index_init(), object_index_add(),
+ * object_index_remove(), and object_index_rekey(). Indices are identified by
+ * C_RBINDEX_MASK(object_index, by_id), and so on. All functions are
+ * generated as static inline functions, which call the comparison functions
+ * directly, so there is neither dispatch overhead, nor any loop over indices
+ * at runtime.
+ *
+ * Objects are embedded in the trees like with plain CRBNodes, and lookups
+ * use the trees directly, for instance via c_rbtree_find_entry(). The API
+ * performs no memory allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <stddef.h>
+#include "c-rbtree.h"
+
+/**
+ * c_rbindex_in_order() - check whether a node is in order with a key
+ * @t:                  tree the node is linked into
+ * @f:                  comparison function
+ * @k:                  key to check
+ * @n:                  node to check
+ *
+ * Return: True if @k orders strictly between the neighbours of @n, false
+ *         otherwise.
+ */
+static inline _Bool c_rbindex_in_order(CRBTree *t, CRBCompareFunc f, const void *k, CRBNode *n) {
+        CRBNode *prev = c_rbnode_prev(n), *next = c_rbnode_next(n);
+
+        return (!prev || f(t, (void *)k, prev) > 0) && (!next || f(t, (void *)k, next) < 0);
+}
+
+/**
+ * C_RBINDEX_MASK() - return mask of an index
+ * @_name:              name of the container
+ * @_index:             name of the index
+ *
+ * Return: The bit of @_index, to be passed to the rekey function.
+ */
+#define C_RBINDEX_MASK(_name, _index) (1U << _name##_INDEX_##_index)
+
+#define C_RBINDEX_X_TREE(_name, _index, _member, _compare) CRBTree _index;
+#define C_RBINDEX_X_ENUM(_name, _index, _member, _compare) _name##_INDEX_##_index,
+#define C_RBINDEX_X_INIT(_name, _index, _member, _compare) c_rbtree_init(&m->_index);
+#define C_RBINDEX_X_DECLARE(_name, _index, _member, _compare) CRBNode **slot_##_index, *p_##_index;
+
+#define C_RBINDEX_X_FIND(_name, _index, _member, _compare)                                              \
+        slot_##_index = c_rbtree_find_slot(&m->_index, _compare, o, &p_##_index);                       \
+        if (!slot_##_index)                                                                             \
+                return -EEXIST;
+
+#define C_RBINDEX_X_LINK(_name, _index, _member, _compare)                                              \
+        c_rbtree_add(&m->_index, p_##_index, slot_##_index, &o->_member);
+
+#define C_RBINDEX_X_UNLINK(_name, _index, _member, _compare)                                            \
+        c_rbnode_unlink(&o->_member);
+
+#define C_RBINDEX_X_REKEY_UNLINK(_name, _index, _member, _compare)                                      \
+        if ((mask & C_RBINDEX_MASK(_name, _index)) &&                                                   \
+            !c_rbindex_in_order(&m->_index, _compare, o, &o->_member))                                  \
+                c_rbnode_unlink(&o->_member);
+
+#define C_RBINDEX_X_REKEY_LINK(_name, _index, _member, _compare)                                        \
+        if ((mask & C_RBINDEX_MASK(_name, _index)) && !c_rbnode_is_linked(&o->_member)) {               \
+                slot_##_index = c_rbtree_find_slot(&m->_index, _compare, o, &p_##_index);               \
+                if (slot_##_index)                                                                      \
+                        c_rbtree_add(&m->_index, p_##_index, slot_##_index, &o->_member);               \
+                else                                                                                    \
+                        r = -EEXIST;                                                                    \
+        }
+
+/**
+ * C_RBINDEX_DEFINE() - define multi-index container
+ * @_name:              name of the container
+ * @_type:              type of the indexed objects
+ * @_indices:           X-macro listing the indices
+ *
+ * This defines `struct @_name` and its functions, as described in the
+ * header documentation. @_indices is invoked as `@_indices(X, @_name)`, and
+ * must expand to `X(@_name, index, member, compare)` for each index, where
+ * `index` is the name of the tree, `member` the name of the CRBNode in
+ * @_type, and `compare` the comparison function. At most 32 indices are
+ * supported.
+ *
+ * @_name##_init(m) initializes an empty container.
+ *
+ * @_name##_add(m, o) links @o into all indices. It returns 0 on success, or
+ * -EEXIST if any index already holds an object with the same key, in which
+ * case @o is linked into no index.
+ *
+ * @_name##_remove(m, o) unlinks @o from all indices.
+ *
+ * @_name##_rekey(m, o, mask) must be called after the keys of the indices in
+ * @mask changed. It relinks @o where needed. It returns 0 on success, or
+ * -EEXIST if any of the new keys conflicts with another object, in which case
+ * @o is unlinked from all indices.
+ */
+#define C_RBINDEX_DEFINE(_name, _type, _indices)                                                        \
+        struct _name {                                                                                  \
+                _indices(C_RBINDEX_X_TREE, _name)                                                       \
+        };                                                                                              \
+                                                                                                        \
+        enum {                                                                                          \
+                _indices(C_RBINDEX_X_ENUM, _name)                                                       \
+                _name##_N_INDICES,                                                                      \
+        };                                                                                              \
+                                                                                                        \
+        _Static_assert(_name##_N_INDICES <= 32, "Too many indices");                                    \
+                                                                                                        \
+        static inline void _name##_init(struct _name *m) {                                              \
+                _indices(C_RBINDEX_X_INIT, _name)                                                       \
+        }                                                                                               \
+                                                                                                        \
+        static inline int _name##_add(struct _name *m, _type *o) {                                      \
+                _indices(C_RBINDEX_X_DECLARE, _name)                                                    \
+                _indices(C_RBINDEX_X_FIND, _name)                                                       \
+                _indices(C_RBINDEX_X_LINK, _name)                                                       \
+                return 0;                                                                               \
+        }                                                                                               \
+                                                                                                        \
+        static inline void _name##_remove(struct _name *m, _type *o) {                                  \
+                (void)m;                                                                                \
+                _indices(C_RBINDEX_X_UNLINK, _name)                                                     \
+        }                                                                                               \
+                                                                                                        \
+        static inline int _name##_rekey(struct _name *m, _type *o, unsigned int mask) {                 \
+                _indices(C_RBINDEX_X_DECLARE, _name)                                                    \
+                int r = 0;                                                                              \
+                                                                                                        \
+                _indices(C_RBINDEX_X_REKEY_UNLINK, _name)                                               \
+                _indices(C_RBINDEX_X_REKEY_LINK, _name)                                                 \
+                                                                                                        \
+                if (r)                                                                                  \
+                        _name##_remove(m, o);                                                           \
+                                                                                                        \
+                return r;                                                                               \
+        }
+
+#ifdef __cplusplus
+}
+#endif
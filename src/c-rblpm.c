@@ -0,0 +1,195 @@
+/*
+ * Longest-Prefix-Match Tables
+ * This implements prefix tables on top of one RB-Tree per prefix length, plus
+ * a bitmap of the populated lengths.
+ *
+ * Addresses are given in network byte order and converted into a pair of
+ * 64bit integers in host order, so prefixes can be masked and compared with a
+ * few integer operations, rather than byte-wise.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "c-rblpm.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rblpm_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBLpmEntry, rb)
+
+static void c_rblpm_mask(uint64_t key[2], unsigned int length) {
+        if (length < 64) {
+                key[0] &= length ? ~UINT64_C(0) << (64 - length) : 0;
+                key[1] = 0;
+        } else if (length < 128) {
+                key[1] &= (length > 64) ? ~UINT64_C(0) << (128 - length) : 0;
+        }
+}
+
+static void c_rblpm_key(CRBLpm *lpm, uint64_t key[2], const void *address) {
+        const uint8_t *a = address;
+        unsigned int i;
+
+        key[0] = 0;
+        key[1] = 0;
+        for (i = 0; i < (lpm->n_bits + 7) / 8; ++i)
+                key[i / 8] |= (uint64_t)a[i] << (56 - 8 * (i % 8));
+
+        c_rblpm_mask(key, lpm->n_bits);
+}
+
+static int c_rblpm_compare(CRBTree *t, void *k, CRBNode *n) {
+        CRBLpmEntry *e = c_rblpm_entry_from_rb(n);
+        uint64_t *key = k;
+
+        if (key[0] != e->key[0])
+                return (key[0] < e->key[0]) ? -1 : 1;
+        if (key[1] != e->key[1])
+                return (key[1] < e->key[1]) ? -1 : 1;
+        return 0;
+}
+
+/**
+ * c_rblpm_init() - initialize LPM table
+ * @lpm:                table to initialize
+ * @n_bits:             width of addresses in bits
+ *
+ * This initializes @lpm as an empty table for addresses of @n_bits bits. Use
+ * 32 for IPv4 and 128 for IPv6. Addresses of all further calls on @lpm must
+ * provide at least (@n_bits + 7) / 8 bytes.
+ */
+_public_ void c_rblpm_init(CRBLpm *lpm, unsigned int n_bits) {
+        assert(lpm);
+        assert(n_bits <= C_RBLPM_MAX_BITS);
+
+        *lpm = (CRBLpm){ .n_bits = n_bits };
+}
+
+/**
+ * c_rblpm_add() - add prefix
+ * @lpm:                table to operate on
+ * @e:                  entry to link
+ * @prefix:             prefix in network byte order
+ * @length:             prefix length in bits
+ *
+ * This links @e into @lpm as entry for the prefix @prefix of length @length.
+ * All bits of @prefix beyond @length are ignored.
+ *
+ * Worst case runtime (n: number of entries with the same length): O(log(n))
+ *
+ * Return: 0 on success, -EEXIST if the prefix is already present.
+ */
+_public_ int c_rblpm_add(CRBLpm *lpm, CRBLpmEntry *e, const void *prefix, unsigned int length) {
+        CRBNode **slot, *p;
+        CRBTree *t;
+
+        assert(lpm);
+        assert(e);
+        assert(prefix);
+        assert(length <= lpm->n_bits);
+
+        c_rblpm_key(lpm, e->key, prefix);
+        c_rblpm_mask(e->key, length);
+        e->length = length;
+
+        t = &lpm->trees[length];
+        slot = c_rbtree_find_slot(t, c_rblpm_compare, e->key, &p);
+        if (!slot)
+                return -EEXIST;
+
+        c_rbtree_add(t, p, slot, &e->rb);
+        lpm->lengths[length / 64] |= UINT64_C(1) << (length % 64);
+        return 0;
+}
+
+/**
+ * c_rblpm_remove() - remove prefix
+ * @lpm:                table to operate on
+ * @e:                  entry to unlink
+ *
+ * This unlinks @e from @lpm. The entry must be linked into @lpm. Afterwards,
+ * it is marked as unlinked, and can be linked again.
+ *
+ * Worst case runtime (n: number of entries with the same length): O(log(n))
+ */
+_public_ void c_rblpm_remove(CRBLpm *lpm, CRBLpmEntry *e) {
+        assert(lpm);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        c_rbnode_unlink(&e->rb);
+        if (c_rbtree_is_empty(&lpm->trees[e->length]))
+                lpm->lengths[e->length / 64] &= ~(UINT64_C(1) << (e->length % 64));
+}
+
+/**
+ * c_rblpm_find() - find prefix
+ * @lpm:                table to search through
+ * @prefix:             prefix in network byte order
+ * @length:             prefix length in bits
+ *
+ * This searches @lpm for an entry of exactly the prefix @prefix of length
+ * @length. All bits of @prefix beyond @length are ignored.
+ *
+ * Worst case runtime (n: number of entries with the same length): O(log(n))
+ *
+ * Return: Pointer to matching entry, or NULL.
+ */
+_public_ CRBLpmEntry *c_rblpm_find(CRBLpm *lpm, const void *prefix, unsigned int length) {
+        uint64_t key[2];
+
+        assert(lpm);
+        assert(prefix);
+        assert(length <= lpm->n_bits);
+
+        c_rblpm_key(lpm, key, prefix);
+        c_rblpm_mask(key, length);
+
+        return c_rblpm_entry_from_rb(c_rbtree_find_node(&lpm->trees[length], c_rblpm_compare, key));
+}
+
+/**
+ * c_rblpm_lookup() - find longest matching prefix
+ * @lpm:                table to search through
+ * @address:            address in network byte order
+ *
+ * This searches @lpm for the entry with the longest prefix that covers
+ * @address. Only lengths that have at least one entry are probed.
+ *
+ * Worst case runtime (n: number of entries, l: number of populated lengths):
+ *     O(l * log(n))
+ *
+ * Return: Pointer to matching entry, or NULL.
+ */
+_public_ CRBLpmEntry *c_rblpm_lookup(CRBLpm *lpm, const void *address) {
+        uint64_t addr[2], key[2], lengths;
+        unsigned int length;
+        CRBNode *n;
+        size_t i;
+
+        assert(lpm);
+        assert(address);
+
+        c_rblpm_key(lpm, addr, address);
+
+        for (i = sizeof(lpm->lengths) / sizeof(*lpm->lengths); i-- > 0; ) {
+                for (lengths = lpm->lengths[i]; lengths; lengths &= ~(UINT64_C(1) << (length % 64))) {
+                        length = i * 64 + 63 - __builtin_clzll(lengths);
+
+                        key[0] = addr[0];
+                        key[1] = addr[1];
+                        c_rblpm_mask(key, length);
+
+                        n = c_rbtree_find_node(&lpm->trees[length], c_rblpm_compare, key);
+                        if (n)
+                                return c_rblpm_entry_from_rb(n);
+                }
+        }
+
+        return NULL;
+}
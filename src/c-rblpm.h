@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+ * Longest-Prefix-Match Tables
+ *
+ * An LPM table stores prefixes of fixed-width addresses (e.g., IPv4 or IPv6
+ * routes), and finds the longest stored prefix that covers a given address.
+ *
+ * The table keeps one RB-Tree per prefix length, each ordered by prefix.
+ * Furthermore, it keeps a bitmap of all lengths that have at least one prefix
+ * stored. A lookup walks this bitmap from the longest to the shortest length,
+ * and probes only the trees of populated lengths. Routing tables usually use
+ * only a small subset of all possible lengths, so most lookups probe a handful
+ * of trees, rather than all 33 (IPv4) or 129 (IPv6) of them.
+ *
+ * Entries are embedded in the objects of the API user, like CRBNode. The API
+ * performs no memory allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBLpm CRBLpm;
+typedef struct CRBLpmEntry CRBLpmEntry;
+
+#define C_RBLPM_MAX_BITS 128
+
+/**
+ * struct CRBLpmEntry - prefix entry
+ * @rb:                 node in the tree of its prefix length
+ * @key:                prefix, masked and converted to host order
+ * @length:             prefix length in bits
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBLpmEntry {
+        CRBNode rb;
+        uint64_t key[2];
+        unsigned int length;
+};
+
+#define C_RBLPM_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb) }
+
+/**
+ * struct CRBLpm - LPM table
+ * @n_bits:             width of addresses in bits
+ * @lengths:            bitmap of populated prefix lengths
+ * @trees:              one tree per prefix length
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBLpm {
+        unsigned int n_bits;
+        uint64_t lengths[(C_RBLPM_MAX_BITS + 64) / 64];
+        CRBTree trees[C_RBLPM_MAX_BITS + 1];
+};
+
+void c_rblpm_init(CRBLpm *lpm, unsigned int n_bits);
+
+int c_rblpm_add(CRBLpm *lpm, CRBLpmEntry *e, const void *prefix, unsigned int length);
+void c_rblpm_remove(CRBLpm *lpm, CRBLpmEntry *e);
+
+CRBLpmEntry *c_rblpm_find(CRBLpm *lpm, const void *prefix, unsigned int length);
+CRBLpmEntry *c_rblpm_lookup(CRBLpm *lpm, const void *address);
+
+/**
+ * c_rblpm_is_empty() - check whether an LPM table is empty
+ * @lpm:                table to operate on
+ *
+ * Return: True if the table is empty, false otherwise.
+ */
+static inline _Bool c_rblpm_is_empty(CRBLpm *lpm) {
+        size_t i;
+
+        for (i = 0; i < sizeof(lpm->lengths) / sizeof(*lpm->lengths); ++i)
+                if (lpm->lengths[i])
+                        return 0;
+
+        return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Counted Multisets
+ * This implements counted multisets on top of an augmented RB-Tree. Each
+ * entry caches the total multiplicity of its subtree, which is maintained via
+ * the augmentation callbacks of the tree implementation, and propagated
+ * towards the root whenever a count changes.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "c-rbmultiset.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rbmultiset_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBMultisetEntry, rb)
+
+static size_t c_rbmultiset_n_subtree(CRBNode *n) {
+        return n ? c_rbmultiset_entry_from_rb(n)->n_subtree : 0;
+}
+
+static _Bool c_rbmultiset_augment(CRBNode *n) {
+        CRBMultisetEntry *e = c_rbmultiset_entry_from_rb(n);
+        size_t n_subtree;
+
+        n_subtree = c_rbmultiset_n_subtree(n->left) + e->count + c_rbmultiset_n_subtree(n->right);
+        if (e->n_subtree == n_subtree)
+                return 0;
+
+        e->n_subtree = n_subtree;
+        return 1;
+}
+
+/**
+ * c_rbmultiset_find() - find entry of key
+ * @s:                  multiset to search through
+ * @f:                  comparison function
+ * @k:                  key to search for
+ *
+ * This searches @s for the entry of key @k.
+ *
+ * Worst case runtime (d: number of distinct keys): O(log(d))
+ *
+ * Return: Pointer to the entry of @k, or NULL if @k is not in @s.
+ */
+_public_ CRBMultisetEntry *c_rbmultiset_find(CRBMultiset *s, CRBCompareFunc f, const void *k) {
+        assert(s);
+        assert(f);
+
+        return c_rbmultiset_entry_from_rb(c_rbtree_find_node(&s->tree, f, k));
+}
+
+/**
+ * c_rbmultiset_add() - add key
+ * @s:                  multiset to operate on
+ * @f:                  comparison function
+ * @k:                  key to add
+ * @e:                  entry to link, if @k is new
+ * @n:                  multiplicity to add
+ *
+ * This adds @n copies of @k to @s. If @s already holds an entry of @k, its
+ * count is raised, and @e is left untouched. Otherwise, @e is linked as
+ * entry of @k, with a count of @n. The caller must make sure @e represents
+ * @k in the latter case, and can tell both cases apart by the return value.
+ * @n must not be 0.
+ *
+ * Worst case runtime (d: number of distinct keys): O(log(d))
+ *
+ * Return: Pointer to the entry of @k, which is @e if @k was not in @s before.
+ */
+_public_ CRBMultisetEntry *c_rbmultiset_add(CRBMultiset *s, CRBCompareFunc f, const void *k, CRBMultisetEntry *e, size_t n) {
+        CRBNode **slot, *p;
+        CRBMultisetEntry *old;
+
+        assert(s);
+        assert(f);
+        assert(e);
+        assert(n > 0);
+
+        slot = c_rbtree_find_slot(&s->tree, f, k, &p);
+        if (!slot) {
+                old = c_rbmultiset_entry_from_rb(p);
+                old->count += n;
+                c_rbnode_propagate(&old->rb, c_rbmultiset_augment);
+                return old;
+        }
+
+        assert(!c_rbnode_is_linked(&e->rb));
+
+        e->count = n;
+        e->n_subtree = 0;
+        c_rbtree_add_augmented(&s->tree, p, slot, &e->rb, c_rbmultiset_augment);
+        return e;
+}
+
+/**
+ * c_rbmultiset_remove() - remove key
+ * @s:                  multiset to operate on
+ * @e:                  entry of the key to remove
+ * @n:                  multiplicity to remove
+ *
+ * This removes @n copies of the key of @e from @s. @e must be linked into
+ * @s, and @n must not exceed its count. Once the count drops to 0, @e is
+ * unlinked, and can be released or linked again.
+ *
+ * Worst case runtime (d: number of distinct keys): O(log(d))
+ *
+ * Return: True if @e was unlinked, false if copies of its key remain.
+ */
+_public_ _Bool c_rbmultiset_remove(CRBMultiset *s, CRBMultisetEntry *e, size_t n) {
+        assert(s);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+        assert(n <= e->count);
+
+        e->count -= n;
+        if (e->count) {
+                c_rbnode_propagate(&e->rb, c_rbmultiset_augment);
+                return 0;
+        }
+
+        c_rbnode_unlink_augmented(&e->rb, c_rbmultiset_augment);
+        return 1;
+}
+
+/**
+ * c_rbmultiset_rank() - return rank of entry
+ * @s:                  multiset to query
+ * @e:                  entry to rank
+ *
+ * This counts the keys of @s lower than the key of @e, including duplicates.
+ * Hence, the copies of the key of @e occupy the positions [rank, rank +
+ * @e->count) in the sorted multiset. @e must be linked into @s.
+ *
+ * Worst case runtime (d: number of distinct keys): O(log(d))
+ *
+ * Return: Number of keys in @s lower than the key of @e.
+ */
+_public_ size_t c_rbmultiset_rank(CRBMultiset *s, CRBMultisetEntry *e) {
+        CRBNode *n, *p;
+        size_t rank;
+
+        assert(s);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        n = &e->rb;
+        rank = c_rbmultiset_n_subtree(n->left);
+
+        /* every time we climb up from a right child, the parent precedes us */
+        for (p = c_rbnode_parent(n); p; n = p, p = c_rbnode_parent(p))
+                if (n == p->right)
+                        rank += c_rbmultiset_n_subtree(p->left) + c_rbmultiset_entry_from_rb(p)->count;
+
+        return rank;
+}
+
+/**
+ * c_rbmultiset_select() - find entry at position
+ * @s:                  multiset to search through
+ * @i:                  position to look up
+ *
+ * This returns the entry of the key at position @i of the sorted multiset,
+ * counting duplicates, starting at 0. This is the inverse of
+ * c_rbmultiset_rank().
+ *
+ * Worst case runtime (d: number of distinct keys): O(log(d))
+ *
+ * Return: Pointer to the entry at position @i, or NULL if @i is out of range.
+ */
+_public_ CRBMultisetEntry *c_rbmultiset_select(CRBMultiset *s, size_t i) {
+        CRBMultisetEntry *e;
+        CRBNode *n;
+        size_t l;
+
+        assert(s);
+
+        n = s->tree.root;
+        while (n) {
+                e = c_rbmultiset_entry_from_rb(n);
+                l = c_rbmultiset_n_subtree(n->left);
+
+                if (i < l) {
+                        n = n->left;
+                } else if (i - l < e->count) {
+                        return e;
+                } else {
+                        i -= l + e->count;
+                        n = n->right;
+                }
+        }
+
+        return NULL;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * Counted Multisets
+ *
+ * A counted multiset stores a multiset of keys, with a single tree node per
+ * distinct key, plus its multiplicity. Workloads with many duplicates thus
+ * pay neither memory, nor tree depth for them: all operations run in
+ * O(log(d)), where d is the number of distinct keys, no matter how many
+ * duplicates are stored.
+ *
+ * Each entry is augmented with the total multiplicity of its subtree. This
+ * allows ranking an entry among all stored keys, and selecting the key at a
+ * given position, both counting duplicates.
+ *
+ * Entries are embedded in the objects of the API user, like CRBNode. Keys are
+ * compared via CRBCompareFunc, like with c_rbtree_find_slot(). An object that
+ * needs to track its duplicates individually can link them into a list of its
+ * own. The API performs no memory allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "c-rbtree.h"
+
+typedef struct CRBMultiset CRBMultiset;
+typedef struct CRBMultisetEntry CRBMultisetEntry;
+
+/**
+ * struct CRBMultisetEntry - multiset entry of a distinct key
+ * @rb:                 node in the multiset tree
+ * @count:              multiplicity of the key
+ * @n_subtree:          total multiplicity of all keys in this subtree
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBMultisetEntry {
+        CRBNode rb;
+        size_t count;
+        size_t n_subtree;
+};
+
+#define C_RBMULTISET_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb) }
+
+/**
+ * struct CRBMultiset - counted multiset
+ * @tree:               tree of all distinct keys
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBMultiset {
+        CRBTree tree;
+};
+
+#define C_RBMULTISET_INIT {}
+
+CRBMultisetEntry *c_rbmultiset_find(CRBMultiset *s, CRBCompareFunc f, const void *k);
+CRBMultisetEntry *c_rbmultiset_add(CRBMultiset *s, CRBCompareFunc f, const void *k, CRBMultisetEntry *e, size_t n);
+_Bool c_rbmultiset_remove(CRBMultiset *s, CRBMultisetEntry *e, size_t n);
+
+size_t c_rbmultiset_rank(CRBMultiset *s, CRBMultisetEntry *e);
+CRBMultisetEntry *c_rbmultiset_select(CRBMultiset *s, size_t i);
+
+/**
+ * c_rbmultiset_init() - initialize multiset
+ * @s:                  multiset to initialize
+ *
+ * This initializes @s as an empty multiset.
+ */
+static inline void c_rbmultiset_init(CRBMultiset *s) {
+        *s = (CRBMultiset)C_RBMULTISET_INIT;
+}
+
+/**
+ * c_rbmultiset_size() - return total multiplicity
+ * @s:                  multiset to query
+ *
+ * Return: Number of keys in @s, counting duplicates.
+ */
+static inline size_t c_rbmultiset_size(CRBMultiset *s) {
+        return s->tree.root ? c_rbnode_entry(s->tree.root, CRBMultisetEntry, rb)->n_subtree : 0;
+}
+
+/**
+ * c_rbmultiset_is_empty() - check whether a multiset is empty
+ * @s:                  multiset to operate on
+ *
+ * Return: True if the multiset is empty, false otherwise.
+ */
+static inline _Bool c_rbmultiset_is_empty(CRBMultiset *s) {
+        return c_rbtree_is_empty(&s->tree);
+}
+
+#ifdef __cplusplus
+}
+#endif
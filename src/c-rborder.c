@@ -0,0 +1,157 @@
+/*
+ * Order-Maintenance Labels
+ * This implements ordered trees on top of an RB-Tree, with each entry
+ * carrying a label that increases strictly in tree order. Rebalancing never
+ * changes the in-order sequence, hence labels need no fixups on rotations,
+ * only on insertion.
+ *
+ * When the gap between the neighbours of a new entry is used up, we look at
+ * aligned label ranges of growing size 2^i around it, and count the entries
+ * in each. The first range whose density is below (1/T)^i, for a fixed T
+ * between 1 and 2, gets its entries relabelled evenly. Any range of size 2^i
+ * relabelled this way has room for a number of insertions proportional to its
+ * entries before it overflows again, which yields O(log(n)) amortized relabels
+ * per insertion. With 64-bit labels and T = 1.4, ranges stay sparse enough for
+ * billions of entries. Beyond that, the whole label space is relabelled.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "c-rborder.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rborder_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBOrderEntry, rb)
+
+/* growth of the allowed number of entries per doubling of a range, 2 / T */
+#define C_RBORDER_GROWTH (2.0 / 1.4)
+
+static void c_rborder_relabel(CRBOrder *o, CRBOrderEntry *e) {
+        CRBOrderEntry *first = e, *last = e, *i;
+        uint64_t anchor, base, mask, step, label;
+        CRBNode *n;
+        size_t count = 1;
+        unsigned int level;
+        double capacity = 1;
+
+        /* the new entry has no label yet, so anchor at one of its neighbours */
+        n = c_rbnode_prev(&e->rb);
+        if (!n)
+                n = c_rbnode_next(&e->rb);
+        assert(n);
+        anchor = c_rborder_entry_from_rb(n)->label;
+
+        for (level = 1; level <= 64; ++level) {
+                mask = (level < 64) ? ((uint64_t)1 << level) - 1 : UINT64_MAX;
+                base = anchor & ~mask;
+                capacity *= C_RBORDER_GROWTH;
+
+                while ((n = c_rbnode_prev(&first->rb)) &&
+                       c_rborder_entry_from_rb(n)->label >= base) {
+                        first = c_rborder_entry_from_rb(n);
+                        ++count;
+                }
+
+                while ((n = c_rbnode_next(&last->rb)) &&
+                       c_rborder_entry_from_rb(n)->label <= (base | mask)) {
+                        last = c_rborder_entry_from_rb(n);
+                        ++count;
+                }
+
+                if ((double)count <= capacity)
+                        break;
+        }
+
+        /*
+         * Either the range is sparse enough, or it covers the entire label
+         * space. In both cases, it has more labels than entries, so spread
+         * the entries evenly, with half a step of space at either end.
+         */
+        assert(count <= mask);
+        step = mask / count;
+        label = base + step / 2;
+
+        for (i = first; ; i = c_rborder_entry_from_rb(c_rbnode_next(&i->rb))) {
+                i->label = label;
+                label += step;
+                if (i == last)
+                        break;
+        }
+
+        o->n_relabeled += count;
+}
+
+/**
+ * c_rborder_add() - link entry
+ * @o:                  tree to operate on
+ * @p:                  parent node to link under, or NULL
+ * @l:                  slot to link the entry into
+ * @e:                  entry to link
+ *
+ * This links @e into @o, just like c_rbtree_add() links a node. @p and @l
+ * are usually retrieved via c_rbtree_find_slot() on @o->tree. Additionally,
+ * @e is assigned a label between the labels of its neighbours. If there is
+ * no room between them, a range of entries around @e is relabelled.
+ *
+ * Worst case runtime (n: number of entries in tree): O(n), amortized
+ * O(log(n))
+ */
+_public_ void c_rborder_add(CRBOrder *o, CRBNode *p, CRBNode **l, CRBOrderEntry *e) {
+        CRBNode *prev, *next;
+        uint64_t lo, hi;
+
+        assert(o);
+        assert(l);
+        assert(e);
+
+        c_rbtree_add(&o->tree, p, l, &e->rb);
+        ++o->n_entries;
+
+        prev = c_rbnode_prev(&e->rb);
+        next = c_rbnode_next(&e->rb);
+
+        /*
+         * Pick the middle of the free labels between both neighbours, or the
+         * middle of the label space for the first entry. Note that an entry
+         * labelled 0 or UINT64_MAX leaves no room on its outer side.
+         */
+        if ((prev && c_rborder_entry_from_rb(prev)->label == UINT64_MAX) ||
+            (next && c_rborder_entry_from_rb(next)->label == 0)) {
+                c_rborder_relabel(o, e);
+                return;
+        }
+
+        lo = prev ? c_rborder_entry_from_rb(prev)->label + 1 : 0;
+        hi = next ? c_rborder_entry_from_rb(next)->label - 1 : UINT64_MAX;
+
+        if (lo <= hi)
+                e->label = lo + (hi - lo) / 2;
+        else
+                c_rborder_relabel(o, e);
+}
+
+/**
+ * c_rborder_remove() - unlink entry
+ * @o:                  tree to operate on
+ * @e:                  entry to unlink
+ *
+ * This unlinks @e from @o. The entry must be linked into @o. Afterwards, it
+ * is marked as unlinked, and can be released or linked again. The labels of
+ * all other entries stay unchanged.
+ *
+ * Worst case runtime (n: number of entries in tree): O(log(n))
+ */
+_public_ void c_rborder_remove(CRBOrder *o, CRBOrderEntry *e) {
+        assert(o);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        --o->n_entries;
+        e->label = 0;
+        c_rbnode_unlink(&e->rb);
+}
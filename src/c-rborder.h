@@ -0,0 +1,120 @@
+#pragma once
+
+/**
+ * Order-Maintenance Labels
+ *
+ * An ordered tree is an RB-Tree whose entries additionally carry an integer
+ * label, which increases strictly in tree order. Whether one linked entry
+ * orders before another can thus be answered by comparing their labels, in
+ * O(1), without a key at hand. Otherwise, this needs a call into the
+ * comparator, which needs the key of one of the entries, or a climb through
+ * parent pointers to a common ancestor, which touches up to O(log(n)) nodes.
+ *
+ * Labels are 64-bit integers. A new entry takes the label in the middle
+ * between its neighbours. Once there is no gap left, the smallest aligned
+ * range of labels around the new entry which is sparse enough is relabelled
+ * evenly. The allowed density of a range shrinks with its size, so larger
+ * relabels leave more space behind. This is the order-maintenance scheme of
+ * Bender et al., and needs O(log(n)) amortized relabels per insertion. Labels
+ * do change during insertions, so they must not be stored for later
+ * comparisons, but only compared while no entry is added.
+ *
+ * Entries are embedded in the objects of the API user, like CRBNode. Slots
+ * for new entries are found via c_rbtree_find_slot() on the underlying tree.
+ * The API performs no memory allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBOrder CRBOrder;
+typedef struct CRBOrderEntry CRBOrderEntry;
+
+/**
+ * struct CRBOrderEntry - entry of an ordered tree
+ * @rb:                 node in the tree
+ * @label:              order label, increasing in tree order
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBOrderEntry {
+        CRBNode rb;
+        uint64_t label;
+};
+
+#define C_RBORDER_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb) }
+
+/**
+ * struct CRBOrder - ordered tree
+ * @tree:               tree of all entries
+ * @n_entries:          number of linked entries
+ * @n_relabeled:        total number of entries relabelled so far
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBOrder {
+        CRBTree tree;
+        size_t n_entries;
+        size_t n_relabeled;
+};
+
+#define C_RBORDER_INIT {}
+
+void c_rborder_add(CRBOrder *o, CRBNode *p, CRBNode **l, CRBOrderEntry *e);
+void c_rborder_remove(CRBOrder *o, CRBOrderEntry *e);
+
+/**
+ * c_rborder_init() - initialize ordered tree
+ * @o:                  tree to initialize
+ *
+ * This initializes @o as an empty ordered tree.
+ */
+static inline void c_rborder_init(CRBOrder *o) {
+        *o = (CRBOrder)C_RBORDER_INIT;
+}
+
+/**
+ * c_rborder_is_empty() - check whether an ordered tree is empty
+ * @o:                  tree to operate on
+ *
+ * Return: True if the tree is empty, false otherwise.
+ */
+static inline _Bool c_rborder_is_empty(CRBOrder *o) {
+        return !o->n_entries;
+}
+
+/**
+ * c_rborder_precedes() - check whether an entry orders before another
+ * @a:                  first entry, which must be linked
+ * @b:                  second entry, which must be linked into the same tree
+ *
+ * Fixed runtime (n: number of entries in tree): O(1)
+ *
+ * Return: True if @a orders before @b in tree order, false otherwise.
+ */
+static inline _Bool c_rborder_precedes(const CRBOrderEntry *a, const CRBOrderEntry *b) {
+        return a->label < b->label;
+}
+
+/**
+ * c_rborder_compare() - compare tree positions of two entries
+ * @a:                  first entry, which must be linked
+ * @b:                  second entry, which must be linked into the same tree
+ *
+ * Fixed runtime (n: number of entries in tree): O(1)
+ *
+ * Return: -1 if @a orders before @b, 1 if it orders after @b, 0 if both are
+ *         the same entry.
+ */
+static inline int c_rborder_compare(const CRBOrderEntry *a, const CRBOrderEntry *b) {
+        return (a->label < b->label) ? -1 : (a->label > b->label) ? 1 : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
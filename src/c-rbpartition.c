@@ -0,0 +1,258 @@
+/*
+ * Partitioned RB-Trees
+ * This implements a set of independent RB-Trees that together form a single
+ * logical collection. Insertion only ever touches a single partition, reads
+ * merge all partitions on the fly, and consolidation merges all partitions
+ * into the global tree via a bulk rebuild.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "c-rbpartition.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+static_assert(sizeof(CRBPartition) == 64, "Invalid CRBPartition size");
+static_assert(alignof(CRBPartition) == 64, "Invalid CRBPartition alignment");
+
+/**
+ * c_rbpartitions_init() - initialize partitioned tree
+ * @ps:                 partitioned tree to operate on
+ * @compare:            comparison function
+ * @partitions:         array of partitions to use
+ * @n_partitions:       number of partitions in @partitions
+ *
+ * This initializes @ps as an empty partitioned tree, using @partitions as
+ * backing storage for its partitions. All partitions are reset to empty
+ * trees. The array must stay valid for the lifetime of @ps, and must be
+ * aligned to alignof(CRBPartition), which is the size of a cache-line.
+ *
+ * @compare is used to order nodes on insertion, as well as to merge
+ * partitions.
+ */
+_public_ void c_rbpartitions_init(CRBPartitions *ps,
+                                  CRBPartitionsCompareFunc compare,
+                                  CRBPartition *partitions,
+                                  size_t n_partitions) {
+        size_t i;
+
+        assert(ps);
+        assert(compare);
+        assert(partitions || !n_partitions);
+        assert(!((uintptr_t)partitions % alignof(CRBPartition)));
+
+        *ps = (CRBPartitions){
+                .compare = compare,
+                .tree = C_RBTREE_INIT,
+                .partitions = partitions,
+                .n_partitions = n_partitions,
+        };
+
+        for (i = 0; i < n_partitions; ++i)
+                partitions[i] = (CRBPartition)C_RBPARTITION_INIT;
+}
+
+/**
+ * c_rbpartitions_add() - add node to a partition
+ * @ps:                 partitioned tree to operate on
+ * @idx:                index of the partition to add to
+ * @n:                  node to add
+ *
+ * This links @n into the partition with index @idx. Nodes that compare equal
+ * to existing nodes are linked after them.
+ *
+ * This only ever accesses the selected partition. No locking is performed, so
+ * the caller must guarantee that no-one else accesses the partition in
+ * parallel. Different partitions can be operated on in parallel without any
+ * synchronization.
+ *
+ * Worst case runtime (n: number of elements in partition): O(log(n))
+ */
+_public_ void c_rbpartitions_add(CRBPartitions *ps, size_t idx, CRBNode *n) {
+        CRBNode **i, *p;
+        CRBTree *t;
+
+        assert(ps);
+        assert(idx < ps->n_partitions);
+        assert(n);
+
+        t = &ps->partitions[idx].tree;
+        i = &t->root;
+        p = NULL;
+        while (*i) {
+                p = *i;
+                if (ps->compare(n, *i) < 0)
+                        i = &(*i)->left;
+                else
+                        i = &(*i)->right;
+        }
+
+        c_rbtree_add(t, p, i, n);
+}
+
+/**
+ * c_rbpartitions_find() - find node
+ * @ps:                 partitioned tree to search through
+ * @f:                  comparison function
+ * @k:                  key to search for
+ *
+ * This searches the global tree and all partitions of @ps for a node that
+ * compares equal to @k. See c_rbtree_find_node() for details.
+ *
+ * Worst case runtime (n: number of elements, p: number of partitions):
+ *     O(p * log(n))
+ *
+ * Return: Pointer to matching node, or NULL.
+ */
+_public_ CRBNode *c_rbpartitions_find(CRBPartitions *ps, CRBCompareFunc f, const void *k) {
+        CRBNode *n;
+        size_t i;
+
+        assert(ps);
+
+        n = c_rbtree_find_node(&ps->tree, f, k);
+        for (i = 0; !n && i < ps->n_partitions; ++i)
+                n = c_rbtree_find_node(&ps->partitions[i].tree, f, k);
+
+        return n;
+}
+
+static CRBNode *c_rbpartitions_merge(CRBPartitionsCompareFunc compare, CRBNode *a, CRBNode *b) {
+        CRBNode *chain = NULL, **tail = &chain;
+
+        /* merge two chains, preferring @a over @b on equal nodes */
+        while (a && b) {
+                if (compare(b, a) < 0) {
+                        *tail = b;
+                        b = b->left;
+                } else {
+                        *tail = a;
+                        a = a->left;
+                }
+                tail = &(*tail)->left;
+        }
+        *tail = a ?: b;
+
+        return chain;
+}
+
+/**
+ * c_rbpartitions_consolidate() - merge partitions into global tree
+ * @ps:                 partitioned tree to operate on
+ *
+ * This moves all nodes of all partitions into the global tree of @ps. All
+ * partitions are empty afterwards. The global tree is rebuilt from scratch as
+ * a balanced tree, the previous shape of all trees is not retained.
+ *
+ * Nodes that compare equal retain their relative order of the merge view. That
+ * is, nodes of the global tree order before nodes of partitions, and nodes of
+ * partitions with lower index order before nodes of partitions with higher
+ * index.
+ *
+ * The caller must guarantee that no partition is accessed in parallel.
+ *
+ * Worst case runtime (n: number of elements, p: number of partitions):
+ *     O(n * log(p))
+ */
+_public_ void c_rbpartitions_consolidate(CRBPartitions *ps) {
+        size_t i, step, n_nodes, n_total;
+        CRBNode *chain;
+
+        assert(ps);
+
+        /*
+         * Turn every partition into a sorted chain and store the head of the
+         * chain in the root-pointer of the partition. Then merge the chains
+         * pair-wise, so every node takes part in O(log(p)) merges only.
+         */
+        n_total = 0;
+        for (i = 0; i < ps->n_partitions; ++i) {
+                chain = c_rbtree_detach_chain(&ps->partitions[i].tree, &n_nodes);
+                ps->partitions[i].tree.root = chain;
+                n_total += n_nodes;
+        }
+
+        for (step = 1; step < ps->n_partitions; step *= 2) {
+                for (i = 0; i + step < ps->n_partitions; i += 2 * step) {
+                        ps->partitions[i].tree.root = c_rbpartitions_merge(ps->compare,
+                                                                           ps->partitions[i].tree.root,
+                                                                           ps->partitions[i + step].tree.root);
+                        ps->partitions[i + step].tree.root = NULL;
+                }
+        }
+
+        chain = c_rbtree_detach_chain(&ps->tree, &n_nodes);
+        n_total += n_nodes;
+
+        if (ps->n_partitions) {
+                chain = c_rbpartitions_merge(ps->compare, chain, ps->partitions[0].tree.root);
+                ps->partitions[0].tree.root = NULL;
+        }
+
+        c_rbtree_attach_chain(&ps->tree, chain, n_total);
+}
+
+/**
+ * c_rbpartitions_iter_init() - initialize merge view iterator
+ * @iter:               iterator to initialize
+ * @ps:                 partitioned tree to iterate
+ * @cursors:            cursor storage
+ *
+ * This initializes @iter to iterate all nodes of @ps in order, starting at
+ * the first node. The caller must provide storage for one cursor per
+ * partition, plus one for the global tree (that is, @cursors must have room
+ * for at least @ps->n_partitions + 1 entries).
+ *
+ * Fixed runtime (n: number of elements, p: number of partitions):
+ *     O(p * log(n))
+ */
+_public_ void c_rbpartitions_iter_init(CRBPartitionsIter *iter, CRBPartitions *ps, CRBNode **cursors) {
+        size_t i;
+
+        assert(iter);
+        assert(ps);
+        assert(cursors);
+
+        iter->partitions = ps;
+        iter->cursors = cursors;
+
+        cursors[0] = c_rbtree_first(&ps->tree);
+        for (i = 0; i < ps->n_partitions; ++i)
+                cursors[i + 1] = c_rbtree_first(&ps->partitions[i].tree);
+}
+
+/**
+ * c_rbpartitions_iter_next() - return next node of merge view
+ * @iter:               iterator to operate on
+ *
+ * This returns the next node in order, taking the global tree and all
+ * partitions into account. Nodes that compare equal are returned in the same
+ * order c_rbpartitions_consolidate() would put them in.
+ *
+ * Worst case runtime (n: number of elements, p: number of partitions):
+ *     O(p + log(n))
+ *
+ * Return: Pointer to next node, or NULL at the end.
+ */
+_public_ CRBNode *c_rbpartitions_iter_next(CRBPartitionsIter *iter) {
+        CRBNode **cursors = iter->cursors, *n = NULL;
+        size_t i, min = 0;
+
+        for (i = 0; i <= iter->partitions->n_partitions; ++i) {
+                if (cursors[i] && (!n || iter->partitions->compare(cursors[i], n) < 0)) {
+                        n = cursors[i];
+                        min = i;
+                }
+        }
+
+        if (n)
+                cursors[min] = c_rbnode_next(n);
+
+        return n;
+}
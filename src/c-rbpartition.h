@@ -0,0 +1,119 @@
+#pragma once
+
+/**
+ * Partitioned RB-Trees
+ *
+ * A partitioned tree splits a single logical RB-Tree into a consolidated
+ * global tree, plus a fixed set of partitions. Each partition is a plain
+ * CRBTree. Writers insert into a partition they own exclusively (usually one
+ * per thread, or one per CPU if migration is prevented by the caller). Since
+ * partitions never share any state, the insertion path does not need any
+ * locking, nor does it bounce cache-lines between writers.
+ *
+ * Ordered reads see the union of the global tree and all partitions via a
+ * merge view (see c_rbpartitions_iter_next()). Regularly, the caller is
+ * expected to quiesce all writers and consolidate the partitions into the
+ * global tree. Consolidation merges all trees pairwise in O(n*log(p)) time,
+ * and then rebuilds the global tree in bulk, in linear time, without any
+ * comparison-based insertion or rotation.
+ *
+ * The API performs no locking and no memory allocation. It is up to the caller
+ * to provide the partition array and to synchronize consolidation and reads
+ * with the writers.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdalign.h>
+#include <stddef.h>
+#include "c-rbtree.h"
+
+typedef struct CRBPartition CRBPartition;
+typedef struct CRBPartitions CRBPartitions;
+typedef struct CRBPartitionsIter CRBPartitionsIter;
+
+/**
+ * CRBPartitionsCompareFunc - compare two nodes
+ * @a:          node to compare
+ * @b:          node to compare to
+ *
+ * This function should work like strcmp(), that is, return <0 if @a orders
+ * before @b, 0 if both compare equal, and >0 if @a orders after @b.
+ */
+typedef int (*CRBPartitionsCompareFunc) (CRBNode *a, CRBNode *b);
+
+/**
+ * struct CRBPartition - single partition
+ * @tree:               tree of this partition
+ *
+ * A partition is aligned to, and thus padded to, the size of a cache-line, so
+ * partitions stored in an array do not share cache-lines with each other.
+ * Arrays on the stack or in static storage get this alignment from the
+ * compiler. Dynamically allocated arrays must be allocated with
+ * aligned_alloc(3), or similar, since malloc(3) does not guarantee it.
+ */
+struct CRBPartition {
+        alignas(64) CRBTree tree;
+};
+
+#define C_RBPARTITION_INIT {}
+
+/**
+ * struct CRBPartitions - partitioned tree
+ * @compare:            comparison function
+ * @tree:               consolidated global tree
+ * @partitions:         array of partitions
+ * @n_partitions:       number of partitions in @partitions
+ *
+ * The API user is free to access @tree and each partition at any time. Nodes
+ * can be unlinked from any of them via c_rbnode_unlink(), as usual.
+ */
+struct CRBPartitions {
+        CRBPartitionsCompareFunc compare;
+        CRBTree tree;
+        CRBPartition *partitions;
+        size_t n_partitions;
+};
+
+/**
+ * struct CRBPartitionsIter - merge view iterator
+ * @partitions:         partitioned tree to iterate
+ * @cursors:            current position in the global tree and each partition
+ */
+struct CRBPartitionsIter {
+        CRBPartitions *partitions;
+        CRBNode **cursors;
+};
+
+void c_rbpartitions_init(CRBPartitions *ps,
+                         CRBPartitionsCompareFunc compare,
+                         CRBPartition *partitions,
+                         size_t n_partitions);
+void c_rbpartitions_add(CRBPartitions *ps, size_t idx, CRBNode *n);
+CRBNode *c_rbpartitions_find(CRBPartitions *ps, CRBCompareFunc f, const void *k);
+void c_rbpartitions_consolidate(CRBPartitions *ps);
+
+void c_rbpartitions_iter_init(CRBPartitionsIter *iter, CRBPartitions *ps, CRBNode **cursors);
+CRBNode *c_rbpartitions_iter_next(CRBPartitionsIter *iter);
+
+/**
+ * c_rbpartitions_for_each() - iterate the merge view
+ * @_iter:      loop iterator
+ * @_pi:        merge view iterator to use
+ * @_ps:        partitioned tree to iterate
+ * @_cursors:   cursor storage, see c_rbpartitions_iter_init()
+ *
+ * This iterates all nodes of the global tree and all partitions of @_ps in
+ * order. Nodes must not be linked or unlinked during iteration.
+ */
+#define c_rbpartitions_for_each(_iter, _pi, _ps, _cursors)                      \
+        for (c_rbpartitions_iter_init((_pi), (_ps), (_cursors)),                \
+             _iter = c_rbpartitions_iter_next(_pi);                             \
+             _iter;                                                             \
+             _iter = c_rbpartitions_iter_next(_pi))
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Radix-Sharded Trees
+ * This implements radix-sharded trees as a direct table of RB-Trees, indexed
+ * by the top bits of the key. Without any shard bits, the single shard is
+ * embedded in the tree object, so small trees need no allocation at all.
+ *
+ * Growing the table splits every shard into 4 adjacent shards. Each shard is
+ * detached into an ordered chain, cut into the runs that share their new
+ * shard index, and each run is attached to its new shard as balanced tree.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "c-rbradix.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+/*
+ * The table grows by C_RBRADIX_GROW_BITS bits, once shards hold more than
+ * C_RBRADIX_SHARD_SIZE entries on average. Afterwards, they hold a quarter of
+ * that, so growth is amortized over many insertions.
+ */
+#define C_RBRADIX_SHARD_SIZE 64
+#define C_RBRADIX_GROW_BITS 2
+
+#define c_rbradix_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBRadixEntry, rb)
+
+static size_t c_rbradix_index(CRBRadix *r, uint64_t key, unsigned int n_shard_bits) {
+        return n_shard_bits ? key >> (r->n_key_bits - n_shard_bits) : 0;
+}
+
+static CRBTree *c_rbradix_shard(CRBRadix *r, size_t index) {
+        return r->shards ? &r->shards[index] : &r->root;
+}
+
+static size_t c_rbradix_n_shards(CRBRadix *r) {
+        return (size_t)1 << r->n_shard_bits;
+}
+
+static int c_rbradix_grow(CRBRadix *r, unsigned int n_shard_bits) {
+        CRBNode *chain, *n;
+        size_t i, index, n_nodes;
+        CRBTree *shards;
+
+        shards = calloc((size_t)1 << n_shard_bits, sizeof(*shards));
+        if (!shards)
+                return -ENOMEM;
+
+        for (i = 0; i < c_rbradix_n_shards(r); ++i) {
+                chain = c_rbtree_detach_chain(c_rbradix_shard(r, i), NULL);
+
+                while (chain) {
+                        index = c_rbradix_index(r, c_rbradix_entry_from_rb(chain)->key, n_shard_bits);
+
+                        n_nodes = 0;
+                        for (n = chain;
+                             n && c_rbradix_index(r, c_rbradix_entry_from_rb(n)->key, n_shard_bits) == index;
+                             n = n->left)
+                                ++n_nodes;
+
+                        c_rbtree_attach_chain(&shards[index], chain, n_nodes);
+                        chain = n;
+                }
+        }
+
+        free(r->shards);
+        r->shards = shards;
+        r->n_shard_bits = n_shard_bits;
+        return 0;
+}
+
+/**
+ * c_rbradix_init() - initialize radix-sharded tree
+ * @r:                  radix-sharded tree to initialize
+ * @n_key_bits:         width of keys in bits
+ *
+ * This initializes @r as an empty tree for keys of @n_key_bits bits. All keys
+ * must be lower than 2^@n_key_bits. The top bits of this width select the
+ * shard, so keys should use their full width.
+ */
+_public_ void c_rbradix_init(CRBRadix *r, unsigned int n_key_bits) {
+        assert(r);
+        assert(n_key_bits > 0 && n_key_bits <= 64);
+
+        *r = (CRBRadix){ .n_key_bits = n_key_bits };
+}
+
+/**
+ * c_rbradix_deinit() - deinitialize radix-sharded tree
+ * @r:                  radix-sharded tree to deinitialize
+ *
+ * This releases the shard table of @r, and marks all its entries as unlinked.
+ * Afterwards, @r is empty and can be reused.
+ *
+ * Worst case runtime (n: number of entries, s: number of shards): O(n + s)
+ */
+_public_ void c_rbradix_deinit(CRBRadix *r) {
+        CRBRadixEntry *e, *safe;
+        size_t i;
+
+        assert(r);
+
+        for (i = 0; i < c_rbradix_n_shards(r); ++i)
+                c_rbtree_for_each_entry_safe_postorder_unlink(e, safe, c_rbradix_shard(r, i), rb)
+                        /* nothing to do */ ;
+
+        free(r->shards);
+        c_rbradix_init(r, r->n_key_bits);
+}
+
+/**
+ * c_rbradix_add() - add entry
+ * @r:                  radix-sharded tree to operate on
+ * @e:                  entry to link
+ * @key:                key of the entry
+ *
+ * This links @e into @r with key @key. If the shards grew too large, the
+ * shard table is grown afterwards. If that fails, @r keeps its current
+ * table, which only affects performance.
+ *
+ * Worst case runtime (n: number of entries): O(log(n)), plus amortized O(1)
+ * for growing the table.
+ *
+ * Return: 0 on success, -EEXIST if the key is already present.
+ */
+_public_ int c_rbradix_add(CRBRadix *r, CRBRadixEntry *e, uint64_t key) {
+        CRBNode **slot, *p = NULL;
+        unsigned int n_shard_bits;
+        uint64_t k;
+        CRBTree *t;
+
+        assert(r);
+        assert(e);
+        assert(!c_rbnode_is_linked(&e->rb));
+        assert(r->n_key_bits == 64 || !(key >> r->n_key_bits));
+
+        t = c_rbradix_shard(r, c_rbradix_index(r, key, r->n_shard_bits));
+        slot = &t->root;
+        while (*slot) {
+                p = *slot;
+                k = c_rbradix_entry_from_rb(p)->key;
+                if (key < k)
+                        slot = &p->left;
+                else if (key > k)
+                        slot = &p->right;
+                else
+                        return -EEXIST;
+        }
+
+        e->key = key;
+        c_rbtree_add(t, p, slot, &e->rb);
+        ++r->n_entries;
+
+        if (r->n_entries > ((size_t)C_RBRADIX_SHARD_SIZE << r->n_shard_bits)) {
+                n_shard_bits = r->n_shard_bits + C_RBRADIX_GROW_BITS;
+                if (n_shard_bits > C_RBRADIX_MAX_SHARD_BITS)
+                        n_shard_bits = C_RBRADIX_MAX_SHARD_BITS;
+                if (n_shard_bits > r->n_key_bits)
+                        n_shard_bits = r->n_key_bits;
+
+                if (n_shard_bits > r->n_shard_bits)
+                        (void)c_rbradix_grow(r, n_shard_bits);
+        }
+
+        return 0;
+}
+
+/**
+ * c_rbradix_remove() - remove entry
+ * @r:                  radix-sharded tree to operate on
+ * @e:                  entry to unlink
+ *
+ * This unlinks @e from @r. The entry must be linked into @r. The shard table
+ * is never shrunk, until @r is deinitialized.
+ *
+ * Worst case runtime (n: number of entries): O(log(n))
+ */
+_public_ void c_rbradix_remove(CRBRadix *r, CRBRadixEntry *e) {
+        assert(r);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        c_rbnode_unlink(&e->rb);
+        --r->n_entries;
+}
+
+/**
+ * c_rbradix_find() - find entry
+ * @r:                  radix-sharded tree to search through
+ * @key:                key to search for
+ *
+ * This searches the shard of @key for an entry with key @key.
+ *
+ * Worst case runtime (n: number of entries): O(log(n))
+ *
+ * Return: Pointer to matching entry, or NULL.
+ */
+_public_ CRBRadixEntry *c_rbradix_find(CRBRadix *r, uint64_t key) {
+        CRBNode *n;
+        uint64_t k;
+
+        assert(r);
+        assert(r->n_key_bits == 64 || !(key >> r->n_key_bits));
+
+        n = c_rbradix_shard(r, c_rbradix_index(r, key, r->n_shard_bits))->root;
+        while (n) {
+                k = c_rbradix_entry_from_rb(n)->key;
+                if (key < k)
+                        n = n->left;
+                else if (key > k)
+                        n = n->right;
+                else
+                        return c_rbradix_entry_from_rb(n);
+        }
+
+        return NULL;
+}
+
+static CRBRadixEntry *c_rbradix_first_from(CRBRadix *r, size_t index) {
+        CRBNode *n;
+
+        for ( ; index < c_rbradix_n_shards(r); ++index) {
+                n = c_rbtree_first(c_rbradix_shard(r, index));
+                if (n)
+                        return c_rbradix_entry_from_rb(n);
+        }
+
+        return NULL;
+}
+
+/**
+ * c_rbradix_first() - return first entry
+ * @r:                  radix-sharded tree to operate on
+ *
+ * Worst case runtime (n: number of entries, s: number of shards):
+ *     O(log(n) + s)
+ *
+ * Return: Pointer to the entry with the lowest key, or NULL.
+ */
+_public_ CRBRadixEntry *c_rbradix_first(CRBRadix *r) {
+        assert(r);
+
+        return c_rbradix_first_from(r, 0);
+}
+
+/**
+ * c_rbradix_next() - return next entry
+ * @r:                  radix-sharded tree to operate on
+ * @e:                  current entry
+ *
+ * This returns the entry following @e in key order. If @e is the last entry
+ * of its shard, the following shards are searched for the next non-empty one.
+ *
+ * Worst case runtime (n: number of entries, s: number of shards):
+ *     O(log(n) + s)
+ *
+ * Return: Pointer to the next entry, or NULL.
+ */
+_public_ CRBRadixEntry *c_rbradix_next(CRBRadix *r, CRBRadixEntry *e) {
+        CRBNode *n;
+
+        assert(r);
+        assert(e);
+
+        n = c_rbnode_next(&e->rb);
+        if (n)
+                return c_rbradix_entry_from_rb(n);
+
+        return c_rbradix_first_from(r, c_rbradix_index(r, e->key, r->n_shard_bits) + 1);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+/**
+ * Radix-Sharded Trees
+ *
+ * A radix-sharded tree stores entries with fixed-width integer keys (e.g.,
+ * 32bit or 64bit) in 2^k RB-Trees, called shards. The top k bits of a key
+ * select its shard from a direct table, and only the shard is searched by
+ * comparison. This replaces the top k levels of a single tree with one table
+ * lookup, which saves k dependent cache misses on large trees.
+ *
+ * The number of shards adapts to the number of entries. Whenever the average
+ * shard grows beyond a fixed size, the table grows by a factor of 4, and all
+ * shards are split in O(n), without any comparisons or rotations. Since keys
+ * of a shard share their top bits, shards are ordered, and in-order iteration
+ * simply walks the shards in turn.
+ *
+ * Entries are embedded in the objects of the API user, like CRBNode. The
+ * shard table itself is allocated by the radix-sharded tree.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBRadix CRBRadix;
+typedef struct CRBRadixEntry CRBRadixEntry;
+
+#define C_RBRADIX_MAX_SHARD_BITS 16
+
+/**
+ * struct CRBRadixEntry - radix-sharded tree entry
+ * @rb:                 node in the tree of its shard
+ * @key:                key of the entry
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBRadixEntry {
+        CRBNode rb;
+        uint64_t key;
+};
+
+#define C_RBRADIX_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb) }
+
+/**
+ * struct CRBRadix - radix-sharded tree
+ * @n_key_bits:         width of keys in bits
+ * @n_shard_bits:       number of top key bits that select the shard
+ * @n_entries:          number of linked entries
+ * @root:               the only shard, if @n_shard_bits is 0
+ * @shards:             table of 2^@n_shard_bits shards, or NULL
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBRadix {
+        unsigned int n_key_bits;
+        unsigned int n_shard_bits;
+        size_t n_entries;
+        CRBTree root;
+        CRBTree *shards;
+};
+
+void c_rbradix_init(CRBRadix *r, unsigned int n_key_bits);
+void c_rbradix_deinit(CRBRadix *r);
+
+int c_rbradix_add(CRBRadix *r, CRBRadixEntry *e, uint64_t key);
+void c_rbradix_remove(CRBRadix *r, CRBRadixEntry *e);
+CRBRadixEntry *c_rbradix_find(CRBRadix *r, uint64_t key);
+
+CRBRadixEntry *c_rbradix_first(CRBRadix *r);
+CRBRadixEntry *c_rbradix_next(CRBRadix *r, CRBRadixEntry *e);
+
+/**
+ * c_rbradix_is_empty() - check whether a radix-sharded tree is empty
+ * @r:                  radix-sharded tree to operate on
+ *
+ * Return: True if the tree is empty, false otherwise.
+ */
+static inline _Bool c_rbradix_is_empty(CRBRadix *r) {
+        return !r->n_entries;
+}
+
+/**
+ * c_rbradix_for_each() - iterate all entries in order
+ * @_iter:      loop iterator, of type CRBRadixEntry
+ * @_r:         radix-sharded tree to iterate
+ *
+ * This iterates all entries of @_r in ascending order of their keys. The tree
+ * must not be modified during iteration.
+ */
+#define c_rbradix_for_each(_iter, _r) \
+        for (_iter = c_rbradix_first(_r); _iter; _iter = c_rbradix_next((_r), _iter))
+
+#ifdef __cplusplus
+}
+#endif
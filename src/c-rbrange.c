@@ -0,0 +1,331 @@
+/*
+ * Range Sets
+ * This implements sets of disjoint, coalesced ranges on top of an augmented
+ * RB-Tree. Each range caches the maximum range length of its subtree, which
+ * is maintained via the augmentation callbacks of the tree implementation.
+ *
+ * Ranges are never adjacent or overlapping, hence ordering by start is the
+ * same as ordering by end. This allows growing or shrinking ranges in place,
+ * without relinking them, as long as they do not reach into their neighbours.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "c-rbrange.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rbrange_from_rb(_rb) c_rbnode_entry((_rb), CRBRange, rb)
+
+static _Bool c_rbrange_augment(CRBNode *n) {
+        CRBRange *r = c_rbrange_from_rb(n), *c;
+        uint64_t max = r->end - r->start;
+
+        if ((c = c_rbrange_from_rb(n->left)) && c->max_length > max)
+                max = c->max_length;
+        if ((c = c_rbrange_from_rb(n->right)) && c->max_length > max)
+                max = c->max_length;
+
+        if (r->max_length == max)
+                return 0;
+
+        r->max_length = max;
+        return 1;
+}
+
+static CRBRange *c_rbrange_next(CRBRange *r) {
+        return c_rbrange_from_rb(c_rbnode_next(&r->rb));
+}
+
+static void c_rbrange_free(CRBRange *r) {
+        c_rbnode_unlink_augmented(&r->rb, c_rbrange_augment);
+        free(r);
+}
+
+/*
+ * Find the last range that starts at, or before, @v. If there is none, NULL
+ * is returned, and @nextp is set to the first range of the set.
+ */
+static CRBRange *c_rbrangeset_find_le(CRBRangeSet *s, uint64_t v, CRBRange **nextp) {
+        CRBNode *n = s->tree.root, *le = NULL, *next = NULL;
+
+        while (n) {
+                if (c_rbrange_from_rb(n)->start <= v) {
+                        le = n;
+                        n = n->right;
+                } else {
+                        next = n;
+                        n = n->left;
+                }
+        }
+
+        if (nextp)
+                *nextp = c_rbrange_from_rb(next);
+        return c_rbrange_from_rb(le);
+}
+
+/* Link @r, which must not overlap, nor be adjacent to, any linked range. */
+static void c_rbrangeset_link(CRBRangeSet *s, CRBRange *r) {
+        CRBNode **slot = &s->tree.root, *p = NULL;
+
+        while (*slot) {
+                p = *slot;
+                if (r->start < c_rbrange_from_rb(p)->start)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbnode_init(&r->rb);
+        c_rbtree_add_augmented(&s->tree, p, slot, &r->rb, c_rbrange_augment);
+}
+
+static int c_rbrangeset_new(CRBRangeSet *s, uint64_t start, uint64_t end) {
+        CRBRange *r;
+
+        r = malloc(sizeof(*r));
+        if (!r)
+                return -ENOMEM;
+
+        r->start = start;
+        r->end = end;
+        r->max_length = 0;
+        c_rbrangeset_link(s, r);
+        return 0;
+}
+
+/**
+ * c_rbrangeset_init() - initialize range set
+ * @s:                  range set to initialize
+ *
+ * This initializes @s as an empty range set.
+ */
+_public_ void c_rbrangeset_init(CRBRangeSet *s) {
+        assert(s);
+
+        *s = (CRBRangeSet)C_RBRANGESET_INIT;
+}
+
+/**
+ * c_rbrangeset_deinit() - deinitialize range set
+ * @s:                  range set to deinitialize
+ *
+ * This releases all ranges of @s. Afterwards, @s is empty and can be reused.
+ *
+ * Worst case runtime (n: number of ranges): O(n)
+ */
+_public_ void c_rbrangeset_deinit(CRBRangeSet *s) {
+        CRBRange *r, *safe;
+
+        assert(s);
+
+        c_rbtree_for_each_entry_safe_postorder_unlink(r, safe, &s->tree, rb)
+                free(r);
+}
+
+/**
+ * c_rbrangeset_insert() - add range to set
+ * @s:                  range set to operate on
+ * @start:              first value to add
+ * @end:                first value after the range to add
+ *
+ * This adds all values in [@start, @end) to @s. Values already present are
+ * ignored. The new range is coalesced with all ranges it overlaps or touches,
+ * so a new range is only allocated if it is disjoint from all others. @start
+ * must be lower than @end.
+ *
+ * Worst case runtime (n: number of ranges, k: number of coalesced ranges):
+ *     O((k + 1) * log(n))
+ *
+ * Return: 0 on success, -ENOMEM if allocation failed, in which case @s is
+ *         unchanged.
+ */
+_public_ int c_rbrangeset_insert(CRBRangeSet *s, uint64_t start, uint64_t end) {
+        CRBRange *r, *next;
+
+        assert(s);
+        assert(start < end);
+
+        r = c_rbrangeset_find_le(s, start, &next);
+        if (r && r->end >= start) {
+                /* the previous range overlaps or touches, extend it */
+                start = r->start;
+                next = c_rbrange_next(r);
+        } else if (next && next->start <= end) {
+                /*
+                 * The following range overlaps or touches. It can be moved
+                 * down to @start without relinking, since the previous range
+                 * ends before @start.
+                 */
+                r = next;
+                next = c_rbrange_next(r);
+        } else {
+                return c_rbrangeset_new(s, start, end);
+        }
+
+        /* swallow all following ranges that overlap or touch */
+        while (next && next->start <= end) {
+                if (next->end > end)
+                        end = next->end;
+                c_rbrange_free(next);
+                next = c_rbrange_next(r);
+        }
+
+        /*
+         * Only update @r once all unlinking is done. Rotations might
+         * recompute it on the way, and propagation would then stop early.
+         */
+        r->start = start;
+        if (end > r->end)
+                r->end = end;
+
+        c_rbnode_propagate(&r->rb, c_rbrange_augment);
+        return 0;
+}
+
+/**
+ * c_rbrangeset_remove() - remove range from set
+ * @s:                  range set to operate on
+ * @start:              first value to remove
+ * @end:                first value after the range to remove
+ *
+ * This removes all values in [@start, @end) from @s. Values not present are
+ * ignored. Ranges that are partially covered are trimmed, and a range that
+ * covers the removed range on both sides is split in two. @start must be lower
+ * than @end.
+ *
+ * Worst case runtime (n: number of ranges, k: number of removed ranges):
+ *     O((k + 1) * log(n))
+ *
+ * Return: 0 on success, -ENOMEM if a split required allocation and it
+ *         failed, in which case @s is unchanged.
+ */
+_public_ int c_rbrangeset_remove(CRBRangeSet *s, uint64_t start, uint64_t end) {
+        CRBRange *r, *next;
+        int e;
+
+        assert(s);
+        assert(start < end);
+
+        r = c_rbrangeset_find_le(s, start, &next);
+        if (r && r->end > start) {
+                if (r->start < start && r->end > end) {
+                        /*
+                         * Split, but link the upper half before trimming @r.
+                         * This leaves @s unchanged if allocation fails, and
+                         * @r cannot be recomputed by rotations before it is
+                         * propagated.
+                         */
+                        e = c_rbrangeset_new(s, end, r->end);
+                        if (e)
+                                return e;
+
+                        r->end = start;
+                        c_rbnode_propagate(&r->rb, c_rbrange_augment);
+                        return 0;
+                } else if (r->start < start) {
+                        r->end = start;
+                        c_rbnode_propagate(&r->rb, c_rbrange_augment);
+                        next = c_rbrange_next(r);
+                } else {
+                        next = r;
+                }
+        } else if (r) {
+                next = c_rbrange_next(r);
+        }
+
+        while (next && next->start < end) {
+                r = next;
+                next = c_rbrange_next(r);
+
+                if (r->end > end) {
+                        r->start = end;
+                        c_rbnode_propagate(&r->rb, c_rbrange_augment);
+                        break;
+                }
+
+                c_rbrange_free(r);
+        }
+
+        return 0;
+}
+
+/**
+ * c_rbrangeset_contains() - check whether range is in set
+ * @s:                  range set to query
+ * @start:              first value to check
+ * @end:                first value after the range to check
+ *
+ * This checks whether all values in [@start, @end) are in @s. Since ranges
+ * are coalesced, this is the case only if a single range covers them all.
+ * @start must be lower than @end.
+ *
+ * Worst case runtime (n: number of ranges): O(log(n))
+ *
+ * Return: True if the range is fully contained, false otherwise.
+ */
+_public_ _Bool c_rbrangeset_contains(CRBRangeSet *s, uint64_t start, uint64_t end) {
+        CRBRange *r;
+
+        assert(s);
+        assert(start < end);
+
+        r = c_rbrangeset_find_le(s, start, NULL);
+        return r && r->end >= end;
+}
+
+/**
+ * c_rbrangeset_allocate() - allocate range from set
+ * @s:                  range set to allocate from
+ * @size:               number of values to allocate
+ * @startp:             output argument for start of the allocated range
+ *
+ * This searches @s for the lowest range that provides at least @size values,
+ * and removes the first @size values of it from @s. The start of the removed
+ * range is returned in @startp. Subtrees that cannot provide a large enough
+ * range are skipped, based on their maximum range length. @size must not be
+ * 0.
+ *
+ * Worst case runtime (n: number of ranges): O(log(n))
+ *
+ * Return: 0 on success, -ENOSPC if no range is large enough.
+ */
+_public_ int c_rbrangeset_allocate(CRBRangeSet *s, uint64_t size, uint64_t *startp) {
+        CRBRange *r, *c;
+        CRBNode *n;
+
+        assert(s);
+        assert(size > 0);
+        assert(startp);
+
+        n = s->tree.root;
+        if (!n || c_rbrange_from_rb(n)->max_length < size)
+                return -ENOSPC;
+
+        for (;;) {
+                r = c_rbrange_from_rb(n);
+                c = c_rbrange_from_rb(n->left);
+                if (c && c->max_length >= size)
+                        n = n->left;
+                else if (r->end - r->start >= size)
+                        break;
+                else
+                        n = n->right;
+        }
+
+        *startp = r->start;
+        r->start += size;
+        if (r->start == r->end)
+                c_rbrange_free(r);
+        else
+                c_rbnode_propagate(&r->rb, c_rbrange_augment);
+
+        return 0;
+}
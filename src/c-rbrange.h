@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * Range Sets
+ *
+ * A range set stores a set of integers as disjoint, half-open ranges
+ * [start, end), ordered by their start. Inserted ranges are coalesced with
+ * overlapping and adjacent ranges, and removed ranges split or trim the
+ * ranges they overlap. Hence, the set always stores the minimal number of
+ * ranges. This is the typical representation of free space in address-pool,
+ * port, or ID allocators.
+ *
+ * Each range is augmented with the maximum range length in its subtree. This
+ * allows first-fit allocation in O(log(n)), by descending only into subtrees
+ * that are known to contain a large enough range.
+ *
+ * Unlike the plain tree API, range sets allocate their ranges themselves.
+ * Functions that might need a new range report -ENOMEM if allocation fails,
+ * in which case the set is left unchanged.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBRange CRBRange;
+typedef struct CRBRangeSet CRBRangeSet;
+
+/**
+ * struct CRBRange - range of a range set
+ * @rb:                 node in the range tree
+ * @start:              first value of the range
+ * @end:                first value after the range
+ * @max_length:         maximum length of any range in this subtree
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBRange {
+        CRBNode rb;
+        uint64_t start;
+        uint64_t end;
+        uint64_t max_length;
+};
+
+/**
+ * struct CRBRangeSet - range set
+ * @tree:               tree of all ranges, ordered by start
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBRangeSet {
+        CRBTree tree;
+};
+
+#define C_RBRANGESET_INIT {}
+
+void c_rbrangeset_init(CRBRangeSet *s);
+void c_rbrangeset_deinit(CRBRangeSet *s);
+
+int c_rbrangeset_insert(CRBRangeSet *s, uint64_t start, uint64_t end);
+int c_rbrangeset_remove(CRBRangeSet *s, uint64_t start, uint64_t end);
+_Bool c_rbrangeset_contains(CRBRangeSet *s, uint64_t start, uint64_t end);
+int c_rbrangeset_allocate(CRBRangeSet *s, uint64_t size, uint64_t *startp);
+
+/**
+ * c_rbrangeset_is_empty() - check whether a range set is empty
+ * @s:                  range set to operate on
+ *
+ * Return: True if the set is empty, false otherwise.
+ */
+static inline _Bool c_rbrangeset_is_empty(CRBRangeSet *s) {
+        return c_rbtree_is_empty(&s->tree);
+}
+
+/**
+ * c_rbrangeset_for_each() - iterate all ranges
+ * @_iter:      loop iterator, of type CRBRange
+ * @_s:         range set to iterate
+ *
+ * This iterates all ranges of @_s in ascending order. The set must not be
+ * modified during iteration.
+ */
+#define c_rbrangeset_for_each(_iter, _s) \
+        c_rbtree_for_each_entry(_iter, &(_s)->tree, rb)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,415 @@
+/*
+ * Two-Dimensional Range Trees
+ * This implements range trees as a static index plus an RB-Tree of staged
+ * entries. The index is a merge-sort tree: slots are ordered by primary key,
+ * and level l keeps the slots of each aligned block of 2^l slots sorted by
+ * secondary key. Every block is a node of the implicit, balanced tree over
+ * all slots, with level 0 as the leaves.
+ *
+ * All levels are stored in a single array of n_levels * n_indexed points,
+ * and level l is built by merging pairs of blocks of level l - 1.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "c-rbrangetree.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+/*
+ * Staged entries and tombstones are folded into the index by the next query,
+ * once they exceed 1/C_RBRANGETREE_PENDING_RATIO of all entries, but not
+ * before there are at least C_RBRANGETREE_PENDING_MIN of them.
+ */
+#define C_RBRANGETREE_PENDING_MIN 32
+#define C_RBRANGETREE_PENDING_RATIO 8
+
+#define c_rbrangetree_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBRangeTreeEntry, rb)
+
+static CRBRangeTreePoint *c_rbrangetree_level(CRBRangeTree *t, unsigned int level) {
+        return t->levels + (size_t)level * t->n_indexed;
+}
+
+static void c_rbrangetree_merge(CRBRangeTreePoint *to,
+                                const CRBRangeTreePoint *a,
+                                size_t n_a,
+                                const CRBRangeTreePoint *b,
+                                size_t n_b) {
+        while (n_a && n_b) {
+                if (b->secondary < a->secondary) {
+                        *to++ = *b++;
+                        --n_b;
+                } else {
+                        *to++ = *a++;
+                        --n_a;
+                }
+        }
+
+        while (n_a--)
+                *to++ = *a++;
+        while (n_b--)
+                *to++ = *b++;
+}
+
+static void c_rbrangetree_build_levels(CRBRangeTree *t) {
+        CRBRangeTreePoint *from, *to;
+        size_t i, half, n_a, n_b;
+        unsigned int l;
+
+        to = c_rbrangetree_level(t, 0);
+        for (i = 0; i < t->n_indexed; ++i)
+                to[i] = (CRBRangeTreePoint){ .secondary = t->slots[i]->secondary, .slot = i };
+
+        for (l = 1; l < t->n_levels; ++l) {
+                from = c_rbrangetree_level(t, l - 1);
+                to = c_rbrangetree_level(t, l);
+                half = (size_t)1 << (l - 1);
+
+                for (i = 0; i < t->n_indexed; i += 2 * half) {
+                        n_a = t->n_indexed - i < half ? t->n_indexed - i : half;
+                        n_b = t->n_indexed - i - n_a < half ? t->n_indexed - i - n_a : half;
+                        c_rbrangetree_merge(to + i, from + i, n_a, from + i + n_a, n_b);
+                }
+        }
+}
+
+/**
+ * c_rbrangetree_init() - initialize range tree
+ * @t:                  range tree to initialize
+ *
+ * This initializes @t as an empty range tree.
+ */
+_public_ void c_rbrangetree_init(CRBRangeTree *t) {
+        assert(t);
+
+        *t = (CRBRangeTree)C_RBRANGETREE_INIT;
+}
+
+/**
+ * c_rbrangetree_deinit() - deinitialize range tree
+ * @t:                  range tree to deinitialize
+ *
+ * This releases the index of @t, and marks all its entries as unlinked.
+ * Afterwards, @t is empty and can be reused.
+ *
+ * Worst case runtime (n: number of entries): O(n)
+ */
+_public_ void c_rbrangetree_deinit(CRBRangeTree *t) {
+        CRBRangeTreeEntry *e, *safe;
+        size_t i;
+
+        assert(t);
+
+        for (i = 0; i < t->n_indexed; ++i)
+                if (t->slots[i])
+                        t->slots[i]->slot = SIZE_MAX;
+
+        c_rbtree_for_each_entry_safe_postorder_unlink(e, safe, &t->staged, rb)
+                /* nothing to do */ ;
+
+        free(t->levels);
+        free(t->keys);
+        free(t->slots);
+        c_rbrangetree_init(t);
+}
+
+/**
+ * c_rbrangetree_add() - add entry
+ * @t:                  range tree to operate on
+ * @e:                  entry to link
+ * @key:                primary key
+ * @secondary:          secondary key
+ *
+ * This links @e into @t with the given keys. Entries with equal keys are
+ * allowed. The entry is staged, and only folded into the index by a later
+ * query or rebuild. @e must not be linked.
+ *
+ * Worst case runtime (n: number of staged entries): O(log(n))
+ */
+_public_ void c_rbrangetree_add(CRBRangeTree *t, CRBRangeTreeEntry *e, uint64_t key, uint64_t secondary) {
+        CRBNode **slot, *p = NULL;
+
+        assert(t);
+        assert(e);
+        assert(!c_rbnode_is_linked(&e->rb));
+        assert(e->slot == SIZE_MAX);
+
+        e->key = key;
+        e->secondary = secondary;
+
+        slot = &t->staged.root;
+        while (*slot) {
+                p = *slot;
+                if (key < c_rbrangetree_entry_from_rb(p)->key)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbtree_add(&t->staged, p, slot, &e->rb);
+        ++t->n_staged;
+}
+
+/**
+ * c_rbrangetree_remove() - remove entry
+ * @t:                  range tree to operate on
+ * @e:                  entry to unlink
+ *
+ * This unlinks @e from @t. The entry must be linked into @t. If it is
+ * indexed, it leaves a tombstone in the index, which is dropped by the next
+ * rebuild. Either way, @e is no longer accessed by @t, and can be released or
+ * linked again.
+ *
+ * Worst case runtime (n: number of staged entries): O(log(n))
+ */
+_public_ void c_rbrangetree_remove(CRBRangeTree *t, CRBRangeTreeEntry *e) {
+        assert(t);
+        assert(e);
+
+        if (e->slot == SIZE_MAX) {
+                assert(c_rbnode_is_linked(&e->rb));
+
+                c_rbnode_unlink(&e->rb);
+                --t->n_staged;
+        } else {
+                assert(e->slot < t->n_indexed);
+                assert(t->slots[e->slot] == e);
+
+                t->slots[e->slot] = NULL;
+                e->slot = SIZE_MAX;
+                ++t->n_tombstones;
+        }
+}
+
+/**
+ * c_rbrangetree_rebuild() - rebuild index
+ * @t:                  range tree to operate on
+ *
+ * This folds all staged entries into the index of @t, and drops all
+ * tombstones. Afterwards, queries run in O(log²(n) + k) until @t is modified
+ * again. Queries call this on their own, once enough modifications piled up.
+ *
+ * Worst case runtime (n: number of entries): O(n * log(n))
+ *
+ * Return: 0 on success, -ENOMEM if allocation failed, in which case @t is
+ *         unchanged.
+ */
+_public_ int c_rbrangetree_rebuild(CRBRangeTree *t) {
+        CRBRangeTreeEntry **slots, *e, *safe;
+        CRBRangeTreePoint *levels;
+        size_t i, j, n;
+        unsigned int n_levels;
+        uint64_t *keys;
+        CRBNode *s;
+
+        assert(t);
+
+        if (!t->n_staged && !t->n_tombstones)
+                return 0;
+
+        n = t->n_indexed - t->n_tombstones + t->n_staged;
+        for (n_levels = 1; ((size_t)1 << (n_levels - 1)) < n; ++n_levels)
+                /* nothing to do */ ;
+
+        if (n) {
+                slots = malloc(n * sizeof(*slots));
+                keys = malloc(n * sizeof(*keys));
+                levels = malloc(n * n_levels * sizeof(*levels));
+                if (!slots || !keys || !levels) {
+                        free(levels);
+                        free(keys);
+                        free(slots);
+                        return -ENOMEM;
+                }
+        } else {
+                slots = NULL;
+                keys = NULL;
+                levels = NULL;
+                n_levels = 0;
+        }
+
+        /* merge the surviving slots with the staged entries, both by key */
+        s = c_rbtree_first(&t->staged);
+        for (i = 0, j = 0; j < n; ++j) {
+                while (i < t->n_indexed && !t->slots[i])
+                        ++i;
+
+                if (s && (i >= t->n_indexed || c_rbrangetree_entry_from_rb(s)->key < t->keys[i])) {
+                        e = c_rbrangetree_entry_from_rb(s);
+                        s = c_rbnode_next(s);
+                } else {
+                        e = t->slots[i++];
+                }
+
+                slots[j] = e;
+                keys[j] = e->key;
+        }
+
+        c_rbtree_for_each_entry_safe_postorder_unlink(e, safe, &t->staged, rb)
+                /* nothing to do */ ;
+
+        for (j = 0; j < n; ++j)
+                slots[j]->slot = j;
+
+        free(t->levels);
+        free(t->keys);
+        free(t->slots);
+
+        t->n_staged = 0;
+        t->n_indexed = n;
+        t->n_tombstones = 0;
+        t->n_levels = n_levels;
+        t->slots = slots;
+        t->keys = keys;
+        t->levels = levels;
+
+        c_rbrangetree_build_levels(t);
+        return 0;
+}
+
+/* Report all entries of block @i of @level with a secondary key in [@min, @max]. */
+static int c_rbrangetree_query_block(CRBRangeTree *t,
+                                     unsigned int level,
+                                     size_t i,
+                                     uint64_t min,
+                                     uint64_t max,
+                                     CRBRangeTreeFunc fn,
+                                     void *userdata) {
+        CRBRangeTreePoint *p = c_rbrangetree_level(t, level) + i;
+        size_t lo = 0, hi = (size_t)1 << level, mid;
+        CRBRangeTreeEntry *e;
+        int r;
+
+        while (lo < hi) {
+                mid = lo + (hi - lo) / 2;
+                if (p[mid].secondary < min)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        for ( ; lo < ((size_t)1 << level) && p[lo].secondary <= max; ++lo) {
+                e = t->slots[p[lo].slot];
+                if (e) {
+                        r = fn(e, userdata);
+                        if (r)
+                                return r;
+                }
+        }
+
+        return 0;
+}
+
+/**
+ * c_rbrangetree_query() - report entries within a rectangle
+ * @t:                  range tree to query
+ * @key_min:            lowest primary key to report
+ * @key_max:            highest primary key to report
+ * @secondary_min:      lowest secondary key to report
+ * @secondary_max:      highest secondary key to report
+ * @fn:                 callback to invoke for each entry
+ * @userdata:           userdata to pass to @fn
+ *
+ * This invokes @fn for each entry of @t with a primary key in [@key_min,
+ * @key_max] and a secondary key in [@secondary_min, @secondary_max]. Entries
+ * are reported in no particular order. If @fn returns non-zero, the query is
+ * stopped and that value is returned. @fn must not modify @t.
+ *
+ * If enough modifications are pending, this rebuilds the index first. If that
+ * fails, the query proceeds on the old index.
+ *
+ * Worst case runtime (n: number of entries, k: number of reported entries, s:
+ * number of staged entries in the primary range): O(log²(n) + k + s)
+ *
+ * Return: 0 if all entries were reported, otherwise the first non-zero value
+ *         returned by @fn.
+ */
+_public_ int c_rbrangetree_query(CRBRangeTree *t,
+                                 uint64_t key_min,
+                                 uint64_t key_max,
+                                 uint64_t secondary_min,
+                                 uint64_t secondary_max,
+                                 CRBRangeTreeFunc fn,
+                                 void *userdata) {
+        size_t lo, hi, l, h, mid, pending;
+        CRBRangeTreeEntry *e;
+        unsigned int level;
+        CRBNode *n, *s;
+        int r;
+
+        assert(t);
+        assert(fn);
+
+        if (key_min > key_max || secondary_min > secondary_max)
+                return 0;
+
+        pending = t->n_staged + t->n_tombstones;
+        if (pending >= C_RBRANGETREE_PENDING_MIN &&
+            pending * C_RBRANGETREE_PENDING_RATIO > t->n_indexed + t->n_staged)
+                (void)c_rbrangetree_rebuild(t);
+
+        /* find the slots [lo, hi) in the primary range */
+        for (l = 0, h = t->n_indexed; l < h; ) {
+                mid = l + (h - l) / 2;
+                if (t->keys[mid] < key_min)
+                        l = mid + 1;
+                else
+                        h = mid;
+        }
+        lo = l;
+
+        for (h = t->n_indexed; l < h; ) {
+                mid = l + (h - l) / 2;
+                if (t->keys[mid] <= key_max)
+                        l = mid + 1;
+                else
+                        h = mid;
+        }
+        hi = l;
+
+        /* split [lo, hi) into maximal aligned blocks */
+        while (lo < hi) {
+                level = lo ? (unsigned int)__builtin_ctzll(lo) : t->n_levels - 1;
+                if (level > t->n_levels - 1)
+                        level = t->n_levels - 1;
+                while (lo + ((size_t)1 << level) > hi)
+                        --level;
+
+                r = c_rbrangetree_query_block(t, level, lo, secondary_min, secondary_max, fn, userdata);
+                if (r)
+                        return r;
+
+                lo += (size_t)1 << level;
+        }
+
+        /* scan the staged entries in the primary range */
+        for (n = t->staged.root, s = NULL; n; ) {
+                if (c_rbrangetree_entry_from_rb(n)->key < key_min) {
+                        n = n->right;
+                } else {
+                        s = n;
+                        n = n->left;
+                }
+        }
+
+        for ( ; s; s = c_rbnode_next(s)) {
+                e = c_rbrangetree_entry_from_rb(s);
+                if (e->key > key_max)
+                        break;
+
+                if (e->secondary >= secondary_min && e->secondary <= secondary_max) {
+                        r = fn(e, userdata);
+                        if (r)
+                                return r;
+                }
+        }
+
+        return 0;
+}
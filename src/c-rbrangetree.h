@@ -0,0 +1,126 @@
+#pragma once
+
+/**
+ * Two-Dimensional Range Trees
+ *
+ * A range tree stores entries with a primary key and a secondary key, and
+ * reports all entries with the primary key in [a, b] and the secondary key in
+ * [c, d]. Without it, such queries are answered by a range scan over the
+ * primary key plus a filter on the secondary key, which visits every entry in
+ * the primary range, no matter how few of them match.
+ *
+ * The index is a static, balanced tree over all entries ordered by primary
+ * key. Each of its nodes keeps the entries of its subtree sorted by secondary
+ * key. A query splits [a, b] into O(log(n)) nodes and binary-searches each of
+ * them for [c, d], which takes O(log²(n) + k) for k results.
+ *
+ * Rebuilding the index costs O(n * log(n)), so modifications are applied
+ * lazily: new entries are linked into an RB-Tree of staged entries, and
+ * removed entries leave tombstones in the index. Queries scan the staged
+ * entries in the primary range in addition to the index, and rebuild the
+ * index once the staged entries and tombstones exceed a fraction of its size.
+ * This keeps updates amortized O(log(n)). Use c_rbrangetree_rebuild() to
+ * fold in all pending modifications right away.
+ *
+ * Entries are embedded in the objects of the API user, like CRBNode. The
+ * index itself is allocated by the range tree.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBRangeTree CRBRangeTree;
+typedef struct CRBRangeTreeEntry CRBRangeTreeEntry;
+typedef struct CRBRangeTreePoint CRBRangeTreePoint;
+typedef int (*CRBRangeTreeFunc) (CRBRangeTreeEntry *e, void *userdata);
+
+/**
+ * struct CRBRangeTreeEntry - range tree entry
+ * @rb:                 node in the tree of staged entries
+ * @key:                primary key
+ * @secondary:          secondary key
+ * @slot:               position in the index, or SIZE_MAX if not indexed
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBRangeTreeEntry {
+        CRBNode rb;
+        uint64_t key;
+        uint64_t secondary;
+        size_t slot;
+};
+
+#define C_RBRANGETREE_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb), .slot = SIZE_MAX }
+
+/**
+ * struct CRBRangeTreePoint - secondary key of an indexed entry
+ * @secondary:          secondary key
+ * @slot:               position in the index
+ *
+ * This is an internal type of the index.
+ */
+struct CRBRangeTreePoint {
+        uint64_t secondary;
+        size_t slot;
+};
+
+/**
+ * struct CRBRangeTree - range tree
+ * @staged:             entries linked since the last rebuild, ordered by key
+ * @n_staged:           number of staged entries
+ * @n_indexed:          number of slots in the index, including tombstones
+ * @n_tombstones:       number of slots of removed entries
+ * @n_levels:           number of levels in the index
+ * @slots:              indexed entries ordered by key, or NULL for tombstones
+ * @keys:               primary keys of all slots
+ * @levels:             per level, all slots sorted by secondary key within
+ *                      blocks of 2^level slots
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBRangeTree {
+        CRBTree staged;
+        size_t n_staged;
+        size_t n_indexed;
+        size_t n_tombstones;
+        unsigned int n_levels;
+        CRBRangeTreeEntry **slots;
+        uint64_t *keys;
+        CRBRangeTreePoint *levels;
+};
+
+#define C_RBRANGETREE_INIT {}
+
+void c_rbrangetree_init(CRBRangeTree *t);
+void c_rbrangetree_deinit(CRBRangeTree *t);
+
+void c_rbrangetree_add(CRBRangeTree *t, CRBRangeTreeEntry *e, uint64_t key, uint64_t secondary);
+void c_rbrangetree_remove(CRBRangeTree *t, CRBRangeTreeEntry *e);
+int c_rbrangetree_rebuild(CRBRangeTree *t);
+
+int c_rbrangetree_query(CRBRangeTree *t,
+                        uint64_t key_min,
+                        uint64_t key_max,
+                        uint64_t secondary_min,
+                        uint64_t secondary_max,
+                        CRBRangeTreeFunc fn,
+                        void *userdata);
+
+/**
+ * c_rbrangetree_is_empty() - check whether a range tree is empty
+ * @t:                  range tree to operate on
+ *
+ * Return: True if the tree is empty, false otherwise.
+ */
+static inline _Bool c_rbrangetree_is_empty(CRBRangeTree *t) {
+        return !t->n_staged && t->n_indexed == t->n_tombstones;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Threaded Trees
+ * This implements threaded trees on top of an RB-Tree, with all entries also
+ * linked into a doubly-linked list in tree order. New entries are always
+ * linked as leaves, so their in-order neighbours are their parent, plus the
+ * neighbour of their parent on the other side. Rebalancing never changes the
+ * in-order sequence, hence the list needs no fixups on rotations.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "c-rbthreaded.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rbthreaded_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBThreadedEntry, rb)
+
+/**
+ * c_rbthreaded_add() - link entry
+ * @t:                  tree to operate on
+ * @p:                  parent node to link under, or NULL
+ * @l:                  slot to link the entry into
+ * @e:                  entry to link
+ *
+ * This links @e into @t, just like c_rbtree_add() links a node. @p and @l
+ * are usually retrieved via c_rbtree_find_slot() on @t->tree. Additionally,
+ * @e is linked into the list of entries, next to @p.
+ *
+ * Worst case runtime (n: number of entries in tree): O(log(n))
+ */
+_public_ void c_rbthreaded_add(CRBThreaded *t, CRBNode *p, CRBNode **l, CRBThreadedEntry *e) {
+        CRBThreadedEntry *parent;
+
+        assert(t);
+        assert(l);
+        assert(e);
+
+        if (!p) {
+                e->prev = NULL;
+                e->next = NULL;
+        } else if (l == &p->left) {
+                parent = c_rbthreaded_entry_from_rb(p);
+                e->prev = parent->prev;
+                e->next = parent;
+        } else {
+                parent = c_rbthreaded_entry_from_rb(p);
+                e->prev = parent;
+                e->next = parent->next;
+        }
+
+        if (e->prev)
+                e->prev->next = e;
+        else
+                t->first = e;
+
+        if (e->next)
+                e->next->prev = e;
+        else
+                t->last = e;
+
+        c_rbtree_add(&t->tree, p, l, &e->rb);
+}
+
+/**
+ * c_rbthreaded_remove() - unlink entry
+ * @t:                  tree to operate on
+ * @e:                  entry to unlink
+ *
+ * This unlinks @e from @t. The entry must be linked into @t. Afterwards, it
+ * is marked as unlinked, and can be released or linked again.
+ *
+ * Worst case runtime (n: number of entries in tree): O(log(n))
+ */
+_public_ void c_rbthreaded_remove(CRBThreaded *t, CRBThreadedEntry *e) {
+        assert(t);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        if (e->prev)
+                e->prev->next = e->next;
+        else
+                t->first = e->next;
+
+        if (e->next)
+                e->next->prev = e->prev;
+        else
+                t->last = e->prev;
+
+        e->prev = NULL;
+        e->next = NULL;
+        c_rbnode_unlink(&e->rb);
+}
+
+/**
+ * c_rbthreaded_find() - find entry
+ * @t:                  tree to search through
+ * @f:                  comparison function
+ * @k:                  key to search for
+ *
+ * This searches @t for an entry that compares equal to @k, just like
+ * c_rbtree_find_node() does.
+ *
+ * Worst case runtime (n: number of entries in tree): O(log(n))
+ *
+ * Return: Pointer to the matching entry, or NULL.
+ */
+_public_ CRBThreadedEntry *c_rbthreaded_find(CRBThreaded *t, CRBCompareFunc f, const void *k) {
+        assert(t);
+        assert(f);
+
+        return c_rbthreaded_entry_from_rb(c_rbtree_find_node(&t->tree, f, k));
+}
+
+/**
+ * c_rbthreaded_lower_bound() - find first entry not ordering before a key
+ * @t:                  tree to search through
+ * @f:                  comparison function
+ * @k:                  key to search for
+ *
+ * This searches @t for the first entry that does not order before @k. That
+ * is, the first entry that compares equal to @k, or if there is none, the
+ * first entry that orders after @k. This is the starting point of range
+ * scans, which then follow c_rbthreaded_next().
+ *
+ * Worst case runtime (n: number of entries in tree): O(log(n))
+ *
+ * Return: Pointer to the entry, or NULL if all entries order before @k.
+ */
+_public_ CRBThreadedEntry *c_rbthreaded_lower_bound(CRBThreaded *t, CRBCompareFunc f, const void *k) {
+        CRBNode *i, *res = NULL;
+
+        assert(t);
+        assert(f);
+
+        i = t->tree.root;
+        while (i) {
+                if (f(&t->tree, (void *)k, i) <= 0) {
+                        res = i;
+                        i = i->left;
+                } else {
+                        i = i->right;
+                }
+        }
+
+        return c_rbthreaded_entry_from_rb(res);
+}
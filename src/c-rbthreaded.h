@@ -0,0 +1,161 @@
+#pragma once
+
+/**
+ * Threaded Trees
+ *
+ * A threaded tree is an RB-Tree whose entries are additionally linked into a
+ * doubly-linked list, in tree order. The tree is used for lookups and to find
+ * the position of new entries. In-order iteration, however, follows the list:
+ * each step to the next or previous entry is a single pointer load, rather
+ * than a climb through parent pointers, which c_rbnode_next() needs for up to
+ * O(log(n)) steps. Range scans thus cost one lookup for the start, plus one
+ * pointer load per entry.
+ *
+ * The list is maintained on link and unlink in O(1): a new entry is always
+ * linked next to its parent in the tree, so its list neighbours are known
+ * without further searching. The price is two extra pointers per entry, and
+ * two extra stores to neighbouring entries on each modification.
+ *
+ * Entries are embedded in the objects of the API user, like CRBNode. Keys are
+ * compared via CRBCompareFunc, and slots for new entries are found via
+ * c_rbtree_find_slot() on the underlying tree. The API performs no memory
+ * allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "c-rbtree.h"
+
+typedef struct CRBThreaded CRBThreaded;
+typedef struct CRBThreadedEntry CRBThreadedEntry;
+
+/**
+ * struct CRBThreadedEntry - entry of a threaded tree
+ * @rb:                 node in the tree
+ * @prev:               previous entry in tree order, or NULL
+ * @next:               next entry in tree order, or NULL
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBThreadedEntry {
+        CRBNode rb;
+        CRBThreadedEntry *prev;
+        CRBThreadedEntry *next;
+};
+
+#define C_RBTHREADED_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb) }
+
+/**
+ * struct CRBThreaded - threaded tree
+ * @tree:               tree of all entries
+ * @first:              first entry in tree order, or NULL
+ * @last:               last entry in tree order, or NULL
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBThreaded {
+        CRBTree tree;
+        CRBThreadedEntry *first;
+        CRBThreadedEntry *last;
+};
+
+#define C_RBTHREADED_INIT {}
+
+void c_rbthreaded_add(CRBThreaded *t, CRBNode *p, CRBNode **l, CRBThreadedEntry *e);
+void c_rbthreaded_remove(CRBThreaded *t, CRBThreadedEntry *e);
+
+CRBThreadedEntry *c_rbthreaded_find(CRBThreaded *t, CRBCompareFunc f, const void *k);
+CRBThreadedEntry *c_rbthreaded_lower_bound(CRBThreaded *t, CRBCompareFunc f, const void *k);
+
+/**
+ * c_rbthreaded_init() - initialize threaded tree
+ * @t:                  tree to initialize
+ *
+ * This initializes @t as an empty threaded tree.
+ */
+static inline void c_rbthreaded_init(CRBThreaded *t) {
+        *t = (CRBThreaded)C_RBTHREADED_INIT;
+}
+
+/**
+ * c_rbthreaded_is_empty() - check whether a threaded tree is empty
+ * @t:                  tree to operate on
+ *
+ * Return: True if the tree is empty, false otherwise.
+ */
+static inline _Bool c_rbthreaded_is_empty(CRBThreaded *t) {
+        return !t->first;
+}
+
+/**
+ * c_rbthreaded_first() - return first entry
+ * @t:                  tree to query
+ *
+ * Fixed runtime (n: number of entries in tree): O(1)
+ *
+ * Return: Pointer to the first entry in tree order, or NULL if @t is empty.
+ */
+static inline CRBThreadedEntry *c_rbthreaded_first(CRBThreaded *t) {
+        return t->first;
+}
+
+/**
+ * c_rbthreaded_last() - return last entry
+ * @t:                  tree to query
+ *
+ * Fixed runtime (n: number of entries in tree): O(1)
+ *
+ * Return: Pointer to the last entry in tree order, or NULL if @t is empty.
+ */
+static inline CRBThreadedEntry *c_rbthreaded_last(CRBThreaded *t) {
+        return t->last;
+}
+
+/**
+ * c_rbthreaded_next() - return next entry
+ * @e:                  current entry, which must be linked
+ *
+ * Fixed runtime (n: number of entries in tree): O(1)
+ *
+ * Return: Pointer to the next entry in tree order, or NULL if @e is the last.
+ */
+static inline CRBThreadedEntry *c_rbthreaded_next(CRBThreadedEntry *e) {
+        return e->next;
+}
+
+/**
+ * c_rbthreaded_prev() - return previous entry
+ * @e:                  current entry, which must be linked
+ *
+ * Fixed runtime (n: number of entries in tree): O(1)
+ *
+ * Return: Pointer to the previous entry in tree order, or NULL if @e is the
+ *         first.
+ */
+static inline CRBThreadedEntry *c_rbthreaded_prev(CRBThreadedEntry *e) {
+        return e->prev;
+}
+
+/**
+ * c_rbthreaded_for_each*() - iterators
+ *
+ * These iterate all entries of a threaded tree in order, following the list
+ * rather than the tree. The "safe" flavour keeps track of the next entry,
+ * so the current one can be removed from within the loop.
+ */
+#define c_rbthreaded_for_each(_iter, _t)                                                                \
+        for (_iter = (_t)->first;                                                                       \
+             _iter;                                                                                     \
+             _iter = _iter->next)
+
+#define c_rbthreaded_for_each_safe(_iter, _safe, _t)                                                    \
+        for (_iter = (_t)->first, _safe = _iter ? _iter->next : NULL;                                   \
+             _iter;                                                                                     \
+             _iter = _safe, _safe = _safe ? _safe->next : NULL)
+
+#ifdef __cplusplus
+}
+#endif
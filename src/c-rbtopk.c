@@ -0,0 +1,123 @@
+/*
+ * Top-K Selection
+ * This implements bounded top-k containers on top of an RB-Tree, with a cached
+ * pointer to the leftmost node. Nodes that compare equal are linked to the
+ * right of each other, so the cached minimum is always the leftmost of equal
+ * nodes, and a candidate equal to the minimum never displaces it.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "c-rbtopk.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+static void c_rbtopk_link(CRBTopk *t, CRBNode *n) {
+        CRBNode **slot = &t->tree.root, *p = NULL;
+
+        while (*slot) {
+                p = *slot;
+                if (t->compare(n, p) < 0)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbtree_add(&t->tree, p, slot, n);
+        ++t->n_nodes;
+
+        if (!t->min || t->compare(n, t->min) < 0)
+                t->min = n;
+}
+
+/**
+ * c_rbtopk_init() - initialize top-k container
+ * @t:                  container to initialize
+ * @compare:            comparison function
+ * @k:                  maximum number of nodes
+ *
+ * This initializes @t as an empty container, which keeps the @k largest
+ * nodes by the order of @compare. @k must not be 0.
+ */
+_public_ void c_rbtopk_init(CRBTopk *t, CRBTopkCompareFunc compare, size_t k) {
+        assert(t);
+        assert(compare);
+        assert(k > 0);
+
+        *t = (CRBTopk)C_RBTOPK_INIT(compare, k);
+}
+
+/**
+ * c_rbtopk_push() - offer candidate
+ * @t:                  container to operate on
+ * @n:                  candidate node
+ *
+ * This offers @n to @t. If @t is not full, @n is linked. Otherwise, if @n
+ * does not order after the current minimum, it is rejected in O(1), and if it
+ * does, it replaces the minimum. @n must not be linked.
+ *
+ * Worst case runtime (k: maximum number of nodes): O(log(k))
+ *
+ * Return: NULL if @n was linked without eviction, the evicted minimum if @n
+ *         replaced it, or @n itself if it was rejected. In the latter two
+ *         cases, the returned node is unlinked and can be released.
+ */
+_public_ CRBNode *c_rbtopk_push(CRBTopk *t, CRBNode *n) {
+        CRBNode *min, *next;
+
+        assert(t);
+        assert(n);
+
+        if (t->n_nodes < t->k) {
+                c_rbtopk_link(t, n);
+                return NULL;
+        }
+
+        min = t->min;
+        if (t->compare(n, min) <= 0)
+                return n;
+
+        /*
+         * The minimum has no left child, so its successor is either its
+         * right child, or its parent. If @n still sorts before it, @n simply
+         * takes the place of the minimum.
+         */
+        next = c_rbnode_next(min);
+        if (!next || t->compare(n, next) <= 0) {
+                c_rbnode_replace(min, n);
+                t->min = n;
+                return min;
+        }
+
+        c_rbnode_unlink(min);
+        --t->n_nodes;
+        t->min = next;
+        c_rbtopk_link(t, n);
+        return min;
+}
+
+/**
+ * c_rbtopk_remove() - remove node
+ * @t:                  container to operate on
+ * @n:                  node to unlink
+ *
+ * This unlinks @n from @t. The node must be linked into @t. Afterwards, it is
+ * marked as unlinked, and can be released or pushed again.
+ *
+ * Worst case runtime (k: maximum number of nodes): O(log(k))
+ */
+_public_ void c_rbtopk_remove(CRBTopk *t, CRBNode *n) {
+        assert(t);
+        assert(n);
+        assert(c_rbnode_is_linked(n));
+
+        if (n == t->min)
+                t->min = c_rbnode_next(n);
+
+        c_rbnode_unlink(n);
+        --t->n_nodes;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+/**
+ * Top-K Selection
+ *
+ * A top-k container keeps the k largest nodes of a stream of candidates, by
+ * the order of a comparison function. It is an RB-Tree bounded to k nodes,
+ * plus a cached pointer to its minimum, which is the threshold a candidate
+ * has to beat once the container is full:
+ *
+ *   o Candidates that do not exceed the threshold are rejected in O(1),
+ *     without touching the tree. In long streams, this is the common case.
+ *
+ *   o Candidates that exceed it replace the minimum. If the candidate still
+ *     sorts below the second-smallest node, it takes the place of the minimum
+ *     in O(1), via c_rbnode_replace(). Otherwise, the minimum is unlinked,
+ *     which never needs more than O(1) amortized rebalancing for the leftmost
+ *     node, and the candidate is linked.
+ *
+ * For bottom-k selection, use an inverted comparison function.
+ *
+ * Nodes are embedded in the objects of the API user. The API performs no
+ * memory allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "c-rbtree.h"
+
+typedef struct CRBTopk CRBTopk;
+
+/**
+ * CRBTopkCompareFunc - compare two nodes
+ * @a:          node to compare
+ * @b:          node to compare to
+ *
+ * Return: <0 if @a orders before @b, 0 if both compare equal, and >0 if @a
+ *         orders after @b.
+ */
+typedef int (*CRBTopkCompareFunc) (CRBNode *a, CRBNode *b);
+
+/**
+ * struct CRBTopk - top-k container
+ * @compare:            comparison function
+ * @k:                  maximum number of nodes
+ * @n_nodes:            number of linked nodes
+ * @min:                smallest linked node, or NULL
+ * @tree:               tree of all linked nodes
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBTopk {
+        CRBTopkCompareFunc compare;
+        size_t k;
+        size_t n_nodes;
+        CRBNode *min;
+        CRBTree tree;
+};
+
+#define C_RBTOPK_INIT(_compare, _k) { .compare = (_compare), .k = (_k) }
+
+void c_rbtopk_init(CRBTopk *t, CRBTopkCompareFunc compare, size_t k);
+
+CRBNode *c_rbtopk_push(CRBTopk *t, CRBNode *n);
+void c_rbtopk_remove(CRBTopk *t, CRBNode *n);
+
+/**
+ * c_rbtopk_min() - return smallest node
+ * @t:                  container to query
+ *
+ * Once @t is full, this is the threshold candidates have to exceed.
+ *
+ * Return: Pointer to the smallest node, or NULL if @t is empty.
+ */
+static inline CRBNode *c_rbtopk_min(CRBTopk *t) {
+        return t->min;
+}
+
+/**
+ * c_rbtopk_is_full() - check whether a top-k container is full
+ * @t:                  container to query
+ *
+ * Return: True if @t holds k nodes, false otherwise.
+ */
+static inline _Bool c_rbtopk_is_full(CRBTopk *t) {
+        return t->n_nodes >= t->k;
+}
+
+#ifdef __cplusplus
+}
+#endif
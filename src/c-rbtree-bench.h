@@ -0,0 +1,197 @@
+#pragma once
+
+/*
+ * Benchmark Helpers
+ * This file contains helpers for the benchmarks of our test-suite. Apart from
+ * measuring CPU time, they sample hardware performance counters via
+ * perf_event_open(2), so benchmarks can tell whether a change reduced cache
+ * misses, TLB misses, or branch mispredictions, rather than just its runtime.
+ *
+ * Hardware counters are optional. If the kernel, the CPU, or the sandbox we run
+ * in does not provide a counter, it is silently skipped and reported as
+ * unavailable. Set CRBTREE_TEST_PERF=0 to disable counters altogether.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+enum {
+        C_RBBENCH_CYCLES,
+        C_RBBENCH_INSTRUCTIONS,
+        C_RBBENCH_L1D_MISSES,
+        C_RBBENCH_LLC_MISSES,
+        C_RBBENCH_DTLB_MISSES,
+        C_RBBENCH_BRANCH_MISSES,
+        _C_RBBENCH_N,
+};
+
+typedef struct CRBBench {
+        int fds[_C_RBBENCH_N];
+} CRBBench;
+
+typedef struct CRBBenchSample {
+        uint64_t ns;
+        uint64_t counters[_C_RBBENCH_N];
+        bool valid[_C_RBBENCH_N];
+} CRBBenchSample;
+
+static const struct {
+        const char *name;
+        uint32_t type;
+        uint64_t config;
+} c_rbbench_events[_C_RBBENCH_N] = {
+        [C_RBBENCH_CYCLES] = {
+                "cycles",
+                PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_CPU_CYCLES,
+        },
+        [C_RBBENCH_INSTRUCTIONS] = {
+                "instr",
+                PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_INSTRUCTIONS,
+        },
+        [C_RBBENCH_L1D_MISSES] = {
+                "L1d-miss",
+                PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_L1D |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        },
+        [C_RBBENCH_LLC_MISSES] = {
+                "LLC-miss",
+                PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_CACHE_MISSES,
+        },
+        [C_RBBENCH_DTLB_MISSES] = {
+                "dTLB-miss",
+                PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        },
+        [C_RBBENCH_BRANCH_MISSES] = {
+                "br-miss",
+                PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_BRANCH_MISSES,
+        },
+};
+
+static inline uint64_t c_rbbench_now(void) {
+        struct timespec ts;
+        int r;
+
+        r = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        assert(r >= 0);
+        return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+static inline void c_rbbench_init(CRBBench *b) {
+        struct perf_event_attr attr;
+        const char *e;
+        unsigned int i;
+
+        for (i = 0; i < _C_RBBENCH_N; ++i)
+                b->fds[i] = -1;
+
+        e = getenv("CRBTREE_TEST_PERF");
+        if (e && !strcmp(e, "0"))
+                return;
+
+        for (i = 0; i < _C_RBBENCH_N; ++i) {
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = c_rbbench_events[i].type;
+                attr.config = c_rbbench_events[i].config;
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                /* failures are fine, the counter is reported as unavailable */
+                b->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+}
+
+static inline void c_rbbench_deinit(CRBBench *b) {
+        unsigned int i;
+
+        for (i = 0; i < _C_RBBENCH_N; ++i) {
+                if (b->fds[i] >= 0)
+                        close(b->fds[i]);
+                b->fds[i] = -1;
+        }
+}
+
+static inline void c_rbbench_start(CRBBench *b, CRBBenchSample *s) {
+        unsigned int i;
+
+        for (i = 0; i < _C_RBBENCH_N; ++i) {
+                if (b->fds[i] >= 0) {
+                        ioctl(b->fds[i], PERF_EVENT_IOC_RESET, 0);
+                        ioctl(b->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+                }
+        }
+
+        s->ns = c_rbbench_now();
+}
+
+static inline void c_rbbench_stop(CRBBench *b, CRBBenchSample *s) {
+        uint64_t v[3];
+        unsigned int i;
+        ssize_t l;
+
+        s->ns = c_rbbench_now() - s->ns;
+
+        for (i = 0; i < _C_RBBENCH_N; ++i) {
+                s->counters[i] = 0;
+                s->valid[i] = false;
+
+                if (b->fds[i] < 0)
+                        continue;
+
+                ioctl(b->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                l = read(b->fds[i], v, sizeof(v));
+                if (l != sizeof(v) || !v[2])
+                        continue;
+
+                /* scale up, in case the counter was multiplexed */
+                s->counters[i] = (v[1] == v[2]) ? v[0] : (uint64_t)((double)v[0] * v[1] / v[2]);
+                s->valid[i] = true;
+        }
+}
+
+static inline void c_rbbench_print_header(const char *title) {
+        unsigned int i;
+
+        fprintf(stderr, "%-32s %10s", title, "ns/op");
+        for (i = 0; i < _C_RBBENCH_N; ++i)
+                fprintf(stderr, " %10s", c_rbbench_events[i].name);
+        fprintf(stderr, "\n");
+}
+
+static inline void c_rbbench_print(const char *name, const CRBBenchSample *s, uint64_t n_ops) {
+        unsigned int i;
+
+        if (!n_ops)
+                n_ops = 1;
+
+        fprintf(stderr, "%-32s %10.2f", name, (double)s->ns / n_ops);
+        for (i = 0; i < _C_RBBENCH_N; ++i) {
+                if (s->valid[i])
+                        fprintf(stderr, " %10.2f", (double)s->counters[i] / n_ops);
+                else
+                        fprintf(stderr, " %10s", "n/a");
+        }
+        fprintf(stderr, "\n");
+}
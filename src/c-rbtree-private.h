@@ -38,3 +38,10 @@ static inline _Bool c_rbnode_is_black(CRBNode *n) {
 static inline _Bool c_rbnode_is_root(CRBNode *n) {
         return c_rbnode_flags(n) & C_RBNODE_ROOT;
 }
+
+/*
+ * Chains
+ */
+
+CRBNode *c_rbtree_detach_chain(CRBTree *t, size_t *n_nodesp);
+void c_rbtree_attach_chain(CRBTree *t, CRBNode *chain, size_t n_nodes);
@@ -25,7 +25,9 @@
 
 #include <assert.h>
 #include <stdalign.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "c-rbtree-private.h"
 #include "c-rbtree.h"
@@ -343,6 +345,168 @@ _public_ CRBNode *c_rbtree_last_postorder(CRBTree *t) {
         return t->root;
 }
 
+static inline void c_rbnode_prefetch(CRBNode *n) {
+#if defined(__GNUC__)
+        __builtin_prefetch(n);
+#endif
+}
+
+/**
+ * c_rbtree_iter_fill() - retrieve next batch of nodes
+ * @iter:       iterator to operate on
+ * @out:        output array for node pointers
+ * @n_out:      number of entries in @out
+ *
+ * This stores the next @n_out nodes of the in-order traversal of @iter in
+ * @out, and advances @iter past them. If fewer than @n_out nodes are left,
+ * only those are stored.
+ *
+ * Unlike a loop over c_rbnode_next(), this does not interleave tree traversal
+ * with the work of the caller. Furthermore, whenever the traversal descends
+ * into a subtree, the right children along the descent are prefetched, since
+ * the traversal will visit them later on. This overlaps the memory latency of
+ * the traversal with the traversal itself.
+ *
+ * Nodes must not be linked or unlinked between calls on the same iterator,
+ * unless @iter->next is reset afterwards.
+ *
+ * Worst case runtime (n: number of elements in tree): O(n_out + log(n))
+ *
+ * Return: Number of nodes stored in @out, 0 if the traversal is done.
+ */
+_public_ size_t c_rbtree_iter_fill(CRBIter *iter, CRBNode **out, size_t n_out) {
+        CRBNode *n, *p;
+        size_t i;
+
+        assert(iter);
+        assert(out || !n_out);
+
+        n = iter->next;
+        for (i = 0; n && i < n_out; ++i) {
+                out[i] = n;
+
+                if (n->right) {
+                        n = n->right;
+                        for (;;) {
+                                if (n->right)
+                                        c_rbnode_prefetch(n->right);
+                                if (!n->left)
+                                        break;
+                                n = n->left;
+                        }
+                } else {
+                        while ((p = c_rbnode_parent(n)) && n == p->right)
+                                n = p;
+                        n = p;
+                }
+        }
+
+        iter->next = n;
+        return i;
+}
+
+static void c_rbtree_find_group(CRBTree *t,
+                                CRBCompareFunc f,
+                                CRBCompareBatchFunc fb,
+                                void **keys,
+                                CRBNode **nodes,
+                                size_t n_keys) {
+        void *active_keys[C_RBTREE_BATCH_MAX];
+        CRBNode *active_nodes[C_RBTREE_BATCH_MAX], *n;
+        int results[C_RBTREE_BATCH_MAX];
+        size_t active[C_RBTREE_BATCH_MAX], i, j, n_active = 0;
+
+        for (i = 0; i < n_keys; ++i) {
+                nodes[i] = NULL;
+                if (t->root) {
+                        active[n_active] = i;
+                        active_keys[n_active] = keys[i];
+                        active_nodes[n_active] = t->root;
+                        ++n_active;
+                }
+        }
+
+        while (n_active) {
+                if (fb) {
+                        fb(t, active_keys, active_nodes, results, n_active);
+                } else {
+                        for (i = 0; i < n_active; ++i)
+                                results[i] = f(t, active_keys[i], active_nodes[i]);
+                }
+
+                /*
+                 * Advance all lookups by one level, and compact the ones that
+                 * are still in flight. The next node of each lookup is
+                 * prefetched, so the loads of the whole group overlap, rather
+                 * than each lookup waiting on its own cache misses in turn.
+                 */
+                for (i = 0, j = 0; i < n_active; ++i) {
+                        if (!results[i]) {
+                                nodes[active[i]] = active_nodes[i];
+                                continue;
+                        }
+
+                        n = (results[i] < 0) ? active_nodes[i]->left : active_nodes[i]->right;
+                        if (!n)
+                                continue;
+
+                        c_rbnode_prefetch(n);
+                        active[j] = active[i];
+                        active_keys[j] = active_keys[i];
+                        active_nodes[j] = n;
+                        ++j;
+                }
+
+                n_active = j;
+        }
+}
+
+/**
+ * c_rbtree_find_batch() - find nodes for a batch of keys
+ * @t:          tree to search through
+ * @f:          comparison function, or NULL
+ * @fb:         batch comparison function, or NULL
+ * @keys:       keys to search for
+ * @nodes:      output array for the matching nodes
+ * @n_keys:     number of keys
+ *
+ * This searches through @t for a node that compares equal to each of the
+ * @n_keys keys in @keys, just like c_rbtree_find_node() does, and stores the
+ * result of the lookup of @keys[i] in @nodes[i]. That is, a pointer to the
+ * matching node, or NULL.
+ *
+ * Rather than descending the tree once per key, the lookups are run in groups
+ * of up to C_RBTREE_BATCH_MAX keys, which descend the tree in lockstep, one
+ * level at a time. The nodes of the next level are prefetched for the whole
+ * group, so independent cache misses overlap.
+ *
+ * If @fb is provided, it is called once per level for the whole group.
+ * Otherwise, @f is called for each lookup still in flight. At least one of
+ * both must be provided.
+ *
+ * Worst case runtime (n: number of elements in tree): O(n_keys * log(n))
+ */
+_public_ void c_rbtree_find_batch(CRBTree *t,
+                                  CRBCompareFunc f,
+                                  CRBCompareBatchFunc fb,
+                                  void **keys,
+                                  CRBNode **nodes,
+                                  size_t n_keys) {
+        size_t n;
+
+        assert(t);
+        assert(f || fb);
+        assert((keys && nodes) || !n_keys);
+
+        while (n_keys) {
+                n = (n_keys < C_RBTREE_BATCH_MAX) ? n_keys : C_RBTREE_BATCH_MAX;
+                c_rbtree_find_group(t, f, fb, keys, nodes, n);
+                keys += n;
+                nodes += n;
+                n_keys -= n;
+        }
+}
+
 static inline void c_rbtree_store(CRBNode **ptr, CRBNode *addr) {
         /*
          * We use volatile accesses whenever we STORE @left or @right members
@@ -441,6 +605,30 @@ static inline void c_rbnode_swap_child(CRBNode *old, CRBNode *new) {
         }
 }
 
+/*
+ * Augmented trees store a value in each node, that is computed from the node
+ * itself and the values of its children. Whenever the children of a node
+ * change, its value must be recomputed, and so must the values of all its
+ * ancestors, until a value does not change.
+ *
+ * All internal helpers take an optional augment-callback, which is NULL for
+ * non-augmented trees. Since all those helpers are inlined, the compiler drops
+ * the augmentation paths entirely for the non-augmented API.
+ *
+ * Tree rotations never change the set of nodes below the rotated subtree, so
+ * they only need to recompute the two rotated nodes, the lower one first.
+ */
+static inline void c_rbnode_augment(CRBNode *n, CRBAugmentFunc f) {
+        if (f)
+                f(n);
+}
+
+static inline void c_rbnode_augment_path(CRBNode *n, CRBAugmentFunc f) {
+        if (f)
+                while (n && f(n))
+                        n = c_rbnode_parent(n);
+}
+
 /**
  * c_rbtree_move() - move tree
  * @to:         destination tree
@@ -468,7 +656,7 @@ _public_ void c_rbtree_move(CRBTree *to, CRBTree *from) {
         }
 }
 
-static inline void c_rbtree_paint_terminal(CRBNode *n) {
+static inline void c_rbtree_paint_terminal(CRBNode *n, CRBAugmentFunc f) {
         CRBNode *p, *g, *gg, *x;
         CRBTree *t;
 
@@ -507,6 +695,8 @@ static inline void c_rbtree_paint_terminal(CRBNode *n) {
                         if (x)
                                 c_rbnode_set_parent_and_flags(x, p, c_rbnode_flags(x));
                         c_rbnode_set_parent_and_flags(p, n, c_rbnode_flags(p));
+                        c_rbnode_augment(p, f);
+                        c_rbnode_augment(n, f);
                         p = n;
                 }
 
@@ -536,6 +726,8 @@ static inline void c_rbtree_paint_terminal(CRBNode *n) {
                 c_rbnode_set_parent_and_flags(p, gg, c_rbnode_flags(p) & ~C_RBNODE_RED);
                 c_rbnode_set_parent_and_flags(g, p, c_rbnode_flags(g) | C_RBNODE_RED);
                 c_rbnode_push_root(p, t);
+                c_rbnode_augment(g, f);
+                c_rbnode_augment(p, f);
         } else /* if (p == g->right) */ { /* same as above, but mirrored */
                 if (n == p->left) {
                         x = n->right;
@@ -544,6 +736,8 @@ static inline void c_rbtree_paint_terminal(CRBNode *n) {
                         if (x)
                                 c_rbnode_set_parent_and_flags(x, p, c_rbnode_flags(x));
                         c_rbnode_set_parent_and_flags(p, n, c_rbnode_flags(p));
+                        c_rbnode_augment(p, f);
+                        c_rbnode_augment(n, f);
                         p = n;
                 }
 
@@ -557,6 +751,8 @@ static inline void c_rbtree_paint_terminal(CRBNode *n) {
                 c_rbnode_set_parent_and_flags(p, gg, c_rbnode_flags(p) & ~C_RBNODE_RED);
                 c_rbnode_set_parent_and_flags(g, p, c_rbnode_flags(g) | C_RBNODE_RED);
                 c_rbnode_push_root(p, t);
+                c_rbnode_augment(g, f);
+                c_rbnode_augment(p, f);
         }
 }
 
@@ -616,7 +812,7 @@ static inline CRBNode *c_rbtree_paint_path(CRBNode *n) {
         }
 }
 
-static inline void c_rbtree_paint(CRBNode *n) {
+static inline void c_rbtree_paint(CRBNode *n, CRBAugmentFunc f) {
         /*
          * When a new node is inserted into an RB-Tree, we always link it as a
          * tail-node and paint it red. This way, the node will not violate the
@@ -653,7 +849,7 @@ static inline void c_rbtree_paint(CRBNode *n) {
          */
         n = c_rbtree_paint_path(n);
         if (n)
-                c_rbtree_paint_terminal(n);
+                c_rbtree_paint_terminal(n, f);
 }
 
 /**
@@ -684,7 +880,30 @@ _public_ void c_rbnode_link(CRBNode *p, CRBNode **l, CRBNode *n) {
         c_rbtree_store(&n->right, NULL);
         c_rbtree_store(l, n);
 
-        c_rbtree_paint(n);
+        c_rbtree_paint(n, NULL);
+}
+
+static inline void c_rbtree_add_internal(CRBTree *t, CRBNode *p, CRBNode **l, CRBNode *n, CRBAugmentFunc f) {
+        assert(t);
+        assert(l);
+        assert(n);
+        assert(!p || l == &p->left || l == &p->right);
+        assert(p || l == &t->root);
+
+        c_rbnode_set_parent_and_flags(n, p, C_RBNODE_RED);
+        c_rbtree_store(&n->left, NULL);
+        c_rbtree_store(&n->right, NULL);
+
+        if (p)
+                c_rbtree_store(l, n);
+        else
+                c_rbnode_push_root(n, t);
+
+        /* compute the new leaf, then all ancestors that gained it */
+        c_rbnode_augment(n, f);
+        c_rbnode_augment_path(p, f);
+
+        c_rbtree_paint(n, f);
 }
 
 /**
@@ -739,25 +958,29 @@ _public_ void c_rbnode_link(CRBNode *p, CRBNode **l, CRBNode *n) {
  * node is unlinked before you call c_rbtree_add().
  */
 _public_ void c_rbtree_add(CRBTree *t, CRBNode *p, CRBNode **l, CRBNode *n) {
-        assert(t);
-        assert(l);
-        assert(n);
-        assert(!p || l == &p->left || l == &p->right);
-        assert(p || l == &t->root);
-
-        c_rbnode_set_parent_and_flags(n, p, C_RBNODE_RED);
-        c_rbtree_store(&n->left, NULL);
-        c_rbtree_store(&n->right, NULL);
+        c_rbtree_add_internal(t, p, l, n, NULL);
+}
 
-        if (p)
-                c_rbtree_store(l, n);
-        else
-                c_rbnode_push_root(n, t);
+/**
+ * c_rbtree_add_augmented() - add node to augmented tree
+ * @t:          tree to operate one
+ * @p:          parent node to link under, or NULL
+ * @l:          left/right slot of @p (or root) to link at
+ * @n:          node to add
+ * @f:          augment callback
+ *
+ * This is the same as c_rbtree_add(), but additionally maintains the
+ * augmented values of all nodes via @f. See CRBAugmentFunc for details.
+ *
+ * Worst case runtime (n: number of elements in tree): O(log(n))
+ */
+_public_ void c_rbtree_add_augmented(CRBTree *t, CRBNode *p, CRBNode **l, CRBNode *n, CRBAugmentFunc f) {
+        assert(f);
 
-        c_rbtree_paint(n);
+        c_rbtree_add_internal(t, p, l, n, f);
 }
 
-static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous) {
+static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous, CRBAugmentFunc f) {
         CRBNode *s, *x, *y, *g;
         CRBTree *t;
 
@@ -780,6 +1003,8 @@ static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous) {
                         c_rbnode_set_parent_and_flags(s, g, c_rbnode_flags(s) & ~C_RBNODE_RED);
                         c_rbnode_set_parent_and_flags(p, s, c_rbnode_flags(p) | C_RBNODE_RED);
                         c_rbnode_push_root(s, t);
+                        c_rbnode_augment(p, f);
+                        c_rbnode_augment(s, f);
                         s = x;
                 }
 
@@ -813,6 +1038,8 @@ static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous) {
                         c_rbtree_store(&p->right, y);
                         if (x)
                                 c_rbnode_set_parent_and_flags(x, s, c_rbnode_flags(x) & ~C_RBNODE_RED);
+                        c_rbnode_augment(s, f);
+                        c_rbnode_augment(y, f);
                         x = s;
                         s = y;
                 }
@@ -835,6 +1062,8 @@ static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous) {
                 c_rbnode_set_parent_and_flags(s, g, c_rbnode_flags(p));
                 c_rbnode_set_parent_and_flags(p, s, c_rbnode_flags(p) & ~C_RBNODE_RED);
                 c_rbnode_push_root(s, t);
+                c_rbnode_augment(p, f);
+                c_rbnode_augment(s, f);
         } else /* if (previous == p->right) */ { /* same as above, but mirrored */
                 s = p->left;
                 if (c_rbnode_is_red(s)) {
@@ -848,6 +1077,8 @@ static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous) {
                         c_rbnode_set_parent_and_flags(s, g, c_rbnode_flags(s) & ~C_RBNODE_RED);
                         c_rbnode_set_parent_and_flags(p, s, c_rbnode_flags(p) | C_RBNODE_RED);
                         c_rbnode_push_root(s, t);
+                        c_rbnode_augment(p, f);
+                        c_rbnode_augment(s, f);
                         s = x;
                 }
 
@@ -867,6 +1098,8 @@ static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous) {
                         c_rbtree_store(&p->left, y);
                         if (x)
                                 c_rbnode_set_parent_and_flags(x, s, c_rbnode_flags(x) & ~C_RBNODE_RED);
+                        c_rbnode_augment(s, f);
+                        c_rbnode_augment(y, f);
                         x = s;
                         s = y;
                 }
@@ -883,6 +1116,8 @@ static inline void c_rbnode_rebalance_terminal(CRBNode *p, CRBNode *previous) {
                 c_rbnode_set_parent_and_flags(s, g, c_rbnode_flags(p));
                 c_rbnode_set_parent_and_flags(p, s, c_rbnode_flags(p) & ~C_RBNODE_RED);
                 c_rbnode_push_root(s, t);
+                c_rbnode_augment(p, f);
+                c_rbnode_augment(s, f);
         }
 }
 
@@ -936,7 +1171,7 @@ static inline CRBNode *c_rbnode_rebalance_path(CRBNode *p, CRBNode **previous) {
         return NULL;
 }
 
-static inline void c_rbnode_rebalance(CRBNode *n) {
+static inline void c_rbnode_rebalance(CRBNode *n, CRBAugmentFunc f) {
         CRBNode *previous = NULL;
 
         /*
@@ -949,20 +1184,10 @@ static inline void c_rbnode_rebalance(CRBNode *n) {
 
         n = c_rbnode_rebalance_path(n, &previous);
         if (n)
-                c_rbnode_rebalance_terminal(n, previous);
+                c_rbnode_rebalance_terminal(n, previous, f);
 }
 
-/**
- * c_rbnode_unlink_stale() - remove node from tree
- * @n:          node to remove
- *
- * This removes the given node from its tree. Once unlinked, the tree is
- * rebalanced.
- *
- * This does *NOT* reset @n to being unlinked. If you need this, use
- * c_rbtree_unlink().
- */
-_public_ void c_rbnode_unlink_stale(CRBNode *n) {
+static inline void c_rbnode_unlink_internal(CRBNode *n, CRBAugmentFunc f) {
         CRBTree *t;
 
         assert(n);
@@ -996,9 +1221,10 @@ _public_ void c_rbnode_unlink_stale(CRBNode *n) {
                 t = c_rbnode_pop_root(n);
                 c_rbnode_swap_child(n, NULL);
                 c_rbnode_push_root(NULL, t);
+                c_rbnode_augment_path(c_rbnode_parent(n), f);
 
                 if (c_rbnode_is_black(n))
-                        c_rbnode_rebalance(c_rbnode_parent(n));
+                        c_rbnode_rebalance(c_rbnode_parent(n), f);
         } else if (!n->left && n->right) {
                 /*
                  * Case 1.1:
@@ -1014,6 +1240,7 @@ _public_ void c_rbnode_unlink_stale(CRBNode *n) {
                 c_rbnode_swap_child(n, n->right);
                 c_rbnode_set_parent_and_flags(n->right, c_rbnode_parent(n), c_rbnode_flags(n->right) & ~C_RBNODE_RED);
                 c_rbnode_push_root(n->right, t);
+                c_rbnode_augment_path(c_rbnode_parent(n), f);
         } else if (n->left && !n->right) {
                 /*
                  * Case 1.2:
@@ -1025,8 +1252,9 @@ _public_ void c_rbnode_unlink_stale(CRBNode *n) {
                 c_rbnode_swap_child(n, n->left);
                 c_rbnode_set_parent_and_flags(n->left, c_rbnode_parent(n), c_rbnode_flags(n->left) & ~C_RBNODE_RED);
                 c_rbnode_push_root(n->left, t);
+                c_rbnode_augment_path(c_rbnode_parent(n), f);
         } else /* if (n->left && n->right) */ {
-                CRBNode *s, *p, *c, *next = NULL;
+                CRBNode *s, *p, *c, *x, *next = NULL;
 
                 /* Cache possible tree-root during tree-rotations. */
                 t = c_rbnode_pop_root(n);
@@ -1112,7 +1340,914 @@ _public_ void c_rbnode_unlink_stale(CRBNode *n) {
                 /* Possibly restore saved tree-root. */
                 c_rbnode_push_root(s, t);
 
+                /*
+                 * All nodes from the old parent of the successor up to its
+                 * new position lost the successor. The successor itself got
+                 * new children, so it must be recomputed even if all nodes
+                 * below were unaffected. Above it, all nodes lost @n.
+                 */
+                if (f) {
+                        for (x = p; x != s && f(x); x = c_rbnode_parent(x))
+                                ;
+                        f(s);
+                        c_rbnode_augment_path(c_rbnode_parent(s), f);
+                }
+
                 if (next)
-                        c_rbnode_rebalance(next);
+                        c_rbnode_rebalance(next, f);
+        }
+}
+
+/**
+ * c_rbnode_unlink_stale() - remove node from tree
+ * @n:          node to remove
+ *
+ * This removes the given node from its tree. Once unlinked, the tree is
+ * rebalanced.
+ *
+ * This does *NOT* reset @n to being unlinked. If you need this, use
+ * c_rbtree_unlink().
+ */
+_public_ void c_rbnode_unlink_stale(CRBNode *n) {
+        c_rbnode_unlink_internal(n, NULL);
+}
+
+/**
+ * c_rbnode_unlink_stale_augmented() - remove node from augmented tree
+ * @n:          node to remove
+ * @f:          augment callback
+ *
+ * This is the same as c_rbnode_unlink_stale(), but additionally maintains the
+ * augmented values of all remaining nodes via @f. See CRBAugmentFunc for
+ * details.
+ *
+ * Worst case runtime (n: number of elements in tree): O(log(n))
+ */
+_public_ void c_rbnode_unlink_stale_augmented(CRBNode *n, CRBAugmentFunc f) {
+        assert(f);
+
+        c_rbnode_unlink_internal(n, f);
+}
+
+/**
+ * c_rbnode_propagate() - update augmented values of node and its ancestors
+ * @n:          node that changed
+ * @f:          augment callback
+ *
+ * If the API user changes the data of a linked node, which its augmented value
+ * is computed from, this must be called to recompute the augmented value of
+ * @n, and all its ancestors. Propagation stops at the first node whose value
+ * did not change.
+ *
+ * Worst case runtime (n: number of elements in tree): O(log(n))
+ */
+_public_ void c_rbnode_propagate(CRBNode *n, CRBAugmentFunc f) {
+        assert(n);
+        assert(f);
+
+        c_rbnode_augment_path(n, f);
+}
+
+/**
+ * c_rbnode_replace() - replace node in place
+ * @old:        linked node to replace
+ * @n:          unlinked node to take its place
+ *
+ * This links @n into the tree of @old at exactly the position of @old, with
+ * the same colour and children, and marks @old as unlinked. No other node is
+ * moved, and no rebalancing is needed. The caller must make sure @n sorts
+ * between the neighbours of @old, or the tree is left unordered. Only the
+ * node links and flags are copied. Augmented values are not copied, since
+ * they live in the objects embedding the nodes, so @n keeps whatever value
+ * it had before. In augmented trees, the caller must either copy the value
+ * itself, or call c_rbnode_propagate() on @n afterwards.
+ *
+ * Fixed runtime: O(1)
+ */
+_public_ void c_rbnode_replace(CRBNode *old, CRBNode *n) {
+        assert(old);
+        assert(n);
+        assert(c_rbnode_is_linked(old));
+        assert(old != n);
+
+        n->left = old->left;
+        n->right = old->right;
+        n->__parent_and_flags = old->__parent_and_flags;
+
+        if (n->left)
+                c_rbnode_set_parent_and_flags(n->left, n, c_rbnode_flags(n->left));
+        if (n->right)
+                c_rbnode_set_parent_and_flags(n->right, n, c_rbnode_flags(n->right));
+
+        if (c_rbnode_is_root(old))
+                c_rbtree_store(&((CRBTree *)c_rbnode_raw(old))->root, n);
+        else
+                c_rbnode_swap_child(old, n);
+
+        c_rbnode_init(old);
+}
+
+static CRBNode *c_rbtree_build_subtree(CRBNode **chain, size_t n_nodes, unsigned int depth, unsigned int n_black) {
+        CRBNode *n, *l, *r;
+        size_t n_left;
+
+        if (!n_nodes)
+                return NULL;
+
+        /*
+         * Split the range in half, with the right side getting the spare node
+         * on even sizes. Both halves thus differ in size by at most one,
+         * which guarantees that all leaf paths of the resulting tree differ in
+         * length by at most one as well. The left half must be built first,
+         * since it precedes @n in the chain.
+         */
+        n_left = (n_nodes - 1) / 2;
+
+        l = c_rbtree_build_subtree(chain, n_left, depth + 1, n_black);
+
+        n = *chain;
+        *chain = n->left;
+
+        r = c_rbtree_build_subtree(chain, n_nodes - n_left - 1, depth + 1, n_black);
+
+        /*
+         * All levels up to @n_black are complete, so they are painted black.
+         * Only the last level can be incomplete. We paint it red, so all
+         * paths contain the same number of black nodes. Red nodes are always
+         * leaves, so they never have red children.
+         */
+        c_rbnode_set_parent_and_flags(n, NULL, (depth > n_black) ? C_RBNODE_RED : 0);
+        c_rbtree_store(&n->left, l);
+        c_rbtree_store(&n->right, r);
+        if (l)
+                c_rbnode_set_parent_and_flags(l, n, c_rbnode_flags(l));
+        if (r)
+                c_rbnode_set_parent_and_flags(r, n, c_rbnode_flags(r));
+
+        return n;
+}
+
+/*
+ * Bulk operations temporarily thread nodes into singly-linked chains, sorted by
+ * their in-order position. The @left pointer of each node is re-used as link,
+ * all other fields of chained nodes are undefined.
+ *
+ * c_rbtree_detach_chain() turns a tree into such a chain, leaving the tree
+ * empty. It works in-place: an in-order walk never looks at the @left pointer
+ * of nodes it already visited, so we can overwrite them as we go.
+ *
+ * c_rbtree_attach_chain() is the reverse operation. It builds a balanced tree
+ * out of the @n_nodes first nodes of a chain, without any comparisons or
+ * rotations.
+ *
+ * Both run in O(n) time and need no memory but O(log(n)) stack.
+ */
+CRBNode *c_rbtree_detach_chain(CRBTree *t, size_t *n_nodesp) {
+        CRBNode *n, *next, *chain;
+        size_t n_nodes = 0;
+
+        assert(t);
+
+        chain = c_rbtree_first(t);
+        for (n = chain; n; n = next) {
+                next = c_rbnode_next(n);
+                n->left = next;
+                ++n_nodes;
         }
+
+        t->root = NULL;
+        if (n_nodesp)
+                *n_nodesp = n_nodes;
+        return chain;
+}
+
+void c_rbtree_attach_chain(CRBTree *t, CRBNode *chain, size_t n_nodes) {
+        unsigned int n_black = 0;
+        CRBNode *root;
+
+        assert(t);
+        assert(!t->root);
+
+        while ((n_nodes + 1) >> (n_black + 1))
+                ++n_black;
+
+        root = c_rbtree_build_subtree(&chain, n_nodes, 1, n_black);
+        c_rbnode_push_root(root, t);
+}
+
+/**
+ * c_rbtree_build() - build tree from sorted nodes
+ * @t:          tree to operate on
+ * @nodes:      array of nodes to link, in ascending order
+ * @n_nodes:    number of nodes in @nodes
+ *
+ * This links all nodes in @nodes into the empty tree @t. The nodes must be
+ * sorted by the order of the tree, the first node in @nodes will be the first
+ * node of @t.
+ *
+ * Unlike repeated calls to c_rbtree_add(), this does neither compare, nor
+ * rotate any node. The nodes are linked as a balanced tree, with all but the
+ * lowest level of the tree painted black. The memory contents of the nodes
+ * do not matter, they can be uninitialized.
+ *
+ * The array @nodes is only accessed during this call. The caller is free to
+ * release or re-use it afterwards.
+ *
+ * Fixed runtime (n: number of elements in tree): O(n)
+ */
+_public_ void c_rbtree_build(CRBTree *t, CRBNode **nodes, size_t n_nodes) {
+        size_t i;
+
+        assert(t);
+        assert(!t->root);
+        assert(nodes || !n_nodes);
+
+        for (i = 0; i + 1 < n_nodes; ++i)
+                nodes[i]->left = nodes[i + 1];
+
+        c_rbtree_attach_chain(t, n_nodes ? nodes[0] : NULL, n_nodes);
+}
+
+/*
+ * Weighted builds link a range of nodes as a subtree with a given black-height
+ * @b, that is, the number of black nodes on each path from its root to a leaf,
+ * including the root if it is black. With a black root, such a subtree holds
+ * between 2^b-1 nodes (all black, perfect) and 4^b-1 nodes (alternating
+ * levels of red and black, perfect). With a red root, it holds two black
+ * subtrees of the same black-height, plus the root.
+ *
+ * Within these bounds, the root of each subtree can be picked freely. We pick
+ * the weighted median of the range, clamped such that both children stay
+ * within the bounds of their black-height. If the root may be red or black,
+ * we pick the colour that allows the root closest to the weighted median.
+ */
+static bool c_rbtree_weighted_bounds(size_t n_nodes, unsigned int b, bool red, size_t *minp, size_t *maxp) {
+        uint64_t min, max;
+
+        if (!n_nodes)
+                return !b && !red;
+        if (!red && !b)
+                return false;
+
+        /* bounds on the size of each child */
+        if (red) {
+                min = ((uint64_t)1 << b) - 1;
+                max = ((uint64_t)1 << (2 * b)) - 1;
+        } else {
+                min = ((uint64_t)1 << (b - 1)) - 1;
+                max = ((uint64_t)2 << (2 * (b - 1))) - 1;
+        }
+
+        if (n_nodes - 1 < 2 * min || n_nodes - 1 > 2 * max)
+                return false;
+
+        /* bounds on the size of the left child, given the right one */
+        *minp = (n_nodes - 1 > min + max) ? n_nodes - 1 - max : min;
+        *maxp = (n_nodes - 1 - min < max) ? n_nodes - 1 - min : max;
+        return true;
+}
+
+static size_t c_rbtree_weighted_median(const size_t *weights, size_t n_nodes) {
+        uint64_t sum = 0, acc = 0;
+        size_t i;
+
+        for (i = 0; i < n_nodes; ++i)
+                sum += weights[i];
+        if (!sum)
+                return (n_nodes - 1) / 2;
+
+        for (i = 0; i + 1 < n_nodes; ++i) {
+                acc += weights[i];
+                if (2 * acc >= sum)
+                        break;
+        }
+
+        return i;
+}
+
+static size_t c_rbtree_weighted_clamp(size_t median, size_t min, size_t max) {
+        return (median < min) ? min : (median > max) ? max : median;
+}
+
+static size_t c_rbtree_weighted_distance(size_t median, size_t min, size_t max) {
+        size_t v = c_rbtree_weighted_clamp(median, min, max);
+
+        return (v > median) ? v - median : median - v;
+}
+
+static CRBNode *c_rbtree_build_weighted_subtree(CRBNode **nodes,
+                                                const size_t *weights,
+                                                size_t n_nodes,
+                                                unsigned int b,
+                                                bool may_be_red) {
+        size_t median, min, max, red_min, red_max, n_left;
+        CRBNode *n, *l, *r;
+        bool black, red;
+
+        black = c_rbtree_weighted_bounds(n_nodes, b, false, &min, &max);
+        red = may_be_red && c_rbtree_weighted_bounds(n_nodes, b, true, &red_min, &red_max);
+        assert(black || red);
+
+        if (!n_nodes)
+                return NULL;
+
+        median = c_rbtree_weighted_median(weights, n_nodes);
+        if (red && (!black || c_rbtree_weighted_distance(median, red_min, red_max) <
+                              c_rbtree_weighted_distance(median, min, max))) {
+                black = false;
+                min = red_min;
+                max = red_max;
+        } else {
+                red = false;
+        }
+
+        n_left = c_rbtree_weighted_clamp(median, min, max);
+
+        /* red nodes have black children of the same black-height */
+        l = c_rbtree_build_weighted_subtree(nodes, weights, n_left, red ? b : b - 1, black);
+        r = c_rbtree_build_weighted_subtree(nodes + n_left + 1,
+                                            weights + n_left + 1,
+                                            n_nodes - n_left - 1,
+                                            red ? b : b - 1,
+                                            black);
+
+        n = nodes[n_left];
+        c_rbnode_set_parent_and_flags(n, NULL, red ? C_RBNODE_RED : 0);
+        c_rbtree_store(&n->left, l);
+        c_rbtree_store(&n->right, r);
+        if (l)
+                c_rbnode_set_parent_and_flags(l, n, c_rbnode_flags(l));
+        if (r)
+                c_rbnode_set_parent_and_flags(r, n, c_rbnode_flags(r));
+
+        return n;
+}
+
+/**
+ * c_rbtree_build_weighted() - build tree from sorted, weighted nodes
+ * @t:          tree to operate on
+ * @nodes:      array of nodes to link, in ascending order
+ * @weights:    array of node weights
+ * @n_nodes:    number of nodes in @nodes and @weights
+ *
+ * This links all nodes in @nodes into the empty tree @t, just like
+ * c_rbtree_build() does. However, rather than a balanced tree, this builds a
+ * tree where heavy nodes are placed closer to the root, where @weights[i] is
+ * the weight of @nodes[i]. Typically, weights are access counts, and the
+ * caller periodically rebuilds the tree from them, so frequently accessed
+ * nodes are found with fewer comparisons on skewed lookup distributions.
+ *
+ * The result is a valid RB-Tree, and can be modified like any other tree. The
+ * root of each subtree is the weighted median of its nodes, clamped such that
+ * the red-black invariants can still be met. Hence, no path is longer than
+ * in any other RB-Tree of the same size, regardless of the weights. The sum of
+ * all weights must not exceed UINT64_MAX / 2.
+ *
+ * The arrays are only accessed during this call. The caller is free to
+ * release or re-use them afterwards.
+ *
+ * Worst case runtime (n: number of elements in tree): O(n log(n))
+ */
+_public_ void c_rbtree_build_weighted(CRBTree *t, CRBNode **nodes, const size_t *weights, size_t n_nodes) {
+        size_t median, min, max, distance, best_distance = SIZE_MAX;
+        unsigned int b, best_b = 0;
+        CRBNode *root;
+
+        assert(t);
+        assert(!t->root);
+        assert((nodes && weights) || !n_nodes);
+
+        if (!n_nodes)
+                return;
+
+        /*
+         * The black-height of the root is up to us. Pick the one that allows
+         * the root closest to the weighted median, preferring lower ones,
+         * since they bound the height of the tree more tightly.
+         */
+        median = c_rbtree_weighted_median(weights, n_nodes);
+        for (b = 1; ((uint64_t)1 << b) - 1 <= n_nodes; ++b) {
+                if (!c_rbtree_weighted_bounds(n_nodes, b, false, &min, &max))
+                        continue;
+
+                distance = c_rbtree_weighted_distance(median, min, max);
+                if (distance < best_distance) {
+                        best_distance = distance;
+                        best_b = b;
+                }
+        }
+
+        root = c_rbtree_build_weighted_subtree(nodes, weights, n_nodes, best_b, false);
+        c_rbnode_push_root(root, t);
+}
+
+static int c_rbtree_clone_node(CRBNode *n, CRBNode *p, CRBNode **copyp, CRBCloneFunc f, void *userdata) {
+        CRBNode *c = NULL;
+        int r;
+
+        r = f(n, &c, userdata);
+        if (r)
+                return r;
+
+        assert(c);
+
+        c->left = NULL;
+        c->right = NULL;
+        c_rbnode_set_parent_and_flags(c, p, c_rbnode_flags(n) & ~C_RBNODE_ROOT);
+
+        c_rbtree_store(copyp, c);
+        return 0;
+}
+
+/**
+ * c_rbtree_clone() - copy tree with identical shape
+ * @to:         empty tree to link the copies into
+ * @from:       tree to copy
+ * @f:          callback to create each copy
+ * @userdata:   userdata to pass to @f
+ *
+ * This walks @from once, calls @f to create a copy of each node, and links the
+ * copies into @to with exactly the same shape and colours as in @from. Nodes
+ * are copied in pre-order, each parent before its children. No comparisons
+ * and no rebalancing are performed, and no memory but the copies is needed.
+ *
+ * If @f fails, the walk stops and the error is returned. In that case, @to
+ * contains all copies created so far, linked as a partial copy of @from that
+ * is not a valid RB-Tree. It must only be torn down via one of the
+ * c_rbtree_for_each*_postorder_unlink() iterators.
+ *
+ * Fixed runtime (n: number of elements in tree): O(n)
+ *
+ * Return: 0 on success, otherwise the first error returned by @f.
+ */
+_public_ int c_rbtree_clone(CRBTree *to, CRBTree *from, CRBCloneFunc f, void *userdata) {
+        CRBNode *n, *c;
+        int r;
+
+        assert(to);
+        assert(!to->root);
+        assert(from);
+        assert(f);
+
+        n = from->root;
+        if (!n)
+                return 0;
+
+        r = c_rbtree_clone_node(n, NULL, &c, f, userdata);
+        if (r)
+                return r;
+
+        c_rbnode_push_root(c, to);
+
+        /*
+         * Walk both trees in parallel. A child of @n still needs to be copied
+         * if the matching child of @c is still NULL. Once both children are
+         * done, move up, until we are back at the root.
+         */
+        for (;;) {
+                if (n->left && !c->left) {
+                        r = c_rbtree_clone_node(n->left, c, &c->left, f, userdata);
+                        if (r)
+                                return r;
+
+                        n = n->left;
+                        c = c->left;
+                } else if (n->right && !c->right) {
+                        r = c_rbtree_clone_node(n->right, c, &c->right, f, userdata);
+                        if (r)
+                                return r;
+
+                        n = n->right;
+                        c = c->right;
+                } else if (c == to->root) {
+                        break;
+                } else {
+                        n = c_rbnode_parent(n);
+                        c = c_rbnode_parent(c);
+                }
+        }
+
+        return 0;
+}
+
+/**
+ * c_rbtree_visit() - search tree, skipping subtrees
+ * @t:          tree to search
+ * @descend:    callback to decide whether to search a subtree, or NULL
+ * @visit:      callback to call for each searched node
+ * @userdata:   userdata to pass to the callbacks
+ *
+ * This searches @t in order, and calls @visit for each node of every subtree
+ * for which @descend returned true. If @descend returns false for a subtree,
+ * none of its nodes are visited, and the search continues after it. If
+ * @descend is NULL, every node is visited.
+ *
+ * Each step moves onto a node that is visited, or was visited already, and
+ * @descend is called at most twice per visited node. So, if @descend rejects
+ * all subtrees without a match, only the matches and their ancestors are
+ * visited, which is O(log(n) + k) for searches of k nodes in a key range.
+ *
+ * No recursion is used, nor any stack. The search follows the parent pointers
+ * back up, so it runs in constant space. If @visit returns non-zero, the
+ * search stops immediately, and the value is returned.
+ *
+ * Worst case runtime (k: number of visited nodes): O(k + 1)
+ *
+ * Return: 0 if all searched nodes were visited, otherwise the first non-zero
+ *         value returned by @visit.
+ */
+_public_ int c_rbtree_visit(CRBTree *t, CRBDescendFunc descend, CRBVisitFunc visit, void *userdata) {
+        CRBNode *n, *p;
+        int r;
+
+        assert(t);
+        assert(visit);
+
+        n = t->root;
+        if (!n || (descend && !descend(n, userdata)))
+                return 0;
+
+        for (;;) {
+                /* every node we step onto was accepted by @descend */
+                while (n->left && (!descend || descend(n->left, userdata)))
+                        n = n->left;
+
+                for (;;) {
+                        r = visit(n, userdata);
+                        if (r)
+                                return r;
+
+                        if (n->right && (!descend || descend(n->right, userdata))) {
+                                n = n->right;
+                                break;
+                        }
+
+                        /* move up past all subtrees we finished from the right */
+                        while ((p = c_rbnode_parent(n)) && n == p->right)
+                                n = p;
+                        if (!p)
+                                return 0;
+
+                        n = p;
+                }
+        }
+}
+
+enum {
+        C_RBTREE_STEP_TEARDOWN,
+        C_RBTREE_STEP_BUILD,
+        C_RBTREE_STEP_RETAIN,
+};
+
+enum {
+        C_RBTREE_STEP_PHASE_WALK,
+        C_RBTREE_STEP_PHASE_LINK,
+        C_RBTREE_STEP_PHASE_DONE,
+};
+
+static void c_rbtree_step_init(CRBStep *s, CRBTree *t, unsigned int op) {
+        s->target = t;
+        c_rbtree_init(&s->tree);
+        s->op = op;
+        s->phase = C_RBTREE_STEP_PHASE_WALK;
+        s->keep = NULL;
+        s->release = NULL;
+        s->userdata = NULL;
+        s->next = NULL;
+        s->chain = NULL;
+        s->chain_tail = &s->chain;
+        s->nodes = NULL;
+        s->n_nodes = 0;
+        s->n_removed = 0;
+        s->n_black = 0;
+        s->n_frames = 0;
+}
+
+static void c_rbtree_step_push(CRBStep *s, size_t n_nodes) {
+        assert(s->n_frames < C_RBTREE_STEP_DEPTH_MAX);
+
+        s->frames[s->n_frames].n_nodes = n_nodes;
+        s->frames[s->n_frames].node = NULL;
+        s->frames[s->n_frames].left = NULL;
+        s->frames[s->n_frames].stage = 0;
+        ++s->n_frames;
+}
+
+static void c_rbtree_step_start_link(CRBStep *s) {
+        s->n_black = 0;
+        while ((s->n_nodes + 1) >> (s->n_black + 1))
+                ++s->n_black;
+
+        s->next = NULL;
+        s->phase = C_RBTREE_STEP_PHASE_LINK;
+        if (s->n_nodes)
+                c_rbtree_step_push(s, s->n_nodes);
+}
+
+/*
+ * Resumable operations link nodes exactly like c_rbtree_build_subtree(), but
+ * replace the recursion with an explicit stack of frames, so linking can stop
+ * after any node, and continue later. Each frame builds one subtree: stage 0
+ * builds its left subtree, stage 1 takes its root from the array or chain and
+ * builds its right subtree, and stage 2 links the root. Right subtrees are
+ * linked to their parent as soon as they are done, left subtrees are kept in
+ * the frame until the parent root is known. The depth of a frame is its index
+ * on the stack, plus one.
+ */
+static size_t c_rbtree_step_link(CRBStep *s, size_t budget) {
+        CRBNode *n, *l;
+        size_t n_left;
+
+        while (s->n_frames) {
+                n_left = (s->frames[s->n_frames - 1].n_nodes - 1) / 2;
+
+                switch (s->frames[s->n_frames - 1].stage) {
+                case 0:
+                        s->frames[s->n_frames - 1].stage = 1;
+                        if (n_left)
+                                c_rbtree_step_push(s, n_left);
+                        break;
+                case 1:
+                        if (!budget)
+                                return 0;
+                        --budget;
+
+                        if (s->nodes) {
+                                n = *s->nodes++;
+                        } else {
+                                n = s->chain;
+                                s->chain = n->left;
+                        }
+
+                        n->right = NULL;
+                        s->frames[s->n_frames - 1].node = n;
+                        s->frames[s->n_frames - 1].stage = 2;
+                        if (s->frames[s->n_frames - 1].n_nodes - n_left - 1)
+                                c_rbtree_step_push(s, s->frames[s->n_frames - 1].n_nodes - n_left - 1);
+                        break;
+                default:
+                        n = s->frames[s->n_frames - 1].node;
+                        l = s->frames[s->n_frames - 1].left;
+
+                        c_rbnode_set_parent_and_flags(n, NULL, (s->n_frames > s->n_black) ? C_RBNODE_RED : 0);
+                        c_rbtree_store(&n->left, l);
+                        if (l)
+                                c_rbnode_set_parent_and_flags(l, n, c_rbnode_flags(l));
+
+                        if (!--s->n_frames) {
+                                s->next = n;
+                        } else if (s->frames[s->n_frames - 1].stage == 1) {
+                                s->frames[s->n_frames - 1].left = n;
+                        } else {
+                                c_rbtree_store(&s->frames[s->n_frames - 1].node->right, n);
+                                c_rbnode_set_parent_and_flags(n, s->frames[s->n_frames - 1].node, c_rbnode_flags(n));
+                        }
+                        break;
+                }
+        }
+
+        assert(!s->target->root);
+        c_rbnode_push_root(s->next, s->target);
+        s->next = NULL;
+        s->phase = C_RBTREE_STEP_PHASE_DONE;
+        return budget;
+}
+
+static size_t c_rbtree_step_teardown_walk(CRBStep *s, size_t budget) {
+        CRBNode *n;
+
+        /*
+         * The postorder successor of a node only depends on its parent, and
+         * parents are visited after their children, so each node can be
+         * marked as unlinked right after we computed its successor.
+         */
+        while (s->next && budget) {
+                --budget;
+
+                n = s->next;
+                s->next = c_rbnode_next_postorder(n);
+                c_rbnode_init(n);
+                ++s->n_removed;
+                if (s->release)
+                        s->release(n, s->userdata);
+        }
+
+        if (!s->next) {
+                s->tree.root = NULL;
+                s->phase = C_RBTREE_STEP_PHASE_DONE;
+        }
+
+        return budget;
+}
+
+static size_t c_rbtree_step_retain_walk(CRBStep *s, size_t budget) {
+        CRBNode *n, *p;
+        _Bool is_right;
+
+        /*
+         * Thread kept nodes into a chain, just like c_rbtree_detach_chain()
+         * does. The in-order walk never looks at the @left pointer of a node
+         * it already passed, so we can overwrite them as we go. Removed nodes
+         * point @left at themselves instead, which no chained node ever does.
+         *
+         * A node is finished once the walk leaves it for good, that is, when
+         * it has no right subtree, or when we climb back up out of it. Only
+         * then is a removed node released, since the walk still needs the
+         * parent pointers of all nodes it might climb past.
+         */
+        while (s->next && budget) {
+                --budget;
+
+                n = s->next;
+                if (s->keep(n, s->userdata)) {
+                        *s->chain_tail = n;
+                        s->chain_tail = &n->left;
+                        ++s->n_nodes;
+                } else {
+                        n->left = n;
+                        ++s->n_removed;
+                }
+
+                if (n->right) {
+                        s->next = c_rbnode_leftmost(n->right);
+                        continue;
+                }
+
+                for (;;) {
+                        p = c_rbnode_parent(n);
+                        is_right = p && n == p->right;
+
+                        if (n->left == n) {
+                                c_rbnode_init(n);
+                                if (s->release)
+                                        s->release(n, s->userdata);
+                        }
+
+                        if (!is_right)
+                                break;
+                        n = p;
+                }
+
+                s->next = p;
+        }
+
+        if (!s->next) {
+                *s->chain_tail = NULL;
+                s->tree.root = NULL;
+                c_rbtree_step_start_link(s);
+        }
+
+        return budget;
+}
+
+/**
+ * c_rbtree_step_teardown() - prepare resumable teardown
+ * @s:          operation object to initialize
+ * @t:          tree to tear down
+ * @release:    callback to release each node, or NULL
+ * @userdata:   userdata to pass to @release
+ *
+ * This initializes @s to unlink all nodes of @t in post-order, and pass each
+ * to @release, like the c_rbtree_for_each*_postorder_unlink() iterators do.
+ * The nodes are detached right away, so @t is empty from now on, and can be
+ * used as usual. The teardown itself is performed by c_rbtree_step_run().
+ *
+ * Fixed runtime: O(1)
+ */
+_public_ void c_rbtree_step_teardown(CRBStep *s, CRBTree *t, CRBReleaseFunc release, void *userdata) {
+        assert(s);
+        assert(t);
+
+        c_rbtree_step_init(s, NULL, C_RBTREE_STEP_TEARDOWN);
+        s->release = release;
+        s->userdata = userdata;
+
+        c_rbtree_move(&s->tree, t);
+        s->next = c_rbtree_first_postorder(&s->tree);
+}
+
+/**
+ * c_rbtree_step_build() - prepare resumable build
+ * @s:          operation object to initialize
+ * @t:          empty tree to build
+ * @nodes:      array of nodes to link, in ascending order
+ * @n_nodes:    number of nodes in @nodes
+ *
+ * This initializes @s to link all nodes in @nodes into @t, with the same
+ * shape as c_rbtree_build() does. The build itself is performed by
+ * c_rbtree_step_run(), and @t stays empty until it finished. Neither @t nor
+ * @nodes must be modified until then.
+ *
+ * Fixed runtime: O(1)
+ */
+_public_ void c_rbtree_step_build(CRBStep *s, CRBTree *t, CRBNode **nodes, size_t n_nodes) {
+        assert(s);
+        assert(t);
+        assert(!t->root);
+        assert(nodes || !n_nodes);
+
+        c_rbtree_step_init(s, t, C_RBTREE_STEP_BUILD);
+        s->nodes = nodes;
+        s->n_nodes = n_nodes;
+        c_rbtree_step_start_link(s);
+}
+
+/**
+ * c_rbtree_step_retain() - prepare resumable retain
+ * @s:          operation object to initialize
+ * @t:          tree to operate on
+ * @keep:       callback to decide whether to keep a node
+ * @release:    callback to release removed nodes, or NULL
+ * @userdata:   userdata to pass to the callbacks
+ *
+ * This initializes @s to perform c_rbtree_retain() on @t. The nodes are
+ * detached right away, so @t appears empty, until c_rbtree_step_run() finished
+ * and linked all kept nodes back into @t. Nodes must not be added to @t until
+ * then. The callbacks are called from c_rbtree_step_run().
+ *
+ * Fixed runtime: O(1)
+ */
+_public_ void c_rbtree_step_retain(CRBStep *s, CRBTree *t, CRBRetainFunc keep, CRBReleaseFunc release, void *userdata) {
+        assert(s);
+        assert(t);
+        assert(keep);
+
+        c_rbtree_step_init(s, t, C_RBTREE_STEP_RETAIN);
+        s->keep = keep;
+        s->release = release;
+        s->userdata = userdata;
+
+        c_rbtree_move(&s->tree, t);
+        s->next = c_rbtree_first(&s->tree);
+}
+
+/**
+ * c_rbtree_step_run() - perform step of resumable operation
+ * @s:          operation to run
+ * @budget:     maximum number of nodes to process, at least 1
+ *
+ * This continues the operation @s, and stops after @budget nodes were
+ * processed, or once the operation finished. Processing a node takes
+ * constant time, apart from an occasional O(log(n)) walk up or down the tree.
+ * A teardown processes each node once, a build links each node once, and a
+ * retain processes each node once, and then links each kept node once.
+ *
+ * Once the operation finished, further calls do nothing. The operation
+ * object needs no cleanup.
+ *
+ * Worst case runtime (n: number of elements in tree, k: @budget):
+ *     O(k + log(n))
+ *
+ * Return: True if the operation finished, false if more steps are needed.
+ */
+_public_ _Bool c_rbtree_step_run(CRBStep *s, size_t budget) {
+        assert(s);
+        assert(budget > 0);
+
+        if (s->phase == C_RBTREE_STEP_PHASE_WALK) {
+                if (s->op == C_RBTREE_STEP_TEARDOWN)
+                        budget = c_rbtree_step_teardown_walk(s, budget);
+                else
+                        budget = c_rbtree_step_retain_walk(s, budget);
+        }
+
+        if (s->phase == C_RBTREE_STEP_PHASE_LINK)
+                c_rbtree_step_link(s, budget);
+
+        return s->phase == C_RBTREE_STEP_PHASE_DONE;
+}
+
+/**
+ * c_rbtree_retain() - remove all nodes not matching a predicate
+ * @t:          tree to operate on
+ * @keep:       callback to decide whether to keep a node
+ * @release:    callback to release removed nodes, or NULL
+ * @userdata:   userdata to pass to the callbacks
+ *
+ * This calls @keep for each node of @t, in order, and removes all nodes it
+ * rejects. Rather than unlinking them one by one, with a rebalance each, the
+ * kept nodes are relinked as a balanced tree, like c_rbtree_build() does. So
+ * the whole pass costs O(n), no matter how many nodes are removed. This beats
+ * repeated unlinks once a large share of the tree goes away, while for few
+ * removals from large trees, the extra pass over the kept nodes dominates.
+ *
+ * @release is called for each removed node, as soon as the walk moved past
+ * it, so its memory is still hot. Removed nodes are marked as unlinked. Since
+ * the tree is only rebuilt at the end, neither callback may traverse the
+ * tree. Augmented values are not recomputed, since the shape of the tree
+ * changes entirely.
+ *
+ * Fixed runtime (n: number of elements in tree): O(n)
+ *
+ * Return: Number of removed nodes.
+ */
+_public_ size_t c_rbtree_retain(CRBTree *t, CRBRetainFunc keep, CRBReleaseFunc release, void *userdata) {
+        CRBStep s;
+
+        assert(t);
+        assert(keep);
+
+        c_rbtree_step_retain(&s, t, keep, release, userdata);
+        c_rbtree_step_run(&s, SIZE_MAX);
+        return s.n_removed;
 }
@@ -30,7 +30,9 @@ extern "C" {
 #include <stdalign.h>
 #include <stddef.h>
 
+typedef struct CRBIter CRBIter;
 typedef struct CRBNode CRBNode;
+typedef struct CRBStep CRBStep;
 typedef struct CRBTree CRBTree;
 
 /* implementation detail */
@@ -67,6 +69,24 @@ struct CRBNode {
 
 #define C_RBNODE_INIT(_var) { .__parent_and_flags = (unsigned long)&(_var) }
 
+/**
+ * CRBAugmentFunc - recompute augmented value of a node
+ * @n:          node to recompute
+ *
+ * Augmented trees store an additional value in each node, which is computed
+ * from the node itself and the values of its direct children (e.g., the
+ * maximum of some field across the subtree). The tree implementation calls
+ * this callback whenever the children of @n changed, or @n was newly linked.
+ * It must recompute the value of @n from @n->left and @n->right, and must not
+ * access any other node. It must return true if the value changed, and false
+ * if it did not, in which case propagation towards the root stops early.
+ *
+ * The value must only depend on the set of nodes in the subtree, not on the
+ * shape of the subtree, since rotations are never propagated beyond the
+ * rotated nodes.
+ */
+typedef _Bool (*CRBAugmentFunc) (CRBNode *n);
+
 CRBNode *c_rbnode_leftmost(CRBNode *n);
 CRBNode *c_rbnode_rightmost(CRBNode *n);
 CRBNode *c_rbnode_leftdeepest(CRBNode *n);
@@ -78,6 +98,9 @@ CRBNode *c_rbnode_prev_postorder(CRBNode *n);
 
 void c_rbnode_link(CRBNode *p, CRBNode **l, CRBNode *n);
 void c_rbnode_unlink_stale(CRBNode *n);
+void c_rbnode_unlink_stale_augmented(CRBNode *n, CRBAugmentFunc f);
+void c_rbnode_propagate(CRBNode *n, CRBAugmentFunc f);
+void c_rbnode_replace(CRBNode *old, CRBNode *n);
 
 /**
  * struct CRBTree - Red-Black Tree
@@ -95,6 +118,141 @@ struct CRBTree {
 
 #define C_RBTREE_INIT {}
 
+/**
+ * struct CRBIter - Batched In-Order Iterator
+ * @next:       next node to return, or NULL
+ *
+ * An iterator remembers the position of an in-order traversal, so nodes can be
+ * retrieved in batches via c_rbtree_iter_fill(). The API user is free to
+ * access @next at any time. In particular, it can be set to any linked node to
+ * start iterating at that node.
+ */
+struct CRBIter {
+        CRBNode *next;
+};
+
+#define C_RBITER_INIT {}
+
+/**
+ * CRBCloneFunc - create copy of a node
+ * @n:          node to copy
+ * @copyp:      output argument for the new node
+ * @userdata:   userdata passed to c_rbtree_clone()
+ *
+ * This is called by c_rbtree_clone() for each node of the source tree. It must
+ * return a new node in @copyp, which is not linked into any tree, and copy
+ * the data of the object that embeds @n, as required. The tree links of the
+ * new node are set by the caller, and must not be touched. @n must not be
+ * modified.
+ *
+ * Return: 0 on success, negative error code on failure.
+ */
+typedef int (*CRBCloneFunc) (CRBNode *n, CRBNode **copyp, void *userdata);
+
+/**
+ * CRBDescendFunc - decide whether to search a subtree
+ * @n:          root of the subtree
+ * @userdata:   userdata passed to c_rbtree_visit()
+ *
+ * This is called by c_rbtree_visit() before it enters the subtree rooted in
+ * @n. It must return false if no node of the subtree can match the search,
+ * usually based on the augmented value of @n. It may return true for subtrees
+ * without any match, at the cost of visiting them.
+ *
+ * Return: True to search the subtree, false to skip it.
+ */
+typedef _Bool (*CRBDescendFunc) (CRBNode *n, void *userdata);
+
+/**
+ * CRBVisitFunc - visit node
+ * @n:          node to visit
+ * @userdata:   userdata passed to c_rbtree_visit()
+ *
+ * This is called by c_rbtree_visit() for each node of each subtree it
+ * searches. It must check whether @n itself matches, since its subtree might
+ * only contain matches below @n. The tree must not be modified.
+ *
+ * Return: 0 to continue, any other value to stop the search.
+ */
+typedef int (*CRBVisitFunc) (CRBNode *n, void *userdata);
+
+/**
+ * CRBRetainFunc - decide whether to keep a node
+ * @n:          node to check
+ * @userdata:   userdata passed to c_rbtree_retain()
+ *
+ * This is called by c_rbtree_retain() once for each node, in order. The tree
+ * must neither be modified, nor traversed.
+ *
+ * Return: True to keep @n, false to remove it.
+ */
+typedef _Bool (*CRBRetainFunc) (CRBNode *n, void *userdata);
+
+/**
+ * CRBReleaseFunc - release removed node
+ * @n:          node that was removed
+ * @userdata:   userdata passed to c_rbtree_retain()
+ *
+ * This is called by c_rbtree_retain() for each removed node, while the walk
+ * is still in progress. @n is marked as unlinked, and can be released. The
+ * tree must neither be modified, nor traversed.
+ */
+typedef void (*CRBReleaseFunc) (CRBNode *n, void *userdata);
+
+#define C_RBTREE_STEP_DEPTH_MAX 64
+
+/**
+ * struct CRBStep - Resumable Bulk Operation
+ * @target:     tree the operation works on
+ * @tree:       nodes detached from @target while the operation runs
+ * @op:         type of the operation
+ * @phase:      current phase of the operation
+ * @keep:       callback to decide whether to keep a node, or NULL
+ * @release:    callback to release removed nodes, or NULL
+ * @userdata:   userdata to pass to the callbacks
+ * @next:       next node to walk
+ * @chain:      chain of nodes to link, or NULL
+ * @chain_tail: end of @chain
+ * @nodes:      array of nodes to link, or NULL
+ * @n_nodes:    number of nodes to link
+ * @n_removed:  number of nodes removed so far
+ * @n_black:    number of black levels of the built tree
+ * @n_frames:   number of used entries in @frames
+ * @frames:     stack of subtrees being built
+ *
+ * A resumable operation performs a bulk operation on a tree in steps of
+ * bounded size, via c_rbtree_step_run(), so it can be spread across multiple
+ * iterations of an event loop. The nodes of the tree are detached into the
+ * operation object while it runs, so the tree itself stays consistent between
+ * steps: it is empty until the operation finishes. The operation object must
+ * not be moved while it runs.
+ *
+ * All fields but @n_removed are private to the implementation.
+ */
+struct CRBStep {
+        CRBTree *target;
+        CRBTree tree;
+        unsigned int op;
+        unsigned int phase;
+        CRBRetainFunc keep;
+        CRBReleaseFunc release;
+        void *userdata;
+        CRBNode *next;
+        CRBNode *chain;
+        CRBNode **chain_tail;
+        CRBNode **nodes;
+        size_t n_nodes;
+        size_t n_removed;
+        unsigned int n_black;
+        unsigned int n_frames;
+        struct {
+                size_t n_nodes;
+                CRBNode *node;
+                CRBNode *left;
+                unsigned int stage;
+        } frames[C_RBTREE_STEP_DEPTH_MAX];
+};
+
 CRBNode *c_rbtree_first(CRBTree *t);
 CRBNode *c_rbtree_last(CRBTree *t);
 CRBNode *c_rbtree_first_postorder(CRBTree *t);
@@ -102,6 +260,19 @@ CRBNode *c_rbtree_last_postorder(CRBTree *t);
 
 void c_rbtree_move(CRBTree *to, CRBTree *from);
 void c_rbtree_add(CRBTree *t, CRBNode *p, CRBNode **l, CRBNode *n);
+void c_rbtree_add_augmented(CRBTree *t, CRBNode *p, CRBNode **l, CRBNode *n, CRBAugmentFunc f);
+void c_rbtree_build(CRBTree *t, CRBNode **nodes, size_t n_nodes);
+void c_rbtree_build_weighted(CRBTree *t, CRBNode **nodes, const size_t *weights, size_t n_nodes);
+int c_rbtree_clone(CRBTree *to, CRBTree *from, CRBCloneFunc f, void *userdata);
+int c_rbtree_visit(CRBTree *t, CRBDescendFunc descend, CRBVisitFunc visit, void *userdata);
+size_t c_rbtree_retain(CRBTree *t, CRBRetainFunc keep, CRBReleaseFunc release, void *userdata);
+
+void c_rbtree_step_teardown(CRBStep *s, CRBTree *t, CRBReleaseFunc release, void *userdata);
+void c_rbtree_step_build(CRBStep *s, CRBTree *t, CRBNode **nodes, size_t n_nodes);
+void c_rbtree_step_retain(CRBStep *s, CRBTree *t, CRBRetainFunc keep, CRBReleaseFunc release, void *userdata);
+_Bool c_rbtree_step_run(CRBStep *s, size_t budget);
+
+size_t c_rbtree_iter_fill(CRBIter *iter, CRBNode **out, size_t n_out);
 
 /**
  * c_rbnode_init() - mark a node as unlinked
@@ -195,6 +366,21 @@ static inline void c_rbnode_unlink(CRBNode *n) {
         }
 }
 
+/**
+ * c_rbnode_unlink_augmented() - safely remove node from augmented tree
+ * @n:          node to remove, or NULL
+ * @f:          augment callback
+ *
+ * This is the same as c_rbnode_unlink(), but for augmented trees. See
+ * c_rbnode_unlink_stale_augmented() for details.
+ */
+static inline void c_rbnode_unlink_augmented(CRBNode *n, CRBAugmentFunc f) {
+        if (c_rbnode_is_linked(n)) {
+                c_rbnode_unlink_stale_augmented(n, f);
+                c_rbnode_init(n);
+        }
+}
+
 /**
  * c_rbtree_init() - initialize a new RB-Tree
  * @t:          tree to operate on
@@ -219,6 +405,18 @@ static inline _Bool c_rbtree_is_empty(CRBTree *t) {
         return !t->root;
 }
 
+/**
+ * c_rbtree_iter_init() - initialize batched iterator
+ * @iter:       iterator to initialize
+ * @t:          tree to iterate
+ *
+ * This initializes @iter to iterate @t in order, starting at its first node.
+ * See c_rbtree_iter_fill() for details.
+ */
+static inline void c_rbtree_iter_init(CRBIter *iter, CRBTree *t) {
+        *iter = (CRBIter){ .next = c_rbtree_first(t) };
+}
+
 /**
  * CRBCompareFunc - compare a node to a key
  * @t:          tree where the node is linked to
@@ -237,6 +435,30 @@ static inline _Bool c_rbtree_is_empty(CRBTree *t) {
  */
 typedef int (*CRBCompareFunc) (CRBTree *t, void *k, CRBNode *n);
 
+/* maximum number of comparisons passed to a CRBCompareBatchFunc at once */
+#define C_RBTREE_BATCH_MAX 16
+
+/**
+ * CRBCompareBatchFunc - compare nodes to keys in batches
+ * @t:          tree where the nodes are linked to
+ * @keys:       keys to compare
+ * @nodes:      nodes to compare
+ * @results:    output array for the comparison results
+ * @n:          number of comparisons, at most C_RBTREE_BATCH_MAX
+ *
+ * This is the batched counterpart of CRBCompareFunc, used by
+ * c_rbtree_find_batch(). It must compare @keys[i] to @nodes[i] for each i
+ * below @n, and store the result in @results[i], with the same semantics as
+ * CRBCompareFunc.
+ *
+ * It is called once per tree level for a whole group of lookups, rather than
+ * once per lookup and level. Hence, it can load the keys of all @nodes at once,
+ * and compare them with SIMD instructions, if the node keys are suitable.
+ */
+typedef void (*CRBCompareBatchFunc) (CRBTree *t, void **keys, CRBNode **nodes, int *results, size_t n);
+
+void c_rbtree_find_batch(CRBTree *t, CRBCompareFunc f, CRBCompareBatchFunc fb, void **keys, CRBNode **nodes, size_t n_keys);
+
 /**
  * c_rbtree_find_node() - find node
  * @t:          tree to search through
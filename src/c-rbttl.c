@@ -0,0 +1,275 @@
+/*
+ * TTL Caches
+ * This implements TTL caches on top of an RB-Tree ordered by expiry, plus a
+ * hash table with intrusive, doubly-linked bucket chains, so entries can be
+ * unlinked from their bucket in O(1), no matter which index they were found
+ * through.
+ *
+ * For a highlevel documentation of the API, see the header file and docbook
+ * comments.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "c-rbttl.h"
+#include "c-rbtree-private.h"
+#include "c-rbtree.h"
+
+#define c_rbttl_entry_from_rb(_rb) c_rbnode_entry((_rb), CRBTtlEntry, rb)
+
+static void c_rbttl_link_hash(CRBTtl *c, CRBTtlEntry *e) {
+        CRBTtlEntry **bucket = &c->buckets[e->hash & (c->n_buckets - 1)];
+
+        e->hash_next = *bucket;
+        e->hash_pprev = bucket;
+        if (e->hash_next)
+                e->hash_next->hash_pprev = &e->hash_next;
+        *bucket = e;
+}
+
+static void c_rbttl_unlink_hash(CRBTtlEntry *e) {
+        *e->hash_pprev = e->hash_next;
+        if (e->hash_next)
+                e->hash_next->hash_pprev = e->hash_pprev;
+        e->hash_next = NULL;
+        e->hash_pprev = NULL;
+}
+
+static void c_rbttl_link_tree(CRBTtl *c, CRBTtlEntry *e) {
+        CRBNode **slot = &c->tree.root, *p = NULL;
+
+        /* equal expiry goes right, to keep insertion order */
+        while (*slot) {
+                p = *slot;
+                if (e->expiry < c_rbttl_entry_from_rb(p)->expiry)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbtree_add(&c->tree, p, slot, &e->rb);
+}
+
+/**
+ * c_rbttl_init() - initialize TTL cache
+ * @c:                  cache to initialize
+ * @buckets:            array of hash buckets
+ * @n_buckets:          number of hash buckets, a power of 2
+ * @max_entries:        maximum number of entries, or 0 if unbounded
+ *
+ * This initializes @c as an empty cache, with @buckets as hash table. The
+ * buckets are initialized by this call, and must stay valid as long as @c is
+ * used.
+ */
+_public_ void c_rbttl_init(CRBTtl *c, CRBTtlEntry **buckets, size_t n_buckets, size_t max_entries) {
+        size_t i;
+
+        assert(c);
+        assert(buckets);
+        assert(n_buckets && !(n_buckets & (n_buckets - 1)));
+
+        for (i = 0; i < n_buckets; ++i)
+                buckets[i] = NULL;
+
+        *c = (CRBTtl){
+                .tree = C_RBTREE_INIT,
+                .buckets = buckets,
+                .n_buckets = n_buckets,
+                .max_entries = max_entries,
+        };
+}
+
+/**
+ * c_rbttl_find() - find entry by key
+ * @c:                  cache to search through
+ * @hash:               hash of the key
+ * @f:                  equality function
+ * @k:                  key to search for
+ *
+ * This searches @c for the entry of key @k. Expiry is not considered, so an
+ * entry is found until it was detached via c_rbttl_expire(), or removed
+ * otherwise.
+ *
+ * Worst case runtime (b: number of entries in the bucket of @hash): O(b)
+ *
+ * Return: Pointer to the entry of @k, or NULL if @k is not in @c.
+ */
+_public_ CRBTtlEntry *c_rbttl_find(CRBTtl *c, size_t hash, CRBTtlEqualFunc f, const void *k) {
+        CRBTtlEntry *e;
+
+        assert(c);
+        assert(f);
+
+        for (e = c->buckets[hash & (c->n_buckets - 1)]; e; e = e->hash_next)
+                if (e->hash == hash && f(e, k))
+                        return e;
+
+        return NULL;
+}
+
+/**
+ * c_rbttl_add() - add entry
+ * @c:                  cache to operate on
+ * @e:                  entry to link
+ * @hash:               hash of the key of @e
+ * @expiry:             expiry time of @e
+ *
+ * This links @e into @c. The caller must make sure no entry of the same key
+ * is linked already, for instance via c_rbttl_find(). If @c is full, the entry
+ * closest to expiry is evicted first, to make room for @e.
+ *
+ * Worst case runtime (n: number of entries in cache): O(log(n))
+ *
+ * Return: The evicted entry, which is unlinked and can be released, or NULL if
+ *         nothing was evicted.
+ */
+_public_ CRBTtlEntry *c_rbttl_add(CRBTtl *c, CRBTtlEntry *e, size_t hash, uint64_t expiry) {
+        CRBTtlEntry *evicted = NULL;
+
+        assert(c);
+        assert(e);
+        assert(!c_rbnode_is_linked(&e->rb));
+
+        if (c->max_entries && c->n_entries >= c->max_entries) {
+                evicted = c_rbttl_entry_from_rb(c_rbtree_first(&c->tree));
+                c_rbttl_remove(c, evicted);
+        }
+
+        e->hash = hash;
+        e->expiry = expiry;
+        c_rbttl_link_hash(c, e);
+        c_rbttl_link_tree(c, e);
+        ++c->n_entries;
+
+        return evicted;
+}
+
+/**
+ * c_rbttl_remove() - remove entry
+ * @c:                  cache to operate on
+ * @e:                  entry to unlink
+ *
+ * This unlinks @e from @c. The entry must be linked into @c. Afterwards, it is
+ * marked as unlinked, and can be released or added again.
+ *
+ * Worst case runtime (n: number of entries in cache): O(log(n))
+ */
+_public_ void c_rbttl_remove(CRBTtl *c, CRBTtlEntry *e) {
+        assert(c);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        c_rbttl_unlink_hash(e);
+        c_rbnode_unlink(&e->rb);
+        --c->n_entries;
+}
+
+/**
+ * c_rbttl_refresh() - change expiry of entry
+ * @c:                  cache to operate on
+ * @e:                  linked entry to refresh
+ * @expiry:             new expiry time
+ *
+ * This changes the expiry time of @e to @expiry. The entry is ordered as if it
+ * was added anew, that is, after all entries with the same expiry, unless the
+ * expiry does not change, in which case its position does not either. If
+ * that order matches its current position, the expiry is updated in place,
+ * without touching the tree. This is the common case if expiry times are
+ * coarse. Only the neighbour in the direction of the change needs to be
+ * checked for that. Otherwise, @e is relinked.
+ *
+ * Worst case runtime (n: number of entries in cache): O(log(n))
+ */
+_public_ void c_rbttl_refresh(CRBTtl *c, CRBTtlEntry *e, uint64_t expiry) {
+        CRBTtlEntry *neighbour;
+
+        assert(c);
+        assert(e);
+        assert(c_rbnode_is_linked(&e->rb));
+
+        if (expiry == e->expiry)
+                return;
+
+        if (expiry > e->expiry) {
+                neighbour = c_rbttl_entry_from_rb(c_rbnode_next(&e->rb));
+                if (!neighbour || expiry < neighbour->expiry) {
+                        e->expiry = expiry;
+                        return;
+                }
+        } else {
+                neighbour = c_rbttl_entry_from_rb(c_rbnode_prev(&e->rb));
+                if (!neighbour || neighbour->expiry <= expiry) {
+                        e->expiry = expiry;
+                        return;
+                }
+        }
+
+        c_rbnode_unlink(&e->rb);
+        e->expiry = expiry;
+        c_rbttl_link_tree(c, e);
+}
+
+/**
+ * c_rbttl_expire() - detach all expired entries
+ * @c:                  cache to operate on
+ * @now:                current time
+ * @n_expiredp:         output storage for the number of expired entries, or
+ *                      NULL
+ *
+ * This unlinks all entries with an expiry time not later than @now from @c,
+ * and returns them as a list, linked via their @hash_next member, in expiry
+ * order. All entries in the list are marked as unlinked, and can be released
+ * or added again, once the caller fetched their successor in the list.
+ *
+ * Expired entries are unlinked one by one, which costs amortized O(1)
+ * rebalancing each, since they are always the leftmost entries. However, if
+ * they make up at least half of @c, the remaining entries are relinked as a
+ * balanced tree instead, which needs neither comparisons nor rotations.
+ *
+ * Worst case runtime (n: number of entries in cache, k: number of expired
+ * entries): O(log(n) + k), amortized, if k is less than n/2, O(n) otherwise
+ *
+ * Return: First expired entry, or NULL if none expired.
+ */
+_public_ CRBTtlEntry *c_rbttl_expire(CRBTtl *c, uint64_t now, size_t *n_expiredp) {
+        CRBTtlEntry *e, *head = NULL, **tail = &head;
+        CRBNode *n, *next, *chain;
+        size_t i, n_expired = 0;
+
+        assert(c);
+
+        for (n = c_rbtree_first(&c->tree); n && c_rbttl_entry_from_rb(n)->expiry <= now; n = c_rbnode_next(n))
+                ++n_expired;
+
+        if (n_expired && 2 * n_expired >= c->n_entries) {
+                chain = c_rbtree_detach_chain(&c->tree, NULL);
+                for (i = 0; i < n_expired; ++i) {
+                        e = c_rbttl_entry_from_rb(chain);
+                        chain = chain->left;
+
+                        c_rbnode_init(&e->rb);
+                        c_rbttl_unlink_hash(e);
+                        *tail = e;
+                        tail = &e->hash_next;
+                }
+
+                c_rbtree_attach_chain(&c->tree, chain, c->n_entries - n_expired);
+        } else {
+                for (i = 0, n = c_rbtree_first(&c->tree); i < n_expired; ++i, n = next) {
+                        e = c_rbttl_entry_from_rb(n);
+                        next = c_rbnode_next(n);
+
+                        c_rbnode_unlink(&e->rb);
+                        c_rbttl_unlink_hash(e);
+                        *tail = e;
+                        tail = &e->hash_next;
+                }
+        }
+
+        c->n_entries -= n_expired;
+        if (n_expiredp)
+                *n_expiredp = n_expired;
+        return head;
+}
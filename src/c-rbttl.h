@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+ * TTL Caches
+ *
+ * A TTL cache indexes entries twice: by key, via a hash table, for lookups in
+ * O(1), and by expiry time, via an RB-Tree, so expired entries can be found
+ * without scanning. Both indices are kept in sync by the API:
+ *
+ *   o Expiry is batched. c_rbttl_expire() detaches all entries expired at a
+ *     given time at once, and returns them as a list. If they make up most
+ *     of the cache, the tree is rebuilt from the survivors in O(n), rather
+ *     than unlinking each expired entry individually.
+ *
+ *   o Refreshing an entry updates its expiry in place, if the new expiry does
+ *     not change its position in expiry order. Only otherwise is the entry
+ *     relinked in the tree.
+ *
+ *   o The cache can be bounded in size. Adding an entry to a full cache
+ *     evicts the entry closest to expiry.
+ *
+ * Entries with equal expiry are ordered by insertion, so they are evicted
+ * first-in first-out.
+ *
+ * Entries are embedded in the objects of the API user, like CRBNode. Keys are
+ * opaque to the cache: the API user provides the hash of each key, and an
+ * equality function for lookups. The bucket array of the hash table is
+ * provided by the API user as well, and the API performs no memory
+ * allocation.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "c-rbtree.h"
+
+typedef struct CRBTtl CRBTtl;
+typedef struct CRBTtlEntry CRBTtlEntry;
+
+/**
+ * CRBTtlEqualFunc - compare the key of an entry to a key
+ * @e:          entry to compare
+ * @k:          key to compare to
+ *
+ * Return: True if the key of @e equals @k, false otherwise.
+ */
+typedef _Bool (*CRBTtlEqualFunc) (CRBTtlEntry *e, const void *k);
+
+/**
+ * struct CRBTtlEntry - TTL cache entry
+ * @rb:                 node in the expiry tree
+ * @hash_next:          next entry in the hash bucket, or in the list
+ *                      returned by c_rbttl_expire()
+ * @hash_pprev:         pointer to the link pointing to this entry
+ * @hash:               hash of the key of this entry
+ * @expiry:             expiry time of this entry
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBTtlEntry {
+        CRBNode rb;
+        CRBTtlEntry *hash_next;
+        CRBTtlEntry **hash_pprev;
+        size_t hash;
+        uint64_t expiry;
+};
+
+#define C_RBTTL_ENTRY_INIT(_var) { .rb = C_RBNODE_INIT((_var).rb) }
+
+/**
+ * struct CRBTtl - TTL cache
+ * @tree:               tree of all entries, ordered by expiry
+ * @buckets:            hash buckets, provided by the API user
+ * @n_buckets:          number of hash buckets, a power of 2
+ * @n_entries:          number of linked entries
+ * @max_entries:        maximum number of entries, or 0 if unbounded
+ *
+ * All fields are read-only to the API user.
+ */
+struct CRBTtl {
+        CRBTree tree;
+        CRBTtlEntry **buckets;
+        size_t n_buckets;
+        size_t n_entries;
+        size_t max_entries;
+};
+
+void c_rbttl_init(CRBTtl *c, CRBTtlEntry **buckets, size_t n_buckets, size_t max_entries);
+
+CRBTtlEntry *c_rbttl_find(CRBTtl *c, size_t hash, CRBTtlEqualFunc f, const void *k);
+CRBTtlEntry *c_rbttl_add(CRBTtl *c, CRBTtlEntry *e, size_t hash, uint64_t expiry);
+void c_rbttl_remove(CRBTtl *c, CRBTtlEntry *e);
+void c_rbttl_refresh(CRBTtl *c, CRBTtlEntry *e, uint64_t expiry);
+CRBTtlEntry *c_rbttl_expire(CRBTtl *c, uint64_t now, size_t *n_expiredp);
+
+/**
+ * c_rbttl_is_empty() - check whether a TTL cache is empty
+ * @c:                  cache to operate on
+ *
+ * Return: True if the cache is empty, false otherwise.
+ */
+static inline _Bool c_rbttl_is_empty(CRBTtl *c) {
+        return !c->n_entries;
+}
+
+#ifdef __cplusplus
+}
+#endif
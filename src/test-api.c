@@ -6,20 +6,62 @@
 
 #undef NDEBUG
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "c-rbarena.h"
+#include "c-rbchangelog.h"
+#include "c-rbeevdf.h"
+#include "c-rbextent.h"
+#include "c-rbindex.h"
+#include "c-rblpm.h"
+#include "c-rbmultiset.h"
+#include "c-rborder.h"
+#include "c-rbpartition.h"
+#include "c-rbradix.h"
+#include "c-rbrange.h"
+#include "c-rbrangetree.h"
+#include "c-rbthreaded.h"
+#include "c-rbtopk.h"
 #include "c-rbtree.h"
+#include "c-rbttl.h"
 
 typedef struct TestNode {
         CRBNode rb;
 } TestNode;
 
+static _Bool test_augment(CRBNode *n) {
+        return 0;
+}
+
+static int test_compare_key(CRBTree *t, void *k, CRBNode *n) {
+        return 0;
+}
+
+static int test_clone(CRBNode *n, CRBNode **copyp, void *userdata) {
+        return -1;
+}
+
+static _Bool test_descend(CRBNode *n, void *userdata) {
+        return 1;
+}
+
+static int test_visit(CRBNode *n, void *userdata) {
+        return 1;
+}
+
+static _Bool test_keep(CRBNode *n, void *userdata) {
+        return 0;
+}
+
 static void test_api(void) {
         CRBTree t = C_RBTREE_INIT, t2 = C_RBTREE_INIT;
-        CRBNode *i, *is, n = C_RBNODE_INIT(n), m = C_RBNODE_INIT(m);
+        CRBIter iter = C_RBITER_INIT;
+        CRBNode *i, *is, n = C_RBNODE_INIT(n), m = C_RBNODE_INIT(m), *v[1];
         TestNode *ie, *ies;
+        CRBStep s;
 
         assert(c_rbtree_is_empty(&t));
         assert(!c_rbnode_is_linked(&n));
@@ -100,9 +142,403 @@ static void test_api(void) {
                 assert(!i);
         c_rbtree_for_each_entry_safe_postorder_unlink(ie, ies, &t, rb)
                 assert(!ie);
+
+        /* build */
+
+        c_rbtree_build(&t, NULL, 0);
+        c_rbtree_build_weighted(&t, NULL, NULL, 0);
+        assert(c_rbtree_is_empty(&t));
+
+        /* batched iterator */
+
+        c_rbtree_iter_init(&iter, &t);
+        assert(!c_rbtree_iter_fill(&iter, NULL, 0));
+
+        /* augmented trees */
+
+        c_rbtree_add_augmented(&t, NULL, &t.root, &n, test_augment);
+        assert(c_rbnode_is_linked(&n));
+
+        c_rbnode_propagate(&n, test_augment);
+
+        c_rbnode_unlink_augmented(&n, test_augment);
+        assert(!c_rbnode_is_linked(&n));
+
+        c_rbtree_add_augmented(&t, NULL, &t.root, &n, test_augment);
+        c_rbnode_unlink_stale_augmented(&n, test_augment);
+        assert(c_rbtree_is_empty(&t));
+        c_rbnode_init(&n);
+
+        /* clone */
+
+        assert(!c_rbtree_clone(&t2, &t, test_clone, NULL));
+        assert(c_rbtree_is_empty(&t2));
+
+        /* find_batch */
+
+        c_rbtree_add(&t, NULL, &t.root, &n);
+        c_rbtree_find_batch(&t, test_compare_key, NULL, (void *[]){ NULL }, &i, 1);
+        assert(i == &n);
+        c_rbnode_unlink(&n);
+
+        /* replace */
+
+        c_rbtree_add(&t, NULL, &t.root, &n);
+        c_rbnode_replace(&n, &m);
+        assert(t.root == &m);
+        assert(!c_rbnode_is_linked(&n));
+        c_rbnode_unlink(&m);
+        assert(c_rbtree_is_empty(&t));
+
+        /* visit */
+
+        c_rbtree_add(&t, NULL, &t.root, &n);
+        assert(c_rbtree_visit(&t, test_descend, test_visit, NULL) == 1);
+        c_rbnode_unlink(&n);
+
+        /* retain */
+
+        c_rbtree_add(&t, NULL, &t.root, &n);
+        assert(c_rbtree_retain(&t, test_keep, NULL, NULL) == 1);
+        assert(!c_rbnode_is_linked(&n));
+        assert(c_rbtree_is_empty(&t));
+
+        /* resumable operations */
+
+        v[0] = &n;
+        c_rbtree_step_build(&s, &t, v, 1);
+        assert(c_rbtree_is_empty(&t));
+        assert(c_rbtree_step_run(&s, 1));
+        assert(t.root == &n);
+
+        c_rbtree_step_retain(&s, &t, test_keep, NULL, NULL);
+        assert(c_rbtree_step_run(&s, 1));
+        assert(s.n_removed == 1);
+        assert(c_rbtree_is_empty(&t));
+
+        c_rbtree_add(&t, NULL, &t.root, &n);
+        c_rbtree_step_teardown(&s, &t, NULL, NULL);
+        assert(c_rbtree_is_empty(&t));
+        assert(c_rbtree_step_run(&s, 1));
+        assert(!c_rbnode_is_linked(&n));
+}
+
+#define TEST_INDICES(X, _ctx) X(_ctx, by_key, rb, test_compare_key)
+
+C_RBINDEX_DEFINE(test_index, TestNode, TEST_INDICES)
+
+static void test_index(void) {
+        TestNode n = { .rb = C_RBNODE_INIT(n.rb) };
+        struct test_index m;
+
+        test_index_init(&m);
+        assert(!test_index_add(&m, &n));
+        assert(test_index_add(&m, &n) == -EEXIST);
+        assert(!test_index_rekey(&m, &n, C_RBINDEX_MASK(test_index, by_key)));
+        test_index_remove(&m, &n);
+        assert(c_rbtree_is_empty(&m.by_key));
+}
+
+static void test_arena(void) {
+        CRBArena a;
+        int r;
+
+        r = c_rbarena_init(&a, 1, 1, 0);
+        assert(!r);
+        c_rbarena_free(&a, c_rbarena_alloc(&a));
+        c_rbarena_deinit(&a);
+}
+
+static void test_changelog(void) {
+        CRBNode n = C_RBNODE_INIT(n);
+        CRBTree t = C_RBTREE_INIT;
+        CRBChange ring[1], c;
+        CRBChangelog l;
+        uint64_t seq = 0;
+        size_t n_read;
+        int r;
+
+        c_rbchangelog_init(&l, ring, 1);
+        assert(!c_rbchangelog_seq(&l));
+
+        c_rbchangelog_add(&l, &t, NULL, &t.root, &n);
+        c_rbchangelog_update(&l, &n);
+        c_rbchangelog_unlink(&l, &n);
+        c_rbchangelog_record(&l, C_RBCHANGE_UPDATE, &n);
+        assert(c_rbchangelog_seq(&l) == 4);
+
+        r = c_rbchangelog_read(&l, &seq, &c, 1, &n_read);
+        assert(r == -ESTALE);
+        seq = 3;
+        r = c_rbchangelog_read(&l, &seq, &c, 1, &n_read);
+        assert(!r && n_read == 1 && seq == 4);
+}
+
+static void test_eevdf(void) {
+        CRBEevdfEntry e = C_RBEEVDF_ENTRY_INIT(e);
+        CRBEevdf q;
+
+        c_rbeevdf_init(&q);
+        assert(c_rbeevdf_is_empty(&q));
+
+        c_rbeevdf_add(&q, &e, 1, 2);
+        assert(c_rbeevdf_min_vstart(&q) == 1);
+        assert(!c_rbeevdf_pick(&q, 0));
+        c_rbeevdf_update(&q, &e, 0, 3);
+        assert(c_rbeevdf_pick(&q, 0) == &e);
+        c_rbeevdf_remove(&q, &e);
+        assert(c_rbeevdf_is_empty(&q));
+}
+
+static void test_extent(void) {
+        CRBExtentAllocator a;
+        uint64_t addr;
+        int r;
+
+        c_rbextent_init(&a);
+        assert(c_rbextent_is_empty(&a));
+
+        r = c_rbextent_free(&a, 0, 8);
+        assert(!r);
+        assert(c_rbextent_largest(&a)->size == 8);
+        r = c_rbextent_alloc(&a, 8, &addr);
+        assert(!r && !addr);
+        assert(c_rbextent_is_empty(&a));
+
+        r = c_rbextent_free(&a, 0, 8);
+        assert(!r);
+        c_rbextent_deinit(&a);
+}
+
+static void test_lpm(void) {
+        CRBLpmEntry e = C_RBLPM_ENTRY_INIT(e);
+        unsigned char address[4] = {};
+        CRBLpm lpm;
+        int r;
+
+        c_rblpm_init(&lpm, 32);
+        assert(c_rblpm_is_empty(&lpm));
+
+        r = c_rblpm_add(&lpm, &e, address, 0);
+        assert(!r);
+        assert(c_rblpm_find(&lpm, address, 0) == &e);
+        assert(c_rblpm_lookup(&lpm, address) == &e);
+
+        c_rblpm_remove(&lpm, &e);
+        assert(c_rblpm_is_empty(&lpm));
+}
+
+static int test_compare(CRBNode *a, CRBNode *b) {
+        return 0;
+}
+
+static void test_multiset(void) {
+        CRBMultisetEntry e = C_RBMULTISET_ENTRY_INIT(e);
+        CRBMultiset s;
+
+        c_rbmultiset_init(&s);
+        assert(c_rbmultiset_is_empty(&s));
+
+        assert(c_rbmultiset_add(&s, test_compare_key, NULL, &e, 2) == &e);
+        assert(c_rbmultiset_find(&s, test_compare_key, NULL) == &e);
+        assert(c_rbmultiset_size(&s) == 2);
+        assert(c_rbmultiset_rank(&s, &e) == 0);
+        assert(c_rbmultiset_select(&s, 1) == &e);
+
+        assert(c_rbmultiset_remove(&s, &e, 2));
+        assert(c_rbmultiset_is_empty(&s));
+}
+
+static void test_order(void) {
+        CRBOrderEntry e = C_RBORDER_ENTRY_INIT(e), f = C_RBORDER_ENTRY_INIT(f);
+        CRBOrder o;
+
+        c_rborder_init(&o);
+        assert(c_rborder_is_empty(&o));
+
+        c_rborder_add(&o, NULL, &o.tree.root, &e);
+        c_rborder_add(&o, &e.rb, &e.rb.right, &f);
+        assert(c_rborder_precedes(&e, &f));
+        assert(c_rborder_compare(&f, &e) == 1);
+
+        c_rborder_remove(&o, &f);
+        c_rborder_remove(&o, &e);
+        assert(c_rborder_is_empty(&o));
+}
+
+static void test_partitions(void) {
+        CRBNode *i, *cursors[2];
+        CRBPartition partitions[1];
+        CRBPartitionsIter iter;
+        CRBPartitions ps;
+
+        c_rbpartitions_init(&ps, test_compare, partitions, 1);
+        c_rbpartitions_consolidate(&ps);
+        assert(!c_rbpartitions_find(&ps, test_compare_key, NULL));
+
+        c_rbpartitions_iter_init(&iter, &ps, cursors);
+        assert(!c_rbpartitions_iter_next(&iter));
+
+        c_rbpartitions_for_each(i, &iter, &ps, cursors)
+                assert(!i);
+
+        if (0)
+                c_rbpartitions_add(&ps, 0, NULL);
+}
+
+static void test_radix(void) {
+        CRBRadixEntry e = C_RBRADIX_ENTRY_INIT(e), *i;
+        CRBRadix r;
+        int v;
+
+        c_rbradix_init(&r, 32);
+        assert(c_rbradix_is_empty(&r));
+
+        v = c_rbradix_add(&r, &e, 0);
+        assert(!v);
+        assert(c_rbradix_find(&r, 0) == &e);
+        assert(c_rbradix_first(&r) == &e);
+        assert(!c_rbradix_next(&r, &e));
+
+        c_rbradix_for_each(i, &r)
+                assert(i == &e);
+
+        c_rbradix_remove(&r, &e);
+        c_rbradix_deinit(&r);
+}
+
+static void test_ranges(void) {
+        CRBRangeSet s;
+        CRBRange *r;
+        uint64_t start;
+        int e;
+
+        c_rbrangeset_init(&s);
+        assert(c_rbrangeset_is_empty(&s));
+
+        e = c_rbrangeset_insert(&s, 0, 2);
+        assert(!e);
+        assert(c_rbrangeset_contains(&s, 0, 2));
+
+        e = c_rbrangeset_allocate(&s, 1, &start);
+        assert(!e && start == 0);
+
+        e = c_rbrangeset_remove(&s, 0, 2);
+        assert(!e);
+
+        c_rbrangeset_for_each(r, &s)
+                assert(!r);
+
+        c_rbrangeset_deinit(&s);
+}
+
+static int test_rangetree_fn(CRBRangeTreeEntry *e, void *userdata) {
+        return 1;
+}
+
+static void test_rangetree(void) {
+        CRBRangeTreeEntry e = C_RBRANGETREE_ENTRY_INIT(e);
+        CRBRangeTree t;
+        int r;
+
+        c_rbrangetree_init(&t);
+        assert(c_rbrangetree_is_empty(&t));
+
+        c_rbrangetree_add(&t, &e, 0, 0);
+        r = c_rbrangetree_query(&t, 0, 0, 0, 0, test_rangetree_fn, NULL);
+        assert(r == 1);
+
+        r = c_rbrangetree_rebuild(&t);
+        assert(!r);
+
+        c_rbrangetree_remove(&t, &e);
+        c_rbrangetree_deinit(&t);
+}
+
+static void test_threaded(void) {
+        CRBThreadedEntry e = C_RBTHREADED_ENTRY_INIT(e), *i;
+        CRBThreaded t;
+
+        c_rbthreaded_init(&t);
+        assert(c_rbthreaded_is_empty(&t));
+        assert(!c_rbthreaded_find(&t, test_compare_key, NULL));
+        assert(!c_rbthreaded_lower_bound(&t, test_compare_key, NULL));
+
+        c_rbthreaded_add(&t, NULL, &t.tree.root, &e);
+        assert(c_rbthreaded_first(&t) == &e);
+        assert(c_rbthreaded_last(&t) == &e);
+        assert(!c_rbthreaded_next(&e));
+        assert(!c_rbthreaded_prev(&e));
+        assert(c_rbthreaded_find(&t, test_compare_key, NULL) == &e);
+        assert(c_rbthreaded_lower_bound(&t, test_compare_key, NULL) == &e);
+
+        c_rbthreaded_for_each(i, &t)
+                assert(i == &e);
+
+        c_rbthreaded_remove(&t, &e);
+        assert(c_rbthreaded_is_empty(&t));
+}
+
+static int test_topk_compare(CRBNode *a, CRBNode *b) {
+        return 0;
+}
+
+static void test_topk(void) {
+        CRBNode n = C_RBNODE_INIT(n);
+        CRBTopk t;
+
+        c_rbtopk_init(&t, test_topk_compare, 1);
+        assert(!c_rbtopk_min(&t));
+        assert(!c_rbtopk_is_full(&t));
+
+        assert(!c_rbtopk_push(&t, &n));
+        assert(c_rbtopk_min(&t) == &n);
+
+        c_rbtopk_remove(&t, &n);
+        assert(!c_rbtopk_min(&t));
+}
+
+static _Bool test_ttl_equal(CRBTtlEntry *e, const void *k) {
+        return 1;
+}
+
+static void test_ttl(void) {
+        CRBTtlEntry e = C_RBTTL_ENTRY_INIT(e), *buckets[1];
+        size_t n_expired;
+        CRBTtl c;
+
+        c_rbttl_init(&c, buckets, 1, 1);
+        assert(c_rbttl_is_empty(&c));
+
+        assert(!c_rbttl_add(&c, &e, 0, 1));
+        assert(c_rbttl_find(&c, 0, test_ttl_equal, NULL) == &e);
+
+        c_rbttl_refresh(&c, &e, 2);
+        assert(!c_rbttl_expire(&c, 1, &n_expired));
+        assert(c_rbttl_expire(&c, 2, &n_expired) == &e);
+        assert(n_expired == 1);
+
+        assert(!c_rbttl_add(&c, &e, 0, 1));
+        c_rbttl_remove(&c, &e);
+        assert(c_rbttl_is_empty(&c));
 }
 
 int main(int argc, char **argv) {
         test_api();
+        test_arena();
+        test_changelog();
+        test_eevdf();
+        test_extent();
+        test_index();
+        test_lpm();
+        test_multiset();
+        test_order();
+        test_partitions();
+        test_radix();
+        test_ranges();
+        test_rangetree();
+        test_threaded();
+        test_topk();
+        test_ttl();
         return 0;
 }
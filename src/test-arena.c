@@ -0,0 +1,159 @@
+/*
+ * Tests for Node Arenas
+ * This allocates tree nodes from arenas with and without huge pages, links
+ * them into a tree, and verifies entry reuse and exhaustion.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbarena.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_NODES 4096
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+        char payload[13];
+} Node;
+
+#define node_from_rb(_rb) ((Node *)((char *)(_rb) - offsetof(Node, rb)))
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = node_from_rb(n);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void insert(CRBTree *t, Node *node) {
+        CRBNode **slot, *p;
+
+        slot = c_rbtree_find_slot(t, compare, (void *)node->key, &p);
+        assert(slot);
+        c_rbtree_add(t, p, slot, &node->rb);
+}
+
+static size_t validate(CRBTree *t) {
+        unsigned long key = 0;
+        size_t count = 0;
+        Node *node;
+
+        c_rbtree_for_each_entry(node, t, rb) {
+                assert(!count || key < node->key);
+                key = node->key;
+                ++count;
+        }
+
+        return count;
+}
+
+static void test_arena(unsigned int flags) {
+        Node *nodes[N_NODES], *node;
+        CRBTree t = C_RBTREE_INIT;
+        CRBArena a;
+        size_t i;
+        int r;
+
+        r = c_rbarena_init(&a, sizeof(Node), N_NODES, flags);
+        assert(!r);
+        assert(a.mem);
+        assert(a.entry_size >= sizeof(Node));
+        assert(a.entry_size % alignof(max_align_t) == 0);
+        assert(a.n_entries >= N_NODES);
+        assert(a.backing == C_RBARENA_BACKING_PAGES ||
+               a.backing == C_RBARENA_BACKING_THP ||
+               a.backing == C_RBARENA_BACKING_HUGETLB);
+        assert((flags & C_RBARENA_FLAG_HUGEPAGES) || a.backing == C_RBARENA_BACKING_PAGES);
+
+        /* allocate nodes in random key order, and link them */
+        for (i = 0; i < N_NODES; ++i) {
+                nodes[i] = c_rbarena_alloc(&a);
+                assert(nodes[i]);
+                assert((uintptr_t)nodes[i] % alignof(max_align_t) == 0);
+                nodes[i]->key = (i * 7919) % N_NODES;
+                memset(nodes[i]->payload, 0xff, sizeof(nodes[i]->payload));
+                insert(&t, nodes[i]);
+        }
+        assert(validate(&t) == N_NODES);
+
+        /* release every other node, and allocate them again */
+        for (i = 0; i < N_NODES; i += 2) {
+                c_rbnode_unlink(&nodes[i]->rb);
+                c_rbarena_free(&a, nodes[i]);
+        }
+        assert(validate(&t) == N_NODES / 2);
+
+        for (i = 0; i < N_NODES; i += 2) {
+                node = c_rbarena_alloc(&a);
+                assert(node);
+                node->key = (i * 7919) % N_NODES;
+                insert(&t, node);
+        }
+        assert(validate(&t) == N_NODES);
+        assert(a.n_used == N_NODES);
+
+        /* exhaust the arena */
+        while (c_rbarena_alloc(&a))
+                ;
+        assert(a.n_used == a.n_entries);
+        assert(!c_rbarena_alloc(&a));
+
+        c_rbarena_free(&a, NULL);
+        c_rbarena_free(&a, nodes[1]);
+        assert(c_rbarena_alloc(&a) == nodes[1]);
+
+        c_rbarena_deinit(&a);
+        assert(!a.mem);
+        c_rbarena_deinit(&a);
+}
+
+static void test_backing(void) {
+        char mode[128] = {};
+        _Bool thp = 0;
+        CRBArena a;
+        FILE *f;
+        int r;
+
+        /* transparent huge pages are only reported if the system enables them */
+        f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "re");
+        if (f) {
+                if (fgets(mode, sizeof(mode), f))
+                        thp = !strstr(mode, "[never]");
+                fclose(f);
+        }
+
+        r = c_rbarena_init(&a, sizeof(Node), N_NODES, C_RBARENA_FLAG_HUGEPAGES);
+        assert(!r);
+
+        if (a.backing != C_RBARENA_BACKING_HUGETLB)
+                assert(a.backing == (thp ? C_RBARENA_BACKING_THP : C_RBARENA_BACKING_PAGES));
+
+        c_rbarena_deinit(&a);
+}
+
+static void test_overflow(unsigned int flags) {
+        CRBArena a;
+
+        /* sizes that wrap around while being rounded up must fail cleanly */
+        assert(c_rbarena_init(&a, SIZE_MAX, 1, flags) == -ENOMEM);
+        assert(c_rbarena_init(&a, 16, SIZE_MAX / 16, flags) == -ENOMEM);
+        assert(c_rbarena_init(&a, 16, (SIZE_MAX - (2UL << 20)) / 16, flags) == -ENOMEM);
+}
+
+int main(int argc, char **argv) {
+        test_arena(0);
+        test_arena(C_RBARENA_FLAG_HUGEPAGES);
+        test_backing();
+        test_overflow(0);
+        test_overflow(C_RBARENA_FLAG_HUGEPAGES);
+        return 0;
+}
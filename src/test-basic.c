@@ -10,6 +10,7 @@
 
 #undef NDEBUG
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -222,6 +223,358 @@ static void test_shuffle(void) {
                 free(nodes[i]);
 }
 
+static int compare_ptr(const void *a, const void *b) {
+        CRBNode *x = *(CRBNode **)a, *y = *(CRBNode **)b;
+
+        return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void test_build(void) {
+        CRBNode *nodes[512], *i;
+        CRBTree t = {};
+        size_t j, n;
+
+        /* allocate all nodes, but leave them uninitialized */
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j) {
+                nodes[j] = malloc(sizeof(*nodes[j]));
+                assert(nodes[j]);
+        }
+
+        qsort(nodes, sizeof(nodes) / sizeof(*nodes), sizeof(*nodes), compare_ptr);
+
+        /* build trees of all sizes and validate them */
+        for (n = 0; n <= sizeof(nodes) / sizeof(*nodes); ++n) {
+                c_rbtree_build(&t, nodes, n);
+                assert(validate(&t) == n);
+
+                j = 0;
+                c_rbtree_for_each(i, &t)
+                        assert(i == nodes[j++]);
+                assert(j == n);
+
+                /* the tree must be usable as usual afterwards */
+                shuffle(nodes, n);
+                for (j = 0; j < n / 2; ++j) {
+                        c_rbnode_unlink(nodes[j]);
+                        assert(validate(&t) == n - j - 1);
+                }
+                for (j = 0; j < n / 2; ++j) {
+                        insert(&t, nodes[j]);
+                        assert(validate(&t) == n - n / 2 + j + 1);
+                }
+
+                c_rbtree_init(&t);
+                qsort(nodes, sizeof(nodes) / sizeof(*nodes), sizeof(*nodes), compare_ptr);
+        }
+
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j)
+                free(nodes[j]);
+}
+
+static size_t depth(CRBNode *n) {
+        size_t d = 0;
+
+        while ((n = c_rbnode_parent(n)))
+                ++d;
+        return d;
+}
+
+static void test_build_weighted(void) {
+        CRBNode *nodes[512], *i;
+        size_t weights[512], j, n, pattern, hot;
+        CRBTree t = {};
+
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j) {
+                nodes[j] = malloc(sizeof(*nodes[j]));
+                assert(nodes[j]);
+        }
+
+        qsort(nodes, sizeof(nodes) / sizeof(*nodes), sizeof(*nodes), compare_ptr);
+
+        /* build trees of all sizes, with different weights, and validate them */
+        for (pattern = 0; pattern < 4; ++pattern) {
+                for (n = 0; n <= sizeof(nodes) / sizeof(*nodes); ++n) {
+                        hot = n / 3;
+                        for (j = 0; j < n; ++j) {
+                                switch (pattern) {
+                                case 0:
+                                        weights[j] = 0;
+                                        break;
+                                case 1:
+                                        weights[j] = rand() % 1000;
+                                        break;
+                                case 2:
+                                        /* skewed, as with zipfian accesses */
+                                        weights[j] = 100000 / (1 + rand() % (n * 4));
+                                        break;
+                                default:
+                                        weights[j] = (j == hot) ? 1000000 : 1;
+                                        break;
+                                }
+                        }
+
+                        c_rbtree_build_weighted(&t, nodes, weights, n);
+                        assert(validate(&t) == n);
+
+                        j = 0;
+                        c_rbtree_for_each(i, &t)
+                                assert(i == nodes[j++]);
+                        assert(j == n);
+
+                        /* a dominant node ends up at the top */
+                        if (pattern == 3 && n)
+                                assert(depth(nodes[hot]) <= 2);
+
+                        /* the tree must be usable as usual afterwards */
+                        shuffle(nodes, n);
+                        for (j = 0; j < n / 2; ++j) {
+                                c_rbnode_unlink(nodes[j]);
+                                assert(validate(&t) == n - j - 1);
+                        }
+                        for (j = 0; j < n / 2; ++j) {
+                                insert(&t, nodes[j]);
+                                assert(validate(&t) == n - n / 2 + j + 1);
+                        }
+
+                        c_rbtree_init(&t);
+                        qsort(nodes, sizeof(nodes) / sizeof(*nodes), sizeof(*nodes), compare_ptr);
+                }
+        }
+
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j)
+                free(nodes[j]);
+}
+
+static void test_iter_fill(void) {
+        static const size_t batches[] = { 1, 3, 64, 1024 };
+        CRBNode *nodes[512], *out[1024];
+        CRBTree t = {};
+        CRBIter iter;
+        size_t b, j, k, n;
+
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j) {
+                nodes[j] = malloc(sizeof(*nodes[j]));
+                assert(nodes[j]);
+                c_rbnode_init(nodes[j]);
+        }
+
+        /* empty trees yield nothing */
+        c_rbtree_iter_init(&iter, &t);
+        assert(!c_rbtree_iter_fill(&iter, out, 1));
+        assert(!c_rbtree_iter_fill(&iter, NULL, 0));
+
+        shuffle(nodes, sizeof(nodes) / sizeof(*nodes));
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j)
+                insert(&t, nodes[j]);
+        qsort(nodes, sizeof(nodes) / sizeof(*nodes), sizeof(*nodes), compare_ptr);
+
+        /* iterate in batches of different sizes, from the start */
+        for (b = 0; b < sizeof(batches) / sizeof(*batches); ++b) {
+                c_rbtree_iter_init(&iter, &t);
+                for (j = 0; (n = c_rbtree_iter_fill(&iter, out, batches[b])); j += n) {
+                        assert(n == batches[b] || j + n == sizeof(nodes) / sizeof(*nodes));
+                        for (k = 0; k < n; ++k)
+                                assert(out[k] == nodes[j + k]);
+                }
+                assert(j == sizeof(nodes) / sizeof(*nodes));
+                assert(!iter.next);
+        }
+
+        /* iterate from an arbitrary node */
+        iter.next = nodes[100];
+        n = c_rbtree_iter_fill(&iter, out, 50);
+        assert(n == 50);
+        for (k = 0; k < n; ++k)
+                assert(out[k] == nodes[100 + k]);
+        assert(iter.next == nodes[150]);
+
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j)
+                free(nodes[j]);
+}
+
+typedef struct {
+        CRBNode *nodes;
+        const unsigned char *keep;
+        unsigned char released[512];
+        size_t n_keep_calls;
+        size_t n_release_calls;
+        CRBNode *last;
+} RetainContext;
+
+static _Bool retain_keep(CRBNode *n, void *userdata) {
+        RetainContext *ctx = userdata;
+
+        /* nodes are passed in order, each exactly once */
+        assert(!ctx->last || ctx->last < n);
+        ctx->last = n;
+        ++ctx->n_keep_calls;
+        return ctx->keep[n - ctx->nodes];
+}
+
+static void retain_release(CRBNode *n, void *userdata) {
+        RetainContext *ctx = userdata;
+
+        assert(!c_rbnode_is_linked(n));
+        assert(!ctx->keep[n - ctx->nodes]);
+        /* each node is released once, after it was passed */
+        assert(n <= ctx->last);
+        assert(!ctx->released[n - ctx->nodes]);
+        ctx->released[n - ctx->nodes] = 1;
+        ++ctx->n_release_calls;
+}
+
+static void test_retain(void) {
+        static const unsigned int ratios[] = { 0, 1, 50, 90, 100 };
+        unsigned char keep[512];
+        CRBNode nodes[512], *order[512], *i;
+        RetainContext ctx;
+        CRBTree t = {};
+        size_t j, k, n, n_kept, n_removed;
+
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j)
+                c_rbnode_init(&nodes[j]);
+
+        for (n = 0; n <= sizeof(nodes) / sizeof(*nodes); n += 1 + n / 4) {
+                for (k = 0; k < sizeof(ratios) / sizeof(*ratios); ++k) {
+                        for (j = 0; j < n; ++j) {
+                                order[j] = &nodes[j];
+                                keep[j] = (unsigned int)(rand() % 100) >= ratios[k];
+                        }
+
+                        shuffle(order, n);
+                        for (j = 0; j < n; ++j)
+                                insert(&t, order[j]);
+
+                        ctx = (RetainContext){ .nodes = nodes, .keep = keep };
+                        n_removed = c_rbtree_retain(&t, retain_keep, retain_release, &ctx);
+                        assert(ctx.n_keep_calls == n);
+                        assert(ctx.n_release_calls == n_removed);
+
+                        /* the kept nodes form a valid tree, in order */
+                        n_kept = validate(&t);
+                        assert(n_kept + n_removed == n);
+                        ctx.last = NULL;
+                        c_rbtree_for_each(i, &t) {
+                                assert(keep[i - nodes]);
+                                assert(!ctx.last || ctx.last < i);
+                                ctx.last = i;
+                        }
+                        for (j = 0; j < n; ++j)
+                                assert(c_rbnode_is_linked(&nodes[j]) == keep[j]);
+
+                        /* the tree must be usable as usual afterwards */
+                        for (j = 0; j < n; ++j)
+                                if (!keep[j])
+                                        insert(&t, &nodes[j]);
+                        assert(validate(&t) == n);
+
+                        /* now remove everything, and release it */
+                        memset(keep, 0, sizeof(keep));
+                        ctx = (RetainContext){ .nodes = nodes, .keep = keep };
+                        n_removed = c_rbtree_retain(&t, retain_keep, retain_release, &ctx);
+                        assert(n_removed == n);
+                        assert(ctx.n_release_calls == n);
+                        for (j = 0; j < n; ++j)
+                                assert(!c_rbnode_is_linked(&nodes[j]));
+                        assert(c_rbtree_is_empty(&t));
+                }
+        }
+}
+
+typedef struct {
+        CRBNode *parent;
+        CRBNode *left;
+        CRBNode *right;
+        _Bool red;
+} StepShape;
+
+static void step_snapshot(StepShape *shape, CRBNode *nodes, size_t n) {
+        size_t j;
+
+        for (j = 0; j < n; ++j) {
+                shape[j].parent = c_rbnode_parent(&nodes[j]);
+                shape[j].left = nodes[j].left;
+                shape[j].right = nodes[j].right;
+                shape[j].red = c_rbnode_is_red(&nodes[j]);
+        }
+}
+
+static void test_step(void) {
+        static const size_t budgets[] = { 1, 2, 3, 7, SIZE_MAX };
+        CRBNode nodes[512], *sorted[512], *order[512], other;
+        StepShape shape[512], built[512];
+        unsigned char keep[512];
+        RetainContext ctx;
+        CRBTree t = {};
+        CRBStep s;
+        size_t j, k, n, n_steps;
+
+        c_rbnode_init(&other);
+        for (j = 0; j < sizeof(nodes) / sizeof(*nodes); ++j) {
+                c_rbnode_init(&nodes[j]);
+                sorted[j] = &nodes[j];
+        }
+
+        for (n = 0; n <= sizeof(nodes) / sizeof(*nodes); n += 1 + n / 4) {
+                for (k = 0; k < sizeof(budgets) / sizeof(*budgets); ++k) {
+                        /* the tree stays empty until the build is finished */
+                        c_rbtree_step_build(&s, &t, sorted, n);
+                        for (n_steps = 0; !c_rbtree_step_run(&s, budgets[k]); ++n_steps)
+                                assert(c_rbtree_is_empty(&t));
+                        assert(n_steps == (n ? (n - 1) / budgets[k] : 0));
+                        assert(validate(&t) == n);
+
+                        /* it must have the exact same shape as a one-shot build */
+                        step_snapshot(shape, nodes, n);
+                        c_rbtree_init(&t);
+                        c_rbtree_build(&t, sorted, n);
+                        step_snapshot(built, nodes, n);
+                        for (j = 0; j < n; ++j) {
+                                assert(shape[j].parent == built[j].parent);
+                                assert(shape[j].left == built[j].left);
+                                assert(shape[j].right == built[j].right);
+                                assert(shape[j].red == built[j].red);
+                        }
+
+                        /* retain in steps, the tree is empty in between */
+                        for (j = 0; j < n; ++j)
+                                keep[j] = rand() % 2;
+                        ctx = (RetainContext){ .nodes = nodes, .keep = keep };
+                        c_rbtree_step_retain(&s, &t, retain_keep, retain_release, &ctx);
+                        while (!c_rbtree_step_run(&s, budgets[k]))
+                                assert(c_rbtree_is_empty(&t));
+                        assert(ctx.n_keep_calls == n);
+                        assert(ctx.n_release_calls == s.n_removed);
+                        assert(validate(&t) + s.n_removed == n);
+                        for (j = 0; j < n; ++j)
+                                assert(c_rbnode_is_linked(&nodes[j]) == keep[j]);
+
+                        for (j = 0; j < n; ++j)
+                                order[j] = &nodes[j];
+                        shuffle(order, n);
+                        for (j = 0; j < n; ++j)
+                                if (!keep[order[j] - nodes])
+                                        insert(&t, order[j]);
+
+                        /* tear down in steps, the tree is usable in between */
+                        memset(keep, 0, sizeof(keep));
+                        ctx = (RetainContext){ .nodes = nodes, .keep = keep, .last = nodes + n };
+                        c_rbtree_step_teardown(&s, &t, retain_release, &ctx);
+                        assert(c_rbtree_is_empty(&t));
+                        do {
+                                insert(&t, &other);
+                                assert(validate(&t) == 1);
+                                c_rbnode_unlink(&other);
+                        } while (!c_rbtree_step_run(&s, budgets[k]));
+                        assert(s.n_removed == n);
+                        assert(ctx.n_release_calls == n);
+                        for (j = 0; j < n; ++j)
+                                assert(!c_rbnode_is_linked(&nodes[j]) && ctx.released[j]);
+                        assert(c_rbtree_is_empty(&t));
+                }
+        }
+}
+
 int main(int argc, char **argv) {
         unsigned int i;
 
@@ -235,5 +588,11 @@ int main(int argc, char **argv) {
         for (i = 0; i < 4; ++i)
                 test_shuffle();
 
+        test_build();
+        test_build_weighted();
+        test_iter_fill();
+        test_retain();
+        test_step();
+
         return 0;
 }
@@ -0,0 +1,183 @@
+/*
+ * Tests for Change Logs
+ * This runs random adds, removes, and updates on a tree with an attached
+ * change log, and follows them with a consumer that keeps a mirror of the
+ * tree. The consumer catches up in fixed intervals, reads changes in random
+ * batches, and rescans the tree whenever it fell too far behind. Each time it
+ * caught up, the mirror must match the tree.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbchangelog.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_NODES 256
+#define N_STEPS 16384
+
+typedef struct {
+        CRBNode rb;
+        unsigned int version;
+} Node;
+
+typedef struct {
+        uint64_t seq;
+        size_t n_rescans;
+        bool present[N_NODES];
+        unsigned int version[N_NODES];
+} Mirror;
+
+#define node_from_rb(_rb) c_rbnode_entry((_rb), Node, rb)
+
+static void insert(CRBChangelog *l, CRBTree *t, Node *node) {
+        CRBNode **slot = &t->root, *p = NULL;
+
+        while (*slot) {
+                p = *slot;
+                if (&node->rb < p)
+                        slot = &p->left;
+                else
+                        slot = &p->right;
+        }
+
+        c_rbchangelog_add(l, t, p, slot, &node->rb);
+}
+
+static void rescan(Mirror *m, CRBChangelog *l, CRBTree *t, Node *nodes) {
+        CRBNode *n;
+
+        m->seq = c_rbchangelog_seq(l);
+        memset(m->present, 0, sizeof(m->present));
+        c_rbtree_for_each(n, t) {
+                m->present[node_from_rb(n) - nodes] = true;
+                m->version[node_from_rb(n) - nodes] = node_from_rb(n)->version;
+        }
+        ++m->n_rescans;
+}
+
+static void catch_up(Mirror *m, CRBChangelog *l, CRBTree *t, Node *nodes) {
+        CRBChange changes[32];
+        size_t i, idx, n_read;
+        uint64_t seq;
+        int r;
+
+        do {
+                seq = m->seq;
+                r = c_rbchangelog_read(l, &m->seq, changes, 1 + rand() % 32, &n_read);
+                if (r == -ESTALE) {
+                        assert(l->seq - seq > l->n_ring);
+                        rescan(m, l, t, nodes);
+                        n_read = 1;
+                        continue;
+                }
+
+                assert(!r);
+                assert(m->seq == seq + n_read);
+
+                for (i = 0; i < n_read; ++i) {
+                        assert(changes[i].seq == seq + i);
+                        idx = node_from_rb(changes[i].node) - nodes;
+
+                        switch (changes[i].type) {
+                        case C_RBCHANGE_ADD:
+                                assert(!m->present[idx]);
+                                m->present[idx] = true;
+                                m->version[idx] = 0;
+                                break;
+                        case C_RBCHANGE_REMOVE:
+                                assert(m->present[idx]);
+                                m->present[idx] = false;
+                                break;
+                        case C_RBCHANGE_UPDATE:
+                                assert(m->present[idx]);
+                                ++m->version[idx];
+                                break;
+                        default:
+                                assert(0);
+                        }
+                }
+        } while (n_read);
+
+        assert(m->seq == c_rbchangelog_seq(l));
+        for (i = 0; i < N_NODES; ++i) {
+                assert(m->present[i] == c_rbnode_is_linked(&nodes[i].rb));
+                assert(!m->present[i] || m->version[i] == nodes[i].version);
+        }
+}
+
+static void test_random(size_t n_ring, unsigned int interval) {
+        CRBTree t = C_RBTREE_INIT;
+        CRBChange *ring;
+        CRBChangelog l;
+        Node *nodes, *node;
+        Mirror *m;
+        size_t i;
+
+        ring = calloc(n_ring, sizeof(*ring));
+        nodes = calloc(N_NODES, sizeof(*nodes));
+        m = calloc(1, sizeof(*m));
+        assert(ring && nodes && m);
+
+        c_rbchangelog_init(&l, ring, n_ring);
+        assert(c_rbchangelog_seq(&l) == 0);
+
+        for (i = 0; i < N_NODES; ++i)
+                c_rbnode_init(&nodes[i].rb);
+
+        for (i = 0; i < N_STEPS; ++i) {
+                node = &nodes[rand() % N_NODES];
+
+                if (!c_rbnode_is_linked(&node->rb)) {
+                        node->version = 0;
+                        insert(&l, &t, node);
+                } else if (rand() % 2) {
+                        c_rbchangelog_unlink(&l, &node->rb);
+                        assert(!c_rbnode_is_linked(&node->rb));
+                } else {
+                        ++node->version;
+                        c_rbchangelog_update(&l, &node->rb);
+                }
+
+                /* unlinking an unlinked node records nothing */
+                if (!c_rbnode_is_linked(&node->rb)) {
+                        c_rbchangelog_unlink(&l, &node->rb);
+                        assert(c_rbchangelog_seq(&l) == i + 1);
+                }
+
+                if (i % interval == 0)
+                        catch_up(m, &l, &t, nodes);
+        }
+
+        catch_up(m, &l, &t, nodes);
+        assert(c_rbchangelog_seq(&l) == N_STEPS);
+
+        /* consumers that keep up never need to rescan */
+        assert(!m->n_rescans == (interval <= n_ring));
+
+        while (t.root)
+                c_rbchangelog_unlink(&l, t.root);
+
+        free(m);
+        free(nodes);
+        free(ring);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_random(1, 1);
+        test_random(16, 4);
+        test_random(16, 64);
+        test_random(1024, 64);
+        return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Tests for EEVDF Queues
+ * This runs random sequences of adds, removes, and updates on an EEVDF queue,
+ * and after each step verifies the cached subtree minima, and compares picks
+ * at random virtual times against a linear scan over all entries in deadline
+ * order.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbeevdf.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_ENTRIES 512
+#define N_STEPS 8192
+
+#define entry_from_rb(_rb) c_rbnode_entry((_rb), CRBEevdfEntry, rb)
+
+static uint64_t verify_subtree(CRBNode *n) {
+        CRBEevdfEntry *e = entry_from_rb(n);
+        uint64_t min_vstart = e->vstart, v;
+
+        if (n->left) {
+                v = verify_subtree(n->left);
+                min_vstart = v < min_vstart ? v : min_vstart;
+        }
+        if (n->right) {
+                v = verify_subtree(n->right);
+                min_vstart = v < min_vstart ? v : min_vstart;
+        }
+
+        assert(e->min_vstart == min_vstart);
+        return min_vstart;
+}
+
+static CRBEevdfEntry *scan(CRBEevdf *q, uint64_t vtime) {
+        CRBNode *n;
+
+        c_rbtree_for_each(n, &q->tree)
+                if (entry_from_rb(n)->vstart <= vtime)
+                        return entry_from_rb(n);
+
+        return NULL;
+}
+
+static void verify(CRBEevdf *q, size_t n_linked) {
+        CRBEevdfEntry *prev = NULL, *e;
+        uint64_t vtime;
+        size_t i = 0;
+        CRBNode *n;
+
+        c_rbtree_for_each(n, &q->tree) {
+                e = entry_from_rb(n);
+                assert(!prev || prev->vdeadline <= e->vdeadline);
+                prev = e;
+                ++i;
+        }
+
+        assert(i == n_linked);
+        assert(c_rbeevdf_is_empty(q) == !n_linked);
+
+        if (n_linked) {
+                vtime = verify_subtree(q->tree.root);
+                assert(vtime == c_rbeevdf_min_vstart(q));
+                if (vtime)
+                        assert(!c_rbeevdf_pick(q, vtime - 1));
+                assert(c_rbeevdf_pick(q, vtime) == scan(q, vtime));
+        }
+
+        for (i = 0; i < 8; ++i) {
+                vtime = rand() % 1100;
+                assert(c_rbeevdf_pick(q, vtime) == scan(q, vtime));
+        }
+}
+
+static void test_random(uint64_t range) {
+        CRBEevdfEntry *entries, *e;
+        CRBEevdf q;
+        size_t i, n_linked = 0;
+        uint64_t vstart;
+
+        entries = calloc(N_ENTRIES, sizeof(*entries));
+        assert(entries);
+
+        c_rbeevdf_init(&q);
+        for (i = 0; i < N_ENTRIES; ++i)
+                c_rbnode_init(&entries[i].rb);
+
+        assert(!c_rbeevdf_pick(&q, UINT64_MAX));
+
+        for (i = 0; i < N_STEPS; ++i) {
+                e = &entries[rand() % N_ENTRIES];
+                vstart = rand() % range;
+
+                if (!c_rbnode_is_linked(&e->rb)) {
+                        c_rbeevdf_add(&q, e, vstart, vstart + rand() % range);
+                        ++n_linked;
+                } else if (rand() % 4 == 0) {
+                        c_rbeevdf_remove(&q, e);
+                        assert(!c_rbnode_is_linked(&e->rb));
+                        --n_linked;
+                } else if (rand() % 2) {
+                        /* keep the deadline, only move the start time */
+                        c_rbeevdf_update(&q, e, vstart, e->vdeadline);
+                } else {
+                        c_rbeevdf_update(&q, e, vstart, vstart + rand() % range);
+                }
+
+                verify(&q, n_linked);
+        }
+
+        for (i = 0; i < N_ENTRIES; ++i) {
+                if (c_rbnode_is_linked(&entries[i].rb)) {
+                        c_rbeevdf_remove(&q, &entries[i]);
+                        --n_linked;
+                        verify(&q, n_linked);
+                }
+        }
+
+        assert(c_rbeevdf_is_empty(&q));
+        free(entries);
+}
+
+static void test_fifo(void) {
+        CRBEevdfEntry e[4] = {
+                C_RBEEVDF_ENTRY_INIT(e[0]),
+                C_RBEEVDF_ENTRY_INIT(e[1]),
+                C_RBEEVDF_ENTRY_INIT(e[2]),
+                C_RBEEVDF_ENTRY_INIT(e[3]),
+        };
+        CRBEevdf q = C_RBEEVDF_INIT;
+        size_t i;
+
+        /* equal deadlines are picked in queueing order */
+        for (i = 0; i < 4; ++i)
+                c_rbeevdf_add(&q, &e[i], 0, 10);
+
+        for (i = 0; i < 4; ++i) {
+                assert(c_rbeevdf_pick(&q, 0) == &e[i]);
+                c_rbeevdf_update(&q, &e[i], 5, 20);
+        }
+
+        /* not eligible yet, so the earlier deadline is skipped */
+        c_rbeevdf_update(&q, &e[2], 15, 12);
+        assert(c_rbeevdf_pick(&q, 4) == NULL);
+        assert(c_rbeevdf_pick(&q, 5) == &e[0]);
+        assert(c_rbeevdf_pick(&q, 15) == &e[2]);
+
+        for (i = 0; i < 4; ++i)
+                c_rbeevdf_remove(&q, &e[i]);
+        assert(c_rbeevdf_is_empty(&q));
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_fifo();
+        test_random(1000);
+        test_random(16);
+        return 0;
+}
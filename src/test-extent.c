@@ -0,0 +1,182 @@
+/*
+ * Tests for Extent Allocators
+ * This runs random allocations and frees on an extent allocator, and mirrors
+ * them in a bitmap of the address space. After each step, the free extents
+ * must be exactly the maximal free runs of the bitmap, both trees must be
+ * ordered, and each allocation must be the best fit among those runs.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbextent.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define SPACE 4096
+#define N_STEPS 8192
+#define N_ALLOCATIONS 1024
+
+typedef struct {
+        uint64_t addr;
+        uint64_t size;
+} Allocation;
+
+/* Find the maximal free run of @free_map that starts at, or after, @addr. */
+static bool next_run(const bool *free_map, uint64_t addr, Allocation *run) {
+        while (addr < SPACE && !free_map[addr])
+                ++addr;
+        if (addr >= SPACE)
+                return false;
+
+        run->addr = addr;
+        while (addr < SPACE && free_map[addr])
+                ++addr;
+        run->size = addr - run->addr;
+        return true;
+}
+
+static uint64_t best_fit(const bool *free_map, uint64_t size) {
+        Allocation run, best = { .size = UINT64_MAX };
+        uint64_t addr = 0;
+
+        for (; next_run(free_map, addr, &run); addr = run.addr + run.size)
+                if (run.size >= size && run.size < best.size)
+                        best = run;
+
+        return best.size == UINT64_MAX ? UINT64_MAX : best.addr;
+}
+
+static void verify(CRBExtentAllocator *a, const bool *free_map) {
+        CRBExtent *e, *prev = NULL;
+        uint64_t addr = 0, n_free = 0;
+        size_t n_extents = 0;
+        Allocation run;
+        CRBNode *n;
+
+        /* the address tree holds exactly the maximal free runs */
+        c_rbextent_for_each(e, a) {
+                assert(next_run(free_map, addr, &run));
+                assert(e->addr == run.addr && e->size == run.size);
+                addr = run.addr + run.size;
+                n_free += e->size;
+                ++n_extents;
+        }
+
+        assert(!next_run(free_map, addr, &run));
+        assert(n_extents == a->n_extents);
+        assert(n_free == a->n_free);
+        assert(c_rbextent_is_empty(a) == !n_extents);
+
+        /* the size tree holds the same extents, ordered by (size, address) */
+        c_rbtree_for_each(n, &a->by_size) {
+                e = c_rbnode_entry(n, CRBExtent, by_size);
+                assert(c_rbnode_is_linked(&e->by_addr));
+                assert(!prev || prev->size < e->size || (prev->size == e->size && prev->addr < e->addr));
+                prev = e;
+                --n_extents;
+        }
+
+        assert(!n_extents);
+        assert(c_rbextent_largest(a) == prev);
+}
+
+static void test_random(uint64_t max_size) {
+        Allocation *allocations;
+        size_t i, j, k, n_allocations = 0;
+        uint64_t addr, size, expected;
+        CRBExtentAllocator a;
+        bool *free_map;
+        int r;
+
+        allocations = calloc(N_ALLOCATIONS, sizeof(*allocations));
+        free_map = calloc(SPACE, sizeof(*free_map));
+        assert(allocations && free_map);
+
+        c_rbextent_init(&a);
+        verify(&a, free_map);
+
+        /* make the space available in random pieces */
+        for (addr = 0; addr < SPACE; addr += size) {
+                size = 1 + rand() % 64;
+                size = size < SPACE - addr ? size : SPACE - addr;
+                assert(n_allocations < N_ALLOCATIONS);
+                allocations[n_allocations++] = (Allocation){ addr, size };
+        }
+        while (n_allocations) {
+                j = rand() % n_allocations;
+                r = c_rbextent_free(&a, allocations[j].addr, allocations[j].size);
+                assert(!r);
+                for (addr = allocations[j].addr; addr < allocations[j].addr + allocations[j].size; ++addr)
+                        free_map[addr] = true;
+                allocations[j] = allocations[--n_allocations];
+                verify(&a, free_map);
+        }
+
+        assert(a.n_extents == 1 && a.n_free == SPACE);
+
+        for (i = 0; i < N_STEPS; ++i) {
+                if (n_allocations < N_ALLOCATIONS && rand() % 2) {
+                        size = 1 + rand() % max_size;
+                        expected = best_fit(free_map, size);
+
+                        r = c_rbextent_alloc(&a, size, &addr);
+                        if (expected == UINT64_MAX) {
+                                assert(r == -ENOSPC);
+                                continue;
+                        }
+
+                        assert(!r);
+                        assert(addr == expected);
+                        for (j = addr; j < addr + size; ++j)
+                                free_map[j] = false;
+                        allocations[n_allocations++] = (Allocation){ addr, size };
+                } else if (n_allocations) {
+                        k = rand() % n_allocations;
+                        addr = allocations[k].addr;
+                        size = allocations[k].size;
+
+                        /* overlapping free space is refused */
+                        if (addr > 0 && free_map[addr - 1]) {
+                                r = c_rbextent_free(&a, addr - 1, size);
+                                assert(r == -EEXIST);
+                        }
+                        if (addr + size < SPACE && free_map[addr + size]) {
+                                r = c_rbextent_free(&a, addr, size + 1);
+                                assert(r == -EEXIST);
+                        }
+
+                        r = c_rbextent_free(&a, addr, size);
+                        assert(!r);
+                        for (j = addr; j < addr + size; ++j)
+                                free_map[j] = true;
+                        allocations[k] = allocations[--n_allocations];
+                }
+
+                verify(&a, free_map);
+        }
+
+        c_rbextent_deinit(&a);
+        assert(c_rbextent_is_empty(&a));
+        assert(!a.n_extents && !a.n_free);
+
+        free(free_map);
+        free(allocations);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_random(8);
+        test_random(64);
+        test_random(512);
+        return 0;
+}
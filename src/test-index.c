@@ -0,0 +1,178 @@
+/*
+ * Tests for Multi-Index Containers
+ * This generates a container with three indices, and runs random adds,
+ * removals, and rekeys of single and multiple indices on it. After each step,
+ * all indices are verified against a plain array of objects. Keys are drawn
+ * from small ranges, so conflicts are common.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbindex.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_OBJECTS 128
+#define N_STEPS 20000
+
+typedef struct {
+        unsigned long id;
+        char name[8];
+        uint64_t expiry;
+        bool linked;
+        CRBNode rb_id;
+        CRBNode rb_name;
+        CRBNode rb_expiry;
+} Object;
+
+static int compare_id(CRBTree *t, void *k, CRBNode *n) {
+        Object *a = k, *b = c_rbnode_entry(n, Object, rb_id);
+
+        return (a->id < b->id) ? -1 : (a->id > b->id) ? 1 : 0;
+}
+
+static int compare_name(CRBTree *t, void *k, CRBNode *n) {
+        Object *a = k, *b = c_rbnode_entry(n, Object, rb_name);
+
+        return strcmp(a->name, b->name);
+}
+
+/* expiry is not unique, so order by id on ties */
+static int compare_expiry(CRBTree *t, void *k, CRBNode *n) {
+        Object *a = k, *b = c_rbnode_entry(n, Object, rb_expiry);
+
+        if (a->expiry != b->expiry)
+                return (a->expiry < b->expiry) ? -1 : 1;
+        return compare_id(t, k, &b->rb_id);
+}
+
+#define OBJECT_INDICES(X, _ctx)                                                                         \
+        X(_ctx, by_id, rb_id, compare_id)                                                               \
+        X(_ctx, by_name, rb_name, compare_name)                                                         \
+        X(_ctx, by_expiry, rb_expiry, compare_expiry)
+
+C_RBINDEX_DEFINE(object_index, Object, OBJECT_INDICES)
+
+static bool conflicts(Object *objects, Object *o) {
+        size_t i;
+
+        for (i = 0; i < N_OBJECTS; ++i) {
+                if (&objects[i] == o || !objects[i].linked)
+                        continue;
+                if (objects[i].id == o->id || !strcmp(objects[i].name, o->name))
+                        return true;
+        }
+
+        return false;
+}
+
+static void verify_tree(CRBTree *t, CRBCompareFunc f, size_t offset, Object *objects, size_t n_linked) {
+        Object *o, *prev = NULL;
+        size_t n_nodes = 0;
+        CRBNode *n;
+
+        c_rbtree_for_each(n, t) {
+                o = (Object *)((char *)n - offset);
+                assert(o->linked);
+                assert(!prev || f(t, prev, n) < 0);
+                assert(c_rbtree_find_node(t, f, o) == n);
+                prev = o;
+                ++n_nodes;
+        }
+
+        assert(n_nodes == n_linked);
+}
+
+static void verify(struct object_index *m, Object *objects) {
+        size_t i, n_linked = 0;
+
+        for (i = 0; i < N_OBJECTS; ++i) {
+                assert(c_rbnode_is_linked(&objects[i].rb_id) == objects[i].linked);
+                assert(c_rbnode_is_linked(&objects[i].rb_name) == objects[i].linked);
+                assert(c_rbnode_is_linked(&objects[i].rb_expiry) == objects[i].linked);
+                n_linked += objects[i].linked;
+        }
+
+        verify_tree(&m->by_id, compare_id, offsetof(Object, rb_id), objects, n_linked);
+        verify_tree(&m->by_name, compare_name, offsetof(Object, rb_name), objects, n_linked);
+        verify_tree(&m->by_expiry, compare_expiry, offsetof(Object, rb_expiry), objects, n_linked);
+}
+
+static void randomize(Object *o, unsigned int mask) {
+        if (mask & C_RBINDEX_MASK(object_index, by_id))
+                o->id = rand() % (2 * N_OBJECTS);
+        if (mask & C_RBINDEX_MASK(object_index, by_name))
+                snprintf(o->name, sizeof(o->name), "n%d", rand() % (2 * N_OBJECTS));
+        if (mask & C_RBINDEX_MASK(object_index, by_expiry))
+                o->expiry = rand() % 16;
+}
+
+static void test_random(void) {
+        Object objects[N_OBJECTS] = {}, *o;
+        struct object_index m;
+        unsigned int mask;
+        size_t i;
+        int r;
+
+        assert(object_index_N_INDICES == 3);
+
+        object_index_init(&m);
+        for (i = 0; i < N_OBJECTS; ++i) {
+                c_rbnode_init(&objects[i].rb_id);
+                c_rbnode_init(&objects[i].rb_name);
+                c_rbnode_init(&objects[i].rb_expiry);
+        }
+
+        for (i = 0; i < N_STEPS; ++i) {
+                o = &objects[rand() % N_OBJECTS];
+                mask = rand() % (1U << object_index_N_INDICES);
+
+                if (!o->linked) {
+                        randomize(o, ~0U);
+                        r = object_index_add(&m, o);
+                        assert(r == (conflicts(objects, o) ? -EEXIST : 0));
+                        o->linked = !r;
+                } else if (rand() % 4) {
+                        randomize(o, mask);
+
+                        /* the expiry index orders by id on ties, too */
+                        if (mask & C_RBINDEX_MASK(object_index, by_id))
+                                mask |= C_RBINDEX_MASK(object_index, by_expiry);
+
+                        r = object_index_rekey(&m, o, mask);
+                        assert(r == (conflicts(objects, o) ? -EEXIST : 0));
+                        o->linked = !r;
+                } else {
+                        object_index_remove(&m, o);
+                        o->linked = false;
+                }
+
+                verify(&m, objects);
+        }
+
+        for (i = 0; i < N_OBJECTS; ++i) {
+                object_index_remove(&m, &objects[i]);
+                objects[i].linked = false;
+        }
+
+        verify(&m, objects);
+        assert(c_rbtree_is_empty(&m.by_id));
+        assert(c_rbtree_is_empty(&m.by_name));
+        assert(c_rbtree_is_empty(&m.by_expiry));
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_random();
+        return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Tests for Longest-Prefix-Match Tables
+ * This fills IPv4 and IPv6 tables with random prefixes, and verifies lookups
+ * against a brute-force scan over all prefixes.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rblpm.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_ROUTES 2048
+#define N_LOOKUPS 4096
+
+typedef struct {
+        uint8_t prefix[16];
+        unsigned int length;
+        CRBLpmEntry lpm;
+} Route;
+
+static void random_address(uint8_t *address, size_t n_bytes) {
+        size_t i;
+
+        for (i = 0; i < n_bytes; ++i)
+                address[i] = rand();
+
+        /* keep addresses clustered, so prefixes actually nest */
+        if (n_bytes > 1)
+                address[0] &= 0x3;
+}
+
+static bool covers(const uint8_t *prefix, unsigned int length, const uint8_t *address) {
+        unsigned int i;
+
+        for (i = 0; i < length; ++i)
+                if ((prefix[i / 8] ^ address[i / 8]) & (0x80 >> (i % 8)))
+                        return false;
+
+        return true;
+}
+
+static Route *brute_force(Route *routes, size_t n_routes, const uint8_t *address) {
+        Route *best = NULL;
+        size_t i;
+
+        for (i = 0; i < n_routes; ++i)
+                if (c_rbnode_is_linked(&routes[i].lpm.rb) &&
+                    covers(routes[i].prefix, routes[i].length, address) &&
+                    (!best || routes[i].length > best->length))
+                        best = &routes[i];
+
+        return best;
+}
+
+static void verify(CRBLpm *lpm, Route *routes, size_t n_routes, size_t n_bytes) {
+        CRBLpmEntry *e;
+        uint8_t address[16];
+        Route *r;
+        size_t i;
+
+        for (i = 0; i < N_LOOKUPS; ++i) {
+                /* look up covered addresses as well as random ones */
+                if (i % 2) {
+                        random_address(address, n_bytes);
+                } else {
+                        memcpy(address, routes[rand() % n_routes].prefix, n_bytes);
+                        address[n_bytes - 1] ^= rand() & 0xf;
+                }
+
+                e = c_rblpm_lookup(lpm, address);
+                r = brute_force(routes, n_routes, address);
+                if (r)
+                        assert(e && e->length == r->length && covers(r->prefix, r->length, address));
+                else
+                        assert(!e);
+        }
+}
+
+static void test_lpm(unsigned int n_bits, const unsigned int *lengths, size_t n_lengths) {
+        size_t i, n_bytes = n_bits / 8;
+        Route *routes;
+        CRBLpm lpm;
+        int r;
+
+        routes = calloc(N_ROUTES, sizeof(*routes));
+        assert(routes);
+
+        c_rblpm_init(&lpm, n_bits);
+        assert(c_rblpm_is_empty(&lpm));
+
+        for (i = 0; i < N_ROUTES; ++i) {
+                random_address(routes[i].prefix, n_bytes);
+                routes[i].length = lengths[rand() % n_lengths];
+                routes[i].lpm = (CRBLpmEntry)C_RBLPM_ENTRY_INIT(routes[i].lpm);
+
+                r = c_rblpm_add(&lpm, &routes[i].lpm, routes[i].prefix, routes[i].length);
+                if (r) {
+                        /* duplicates are rejected and not linked */
+                        assert(r == -EEXIST);
+                        assert(c_rblpm_find(&lpm, routes[i].prefix, routes[i].length));
+                        assert(!c_rbnode_is_linked(&routes[i].lpm.rb));
+                } else {
+                        assert(c_rblpm_find(&lpm, routes[i].prefix, routes[i].length) == &routes[i].lpm);
+                }
+        }
+
+        verify(&lpm, routes, N_ROUTES, n_bytes);
+
+        /* remove half the routes, which also drops some lengths entirely */
+        for (i = 0; i < N_ROUTES; i += 2)
+                if (c_rbnode_is_linked(&routes[i].lpm.rb))
+                        c_rblpm_remove(&lpm, &routes[i].lpm);
+
+        verify(&lpm, routes, N_ROUTES, n_bytes);
+
+        for (i = 0; i < N_ROUTES; ++i)
+                if (c_rbnode_is_linked(&routes[i].lpm.rb))
+                        c_rblpm_remove(&lpm, &routes[i].lpm);
+
+        assert(c_rblpm_is_empty(&lpm));
+        verify(&lpm, routes, N_ROUTES, n_bytes);
+
+        free(routes);
+}
+
+static void test_default(void) {
+        uint8_t address[4] = { 192, 168, 1, 1 }, zero[4] = {};
+        CRBLpmEntry def = C_RBLPM_ENTRY_INIT(def), net = C_RBLPM_ENTRY_INIT(net);
+        CRBLpm lpm;
+        int r;
+
+        c_rblpm_init(&lpm, 32);
+        assert(!c_rblpm_lookup(&lpm, address));
+
+        /* the default route covers everything */
+        r = c_rblpm_add(&lpm, &def, zero, 0);
+        assert(!r);
+        assert(c_rblpm_lookup(&lpm, address) == &def);
+
+        /* host bits of prefixes are ignored */
+        r = c_rblpm_add(&lpm, &net, address, 16);
+        assert(!r);
+        assert(c_rblpm_lookup(&lpm, address) == &net);
+        assert(c_rblpm_find(&lpm, (uint8_t[]){ 192, 168, 0, 0 }, 16) == &net);
+        assert(c_rblpm_lookup(&lpm, (uint8_t[]){ 192, 169, 0, 0 }) == &def);
+
+        c_rblpm_remove(&lpm, &net);
+        c_rblpm_remove(&lpm, &def);
+        assert(c_rblpm_is_empty(&lpm));
+}
+
+int main(int argc, char **argv) {
+        static const unsigned int lengths4[] = { 0, 8, 12, 16, 20, 22, 23, 24, 24, 24, 28, 32 };
+        static const unsigned int lengths6[] = { 16, 29, 32, 32, 40, 44, 48, 48, 48, 56, 64, 96, 127, 128 };
+
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_default();
+        test_lpm(32, lengths4, sizeof(lengths4) / sizeof(*lengths4));
+        test_lpm(128, lengths6, sizeof(lengths6) / sizeof(*lengths6));
+        return 0;
+}
@@ -29,6 +29,13 @@ static int test_compare(CRBTree *t, void *k, CRBNode *n) {
         return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
 }
 
+static void test_compare_batch(CRBTree *t, void **keys, CRBNode **nodes, int *results, size_t n) {
+        size_t i;
+
+        for (i = 0; i < n; ++i)
+                results[i] = test_compare(t, keys[i], nodes[i]);
+}
+
 static void shuffle(Node **nodes, size_t n_memb) {
         unsigned int i, j;
         Node *t;
@@ -44,7 +51,9 @@ static void shuffle(Node **nodes, size_t n_memb) {
 static void test_map(void) {
         CRBNode **slot, *p, *safe_p;
         CRBTree t = {};
+        CRBNode *found[3001];
         Node *n, *safe_n, *nodes[2048];
+        void *keys[3001];
         unsigned long i, v;
 
         /* allocate and initialize all nodes */
@@ -72,6 +81,22 @@ static void test_map(void) {
                 assert(nodes[i] == c_rbtree_find_entry(&t, test_compare, (void *)nodes[i]->key, Node, rb));
         }
 
+        /* verify batched lookups, including misses and a partial group */
+        for (i = 0; i < sizeof(keys) / sizeof(*keys); ++i)
+                keys[i] = (void *)(unsigned long)(rand() % (2 * sizeof(nodes) / sizeof(*nodes)));
+
+        for (v = 0; v < 2; ++v) {
+                memset(found, 0xff, sizeof(found));
+                c_rbtree_find_batch(&t,
+                                    v ? NULL : test_compare,
+                                    v ? test_compare_batch : NULL,
+                                    keys,
+                                    found,
+                                    sizeof(keys) / sizeof(*keys));
+                for (i = 0; i < sizeof(keys) / sizeof(*keys); ++i)
+                        assert(found[i] == c_rbtree_find_node(&t, test_compare, keys[i]));
+        }
+
         /* verify in-order traversal works */
         i = 0;
         v = 0;
@@ -5,6 +5,8 @@
 
 #undef NDEBUG
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,8 +61,205 @@ static void test_move(void) {
         assert(c_rbtree_is_empty(&t2));
 }
 
+typedef struct {
+        CRBNode *from;
+        CRBNode *to;
+        size_t n_left;
+} CloneContext;
+
+static int clone_node(CRBNode *n, CRBNode **copyp, void *userdata) {
+        CloneContext *ctx = userdata;
+
+        if (!ctx->n_left)
+                return -ENOMEM;
+
+        --ctx->n_left;
+        *copyp = &ctx->to[n - ctx->from];
+        return 0;
+}
+
+static void assert_same_shape(CRBNode *a, CRBNode *b, CRBNode *from, CRBNode *to) {
+        if (!a) {
+                assert(!b);
+                return;
+        }
+
+        /* copies are placed at the same index as their originals */
+        assert(b == &to[a - from]);
+        assert(c_rbnode_is_red(a) == c_rbnode_is_red(b));
+        assert(c_rbnode_is_root(a) == c_rbnode_is_root(b));
+        assert(!c_rbnode_parent(a) == !c_rbnode_parent(b));
+        assert(!c_rbnode_parent(a) || c_rbnode_parent(b) == &to[c_rbnode_parent(a) - from]);
+
+        assert_same_shape(a->left, b->left, from, to);
+        assert_same_shape(a->right, b->right, from, to);
+}
+
+static void test_clone(void) {
+        CRBTree t1 = C_RBTREE_INIT, t2 = C_RBTREE_INIT;
+        CRBNode n[512], m[512], *i, *safe;
+        CloneContext ctx = { .from = n, .to = m };
+        size_t j, n_nodes;
+        int r;
+
+        /* cloning an empty tree never calls the callback */
+        r = c_rbtree_clone(&t2, &t1, clone_node, &ctx);
+        assert(!r);
+        assert(c_rbtree_is_empty(&t2));
+
+        for (j = 0; j < sizeof(n) / sizeof(*n); ++j) {
+                n[j] = (CRBNode)C_RBNODE_INIT(n[j]);
+                insert(&t1, &n[j]);
+        }
+
+        /* remove some nodes, so the shape is not just insertion order */
+        for (j = 0; j < sizeof(n) / sizeof(*n); j += 3)
+                c_rbnode_unlink(&n[j]);
+
+        ctx.n_left = SIZE_MAX;
+        r = c_rbtree_clone(&t2, &t1, clone_node, &ctx);
+        assert(!r);
+        assert(c_rbnode_parent(t2.root) == NULL);
+        assert_same_shape(t1.root, t2.root, n, m);
+
+        /* the copy is a fully functional tree on its own */
+        for (j = 0; j < sizeof(m) / sizeof(*m); j += 3) {
+                m[j] = (CRBNode)C_RBNODE_INIT(m[j]);
+                insert(&t2, &m[j]);
+        }
+        for (j = 1; j < sizeof(m) / sizeof(*m); j += 3)
+                c_rbnode_unlink(&m[j]);
+        while (t2.root)
+                c_rbnode_unlink(t2.root);
+
+        /* partial copies are torn down via the postorder-unlink iterators */
+        for (n_nodes = 0; n_nodes < 16; ++n_nodes) {
+                ctx.n_left = n_nodes;
+                r = c_rbtree_clone(&t2, &t1, clone_node, &ctx);
+                assert(r == -ENOMEM);
+
+                j = 0;
+                c_rbtree_for_each_safe_postorder_unlink(i, safe, &t2)
+                        ++j;
+                assert(j == n_nodes);
+                assert(c_rbtree_is_empty(&t2));
+        }
+
+        while (t1.root)
+                c_rbnode_unlink(t1.root);
+}
+
+typedef struct {
+        CRBNode rb;
+        unsigned int key;
+        unsigned int value;
+        unsigned int max_value;
+} VisitNode;
+
+typedef struct {
+        unsigned int threshold;
+        size_t n_visited;
+        size_t n_matches;
+        size_t n_stop;
+        VisitNode *last;
+} VisitContext;
+
+#define visit_node_from_rb(_rb) c_rbnode_entry((_rb), VisitNode, rb)
+
+static _Bool visit_augment(CRBNode *n) {
+        VisitNode *v = visit_node_from_rb(n), *c;
+        unsigned int max = v->value;
+
+        if ((c = visit_node_from_rb(n->left)) && c->max_value > max)
+                max = c->max_value;
+        if ((c = visit_node_from_rb(n->right)) && c->max_value > max)
+                max = c->max_value;
+
+        if (v->max_value == max)
+                return 0;
+
+        v->max_value = max;
+        return 1;
+}
+
+static _Bool visit_descend(CRBNode *n, void *userdata) {
+        VisitContext *ctx = userdata;
+
+        return visit_node_from_rb(n)->max_value >= ctx->threshold;
+}
+
+static int visit_match(CRBNode *n, void *userdata) {
+        VisitContext *ctx = userdata;
+        VisitNode *v = visit_node_from_rb(n);
+
+        /* nodes are visited in order */
+        assert(!ctx->last || ctx->last->key < v->key);
+        ctx->last = v;
+
+        ++ctx->n_visited;
+        if (v->value >= ctx->threshold && ++ctx->n_matches == ctx->n_stop)
+                return 7;
+        return 0;
+}
+
+static void test_visit(void) {
+        CRBTree t = C_RBTREE_INIT;
+        VisitContext ctx;
+        VisitNode v[512];
+        size_t i, j, n_matches, n_visited, n_nodes = sizeof(v) / sizeof(*v);
+        CRBNode *p;
+        int r;
+
+        /* empty trees never call any callback */
+        r = c_rbtree_visit(&t, NULL, visit_match, NULL);
+        assert(!r);
+
+        for (i = 0; i < n_nodes; ++i) {
+                v[i] = (VisitNode){ .rb = C_RBNODE_INIT(v[i].rb), .key = i, .value = rand() % 4096 };
+                v[i].max_value = v[i].value;
+                p = c_rbtree_last(&t);
+                c_rbtree_add_augmented(&t, p, p ? &p->right : &t.root, &v[i].rb, visit_augment);
+        }
+
+        /* without pruning, all nodes are visited */
+        ctx = (VisitContext){ .threshold = 0 };
+        r = c_rbtree_visit(&t, NULL, visit_match, &ctx);
+        assert(!r);
+        assert(ctx.n_visited == n_nodes && ctx.n_matches == n_nodes);
+
+        for (j = 0; j < 64; ++j) {
+                ctx = (VisitContext){ .threshold = rand() % 4200 };
+                for (i = 0, n_matches = 0, n_visited = 0; i < n_nodes; ++i) {
+                        n_matches += v[i].value >= ctx.threshold;
+                        n_visited += v[i].max_value >= ctx.threshold;
+                }
+
+                /* all matches are found, and only their ancestors are visited besides */
+                r = c_rbtree_visit(&t, visit_descend, visit_match, &ctx);
+                assert(!r);
+                assert(ctx.n_matches == n_matches);
+                assert(ctx.n_visited == n_visited);
+
+                /* the first non-zero return value stops the search */
+                if (n_matches > 1) {
+                        ctx = (VisitContext){ .threshold = ctx.threshold, .n_stop = n_matches / 2 };
+                        r = c_rbtree_visit(&t, visit_descend, visit_match, &ctx);
+                        assert(r == 7);
+                        assert(ctx.n_matches == n_matches / 2);
+                }
+        }
+
+        while (t.root)
+                c_rbnode_unlink_augmented(t.root, visit_augment);
+}
+
 int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
         test_move();
+        test_clone();
+        test_visit();
 
         return 0;
 }
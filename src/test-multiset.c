@@ -0,0 +1,151 @@
+/*
+ * Tests for Counted Multisets
+ * This adds and removes random keys with random multiplicities, and verifies
+ * counts, subtree totals, ranks, and selection against a plain array of
+ * counts after each step.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbmultiset.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_KEYS 128
+#define N_STEPS 20000
+
+typedef struct {
+        unsigned long key;
+        CRBMultisetEntry ms;
+} Node;
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = c_rbnode_entry(n, Node, ms.rb);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static size_t validate_subtree(CRBNode *n) {
+        CRBMultisetEntry *e;
+        size_t total;
+
+        if (!n)
+                return 0;
+
+        e = c_rbnode_entry(n, CRBMultisetEntry, rb);
+        assert(e->count > 0);
+
+        total = validate_subtree(n->left) + e->count + validate_subtree(n->right);
+        assert(e->n_subtree == total);
+
+        return total;
+}
+
+static void verify(CRBMultiset *s, Node *nodes, const size_t *counts) {
+        size_t i, j, rank = 0;
+
+        assert(validate_subtree(s->tree.root) == c_rbmultiset_size(s));
+
+        for (i = 0; i < N_KEYS; ++i) {
+                if (!counts[i]) {
+                        assert(!c_rbmultiset_find(s, compare, (void *)i));
+                        continue;
+                }
+
+                assert(c_rbmultiset_find(s, compare, (void *)i) == &nodes[i].ms);
+                assert(nodes[i].ms.count == counts[i]);
+                assert(c_rbmultiset_rank(s, &nodes[i].ms) == rank);
+
+                for (j = 0; j < counts[i]; ++j)
+                        assert(c_rbmultiset_select(s, rank + j) == &nodes[i].ms);
+
+                rank += counts[i];
+        }
+
+        assert(rank == c_rbmultiset_size(s));
+        assert(!c_rbmultiset_select(s, rank));
+        assert(c_rbmultiset_is_empty(s) == !rank);
+}
+
+static void test_random(void) {
+        CRBMultisetEntry *e;
+        size_t counts[N_KEYS] = {}, i, k, n;
+        Node nodes[N_KEYS];
+        CRBMultiset s;
+        bool unlinked;
+
+        c_rbmultiset_init(&s);
+        assert(c_rbmultiset_is_empty(&s));
+        assert(!c_rbmultiset_size(&s));
+
+        for (i = 0; i < N_KEYS; ++i) {
+                nodes[i].key = i;
+                nodes[i].ms = (CRBMultisetEntry)C_RBMULTISET_ENTRY_INIT(nodes[i].ms);
+        }
+
+        for (i = 0; i < N_STEPS; ++i) {
+                k = rand() % N_KEYS;
+
+                if (rand() % 2) {
+                        n = 1 + rand() % 8;
+                        e = c_rbmultiset_add(&s, compare, (void *)k, &nodes[k].ms, n);
+                        assert(e == &nodes[k].ms);
+                        counts[k] += n;
+                } else if (counts[k]) {
+                        n = 1 + rand() % counts[k];
+                        unlinked = c_rbmultiset_remove(&s, &nodes[k].ms, n);
+                        counts[k] -= n;
+                        assert(unlinked == !counts[k]);
+                        assert(c_rbnode_is_linked(&nodes[k].ms.rb) == !!counts[k]);
+                }
+
+                if (!(i % 64))
+                        verify(&s, nodes, counts);
+        }
+
+        verify(&s, nodes, counts);
+
+        for (k = 0; k < N_KEYS; ++k)
+                if (counts[k])
+                        assert(c_rbmultiset_remove(&s, &nodes[k].ms, counts[k]));
+
+        assert(c_rbmultiset_is_empty(&s));
+}
+
+static void test_duplicates(void) {
+        Node a = { .key = 1, .ms = C_RBMULTISET_ENTRY_INIT(a.ms) };
+        Node b = { .key = 1, .ms = C_RBMULTISET_ENTRY_INIT(b.ms) };
+        CRBMultiset s;
+
+        c_rbmultiset_init(&s);
+
+        /* a second entry of a known key is left untouched */
+        assert(c_rbmultiset_add(&s, compare, (void *)1UL, &a.ms, 1) == &a.ms);
+        assert(c_rbmultiset_add(&s, compare, (void *)1UL, &b.ms, 1000000) == &a.ms);
+        assert(!c_rbnode_is_linked(&b.ms.rb));
+        assert(a.ms.count == 1000001);
+        assert(c_rbmultiset_size(&s) == 1000001);
+
+        assert(c_rbmultiset_select(&s, 1000000) == &a.ms);
+        assert(!c_rbmultiset_select(&s, 1000001));
+
+        assert(!c_rbmultiset_remove(&s, &a.ms, 1000000));
+        assert(c_rbmultiset_remove(&s, &a.ms, 1));
+        assert(c_rbmultiset_is_empty(&s));
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_duplicates();
+        test_random();
+        return 0;
+}
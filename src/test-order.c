@@ -0,0 +1,180 @@
+/*
+ * Tests for Order-Maintenance Labels
+ * This adds and removes random keys, and verifies after each step that labels
+ * increase strictly in tree order, and that comparing labels of random pairs
+ * of entries agrees with comparing their keys. It then stresses relabelling
+ * with insertion patterns that use up gaps quickly: always inserting at the
+ * same position, and always inserting at either end.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rborder.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_KEYS 256
+#define N_STEPS 20000
+#define N_DENSE 20000
+
+typedef struct {
+        unsigned long key;
+        CRBOrderEntry o;
+} Node;
+
+#define node_from_rb(_rb) c_rbnode_entry((_rb), Node, o.rb)
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = node_from_rb(n);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void add(CRBOrder *o, Node *node) {
+        CRBNode **slot, *p;
+
+        slot = c_rbtree_find_slot(&o->tree, compare, (void *)node->key, &p);
+        assert(slot);
+        c_rborder_add(o, p, slot, &node->o);
+}
+
+static size_t verify(CRBOrder *o) {
+        Node *node, *prev = NULL;
+        size_t n_entries = 0;
+        CRBNode *n;
+
+        c_rbtree_for_each(n, &o->tree) {
+                node = node_from_rb(n);
+                if (prev) {
+                        assert(prev->o.label < node->o.label);
+                        assert(c_rborder_precedes(&prev->o, &node->o));
+                        assert(!c_rborder_precedes(&node->o, &prev->o));
+                        assert(c_rborder_compare(&prev->o, &node->o) == -1);
+                        assert(c_rborder_compare(&node->o, &prev->o) == 1);
+                }
+                assert(c_rborder_compare(&node->o, &node->o) == 0);
+                prev = node;
+                ++n_entries;
+        }
+
+        assert(n_entries == o->n_entries);
+        assert(c_rborder_is_empty(o) == !n_entries);
+        return n_entries;
+}
+
+static void test_random(void) {
+        CRBOrder o = C_RBORDER_INIT;
+        bool linked[N_KEYS] = {};
+        Node nodes[N_KEYS];
+        size_t i, j, k;
+
+        for (i = 0; i < N_KEYS; ++i) {
+                nodes[i].key = i;
+                nodes[i].o = (CRBOrderEntry)C_RBORDER_ENTRY_INIT(nodes[i].o);
+        }
+
+        verify(&o);
+
+        for (i = 0; i < N_STEPS; ++i) {
+                k = rand() % N_KEYS;
+
+                if (!linked[k]) {
+                        add(&o, &nodes[k]);
+                } else {
+                        c_rborder_remove(&o, &nodes[k].o);
+                        assert(!c_rbnode_is_linked(&nodes[k].o.rb));
+                }
+
+                linked[k] = !linked[k];
+
+                if (!(i % 32)) {
+                        verify(&o);
+
+                        /* labels agree with keys for random pairs */
+                        for (j = 0; j < 64; ++j) {
+                                Node *a = &nodes[rand() % N_KEYS], *b = &nodes[rand() % N_KEYS];
+
+                                if (!linked[a->key] || !linked[b->key])
+                                        continue;
+
+                                assert(c_rborder_precedes(&a->o, &b->o) == (a->key < b->key));
+                                assert(c_rborder_compare(&a->o, &b->o) == compare(NULL, (void *)a->key, &b->o.rb));
+                        }
+                }
+        }
+
+        for (i = 0; i < N_KEYS; ++i)
+                if (linked[i])
+                        c_rborder_remove(&o, &nodes[i].o);
+
+        assert(verify(&o) == 0);
+        assert(c_rbtree_is_empty(&o.tree));
+}
+
+static void test_dense(void) {
+        CRBOrder o;
+        Node *nodes;
+        size_t i;
+
+        nodes = calloc(N_DENSE, sizeof(*nodes));
+        assert(nodes);
+
+        /*
+         * Insert each key right after the first one, so all insertions hit
+         * the same gap, which is used up after 64 insertions. Keys are
+         * assigned such that the tree order matches this.
+         */
+        c_rborder_init(&o);
+        for (i = 0; i < N_DENSE; ++i) {
+                nodes[i].key = i ? 2UL * N_DENSE - i : 0;
+                c_rbnode_init(&nodes[i].o.rb);
+                add(&o, &nodes[i]);
+                if (!(i % 1024))
+                        verify(&o);
+        }
+        assert(verify(&o) == N_DENSE);
+
+        /* relabels must be amortized, rather than linear per insertion */
+        assert(o.n_relabeled < (size_t)N_DENSE * 64);
+
+        for (i = 0; i < N_DENSE; ++i)
+                c_rborder_remove(&o, &nodes[i].o);
+        assert(verify(&o) == 0);
+
+        /* append at alternating ends, which uses up the outer labels */
+        c_rborder_init(&o);
+        for (i = 0; i < N_DENSE; ++i) {
+                nodes[i].key = (i % 2) ? N_DENSE + i : N_DENSE - i;
+                add(&o, &nodes[i]);
+                if (!(i % 1024))
+                        verify(&o);
+        }
+        assert(verify(&o) == N_DENSE);
+        assert(o.n_relabeled < (size_t)N_DENSE * 64);
+
+        /* labels survive removal of every other entry, and refilling */
+        for (i = 0; i < N_DENSE; i += 2)
+                c_rborder_remove(&o, &nodes[i].o);
+        assert(verify(&o) == N_DENSE / 2);
+        for (i = 0; i < N_DENSE; i += 2)
+                add(&o, &nodes[i]);
+        assert(verify(&o) == N_DENSE);
+
+        free(nodes);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_random();
+        test_dense();
+        return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Tests for Partitioned Trees
+ * This runs a set of writer threads, each inserting into its own partition
+ * without any locking. Afterwards, it verifies the merge view and the
+ * consolidation into the global tree.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbpartition.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_PARTITIONS 8
+#define N_NODES 4096
+
+typedef struct {
+        unsigned long key;
+        CRBNode rb;
+} Node;
+
+typedef struct {
+        CRBPartitions *partitions;
+        size_t idx;
+        Node *nodes;
+        size_t n_nodes;
+} Writer;
+
+#define node_from_rb(_rb) ((Node *)((char *)(_rb) - offsetof(Node, rb)))
+
+static int compare(CRBNode *a, CRBNode *b) {
+        Node *x = node_from_rb(a), *y = node_from_rb(b);
+
+        return (x->key < y->key) ? -1 : (x->key > y->key) ? 1 : 0;
+}
+
+static int compare_key(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = node_from_rb(n);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static size_t validate(CRBTree *t) {
+        unsigned int n_black = 0, i_black;
+        CRBNode *n, *p;
+        size_t count = 0;
+
+        assert(!t->root || c_rbnode_is_black(t->root));
+
+        c_rbtree_for_each(n, t) {
+                ++count;
+
+                assert(!n->left || c_rbnode_parent(n->left) == n);
+                assert(!n->right || c_rbnode_parent(n->right) == n);
+                assert(!c_rbnode_next(n) || compare(n, c_rbnode_next(n)) <= 0);
+
+                if (c_rbnode_is_red(n)) {
+                        assert(!n->left || c_rbnode_is_black(n->left));
+                        assert(!n->right || c_rbnode_is_black(n->right));
+                }
+
+                if (!n->left || !n->right) {
+                        i_black = 0;
+                        for (p = n; p; p = c_rbnode_parent(p))
+                                i_black += c_rbnode_is_black(p);
+                        assert(!n_black || n_black == i_black);
+                        n_black = i_black;
+                }
+        }
+
+        return count;
+}
+
+static void *writer_fn(void *userdata) {
+        Writer *w = userdata;
+        size_t i;
+
+        for (i = 0; i < w->n_nodes; ++i)
+                c_rbpartitions_add(w->partitions, w->idx, &w->nodes[i].rb);
+
+        return NULL;
+}
+
+static void verify(CRBPartitions *ps, size_t n_nodes) {
+        CRBNode *cursors[N_PARTITIONS + 1], *n, *prev = NULL;
+        CRBPartitionsIter iter;
+        size_t i = 0;
+
+        c_rbpartitions_for_each(n, &iter, ps, cursors) {
+                assert(!prev || compare(prev, n) <= 0);
+                prev = n;
+                ++i;
+        }
+        assert(i == n_nodes);
+}
+
+static void test_partitions(void) {
+        CRBPartition partitions[N_PARTITIONS];
+        pthread_t threads[N_PARTITIONS];
+        Writer writers[N_PARTITIONS];
+        CRBPartitions ps;
+        Node *nodes;
+        size_t i;
+        int r;
+
+        nodes = malloc(sizeof(*nodes) * N_NODES * 2);
+        assert(nodes);
+
+        /* keys are pseudo-random, with plenty of duplicates */
+        for (i = 0; i < N_NODES * 2; ++i)
+                nodes[i].key = rand() % (N_NODES / 2);
+
+        c_rbpartitions_init(&ps, compare, partitions, N_PARTITIONS);
+
+        /* run two rounds of parallel writers, consolidate after each */
+        for (unsigned int round = 0; round < 2; ++round) {
+                for (i = 0; i < N_PARTITIONS; ++i) {
+                        writers[i] = (Writer){
+                                .partitions = &ps,
+                                .idx = i,
+                                .nodes = nodes + round * N_NODES + i * (N_NODES / N_PARTITIONS),
+                                .n_nodes = N_NODES / N_PARTITIONS,
+                        };
+                        r = pthread_create(&threads[i], NULL, writer_fn, &writers[i]);
+                        assert(!r);
+                }
+
+                for (i = 0; i < N_PARTITIONS; ++i) {
+                        r = pthread_join(threads[i], NULL);
+                        assert(!r);
+                        assert(validate(&partitions[i].tree) == N_NODES / N_PARTITIONS);
+                }
+
+                verify(&ps, (round + 1) * N_NODES);
+
+                for (i = round * N_NODES; i < (round + 1) * N_NODES; ++i)
+                        assert(c_rbpartitions_find(&ps, compare_key, (void *)nodes[i].key));
+
+                c_rbpartitions_consolidate(&ps);
+
+                for (i = 0; i < N_PARTITIONS; ++i)
+                        assert(c_rbtree_is_empty(&partitions[i].tree));
+                assert(validate(&ps.tree) == (round + 1) * N_NODES);
+
+                verify(&ps, (round + 1) * N_NODES);
+        }
+
+        /* the global tree must be usable as a normal tree */
+        for (i = 0; i < N_NODES * 2; i += 2)
+                c_rbnode_unlink(&nodes[i].rb);
+        assert(validate(&ps.tree) == N_NODES);
+
+        c_rbpartitions_consolidate(&ps);
+        assert(validate(&ps.tree) == N_NODES);
+
+        free(nodes);
+}
+
+static void test_stable(void) {
+        CRBNode *cursors[3], *n;
+        CRBPartition partitions[2];
+        CRBPartitionsIter iter;
+        CRBPartitions ps;
+        Node nodes[6];
+        size_t i;
+
+        /* all nodes compare equal, so the merge order must be stable */
+        for (i = 0; i < 6; ++i)
+                nodes[i].key = 0;
+
+        c_rbpartitions_init(&ps, compare, partitions, 2);
+        c_rbpartitions_add(&ps, 1, &nodes[4].rb);
+        c_rbpartitions_add(&ps, 1, &nodes[5].rb);
+        c_rbpartitions_add(&ps, 0, &nodes[2].rb);
+        c_rbpartitions_add(&ps, 0, &nodes[3].rb);
+        c_rbtree_add(&ps.tree, NULL, &ps.tree.root, &nodes[0].rb);
+        c_rbnode_link(&nodes[0].rb, &nodes[0].rb.right, &nodes[1].rb);
+
+        i = 0;
+        c_rbpartitions_for_each(n, &iter, &ps, cursors)
+                assert(n == &nodes[i++].rb);
+        assert(i == 6);
+
+        c_rbpartitions_consolidate(&ps);
+
+        i = 0;
+        c_rbtree_for_each(n, &ps.tree)
+                assert(n == &nodes[i++].rb);
+        assert(i == 6);
+}
+
+static int compare_layout(CRBNode *a, CRBNode *b) {
+        return 0;
+}
+
+static void test_layout(void) {
+        CRBPartition stack[3], *heap;
+        CRBPartitions ps;
+        size_t i;
+
+        /* each partition occupies exactly one cache-line of its own */
+        heap = aligned_alloc(alignof(CRBPartition), 3 * sizeof(*heap));
+        assert(heap);
+
+        for (i = 0; i < 3; ++i) {
+                assert(!((uintptr_t)&stack[i] % 64));
+                assert(!((uintptr_t)&heap[i] % 64));
+        }
+
+        c_rbpartitions_init(&ps, compare_layout, stack, 3);
+        c_rbpartitions_init(&ps, compare_layout, heap, 3);
+
+        free(heap);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_partitions();
+        test_stable();
+        test_layout();
+        return 0;
+}
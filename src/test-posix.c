@@ -51,6 +51,7 @@
 #include <time.h>
 
 #include "c-rbtree.h"
+#include "c-rbtree-bench.h"
 #include "c-rbtree-private.h"
 
 typedef struct {
@@ -80,15 +81,6 @@ static int compare(CRBTree *t, void *k, CRBNode *n) {
         return key - node->key;
 }
 
-static uint64_t now(void) {
-        struct timespec ts;
-        int r;
-
-        r = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
-        assert(r >= 0);
-        return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
-}
-
 /*
  * POSIX tsearch(3p) based RB-Tree API
  *
@@ -166,15 +158,18 @@ static void posix_rbtree_traverse(PosixRBTree *t) {
  */
 
 static void test_posix(void) {
-        uint64_t ts, ts_c1, ts_c2, ts_c3, ts_c4;
-        uint64_t ts_p1, ts_p2, ts_p3, ts_p4;
+        CRBBenchSample s_c1, s_c2, s_c3, s_c4;
+        CRBBenchSample s_p1, s_p2, s_p3, s_p4;
         PosixRBTree pt = {};
+        CRBBench b;
         CRBNode **slot, *p;
         CRBTree t = {};
         Node *nodes[2048];
         unsigned long i;
         int v;
 
+        c_rbbench_init(&b);
+
         /* allocate and initialize all nodes */
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i) {
                 nodes[i] = malloc(sizeof(*nodes[i]));
@@ -187,24 +182,24 @@ static void test_posix(void) {
         shuffle(nodes, sizeof(nodes) / sizeof(*nodes));
 
         /* add all nodes, and verify that each node is linked */
-        ts = now();
+        c_rbbench_start(&b, &s_c1);
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i) {
                 slot = c_rbtree_find_slot(&t, compare, (void *)(unsigned long)nodes[i]->key, &p);
                 assert(slot);
                 c_rbtree_add(&t, p, slot, &nodes[i]->rb);
         }
-        ts_c1 = now() - ts;
+        c_rbbench_stop(&b, &s_c1);
 
-        ts = now();
+        c_rbbench_start(&b, &s_p1);
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i)
                 posix_rbtree_add(&pt, nodes[i]);
-        ts_p1 = now() - ts;
+        c_rbbench_stop(&b, &s_p1);
 
         /* shuffle nodes again */
         shuffle(nodes, sizeof(nodes) / sizeof(*nodes));
 
         /* traverse tree in-order */
-        ts = now();
+        c_rbbench_start(&b, &s_c2);
         i = 0;
         v = 0;
         for (p = c_rbtree_first(&t); p; p = c_rbnode_next(p)) {
@@ -214,51 +209,58 @@ static void test_posix(void) {
                 v = node_from_rb(p)->key;
         }
         assert(i == sizeof(nodes) / sizeof(*nodes));
-        ts_c2 = now() - ts;
+        c_rbbench_stop(&b, &s_c2);
 
-        ts = now();
+        c_rbbench_start(&b, &s_p2);
         posix_rbtree_traverse(&pt);
-        ts_p2 = now() - ts;
+        c_rbbench_stop(&b, &s_p2);
 
         /* shuffle nodes again */
         shuffle(nodes, sizeof(nodes) / sizeof(*nodes));
 
         /* lookup all nodes (in different order) */
-        ts = now();
+        c_rbbench_start(&b, &s_c3);
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i)
                 assert(nodes[i] == c_rbtree_find_entry(&t, compare,
                                                        (void *)(unsigned long)nodes[i]->key,
                                                        Node, rb));
-        ts_c3 = now() - ts;
+        c_rbbench_stop(&b, &s_c3);
 
-        ts = now();
+        c_rbbench_start(&b, &s_p3);
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i)
                 assert(nodes[i] == posix_rbtree_find(&pt, nodes[i]->key));
-        ts_p3 = now() - ts;
+        c_rbbench_stop(&b, &s_p3);
 
         /* shuffle nodes again */
         shuffle(nodes, sizeof(nodes) / sizeof(*nodes));
 
         /* remove all nodes (in different order) */
-        ts = now();
+        c_rbbench_start(&b, &s_c4);
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i)
                 c_rbnode_unlink(&nodes[i]->rb);
-        ts_c4 = now() - ts;
+        c_rbbench_stop(&b, &s_c4);
 
-        ts = now();
+        c_rbbench_start(&b, &s_p4);
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i)
                 posix_rbtree_remove(&pt, nodes[i]);
-        ts_p4 = now() - ts;
+        c_rbbench_stop(&b, &s_p4);
 
         /* free nodes again */
         for (i = 0; i < sizeof(nodes) / sizeof(*nodes); ++i)
                 free(nodes[i]);
 
-        fprintf(stderr, "              insertion  traversal     lookup    removal\n");
-        fprintf(stderr, "   c-rbtree: %8"PRIu64"ns %8"PRIu64"ns %8"PRIu64"ns %8"PRIu64"ns\n",
-                ts_c1, ts_c2, ts_c3, ts_c4);
-        fprintf(stderr, "tsearch(3p): %8"PRIu64"ns %8"PRIu64"ns %8"PRIu64"ns %8"PRIu64"ns\n",
-                ts_p1, ts_p2, ts_p3, ts_p4);
+        c_rbbench_deinit(&b);
+
+        /* print per-operation costs */
+        c_rbbench_print_header("");
+        c_rbbench_print("c-rbtree insertion", &s_c1, sizeof(nodes) / sizeof(*nodes));
+        c_rbbench_print("tsearch(3p) insertion", &s_p1, sizeof(nodes) / sizeof(*nodes));
+        c_rbbench_print("c-rbtree traversal", &s_c2, sizeof(nodes) / sizeof(*nodes));
+        c_rbbench_print("tsearch(3p) traversal", &s_p2, sizeof(nodes) / sizeof(*nodes));
+        c_rbbench_print("c-rbtree lookup", &s_c3, sizeof(nodes) / sizeof(*nodes));
+        c_rbbench_print("tsearch(3p) lookup", &s_p3, sizeof(nodes) / sizeof(*nodes));
+        c_rbbench_print("c-rbtree removal", &s_c4, sizeof(nodes) / sizeof(*nodes));
+        c_rbbench_print("tsearch(3p) removal", &s_p4, sizeof(nodes) / sizeof(*nodes));
 }
 
 int main(int argc, char **argv) {
@@ -0,0 +1,166 @@
+/*
+ * Tests for Radix-Sharded Trees
+ * This fills radix-sharded trees with random keys of different widths and
+ * distributions, so the shard table grows several times, and verifies
+ * lookups and ordered iteration against a sorted array of all keys.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbradix.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_ENTRIES (1 << 16)
+
+static uint64_t random_key(unsigned int n_key_bits, bool clustered) {
+        uint64_t key;
+
+        key = (uint64_t)rand() << 62 ^ (uint64_t)rand() << 31 ^ (uint64_t)rand();
+        if (n_key_bits < 64)
+                key &= (UINT64_C(1) << n_key_bits) - 1;
+
+        /* clustered keys all land in few shards */
+        if (clustered)
+                key &= 0xffffff;
+
+        return key;
+}
+
+static int compare_key(const void *a, const void *b) {
+        uint64_t ka = *(const uint64_t *)a, kb = *(const uint64_t *)b;
+
+        return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+static void verify(CRBRadix *r, CRBRadixEntry *entries, size_t n_entries) {
+        CRBRadixEntry *e;
+        uint64_t *keys;
+        size_t i, n = 0;
+
+        keys = malloc(n_entries * sizeof(*keys));
+        assert(keys);
+
+        for (i = 0; i < n_entries; ++i)
+                if (c_rbnode_is_linked(&entries[i].rb))
+                        keys[n++] = entries[i].key;
+
+        qsort(keys, n, sizeof(*keys), compare_key);
+
+        i = 0;
+        c_rbradix_for_each(e, r) {
+                assert(i < n);
+                assert(e->key == keys[i]);
+                assert(c_rbradix_find(r, e->key) == e);
+                ++i;
+        }
+        assert(i == n);
+        assert(r->n_entries == n);
+
+        free(keys);
+}
+
+static void test_radix(unsigned int n_key_bits, bool clustered) {
+        CRBRadixEntry *entries;
+        unsigned int n_shard_bits = 0;
+        CRBRadix r;
+        uint64_t key;
+        size_t i;
+        int e;
+
+        entries = calloc(N_ENTRIES, sizeof(*entries));
+        assert(entries);
+
+        c_rbradix_init(&r, n_key_bits);
+        assert(c_rbradix_is_empty(&r));
+        assert(!c_rbradix_first(&r));
+
+        for (i = 0; i < N_ENTRIES; ++i) {
+                entries[i] = (CRBRadixEntry)C_RBRADIX_ENTRY_INIT(entries[i]);
+
+                key = random_key(n_key_bits, clustered);
+                e = c_rbradix_add(&r, &entries[i], key);
+                if (e) {
+                        /* duplicates are rejected and not linked */
+                        assert(e == -EEXIST);
+                        assert(c_rbradix_find(&r, key));
+                        assert(!c_rbnode_is_linked(&entries[i].rb));
+                } else {
+                        assert(c_rbradix_find(&r, key) == &entries[i]);
+                }
+
+                /* the table only ever grows */
+                assert(r.n_shard_bits >= n_shard_bits);
+                n_shard_bits = r.n_shard_bits;
+
+                if (!(i % 8192))
+                        verify(&r, entries, i + 1);
+        }
+
+        assert(r.n_shard_bits > 0);
+        verify(&r, entries, N_ENTRIES);
+
+        /* remove every other entry, which leaves some shards empty */
+        for (i = 0; i < N_ENTRIES; i += 2) {
+                if (c_rbnode_is_linked(&entries[i].rb)) {
+                        key = entries[i].key;
+                        c_rbradix_remove(&r, &entries[i]);
+                        assert(c_rbradix_find(&r, key) != &entries[i]);
+                }
+        }
+
+        verify(&r, entries, N_ENTRIES);
+
+        c_rbradix_deinit(&r);
+        assert(c_rbradix_is_empty(&r));
+        assert(!r.shards && !r.n_shard_bits);
+
+        for (i = 0; i < N_ENTRIES; ++i)
+                assert(!c_rbnode_is_linked(&entries[i].rb));
+
+        free(entries);
+}
+
+static void test_narrow(void) {
+        CRBRadixEntry entries[256];
+        CRBRadixEntry *e;
+        CRBRadix r;
+        size_t i;
+        int v;
+
+        /* with 8bit keys, the table never exceeds 8 shard bits */
+        c_rbradix_init(&r, 8);
+
+        for (i = 0; i < 256; ++i) {
+                entries[i] = (CRBRadixEntry)C_RBRADIX_ENTRY_INIT(entries[i]);
+                v = c_rbradix_add(&r, &entries[i], 255 - i);
+                assert(!v);
+        }
+
+        assert(r.n_shard_bits <= 8);
+
+        i = 0;
+        c_rbradix_for_each(e, &r)
+                assert(e->key == i++);
+        assert(i == 256);
+
+        c_rbradix_deinit(&r);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_narrow();
+        test_radix(32, false);
+        test_radix(64, false);
+        test_radix(64, true);
+        return 0;
+}
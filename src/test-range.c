@@ -0,0 +1,206 @@
+/*
+ * Tests for Range Sets
+ * This runs random insertions, removals, and allocations on a range set, and
+ * verifies it against a bitmap after each step. It also verifies that ranges
+ * are coalesced, and that the augmented range lengths are correct, which
+ * covers the augmentation paths of the tree implementation.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbrange.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_VALUES 512
+#define N_STEPS 20000
+
+static size_t validate_subtree(CRBNode *n, uint64_t *max_lengthp) {
+        uint64_t max_length, left, right;
+        size_t n_black, n_right;
+        CRBRange *r;
+
+        if (!n) {
+                *max_lengthp = 0;
+                return 0;
+        }
+
+        r = c_rbnode_entry(n, CRBRange, rb);
+
+        if (c_rbnode_is_red(n)) {
+                assert(!n->left || c_rbnode_is_black(n->left));
+                assert(!n->right || c_rbnode_is_black(n->right));
+        }
+
+        n_black = validate_subtree(n->left, &left);
+        n_right = validate_subtree(n->right, &right);
+        assert(n_black == n_right);
+
+        max_length = r->end - r->start;
+        if (left > max_length)
+                max_length = left;
+        if (right > max_length)
+                max_length = right;
+
+        assert(r->max_length == max_length);
+        *max_lengthp = max_length;
+
+        return n_black + c_rbnode_is_black(n);
+}
+
+static void validate(CRBRangeSet *s, const bool *values) {
+        uint64_t max_length, v = 0;
+        CRBRange *r, *prev = NULL;
+
+        assert(!s->tree.root || c_rbnode_is_black(s->tree.root));
+        validate_subtree(s->tree.root, &max_length);
+
+        c_rbrangeset_for_each(r, s) {
+                assert(r->start < r->end);
+                assert(r->end <= N_VALUES);
+
+                /* ranges must neither overlap nor touch */
+                assert(!prev || prev->end < r->start);
+
+                for ( ; v < r->start; ++v)
+                        assert(!values[v]);
+                for ( ; v < r->end; ++v)
+                        assert(values[v]);
+
+                prev = r;
+        }
+
+        for ( ; v < N_VALUES; ++v)
+                assert(!values[v]);
+}
+
+static bool first_fit(const bool *values, uint64_t size, uint64_t *startp) {
+        uint64_t v, n = 0;
+
+        for (v = 0; v < N_VALUES; ++v) {
+                n = values[v] ? n + 1 : 0;
+                if (n == size) {
+                        *startp = v + 1 - size;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+static void test_random(void) {
+        uint64_t i, v, start, end, expected;
+        bool values[N_VALUES] = {}, all;
+        CRBRangeSet s;
+        int r;
+
+        c_rbrangeset_init(&s);
+
+        for (i = 0; i < N_STEPS; ++i) {
+                start = rand() % N_VALUES;
+                end = start + 1 + rand() % 16;
+                if (end > N_VALUES)
+                        end = N_VALUES;
+
+                switch (rand() % 4) {
+                case 0:
+                case 1:
+                        r = c_rbrangeset_insert(&s, start, end);
+                        assert(!r);
+                        for (v = start; v < end; ++v)
+                                values[v] = true;
+                        break;
+                case 2:
+                        r = c_rbrangeset_remove(&s, start, end);
+                        assert(!r);
+                        for (v = start; v < end; ++v)
+                                values[v] = false;
+                        break;
+                case 3:
+                        r = c_rbrangeset_allocate(&s, end - start, &v);
+                        if (first_fit(values, end - start, &expected)) {
+                                assert(!r);
+                                assert(v == expected);
+                                for ( ; v < expected + end - start; ++v)
+                                        values[v] = false;
+                        } else {
+                                assert(r == -ENOSPC);
+                        }
+                        break;
+                }
+
+                for (all = true, v = start; v < end; ++v)
+                        all = all && values[v];
+                assert(c_rbrangeset_contains(&s, start, end) == all);
+
+                validate(&s, values);
+        }
+
+        c_rbrangeset_deinit(&s);
+        assert(c_rbrangeset_is_empty(&s));
+}
+
+static void test_coalesce(void) {
+        uint64_t start;
+        CRBRangeSet s;
+        CRBRange *r;
+        int e;
+
+        c_rbrangeset_init(&s);
+
+        /* adjacent ranges are merged, even if inserted out of order */
+        e = c_rbrangeset_insert(&s, 10, 20);
+        assert(!e);
+        e = c_rbrangeset_insert(&s, 30, 40);
+        assert(!e);
+        e = c_rbrangeset_insert(&s, 20, 30);
+        assert(!e);
+
+        r = c_rbnode_entry(s.tree.root, CRBRange, rb);
+        assert(r->start == 10 && r->end == 40);
+        assert(!r->rb.left && !r->rb.right);
+        assert(c_rbrangeset_contains(&s, 10, 40));
+        assert(!c_rbrangeset_contains(&s, 9, 40));
+        assert(!c_rbrangeset_contains(&s, 10, 41));
+
+        /* removing from the middle splits */
+        e = c_rbrangeset_remove(&s, 15, 35);
+        assert(!e);
+        assert(c_rbrangeset_contains(&s, 10, 15));
+        assert(c_rbrangeset_contains(&s, 35, 40));
+        assert(!c_rbrangeset_contains(&s, 14, 16));
+
+        /* first fit skips ranges that are too small */
+        e = c_rbrangeset_allocate(&s, 6, &start);
+        assert(e == -ENOSPC);
+        e = c_rbrangeset_allocate(&s, 5, &start);
+        assert(!e && start == 10);
+        e = c_rbrangeset_allocate(&s, 5, &start);
+        assert(!e && start == 35);
+        assert(c_rbrangeset_is_empty(&s));
+
+        /* the full value space is supported */
+        e = c_rbrangeset_insert(&s, 0, UINT64_MAX);
+        assert(!e);
+        e = c_rbrangeset_allocate(&s, UINT64_MAX, &start);
+        assert(!e && start == 0);
+        assert(c_rbrangeset_is_empty(&s));
+
+        c_rbrangeset_deinit(&s);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_coalesce();
+        test_random();
+        return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Tests for Two-Dimensional Range Trees
+ * This runs random insertions and removals on a range tree, interleaved with
+ * random rectangle queries, and verifies the reported entries against a
+ * brute-force scan over all entries.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbrangetree.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_ENTRIES 2048
+#define N_STEPS 20000
+#define N_KEYS 256
+
+typedef struct {
+        CRBRangeTreeEntry rt;
+        bool linked;
+        unsigned int n_reported;
+} Entry;
+
+static size_t n_reported;
+
+static int report(CRBRangeTreeEntry *e, void *userdata) {
+        Entry *entry = c_rbnode_entry(&e->rb, Entry, rt.rb);
+
+        ++entry->n_reported;
+        ++n_reported;
+        return 0;
+}
+
+static int count(CRBRangeTreeEntry *e, void *userdata) {
+        ++*(size_t *)userdata;
+        return 0;
+}
+
+static int stop(CRBRangeTreeEntry *e, void *userdata) {
+        ++*(size_t *)userdata;
+        return -EINTR;
+}
+
+static void verify(CRBRangeTree *t, Entry *entries) {
+        uint64_t a, b, c, d;
+        size_t i, n = 0;
+        bool match;
+        int r;
+
+        a = rand() % N_KEYS;
+        b = a + rand() % (N_KEYS / 4);
+        c = rand() % N_KEYS;
+        d = c + rand() % (N_KEYS / 2);
+
+        n_reported = 0;
+        r = c_rbrangetree_query(t, a, b, c, d, report, NULL);
+        assert(!r);
+
+        for (i = 0; i < N_ENTRIES; ++i) {
+                match = entries[i].linked &&
+                        entries[i].rt.key >= a && entries[i].rt.key <= b &&
+                        entries[i].rt.secondary >= c && entries[i].rt.secondary <= d;
+                assert(entries[i].n_reported == match);
+                entries[i].n_reported = 0;
+                n += match;
+        }
+
+        assert(n_reported == n);
+
+        /* a non-zero return stops the query */
+        i = 0;
+        r = c_rbrangetree_query(t, a, b, c, d, stop, &i);
+        assert(r == (n ? -EINTR : 0));
+        assert(i == !!n);
+}
+
+static void test_random(void) {
+        Entry *entries, *e;
+        CRBRangeTree t;
+        size_t i;
+        int r;
+
+        entries = calloc(N_ENTRIES, sizeof(*entries));
+        assert(entries);
+
+        for (i = 0; i < N_ENTRIES; ++i)
+                entries[i].rt = (CRBRangeTreeEntry)C_RBRANGETREE_ENTRY_INIT(entries[i].rt);
+
+        c_rbrangetree_init(&t);
+        assert(c_rbrangetree_is_empty(&t));
+
+        for (i = 0; i < N_STEPS; ++i) {
+                e = &entries[rand() % N_ENTRIES];
+
+                switch (rand() % 8) {
+                case 0:
+                case 1:
+                case 2:
+                        if (e->linked) {
+                                c_rbrangetree_remove(&t, &e->rt);
+                                assert(e->rt.slot == SIZE_MAX);
+                                assert(!c_rbnode_is_linked(&e->rt.rb));
+                                e->linked = false;
+                        }
+                        c_rbrangetree_add(&t, &e->rt, rand() % N_KEYS, rand() % N_KEYS);
+                        e->linked = true;
+                        break;
+                case 3:
+                case 4:
+                        if (e->linked) {
+                                c_rbrangetree_remove(&t, &e->rt);
+                                e->linked = false;
+                        }
+                        break;
+                case 5:
+                        if (!(rand() % 64)) {
+                                r = c_rbrangetree_rebuild(&t);
+                                assert(!r);
+                                assert(!t.n_staged && !t.n_tombstones);
+                        }
+                        break;
+                default:
+                        verify(&t, entries);
+                        break;
+                }
+        }
+
+        c_rbrangetree_deinit(&t);
+        assert(c_rbrangetree_is_empty(&t));
+
+        for (i = 0; i < N_ENTRIES; ++i) {
+                assert(!c_rbnode_is_linked(&entries[i].rt.rb));
+                assert(entries[i].rt.slot == SIZE_MAX);
+        }
+
+        free(entries);
+}
+
+static void test_empty(void) {
+        CRBRangeTreeEntry e = C_RBRANGETREE_ENTRY_INIT(e);
+        CRBRangeTree t = C_RBRANGETREE_INIT;
+        size_t n = 0;
+        int r;
+
+        r = c_rbrangetree_query(&t, 0, UINT64_MAX, 0, UINT64_MAX, stop, NULL);
+        assert(!r);
+
+        c_rbrangetree_add(&t, &e, UINT64_MAX, UINT64_MAX);
+        r = c_rbrangetree_rebuild(&t);
+        assert(!r);
+        assert(e.slot == 0);
+
+        r = c_rbrangetree_query(&t, UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX, count, &n);
+        assert(!r && n == 1);
+
+        /* dropping the last entry releases the index */
+        c_rbrangetree_remove(&t, &e);
+        assert(c_rbrangetree_is_empty(&t));
+        r = c_rbrangetree_rebuild(&t);
+        assert(!r);
+        assert(!t.n_indexed && !t.slots);
+
+        c_rbrangetree_deinit(&t);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_empty();
+        test_random();
+        return 0;
+}
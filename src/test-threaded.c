@@ -0,0 +1,127 @@
+/*
+ * Tests for Threaded Trees
+ * This adds and removes random keys, and verifies after each step that the
+ * list of entries matches the in-order traversal of the tree, in both
+ * directions. It also verifies lower-bound lookups, and removal from within
+ * the safe iterator.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbthreaded.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_KEYS 256
+#define N_STEPS 20000
+
+typedef struct {
+        unsigned long key;
+        CRBThreadedEntry th;
+} Node;
+
+#define node_from_th(_th) c_rbnode_entry((_th), Node, th)
+
+static int compare(CRBTree *t, void *k, CRBNode *n) {
+        unsigned long key = (unsigned long)k;
+        Node *node = c_rbnode_entry(n, Node, th.rb);
+
+        return (key < node->key) ? -1 : (key > node->key) ? 1 : 0;
+}
+
+static void verify(CRBThreaded *t, Node *nodes, const bool *linked) {
+        CRBThreadedEntry *e, *prev = NULL;
+        unsigned long k;
+        CRBNode *n;
+        size_t i;
+
+        /* the list matches the tree in both directions */
+        e = c_rbthreaded_first(t);
+        c_rbtree_for_each(n, &t->tree) {
+                assert(e && &e->rb == n);
+                assert(c_rbthreaded_prev(e) == prev);
+                prev = e;
+                e = c_rbthreaded_next(e);
+        }
+        assert(!e);
+        assert(c_rbthreaded_last(t) == prev);
+        assert(c_rbthreaded_is_empty(t) == !prev);
+
+        /* keys are even, so odd keys probe the gaps */
+        for (k = 0; k <= 2 * N_KEYS; ++k) {
+                for (i = (k + 1) / 2; i < N_KEYS && !linked[i]; ++i)
+                        ;
+
+                e = c_rbthreaded_lower_bound(t, compare, (void *)k);
+                assert(e == (i < N_KEYS ? &nodes[i].th : NULL));
+
+                e = c_rbthreaded_find(t, compare, (void *)k);
+                assert(e == ((k % 2 == 0 && k / 2 < N_KEYS && linked[k / 2]) ? &nodes[k / 2].th : NULL));
+        }
+}
+
+static void test_random(void) {
+        CRBThreaded t = C_RBTHREADED_INIT;
+        CRBThreadedEntry *e, *safe;
+        bool linked[N_KEYS] = {};
+        Node nodes[N_KEYS];
+        CRBNode **slot, *p;
+        size_t i, k, n;
+
+        for (i = 0; i < N_KEYS; ++i) {
+                nodes[i].key = 2 * i;
+                nodes[i].th = (CRBThreadedEntry)C_RBTHREADED_ENTRY_INIT(nodes[i].th);
+        }
+
+        verify(&t, nodes, linked);
+
+        for (i = 0; i < N_STEPS; ++i) {
+                k = rand() % N_KEYS;
+
+                if (!linked[k]) {
+                        slot = c_rbtree_find_slot(&t.tree, compare, (void *)nodes[k].key, &p);
+                        assert(slot);
+                        c_rbthreaded_add(&t, p, slot, &nodes[k].th);
+                } else {
+                        c_rbthreaded_remove(&t, &nodes[k].th);
+                        assert(!c_rbnode_is_linked(&nodes[k].th.rb));
+                }
+
+                linked[k] = !linked[k];
+                if (!(i % 32))
+                        verify(&t, nodes, linked);
+        }
+
+        verify(&t, nodes, linked);
+
+        /* remove every other entry while iterating, then the rest */
+        n = 0;
+        c_rbthreaded_for_each_safe(e, safe, &t) {
+                if (n++ % 2) {
+                        c_rbthreaded_remove(&t, e);
+                        linked[node_from_th(e)->key / 2] = false;
+                }
+        }
+        verify(&t, nodes, linked);
+
+        c_rbthreaded_for_each_safe(e, safe, &t)
+                c_rbthreaded_remove(&t, e);
+
+        memset(linked, 0, sizeof(linked));
+        verify(&t, nodes, linked);
+        assert(c_rbtree_is_empty(&t.tree));
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_random();
+        return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Tests for Top-K Selection
+ * This streams random values, with plenty of duplicates, through top-k
+ * containers of different sizes, and verifies the selection against sorting
+ * the whole stream. It also verifies the cached minimum, and the tree order,
+ * after each step, which covers c_rbnode_replace().
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbtopk.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_VALUES 8192
+
+typedef struct {
+        unsigned int value;
+        CRBNode rb;
+} Node;
+
+#define node_from_rb(_rb) c_rbnode_entry((_rb), Node, rb)
+
+static int compare(CRBNode *a, CRBNode *b) {
+        unsigned int va = node_from_rb(a)->value, vb = node_from_rb(b)->value;
+
+        return (va < vb) ? -1 : (va > vb) ? 1 : 0;
+}
+
+static int compare_value(const void *a, const void *b) {
+        unsigned int va = *(const unsigned int *)a, vb = *(const unsigned int *)b;
+
+        return (va < vb) ? -1 : (va > vb) ? 1 : 0;
+}
+
+static void verify(CRBTopk *t, unsigned int threshold) {
+        CRBNode *n, *prev = NULL;
+        size_t n_nodes = 0;
+
+        assert(c_rbtopk_min(t) == c_rbtree_first(&t->tree));
+
+        c_rbtree_for_each(n, &t->tree) {
+                assert(!prev || compare(prev, n) <= 0);
+                assert(node_from_rb(n)->value >= threshold);
+                prev = n;
+                ++n_nodes;
+        }
+
+        assert(n_nodes == t->n_nodes);
+        assert(n_nodes <= t->k);
+}
+
+static void test_stream(size_t k, unsigned int range) {
+        unsigned int *values, threshold = 0;
+        CRBNode *n, *r;
+        CRBTopk t;
+        Node *nodes;
+        size_t i;
+
+        nodes = calloc(N_VALUES, sizeof(*nodes));
+        values = malloc(N_VALUES * sizeof(*values));
+        assert(nodes && values);
+
+        c_rbtopk_init(&t, compare, k);
+        assert(!c_rbtopk_min(&t));
+
+        for (i = 0; i < N_VALUES; ++i) {
+                nodes[i].value = rand() % range;
+                values[i] = nodes[i].value;
+                c_rbnode_init(&nodes[i].rb);
+
+                r = c_rbtopk_push(&t, &nodes[i].rb);
+                if (i < k) {
+                        assert(!r);
+                } else {
+                        assert(r);
+                        assert(!c_rbnode_is_linked(r));
+                        assert(r == &nodes[i].rb || c_rbnode_is_linked(&nodes[i].rb));
+
+                        /* nothing we dropped may exceed anything we keep */
+                        if (node_from_rb(r)->value > threshold)
+                                threshold = node_from_rb(r)->value;
+                }
+
+                assert(c_rbtopk_is_full(&t) == (i + 1 >= k));
+                verify(&t, threshold);
+        }
+
+        /* the kept values are exactly the top-k of the stream */
+        qsort(values, N_VALUES, sizeof(*values), compare_value);
+        i = N_VALUES - t.n_nodes;
+        c_rbtree_for_each(n, &t.tree)
+                assert(node_from_rb(n)->value == values[i++]);
+        assert(i == N_VALUES);
+
+        /* removal keeps the cached minimum intact */
+        while (t.n_nodes) {
+                n = (rand() % 2) ? c_rbtopk_min(&t) : t.tree.root;
+                c_rbtopk_remove(&t, n);
+                assert(!c_rbnode_is_linked(n));
+                verify(&t, threshold);
+        }
+
+        assert(!c_rbtopk_min(&t));
+        assert(c_rbtree_is_empty(&t.tree));
+
+        free(values);
+        free(nodes);
+}
+
+static void test_replace(void) {
+        CRBTree t = C_RBTREE_INIT;
+        CRBNode a, b, c, d;
+
+        /* replace the root, an inner node, and a leaf */
+        c_rbtree_add(&t, NULL, &t.root, &b);
+        c_rbtree_add(&t, &b, &b.left, &a);
+        c_rbtree_add(&t, &b, &b.right, &c);
+
+        c_rbnode_replace(&b, &d);
+        assert(t.root == &d);
+        assert(!c_rbnode_parent(&d));
+        assert(c_rbnode_parent(&a) == &d && c_rbnode_parent(&c) == &d);
+        assert(!c_rbnode_is_linked(&b));
+
+        c_rbnode_replace(&a, &b);
+        assert(d.left == &b && c_rbnode_parent(&b) == &d);
+        assert(!c_rbnode_is_linked(&a));
+
+        c_rbnode_unlink(&b);
+        c_rbnode_unlink(&c);
+        c_rbnode_unlink(&d);
+        assert(c_rbtree_is_empty(&t));
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_replace();
+        test_stream(1, 1000);
+        test_stream(64, 1000);
+        test_stream(64, 16);
+        test_stream(1000, 100000);
+        test_stream(N_VALUES, 100);
+        return 0;
+}
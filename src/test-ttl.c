@@ -0,0 +1,183 @@
+/*
+ * Tests for TTL Caches
+ * This runs random adds, refreshes, removals, and expiries on a size-bounded
+ * cache with few hash buckets, and verifies the cache against a plain array
+ * of expiry times after each step. Expiry times are coarse, so many entries
+ * share them, which covers the ordering of ties as well as in-place refreshes.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c-rbttl.h"
+#include "c-rbtree.h"
+#include "c-rbtree-private.h"
+
+#define N_KEYS 512
+#define N_BUCKETS 64
+#define N_STEPS 50000
+#define MAX_ENTRIES 200
+
+typedef struct {
+        unsigned long key;
+        bool linked;
+        uint64_t seq;
+        CRBTtlEntry ttl;
+} Node;
+
+#define node_from_ttl(_ttl) c_rbnode_entry((_ttl), Node, ttl)
+
+static uint64_t seq;
+
+static size_t hash(unsigned long key) {
+        return key * 0x9e3779b97f4a7c15ULL;
+}
+
+static bool equal(CRBTtlEntry *e, const void *k) {
+        return node_from_ttl(e)->key == (unsigned long)k;
+}
+
+/* entries are ordered by expiry, and by the time they were (re)linked */
+static bool before(Node *a, Node *b) {
+        return a->ttl.expiry < b->ttl.expiry || (a->ttl.expiry == b->ttl.expiry && a->seq < b->seq);
+}
+
+static Node *earliest(Node *nodes) {
+        Node *min = NULL;
+        size_t i;
+
+        for (i = 0; i < N_KEYS; ++i)
+                if (nodes[i].linked && (!min || before(&nodes[i], min)))
+                        min = &nodes[i];
+
+        return min;
+}
+
+static void verify(CRBTtl *c, Node *nodes) {
+        Node *prev = NULL, *node;
+        size_t i, n_linked = 0;
+        CRBNode *n;
+
+        c_rbtree_for_each(n, &c->tree) {
+                node = c_rbnode_entry(n, Node, ttl.rb);
+                assert(node->linked);
+                assert(!prev || before(prev, node));
+                prev = node;
+        }
+
+        for (i = 0; i < N_KEYS; ++i) {
+                assert(c_rbttl_find(c, hash(i), equal, (void *)i) == (nodes[i].linked ? &nodes[i].ttl : NULL));
+                n_linked += nodes[i].linked;
+        }
+
+        assert(c->n_entries == n_linked);
+        assert(n_linked <= MAX_ENTRIES);
+        assert(c_rbttl_is_empty(c) == !n_linked);
+}
+
+static void test_random(void) {
+        CRBTtlEntry *buckets[N_BUCKETS], *e, *next;
+        Node nodes[N_KEYS], *node, *expected;
+        size_t i, k, n_expired, n_expected;
+        uint64_t now = 0, expiry, last;
+        CRBTtl c;
+
+        c_rbttl_init(&c, buckets, N_BUCKETS, MAX_ENTRIES);
+        assert(c_rbttl_is_empty(&c));
+
+        for (i = 0; i < N_KEYS; ++i) {
+                nodes[i] = (Node){ .key = i, .ttl = C_RBTTL_ENTRY_INIT(nodes[i].ttl) };
+                assert(!c_rbttl_find(&c, hash(i), equal, (void *)i));
+        }
+
+        for (i = 0; i < N_STEPS; ++i) {
+                k = rand() % N_KEYS;
+                node = &nodes[k];
+
+                switch (rand() % 8) {
+                case 0:
+                case 1:
+                case 2:
+                        if (node->linked) {
+                                /* refreshed entries are ordered last, unless unchanged */
+                                expiry = now + rand() % 16;
+                                if (expiry != node->ttl.expiry)
+                                        node->seq = ++seq;
+                                c_rbttl_refresh(&c, &node->ttl, expiry);
+                                break;
+                        }
+
+                        expected = (c.n_entries >= MAX_ENTRIES) ? earliest(nodes) : NULL;
+                        e = c_rbttl_add(&c, &node->ttl, hash(k), now + rand() % 16);
+                        assert(e == (expected ? &expected->ttl : NULL));
+                        if (e) {
+                                assert(!c_rbnode_is_linked(&e->rb));
+                                node_from_ttl(e)->linked = false;
+                        }
+                        node->linked = true;
+                        node->seq = ++seq;
+                        break;
+                case 3:
+                        if (node->linked) {
+                                c_rbttl_remove(&c, &node->ttl);
+                                assert(!c_rbnode_is_linked(&node->ttl.rb));
+                                node->linked = false;
+                        }
+                        break;
+                default:
+                        if (rand() % 8)
+                                break;
+
+                        /* sometimes expire most entries, sometimes few */
+                        now += rand() % ((rand() % 2) ? 4 : 16);
+
+                        n_expected = 0;
+                        for (k = 0; k < N_KEYS; ++k)
+                                n_expected += nodes[k].linked && nodes[k].ttl.expiry <= now;
+
+                        e = c_rbttl_expire(&c, now, &n_expired);
+                        assert(n_expired == n_expected);
+
+                        for (last = 0, node = NULL; e; e = next) {
+                                next = e->hash_next;
+                                assert(!c_rbnode_is_linked(&e->rb));
+                                assert(e->expiry <= now);
+                                assert(e->expiry >= last);
+                                assert(node_from_ttl(e)->linked);
+                                assert(!node || before(node, node_from_ttl(e)));
+
+                                node = node_from_ttl(e);
+                                node->linked = false;
+                                last = e->expiry;
+                                --n_expected;
+                        }
+                        assert(!n_expected);
+                        break;
+                }
+
+                verify(&c, nodes);
+        }
+
+        /* expiring everything empties the cache */
+        assert(c_rbttl_expire(&c, UINT64_MAX, &n_expired) || !n_expired);
+        for (i = 0; i < N_KEYS; ++i)
+                nodes[i].linked = false;
+        verify(&c, nodes);
+        assert(c_rbtree_is_empty(&c.tree));
+        assert(!c_rbttl_expire(&c, UINT64_MAX, &n_expired));
+        assert(!n_expired);
+}
+
+int main(int argc, char **argv) {
+        /* we want stable tests, so use fixed seed */
+        srand(0xdeadbeef);
+
+        test_random();
+        return 0;
+}